@@ -0,0 +1,510 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+/*
+Python bindings of libmolasses (see src/include/molasses.h):
+
+	import molasses, numpy as np
+	dem = molasses.Dem("dem.tif")
+	dem.ensemble()                          # keep hits and statistics
+	dem.run([(501500, 4001500)], volume=1e6, pulse=100, residual=2, runs=50)
+	hits = np.asarray(dem.hits)             # rows x cols, row 0 is the south row
+	elevation = np.asarray(dem.elevation)
+
+The grids are Raster objects exporting the buffer protocol: numpy
+arrays made from them are views of the simulation's own memory, no
+copy is made, and they follow the flows as they run. While such views
+exist the Dem cannot be closed, nor the ensemble restarted if they are
+of its grids.
+
+run() releases the GIL for the whole simulation, so other Python
+threads go on meanwhile; a Dem runs one flow at a time. Run k of a
+call spreads its lava from seed + k (seed=0 by default), so Dems run
+in threads give the flows they would give one after the other.
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include "molasses.h"
+
+typedef struct {
+	PyObject_HEAD
+	MolassesContext *ctx;
+	int cols, rows;
+	double gt[6];
+	Py_ssize_t exports[6];    /* buffers handed out by its Rasters, per grid */
+	int busy;                 /* running a flow without the GIL */
+} DemObject;
+
+typedef struct {
+	PyObject_HEAD
+	DemObject *dem;
+	int which;
+	Py_ssize_t shape[2];
+	Py_ssize_t strides[2];
+} RasterObject;
+
+static PyTypeObject DemType, RasterType;
+
+static const char *grid_names[] = {"elevation", "thickness", "hits", "mean", "m2", "max"};
+
+/* RETURN 0, -1 with an exception set */
+static int dem_ready(
+DemObject *self)
+{
+	if (self->ctx == NULL) {
+		PyErr_SetString(PyExc_ValueError, "the Dem is closed");
+		return -1;
+	}
+	if (self->busy) {
+		PyErr_SetString(PyExc_RuntimeError, "the Dem is running a flow");
+		return -1;
+	}
+	return 0;
+}
+
+/*****************************
+Raster: a grid of a Dem as a buffer
+*******************************/
+
+static int raster_getbuffer(
+RasterObject *self,
+Py_buffer *view,
+int flags)
+{
+	MolassesRaster raster;
+	DemObject *dem = self->dem;
+
+	if (dem->ctx == NULL) {
+		PyErr_SetString(PyExc_BufferError, "the Dem is closed");
+		return -1;
+	}
+	if (flags & PyBUF_WRITABLE) {
+		PyErr_SetString(PyExc_BufferError, "the grids are read-only");
+		return -1;
+	}
+	if (molasses_raster(dem->ctx, self->which, &raster)) {
+		PyErr_Format(PyExc_BufferError, "%s is not kept, see Dem.ensemble()", grid_names[self->which]);
+		return -1;
+	}
+	/* the grids of the cell struct are strided */
+	if ((flags & PyBUF_STRIDES) != PyBUF_STRIDES &&
+	    raster.col_stride != (long) (raster.format == 'i' ? sizeof(int) : sizeof(double))) {
+		PyErr_SetString(PyExc_BufferError, "the grid is not contiguous, ask for strides");
+		return -1;
+	}
+	self->shape[0] = raster.rows;
+	self->shape[1] = raster.cols;
+	self->strides[0] = raster.row_stride;
+	self->strides[1] = raster.col_stride;
+
+	view->obj = (PyObject *) self;
+	Py_INCREF(self);
+	view->buf = raster.data;
+	view->itemsize = (raster.format == 'i') ? sizeof(int) : sizeof(double);
+	view->len = (Py_ssize_t) raster.rows * raster.cols * view->itemsize;
+	view->readonly = 1;
+	view->format = (flags & PyBUF_FORMAT) ? (raster.format == 'i' ? "i" : "d") : NULL;
+	view->ndim = 2;
+	view->shape = self->shape;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	dem->exports[self->which]++;
+	return 0;
+}
+
+static void raster_releasebuffer(
+RasterObject *self,
+Py_buffer *view)
+{
+	self->dem->exports[self->which]--;
+}
+
+static PyBufferProcs raster_as_buffer = {
+	(getbufferproc) raster_getbuffer,
+	(releasebufferproc) raster_releasebuffer,
+};
+
+static void raster_dealloc(
+RasterObject *self)
+{
+	Py_XDECREF(self->dem);
+	Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *raster_repr(
+RasterObject *self)
+{
+	return PyUnicode_FromFormat("<molasses.Raster %s %d x %d>", grid_names[self->which],
+	                            self->dem->rows, self->dem->cols);
+}
+
+static PyTypeObject RasterType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "molasses.Raster",
+	.tp_basicsize = sizeof(RasterObject),
+	.tp_dealloc = (destructor) raster_dealloc,
+	.tp_repr = (reprfunc) raster_repr,
+	.tp_as_buffer = &raster_as_buffer,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "A grid of a Dem, rows x cols with row 0 the south row; "
+	          "numpy.asarray(raster) is a view of it",
+};
+
+/*****************************
+Dem
+*******************************/
+
+static int dem_init(
+DemObject *self,
+PyObject *args,
+PyObject *kwds)
+{
+	static char *keywords[] = {"dem_file", NULL};
+	PyObject *path;
+	MolassesContext *ctx;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&", keywords, PyUnicode_FSConverter, &path))
+		return -1;
+	if (self->ctx != NULL) {
+		Py_DECREF(path);
+		PyErr_SetString(PyExc_RuntimeError, "the Dem is already open");
+		return -1;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	ctx = molasses_open(PyBytes_AS_STRING(path));
+	Py_END_ALLOW_THREADS
+	if (ctx == NULL) {
+		PyErr_Format(PyExc_OSError, "cannot load the DEM %s", PyBytes_AS_STRING(path));
+		Py_DECREF(path);
+		return -1;
+	}
+	Py_DECREF(path);
+	self->ctx = ctx;
+	molasses_grid(ctx, &self->cols, &self->rows, self->gt);
+	return 0;
+}
+
+static void dem_dealloc(
+DemObject *self)
+{
+	/* no Raster is left, each holds a reference */
+	if (self->ctx != NULL) molasses_close(self->ctx);
+	Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *dem_close(
+DemObject *self,
+PyObject *unused)
+{
+	int i;
+
+	if (self->ctx == NULL) Py_RETURN_NONE;
+	if (dem_ready(self)) return NULL;
+	for (i = 0; i < 6 && !self->exports[i]; i++);
+	if (i < 6) {
+		PyErr_SetString(PyExc_BufferError, "views of the grids exist");
+		return NULL;
+	}
+	molasses_close(self->ctx);
+	self->ctx = NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *dem_ensemble(
+DemObject *self,
+PyObject *args,
+PyObject *kwds)
+{
+	static char *keywords[] = {"keep", NULL};
+	int keep = 1;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p", keywords, &keep)) return NULL;
+	if (dem_ready(self)) return NULL;
+	/* elevation and hits stay in place, the others are reallocated */
+	if (self->exports[MOLASSES_THICKNESS] || self->exports[MOLASSES_MEAN] ||
+	    self->exports[MOLASSES_M2] || self->exports[MOLASSES_MAX]) {
+		PyErr_SetString(PyExc_BufferError, "views of the ensemble grids exist");
+		return NULL;
+	}
+	if (molasses_ensemble(self->ctx, keep)) {
+		PyErr_SetString(PyExc_MemoryError, molasses_error(self->ctx));
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+/* Largest thickness and cell count of a flow */
+typedef struct {
+	unsigned int cells;
+	double max_thickness;
+} FlowSummary;
+
+static int summary_cell(
+const MolassesCell *cell,
+void *user)
+{
+	FlowSummary *sum = (FlowSummary *) user;
+
+	sum->cells++;
+	if (cell->thickness > sum->max_thickness) sum->max_thickness = cell->thickness;
+	return 0;
+}
+
+/* vents: one (easting, northing) pair or a sequence of them.
+   RETURN the vents (PyMem), NULL with an exception set */
+static MolassesVent *read_vents(
+PyObject *obj,
+int *num_vents)
+{
+	PyObject *seq, *pair, *item;
+	MolassesVent *vents;
+	Py_ssize_t n, i;
+
+	seq = PySequence_Fast(obj, "vents must be a sequence of (easting, northing)");
+	if (seq == NULL) return NULL;
+	n = PySequence_Fast_GET_SIZE(seq);
+	if (n == 2 && PyNumber_Check(PySequence_Fast_GET_ITEM(seq, 0))) {
+		vents = PyMem_New(MolassesVent, 1);
+		if (vents == NULL) {
+			Py_DECREF(seq);
+			return (MolassesVent *) PyErr_NoMemory();
+		}
+		vents->easting = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, 0));
+		vents->northing = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, 1));
+		*num_vents = 1;
+	}
+	else {
+		vents = PyMem_New(MolassesVent, n ? n : 1);
+		if (vents == NULL) {
+			Py_DECREF(seq);
+			return (MolassesVent *) PyErr_NoMemory();
+		}
+		for (i = 0; i < n && !PyErr_Occurred(); i++) {
+			pair = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, i), "a vent is (easting, northing)");
+			if (pair == NULL) break;
+			if (PySequence_Fast_GET_SIZE(pair) != 2) {
+				PyErr_SetString(PyExc_ValueError, "a vent is (easting, northing)");
+			}
+			else {
+				item = PySequence_Fast_GET_ITEM(pair, 0);
+				vents[i].easting = PyFloat_AsDouble(item);
+				item = PySequence_Fast_GET_ITEM(pair, 1);
+				vents[i].northing = PyFloat_AsDouble(item);
+			}
+			Py_DECREF(pair);
+		}
+		*num_vents = (int) n;
+		if (!n && !PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "no vents");
+	}
+	Py_DECREF(seq);
+	if (PyErr_Occurred()) {
+		PyMem_Free(vents);
+		return NULL;
+	}
+	return vents;
+}
+
+static PyObject *dem_run(
+DemObject *self,
+PyObject *args,
+PyObject *kwds)
+{
+	static char *keywords[] = {"vents", "volume", "pulse", "residual", "runs", "seed", NULL};
+	PyObject *vent_obj, *result, *item;
+	MolassesVent *vents;
+	FlowSummary *sums;
+	double volume, pulse, residual;
+	unsigned int seed = 0;
+	int num_vents = 0, runs = 1, run, ret = MOLASSES_OK;
+	char error[256];
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oddd|iI", keywords,
+	                                 &vent_obj, &volume, &pulse, &residual, &runs, &seed))
+		return NULL;
+	if (dem_ready(self)) return NULL;
+	if (runs < 1) {
+		PyErr_SetString(PyExc_ValueError, "runs must be at least 1");
+		return NULL;
+	}
+	vents = read_vents(vent_obj, &num_vents);
+	if (vents == NULL) return NULL;
+	sums = PyMem_New(FlowSummary, runs);
+	if (sums == NULL) {
+		PyMem_Free(vents);
+		return PyErr_NoMemory();
+	}
+	memset(sums, 0, runs * sizeof(FlowSummary));
+
+	self->busy = 1;
+	Py_BEGIN_ALLOW_THREADS
+	for (run = 0; run < runs && ret == MOLASSES_OK; run++)
+		ret = molasses_run_callback(self->ctx, vents, num_vents, volume, pulse, residual,
+		                            seed + (unsigned int) run, summary_cell, sums + run);
+	if (ret) snprintf(error, sizeof error, "%s", molasses_error(self->ctx));
+	Py_END_ALLOW_THREADS
+	self->busy = 0;
+	PyMem_Free(vents);
+	if (ret) {
+		PyMem_Free(sums);
+		PyErr_SetString(PyExc_ValueError, error);
+		return NULL;
+	}
+
+	result = PyList_New(runs);
+	for (run = 0; result != NULL && run < runs; run++) {
+		item = Py_BuildValue("{s:I,s:d,s:d}", "cells", sums[run].cells,
+		                     "area_km2", sums[run].cells * self->gt[1] * -self->gt[5] * 1e-6,
+		                     "max_thickness", sums[run].max_thickness);
+		if (item == NULL) Py_CLEAR(result);
+		else PyList_SET_ITEM(result, run, item);
+	}
+	PyMem_Free(sums);
+	return result;
+}
+
+static PyObject *dem_raster(
+DemObject *self,
+void *which)
+{
+	RasterObject *raster;
+
+	if (self->ctx == NULL) {
+		PyErr_SetString(PyExc_ValueError, "the Dem is closed");
+		return NULL;
+	}
+	raster = PyObject_New(RasterObject, &RasterType);
+	if (raster == NULL) return NULL;
+	Py_INCREF(self);
+	raster->dem = self;
+	raster->which = (int) (Py_intptr_t) which;
+	return (PyObject *) raster;
+}
+
+static PyObject *dem_get_geotransform(
+DemObject *self,
+void *unused)
+{
+	return Py_BuildValue("(dddddd)", self->gt[0], self->gt[1], self->gt[2],
+	                     self->gt[3], self->gt[4], self->gt[5]);
+}
+
+static PyObject *dem_get_flows(
+DemObject *self,
+void *unused)
+{
+	if (self->ctx == NULL) return PyLong_FromLong(0);
+	return PyLong_FromUnsignedLong(molasses_flows(self->ctx));
+}
+
+static PyMemberDef dem_members[] = {
+	{"cols", T_INT, offsetof(DemObject, cols), READONLY, "columns of the grid"},
+	{"rows", T_INT, offsetof(DemObject, rows), READONLY, "rows of the grid"},
+	{NULL}
+};
+
+static PyGetSetDef dem_getset[] = {
+	{"geotransform", (getter) dem_get_geotransform, NULL, "GDAL geotransform of the DEM (north-up)", NULL},
+	{"flows", (getter) dem_get_flows, NULL, "flows in the ensemble", NULL},
+	{"elevation", (getter) dem_raster, NULL, "DEM elevation (float64)", (void *) MOLASSES_ELEVATION},
+	{"thickness", (getter) dem_raster, NULL, "lava thickness of the last flow (float64)", (void *) MOLASSES_THICKNESS},
+	{"hits", (getter) dem_raster, NULL, "flows that inundated each cell (int32)", (void *) MOLASSES_HITS},
+	{"mean", (getter) dem_raster, NULL, "mean thickness where inundated (float64)", (void *) MOLASSES_MEAN},
+	{"m2", (getter) dem_raster, NULL, "sum of squared differences from the mean (float64); "
+	                                  "std = sqrt(m2 / (hits - 1))", (void *) MOLASSES_M2},
+	{"max", (getter) dem_raster, NULL, "largest thickness (float64)", (void *) MOLASSES_MAX},
+	{NULL}
+};
+
+static PyMethodDef dem_methods[] = {
+	{"run", (PyCFunction) (void (*)(void)) dem_run, METH_VARARGS | METH_KEYWORDS,
+	 "run(vents, volume, pulse, residual, runs=1, seed=0)\n"
+	 "Run flows from the vents, without the GIL; run k spreads its lava "
+	 "from seed + k. Returns a dict per run (cells, area_km2, max_thickness)."},
+	{"ensemble", (PyCFunction) (void (*)(void)) dem_ensemble, METH_VARARGS | METH_KEYWORDS,
+	 "ensemble(keep=True)\n"
+	 "Keep thickness, hits, mean, m2 and max of the flows from now on, from zero."},
+	{"close", (PyCFunction) dem_close, METH_NOARGS, "Release the DEM."},
+	{NULL}
+};
+
+static PyTypeObject DemType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "molasses.Dem",
+	.tp_basicsize = sizeof(DemObject),
+	.tp_dealloc = (destructor) dem_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "Dem(dem_file): a DEM loaded once to run lava flows on",
+	.tp_methods = dem_methods,
+	.tp_members = dem_members,
+	.tp_getset = dem_getset,
+	.tp_init = (initproc) dem_init,
+	.tp_new = PyType_GenericNew,
+};
+
+static PyObject *module_thread_exit(
+PyObject *module,
+PyObject *unused)
+{
+	molasses_thread_exit();
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef module_methods[] = {
+	{"thread_exit", module_thread_exit, METH_NOARGS,
+	 "Call at the end of a thread that ran flows (see molasses.h)."},
+	{NULL}
+};
+
+static struct PyModuleDef molasses_module = {
+	PyModuleDef_HEAD_INIT,
+	.m_name = "molasses",
+	.m_doc = "MOLASSES lava flow simulations on DEMs kept in memory.",
+	.m_size = -1,
+	.m_methods = module_methods,
+};
+
+PyMODINIT_FUNC PyInit_molasses(void)
+{
+	PyObject *m;
+
+	if (PyType_Ready(&DemType) < 0 || PyType_Ready(&RasterType) < 0) return NULL;
+	m = PyModule_Create(&molasses_module);
+	if (m == NULL) return NULL;
+	Py_INCREF(&DemType);
+	if (PyModule_AddObject(m, "Dem", (PyObject *) &DemType) < 0) {
+		Py_DECREF(&DemType);
+		Py_DECREF(m);
+		return NULL;
+	}
+	Py_INCREF(&RasterType);
+	if (PyModule_AddObject(m, "Raster", (PyObject *) &RasterType) < 0) {
+		Py_DECREF(&RasterType);
+		Py_DECREF(m);
+		return NULL;
+	}
+	return m;
+}
@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################
+
+# Python bindings of libmolasses. Build libmolasses first (make libmolasses
+# in the top-level directory), then:
+#	python3 setup.py build_ext --inplace
+# The ranlib sources are compiled in, as ../lib/libran.a is not position
+# independent. GDAL_LIB_PATH in the environment adds a GDAL library path.
+
+import os
+from setuptools import setup, Extension
+
+top = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+ranlib = os.path.join(top, 'external_libraries', 'ranlib')
+library_dirs = [os.environ['GDAL_LIB_PATH']] if os.environ.get('GDAL_LIB_PATH') else []
+
+setup(
+	name='molasses',
+	version='1.0',
+	description='MOLASSES lava flow simulations on DEMs kept in memory',
+	ext_modules=[Extension(
+		'molasses',
+		sources=['molassesmodule.c',
+		         os.path.join(ranlib, 'ranlib.c'),
+		         os.path.join(ranlib, 'rnglib.c')],
+		include_dirs=[os.path.join(top, 'src', 'include'), ranlib],
+		extra_objects=[os.path.join(top, 'src', 'libmolasses.a')],
+		library_dirs=library_dirs,
+		libraries=['gdal', 'gc', 'z', 'm', 'pthread'],
+	)],
+)
@@ -0,0 +1,317 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+#include <unistd.h>
+
+/*****************************
+MODULE: ARCHIVE
+Write every run of an ensemble into one indexed flow archive file
+(FLOW_ARCHIVE = file) instead of one ASCII flow file per run.
+All values are written in native byte order (little-endian on x86 and ARM).
+
+File layout:
+	HEADER
+	char   magic[8]        "MOLFLOW1"
+	int    cols, rows
+	double gridinfo[6]     (this code's metadata format, see DEM_LOADER)
+
+	RUN RECORD (one per run)
+	char   tag[4]          "MRUN"
+	int    run
+	double volume, pulse volume, residual
+	int    num_vents
+	double easting, northing  (x num_vents)
+	unsigned int cells     (number of inundated cells)
+	unsigned long long raw_size, packed_size
+	packed_size bytes      zlib compressed block of raw_size bytes:
+	                       cells varints: cell index (row*cols+col) minus previous index
+	                       cells doubles: lava thickness
+	                       cells doubles: original (pre-flow) elevation
+
+	INDEX (written when the archive is closed)
+	char   tag[4]          "MIDX"
+	unsigned int count
+	int run, long long offset of its record  (x count)
+
+	FOOTER
+	long long offset of INDEX
+	char   magic[8]        "MOLFLEND"
+
+The new elevation of a cell is recovered as original elevation + thickness.
+Thickness is eff_elev - dem_elev, which is exact for lava thinner than the
+ground elevation, so this sum gives back eff_elev bit for bit.
+If a run ends without ARCHIVE_CLOSE, readers can still find the records
+by scanning them from the header.
+*******************************/
+
+/* Append an unsigned value as a LEB128 varint, return bytes written */
+size_t varint_put(
+unsigned char *buf,
+unsigned long long value)
+{
+	size_t n = 0;
+
+	while (value >= 0x80) {
+		buf[n++] = (unsigned char) (value | 0x80);
+		value >>= 7;
+	}
+	buf[n++] = (unsigned char) value;
+	return n;
+}
+
+/* Read a LEB128 varint, return bytes read or 0 if it runs past end */
+size_t varint_get(
+const unsigned char *buf,
+const unsigned char *end,
+unsigned long long *value)
+{
+	size_t n = 0;
+	int shift = 0;
+
+	*value = 0;
+	while (buf + n < end && shift < 64) {
+		*value |= (unsigned long long) (buf[n] & 0x7f) << shift;
+		if (!(buf[n++] & 0x80)) return n;
+		shift += 7;
+	}
+	return 0;
+}
+
+FlowArchive *ARCHIVE_OPEN(
+char *file,
+double *gridinfo)
+{
+	FlowArchive *archive;
+	int cols = (int) gridinfo[2];
+	int rows = (int) gridinfo[4];
+
+	archive = (FlowArchive *) GC_MALLOC(sizeof(FlowArchive));
+	if (archive == NULL) {
+		fprintf(stderr, "[ARCHIVE_OPEN] Out of Memory creating flow archive!\n");
+		return NULL;
+	}
+	archive->size = 1024;
+	archive->count = 0;
+	archive->runs = (int *) GC_MALLOC_ATOMIC(archive->size * sizeof(int));
+	archive->offsets = (long long *) GC_MALLOC_ATOMIC(archive->size * sizeof(long long));
+	if (archive->runs == NULL || archive->offsets == NULL) {
+		fprintf(stderr, "[ARCHIVE_OPEN] Out of Memory creating flow archive index!\n");
+		return NULL;
+	}
+	archive->fp = fopen(file, "wb");
+	if (archive->fp == NULL) {
+		fprintf(stderr, "Cannot open FLOW ARCHIVE file=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	archive->cols = cols;
+	archive->rows = rows;
+	pthread_mutex_init(&archive->lock, NULL);
+	fwrite(ARCHIVE_MAGIC, 1, 8, archive->fp);
+	fwrite(&cols, sizeof(int), 1, archive->fp);
+	fwrite(&rows, sizeof(int), 1, archive->fp);
+	fwrite(gridinfo, sizeof(double), 6, archive->fp);
+	if (ferror(archive->fp)) {
+		fprintf(stderr, "[ARCHIVE_OPEN] Cannot write header of [%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	fprintf(stdout, "Writing flows to archive: %s\n", file);
+	return archive;
+}
+
+/* Go on writing an archive of a checkpointed ensemble (see ENSEMBLE_STATE):
+   drop what was written after the checkpoint and take back its index.
+   Also reopens footprint indexes (magic FOOTINDEX_MAGIC). */
+FlowArchive *ARCHIVE_REOPEN(
+char *file,
+double *gridinfo,
+const char *magic,
+FlowArchive *saved,
+long long size)
+{
+	FlowArchive *archive;
+	char head[8];
+	int cols, rows;
+	double info[6];
+	size_t n;
+
+	archive = (FlowArchive *) GC_MALLOC(sizeof(FlowArchive));
+	if (archive == NULL) {
+		fprintf(stderr, "[ARCHIVE_REOPEN] Out of Memory reopening [%s]!\n", file);
+		return NULL;
+	}
+	archive->count = saved->count;
+	archive->size = (saved->count < 1024) ? 1024 : saved->count;
+	archive->runs = (int *) GC_MALLOC_ATOMIC(archive->size * sizeof(int));
+	archive->offsets = (long long *) GC_MALLOC_ATOMIC(archive->size * sizeof(long long));
+	if (archive->runs == NULL || archive->offsets == NULL) {
+		fprintf(stderr, "[ARCHIVE_REOPEN] Out of Memory reopening [%s]!\n", file);
+		return NULL;
+	}
+	memcpy(archive->runs, saved->runs, saved->count * sizeof(int));
+	memcpy(archive->offsets, saved->offsets, saved->count * sizeof(long long));
+	archive->fp = fopen(file, "r+b");
+	if (archive->fp == NULL) {
+		fprintf(stderr, "Cannot reopen file=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	n = fread(head, 1, 8, archive->fp);
+	n += fread(&cols, sizeof(int), 1, archive->fp);
+	n += fread(&rows, sizeof(int), 1, archive->fp);
+	n += fread(info, sizeof(double), 6, archive->fp);
+	if (n != 16 || memcmp(head, magic, 8) || cols != (int) gridinfo[2] || rows != (int) gridinfo[4] ||
+	    memcmp(info, gridinfo, sizeof info)) {
+		fprintf(stderr, "[ARCHIVE_REOPEN] [%s] is not the file of the checkpoint!\n", file);
+		fclose(archive->fp);
+		return NULL;
+	}
+	if (fseeko(archive->fp, 0, SEEK_END) || (long long) ftello(archive->fp) < size) {
+		fprintf(stderr, "[ARCHIVE_REOPEN] [%s] is shorter than at the checkpoint!\n", file);
+		fclose(archive->fp);
+		return NULL;
+	}
+	if (ftruncate(fileno(archive->fp), (off_t) size) || fseeko(archive->fp, 0, SEEK_END)) {
+		fprintf(stderr, "[ARCHIVE_REOPEN] Cannot truncate [%s]:[%s]!\n", file, strerror(errno));
+		fclose(archive->fp);
+		return NULL;
+	}
+	archive->cols = cols;
+	archive->rows = rows;
+	pthread_mutex_init(&archive->lock, NULL);
+	fprintf(stdout, "Writing flows to %s after its %u runs\n", file, archive->count);
+	return archive;
+}
+
+/* Append the footprint of one run to the archive.
+   The cells are compressed by the calling thread; only the file write
+   is serialized, so several output threads can append at once. */
+int ARCHIVE_WRITE_RUN(
+FlowArchive *archive,
+FlowFootprint *fp)
+{
+	unsigned int cells = fp->count, c;
+	int i;
+	size_t nvar = 0;
+	unsigned long long index, last = 0, raw_size, packed_size;
+	uLongf packed_len;
+	unsigned char *raw, *packed;
+	double thickness;
+	int *grown_runs;
+	long long *grown_offsets;
+
+	/* Worst case: a 10 byte varint and two doubles per cell */
+	raw = (unsigned char *) GC_MALLOC_ATOMIC((size_t) cells * (10 + 2 * sizeof(double)) + 1);
+	if (raw == NULL) {
+		fprintf(stderr, "[ARCHIVE_WRITE_RUN] Out of Memory packing run %d!\n", fp->run);
+		return 1;
+	}
+	for (c = 0; c < cells; c++) {
+		index = (unsigned long long) fp->cells[c].row * archive->cols + fp->cells[c].col;
+		nvar += varint_put(raw + nvar, index - last);
+		last = index;
+	}
+	raw_size = nvar;
+	for (c = 0; c < cells; c++, raw_size += sizeof(double)) {
+		thickness = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+		memcpy(raw + raw_size, &thickness, sizeof(double));
+	}
+	for (c = 0; c < cells; c++, raw_size += sizeof(double))
+		memcpy(raw + raw_size, &fp->cells[c].dem_elev, sizeof(double));
+
+	packed_len = compressBound(raw_size);
+	packed = (unsigned char *) GC_MALLOC_ATOMIC(packed_len);
+	if (packed == NULL) {
+		fprintf(stderr, "[ARCHIVE_WRITE_RUN] Out of Memory packing run %d!\n", fp->run);
+		return 1;
+	}
+	if (compress2(packed, &packed_len, raw, raw_size, 6) != Z_OK) {
+		fprintf(stderr, "[ARCHIVE_WRITE_RUN] zlib could not compress run %d!\n", fp->run);
+		return 1;
+	}
+	packed_size = packed_len;
+
+	pthread_mutex_lock(&archive->lock);
+	/* Remember where this record starts */
+	if (archive->count == archive->size) {
+		archive->size *= 2;
+		grown_runs = (int *) GC_REALLOC(archive->runs, archive->size * sizeof(int));
+		grown_offsets = (long long *) GC_REALLOC(archive->offsets, archive->size * sizeof(long long));
+		if (grown_runs == NULL || grown_offsets == NULL) {
+			fprintf(stderr, "[ARCHIVE_WRITE_RUN] Out of Memory growing archive index!\n");
+			pthread_mutex_unlock(&archive->lock);
+			return 1;
+		}
+		archive->runs = grown_runs;
+		archive->offsets = grown_offsets;
+	}
+	archive->runs[archive->count] = fp->run;
+	archive->offsets[archive->count++] = (long long) ftello(archive->fp);
+
+	fwrite("MRUN", 1, 4, archive->fp);
+	fwrite(&fp->run, sizeof(int), 1, archive->fp);
+	fwrite(&fp->volume, sizeof(double), 1, archive->fp);
+	fwrite(&fp->pulsevolume, sizeof(double), 1, archive->fp);
+	fwrite(&fp->residual, sizeof(double), 1, archive->fp);
+	fwrite(&fp->num_vents, sizeof(int), 1, archive->fp);
+	for (i = 0; i < fp->num_vents; i++) {
+		fwrite(&fp->vents[i].easting, sizeof(double), 1, archive->fp);
+		fwrite(&fp->vents[i].northing, sizeof(double), 1, archive->fp);
+	}
+	fwrite(&cells, sizeof(unsigned int), 1, archive->fp);
+	fwrite(&raw_size, sizeof(unsigned long long), 1, archive->fp);
+	fwrite(&packed_size, sizeof(unsigned long long), 1, archive->fp);
+	fwrite(packed, 1, packed_len, archive->fp);
+	if (ferror(archive->fp)) {
+		fprintf(stderr, "[ARCHIVE_WRITE_RUN] Cannot write run %d:[%s]!\n", fp->run, strerror(errno));
+		pthread_mutex_unlock(&archive->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&archive->lock);
+	fprintf(stderr, " Run %d archived: %u cells, %llu bytes.\n", fp->run, cells, packed_size);
+	return 0;
+}
+
+/* Write the run index and footer, then close the archive */
+int ARCHIVE_CLOSE(
+FlowArchive *archive)
+{
+	long long index_offset;
+	int i;
+
+	index_offset = (long long) ftello(archive->fp);
+	fwrite("MIDX", 1, 4, archive->fp);
+	fwrite(&archive->count, sizeof(unsigned int), 1, archive->fp);
+	for (i = 0; i < (int) archive->count; i++) {
+		fwrite(archive->runs + i, sizeof(int), 1, archive->fp);
+		fwrite(archive->offsets + i, sizeof(long long), 1, archive->fp);
+	}
+	fwrite(&index_offset, sizeof(long long), 1, archive->fp);
+	fwrite(ARCHIVE_END_MAGIC, 1, 8, archive->fp);
+	if (ferror(archive->fp) || fclose(archive->fp)) {
+		fprintf(stderr, "[ARCHIVE_CLOSE] Cannot write archive index:[%s]!\n", strerror(errno));
+		return 1;
+	}
+	fprintf(stderr, "Flow archive closed: %u runs.\n", archive->count);
+	return 0;
+}
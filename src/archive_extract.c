@@ -0,0 +1,235 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*
+MOLASSES-EXTRACT:
+Reads a flow archive written with FLOW_ARCHIVE (see archive_LJC2.c).
+
+Usage:
+	molasses-extract archive-file              list the runs in the archive
+	molasses-extract archive-file run [file]   write one run as an ASCII flow map
+
+The ASCII flow map has the same format as the ASCII_FLOW_MAP output:
+x y z: easting northing thickness new_elev orig_elev
+If no output file is given, the flow map is written to stdout.
+*/
+
+/* Read the run index from the end of the archive.
+   If the archive was not closed, find the records by scanning from the header.
+   RETURN: number of runs, or -1 on error */
+static int read_index(
+FILE *in,
+int **runs,
+long long **offsets)
+{
+	char magic[8], tag[4];
+	long long index_offset, offset, file_size;
+	unsigned int count = 0, i, size = 1024, cells;
+	unsigned long long raw_size, packed_size;
+	int num_vents, run;
+
+	if (!fseeko(in, -16, SEEK_END) &&
+	    fread(&index_offset, sizeof(long long), 1, in) == 1 &&
+	    fread(magic, 1, 8, in) == 8 && !memcmp(magic, ARCHIVE_END_MAGIC, 8) &&
+	    !fseeko(in, index_offset, SEEK_SET) &&
+	    fread(tag, 1, 4, in) == 4 && !memcmp(tag, "MIDX", 4) &&
+	    fread(&count, sizeof(unsigned int), 1, in) == 1) {
+		*runs = (int *) malloc((count + 1) * sizeof(int));
+		*offsets = (long long *) malloc((count + 1) * sizeof(long long));
+		if (*runs == NULL || *offsets == NULL) return -1;
+		for (i = 0; i < count; i++) {
+			if (fread(*runs + i, sizeof(int), 1, in) != 1 ||
+			    fread(*offsets + i, sizeof(long long), 1, in) != 1) return -1;
+		}
+		return (int) count;
+	}
+
+	fprintf(stderr, "No index found (archive not closed?), scanning records.\n");
+	if (fseeko(in, 0, SEEK_END)) return -1;
+	file_size = ftello(in);
+	*runs = (int *) malloc(size * sizeof(int));
+	*offsets = (long long *) malloc(size * sizeof(long long));
+	if (*runs == NULL || *offsets == NULL) return -1;
+	offset = 8 + 2 * sizeof(int) + 6 * sizeof(double);
+	while (!fseeko(in, offset, SEEK_SET) && fread(tag, 1, 4, in) == 4 && !memcmp(tag, "MRUN", 4)) {
+		if (fread(&run, sizeof(int), 1, in) != 1 ||
+		    fseeko(in, 3 * sizeof(double), SEEK_CUR) ||
+		    fread(&num_vents, sizeof(int), 1, in) != 1 ||
+		    fseeko(in, 2 * sizeof(double) * num_vents, SEEK_CUR) ||
+		    fread(&cells, sizeof(unsigned int), 1, in) != 1 ||
+		    fread(&raw_size, sizeof(unsigned long long), 1, in) != 1 ||
+		    fread(&packed_size, sizeof(unsigned long long), 1, in) != 1) break;
+		if (ftello(in) + (long long) packed_size > file_size) break; /* cut off record */
+		if (count == size) {
+			size *= 2;
+			*runs = (int *) realloc(*runs, size * sizeof(int));
+			*offsets = (long long *) realloc(*offsets, size * sizeof(long long));
+			if (*runs == NULL || *offsets == NULL) return -1;
+		}
+		(*runs)[count] = run;
+		(*offsets)[count++] = offset;
+		offset = ftello(in) + packed_size;
+	}
+	return (int) count;
+}
+
+/* Write the run record at [offset] as an ASCII flow map. RETURN 0 or 1 on error */
+static int extract_run(
+FILE *in,
+long long offset,
+double *gridinfo,
+int cols,
+FILE *out)
+{
+	char tag[4];
+	int run, num_vents, i;
+	double volume, pulse, residual, vent[2];
+	unsigned int cells, c;
+	unsigned long long raw_size, packed_size, index = 0, delta;
+	uLongf raw_len;
+	unsigned char *raw, *packed, *p, *end;
+	double *thick, *orig, easting, northing;
+	size_t n;
+
+	if (fseeko(in, offset, SEEK_SET) || fread(tag, 1, 4, in) != 4 || memcmp(tag, "MRUN", 4) ||
+	    fread(&run, sizeof(int), 1, in) != 1 ||
+	    fread(&volume, sizeof(double), 1, in) != 1 ||
+	    fread(&pulse, sizeof(double), 1, in) != 1 ||
+	    fread(&residual, sizeof(double), 1, in) != 1 ||
+	    fread(&num_vents, sizeof(int), 1, in) != 1) {
+		fprintf(stderr, "[molasses-extract] Corrupt run record at offset %lld\n", offset);
+		return 1;
+	}
+
+	/* Print file header, as OUTPUT does */
+	fprintf (out, "# VOLUME PULSE RESIDUAL VENTS\n");
+	fprintf(out, "# %0.4f\t%0.4f\t%0.1f ", volume, pulse, residual);
+	for (i = 0; i < num_vents; i++) {
+		if (fread(vent, sizeof(double), 2, in) != 2) return 1;
+		fprintf(out, " %0.3f\t%.03f\t", vent[0], vent[1]);
+	}
+	fprintf (out, "\n# EAST NORTH THICKNESS NEW_ELEV ORIG_ELEV");
+
+	/* at least a 1 byte varint and two doubles per cell, as SHARD_READ_RUN checks */
+	if (fread(&cells, sizeof(unsigned int), 1, in) != 1 ||
+	    fread(&raw_size, sizeof(unsigned long long), 1, in) != 1 ||
+	    fread(&packed_size, sizeof(unsigned long long), 1, in) != 1 ||
+	    raw_size < (unsigned long long) cells * (1 + 2 * sizeof(double))) {
+		fprintf(stderr, "[molasses-extract] Corrupt run record at offset %lld\n", offset);
+		return 1;
+	}
+	raw = (unsigned char *) malloc(raw_size + 1);
+	packed = (unsigned char *) malloc(packed_size + 1);
+	if (raw == NULL || packed == NULL) {
+		fprintf(stderr, "[molasses-extract] Out of Memory reading run %d\n", run);
+		return 1;
+	}
+	raw_len = raw_size;
+	if (fread(packed, 1, packed_size, in) != packed_size ||
+	    uncompress(raw, &raw_len, packed, packed_size) != Z_OK || raw_len != raw_size) {
+		fprintf(stderr, "[molasses-extract] Cannot decompress run %d\n", run);
+		return 1;
+	}
+
+	/* The doubles follow the varints; they are copied out so they are aligned */
+	thick = (double *) malloc((cells + 1) * sizeof(double));
+	orig = (double *) malloc((cells + 1) * sizeof(double));
+	if (thick == NULL || orig == NULL) return 1;
+	memcpy(thick, raw + raw_size - 2 * (size_t) cells * sizeof(double), cells * sizeof(double));
+	memcpy(orig, raw + raw_size - (size_t) cells * sizeof(double), cells * sizeof(double));
+	p = raw;
+	end = raw + raw_size - 2 * (size_t) cells * sizeof(double);
+	for (c = 0; c < cells; c++) {
+		if (!(n = varint_get(p, end, &delta))) {
+			fprintf(stderr, "[molasses-extract] Corrupt cell list in run %d\n", run);
+			return 1;
+		}
+		p += n;
+		index += delta;
+		easting = gridinfo[0] + (gridinfo[1] * (double) (index % cols));
+		northing = gridinfo[3] + (gridinfo[5] * (double) (index / cols));
+		fprintf(out, "\n%0.3f\t%0.3f\t%f\t%f\t%f", easting, northing, thick[c], orig[c] + thick[c], orig[c]);
+	}
+	free(raw); free(packed); free(thick); free(orig);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	FILE *in, *out = stdout;
+	char magic[8];
+	int cols, rows, count, i, run;
+	int *runs = NULL;
+	long long *offsets = NULL;
+	double gridinfo[6];
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s archive-file [run [output-file]]\n", argv[0]);
+		return 1;
+	}
+	in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open flow archive=[%s]:[%s]!\n", argv[1], strerror(errno));
+		return 1;
+	}
+	if (fread(magic, 1, 8, in) != 8 || memcmp(magic, ARCHIVE_MAGIC, 8) ||
+	    fread(&cols, sizeof(int), 1, in) != 1 ||
+	    fread(&rows, sizeof(int), 1, in) != 1 ||
+	    fread(gridinfo, sizeof(double), 6, in) != 6) {
+		fprintf(stderr, "[%s] is not a MOLASSES flow archive!\n", argv[1]);
+		return 1;
+	}
+	count = read_index(in, &runs, &offsets);
+	if (count < 0) {
+		fprintf(stderr, "Cannot read the run index of [%s]!\n", argv[1]);
+		return 1;
+	}
+
+	if (argc == 2) {
+		fprintf(stdout, "# %s: %d runs, grid %d cols x %d rows\n", argv[1], count, cols, rows);
+		fprintf(stdout, "# RUN OFFSET\n");
+		for (i = 0; i < count; i++) fprintf(stdout, "%d\t%lld\n", runs[i], offsets[i]);
+		return 0;
+	}
+
+	run = atoi(argv[2]);
+	for (i = 0; i < count; i++) if (runs[i] == run) break;
+	if (i == count) {
+		fprintf(stderr, "Run %d is not in [%s]!\n", run, argv[1]);
+		return 1;
+	}
+	if (argc > 3) {
+		out = fopen(argv[3], "w");
+		if (out == NULL) {
+			fprintf(stderr, "Cannot open ASCII FLOW file=[%s]:[%s]!\n", argv[3], strerror(errno));
+			return 1;
+		}
+	}
+	if (extract_run(in, offsets[i], gridinfo, cols, out)) return 1;
+	fclose(out);
+	fclose(in);
+	return 0;
+}
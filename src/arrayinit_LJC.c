@@ -22,6 +22,14 @@
 #    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ###########################################################################*/ 
 #include "include/prototypes_LJC2.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#ifdef NUMA_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
 
 /*Reserves memory for active list with size [CAListSize] With the typedef of ActiveList. */
 ActiveList *ACTIVELIST_INIT(
@@ -40,13 +48,55 @@ unsigned int CAListSize)
 	return (m);
 }
 
-/*Reserves memory for matrix of size [rows]x[cols] With the typedef of DataCell.*/
+/*Applies memory placement hints to the data grid before it is first touched.
+  Linux only; elsewhere this does nothing.
+  MADV_HUGEPAGE asks for transparent huge pages, which cuts TLB misses
+  when neighbor lookups stride across rows of a large grid.
+  If compiled with -DNUMA_INTERLEAVE, the pages are also interleaved across
+  all NUMA nodes, so that threads on every socket see the same average latency
+  instead of all reading from the node of the thread that loaded the DEM.
+  Only whole pages inside the block are advised. */
+static void place_grid_memory(
+void *block,
+size_t bytes)
+{
+#ifdef __linux__
+	long pagesize = sysconf(_SC_PAGESIZE);
+	unsigned long start, end;
+#ifdef NUMA_INTERLEAVE
+	unsigned long nodemask[16];
+#endif
+	
+	if (pagesize <= 0) return;
+	start = ((unsigned long) block + pagesize - 1) & ~((unsigned long) pagesize - 1);
+	end = ((unsigned long) block + bytes) & ~((unsigned long) pagesize - 1);
+	if (end <= start) return;
+#ifdef MADV_HUGEPAGE
+	(void) madvise((void *) start, end - start, MADV_HUGEPAGE);
+#endif
+#ifdef NUMA_INTERLEAVE
+	/* All nodes; the kernel drops nodes not allowed to this process. */
+	memset(nodemask, 0xff, sizeof(nodemask));
+	if (syscall(SYS_mbind, start, end - start, MPOL_INTERLEAVE, nodemask, 
+	            (unsigned long) (sizeof(nodemask) * CHAR_BIT), 0))
+		fprintf(stderr, "[GLOBALDATA_INIT] NUMA interleave not applied:[%s]\n", strerror(errno));
+#endif
+#endif
+	return;
+}
+
+/*Reserves memory for matrix of size [rows]x[cols] With the typedef of DataCell.
+  The cells are one contiguous block, row after row; the row pointers index into it.
+  A DataCell holds no pointers, so the block is allocated atomic and the 
+  collector never has to scan it. */
 DataCell **GLOBALDATA_INIT(
 int rows, 
 int cols)
 {
 	int i;
 	DataCell **m = NULL;
+	DataCell *cells = NULL;
+	size_t bytes = (size_t)(rows) * (size_t)(cols) * sizeof(DataCell);
 	
 	/*Allocate row pointers*/
 	if((m = (DataCell**) GC_MALLOC((size_t)(rows) * sizeof(DataCell*) )) == NULL)
@@ -55,15 +105,18 @@ int cols)
 		fprintf(stderr, "   NO MORE MEMORY: Tried to allocate memory for %d Rows!! Program stopped!\n", rows);
 		return NULL;
 	}
-	/*allocate cols & set previously allocated row pointers to point to these*/
+	/*allocate all cells & set previously allocated row pointers to point into them*/
+	if((cells = (DataCell*) GC_MALLOC_ATOMIC(bytes)) == NULL)
+	{
+		fprintf(stderr, "[GLOBALDATA_INIT]\n");
+		fprintf(stderr, "   NO MORE MEMORY: Tried to allocate memory for %d cols in %d rows!! Program stopped!", cols,rows);
+		return NULL;
+	}
+	place_grid_memory(cells, bytes);
+	memset(cells, 0, bytes); /* first touch */
 	for (i = 0; i < rows; i++) 
 	{
-		if((m[i] = (DataCell*) GC_MALLOC((size_t)(cols) * sizeof(DataCell) )) == NULL)
-		{
-			fprintf(stderr, "[GLOBALDATA_INIT]\n");
-			fprintf(stderr, "   NO MORE MEMORY: Tried to allocate memory for %d cols in %d rows!! Program stopped!", cols,rows);
-			return NULL;
-		}
+		m[i] = cells + (size_t)i * (size_t)cols;
 	}
 	return m; /*return array */
 }
@@ -0,0 +1,343 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: ARRIVAL
+When the lava first reached each cell: the pulse (1 for the first
+pulse of a run) at which DISTRIBUTE first found the cell above its
+residual. Vent cells arrive with the first pulse. Cells that hold
+lava but never went above their residual are not stamped.
+
+ARRIVAL_INIT       allocate the tile table
+ARRIVAL_STAMPS     a tile table of its own, for the runs of a worker
+                   thread (SCENARIO_THREADS, see RUN_POOL)
+ARRIVAL_MARK       stamp a cell, called by DISTRIBUTE
+ARRIVAL_STAMP      the stamp of a cell, ARRIVAL_SET sets it (flow
+                   checkpoints, see FLOW_STATE)
+ARRIVAL_END        copy the stamps of a run into its footprint, clear
+                   them for the next run
+ARRIVAL_ADD        add the arrivals of a footprint to the ensemble
+ARRIVAL_WRITE_RUN  raster of one run (ARRIVAL_MAP = prefix, prefix<run>.tif)
+ARRIVAL_WRITE      ensemble rasters (ARRIVAL_ENSEMBLE = prefix):
+                   prefix_min.tif, prefix_median.tif
+
+The stamps are unsigned ints in tiles of ARRIVAL_TILE x ARRIVAL_TILE
+cells, allocated the first time a flow reaches the tile. The ensemble
+keeps, per tile, the arrival of every run at every cell it reached.
+
+ARRIVAL_UNITS = PULSE (default) writes pulse numbers (UInt32 per run);
+VOLUME writes the volume erupted when the lava arrived, the pulse
+number times the pulse volume (Float32). 0 is never reached. The
+ensemble rasters are Float32, over the runs that reached the cell;
+the median of an even number of runs is the mean of the middle two.
+*******************************/
+
+#define TILE_CELLS (ARRIVAL_TILE * ARRIVAL_TILE)
+
+Arrival *ARRIVAL_STAMPS(
+double *gridinfo)
+{
+	Arrival *arr;
+	size_t tiles;
+
+	/* GC_MALLOC memory is cleared: no ensemble, no tile is allocated yet */
+	arr = (Arrival *) GC_MALLOC(sizeof(Arrival));
+	if (arr == NULL) {
+		fprintf(stderr, "[ARRIVAL_STAMPS] Out of Memory!\n");
+		return NULL;
+	}
+	arr->cols = (int) gridinfo[2];
+	arr->rows = (int) gridinfo[4];
+	arr->tiles_x = (arr->cols + ARRIVAL_TILE - 1) / ARRIVAL_TILE;
+	arr->tiles_y = (arr->rows + ARRIVAL_TILE - 1) / ARRIVAL_TILE;
+	tiles = (size_t) arr->tiles_x * arr->tiles_y;
+	arr->tiles = (unsigned int **) GC_MALLOC(tiles * sizeof(unsigned int *));
+	if (arr->tiles == NULL) {
+		fprintf(stderr, "[ARRIVAL_STAMPS] Out of Memory for %lu tiles!\n", (unsigned long) tiles);
+		return NULL;
+	}
+	return arr;
+}
+
+Arrival *ARRIVAL_INIT(
+Inputs *In,
+Outputs *Out,
+double *gridinfo)
+{
+	Arrival *arr;
+	size_t tiles;
+
+	if (DEM_PROJECTION(In) == NULL) return NULL;
+	arr = ARRIVAL_STAMPS(gridinfo);
+	if (arr == NULL) return NULL;
+	arr->volume = !strcmp(Out->arrival_units, "VOLUME");
+	arr->ensemble = (strlen(Out->arrival_ensemble_file) > 0);
+	arr->In = In;
+	tiles = (size_t) arr->tiles_x * arr->tiles_y;
+	if (arr->ensemble) {
+		arr->ens_cell = (unsigned short **) GC_MALLOC(tiles * sizeof(unsigned short *));
+		arr->ens_value = (float **) GC_MALLOC(tiles * sizeof(float *));
+		arr->ens_count = (unsigned int *) GC_MALLOC_ATOMIC(tiles * sizeof(unsigned int));
+		arr->ens_size = (unsigned int *) GC_MALLOC_ATOMIC(tiles * sizeof(unsigned int));
+		if (arr->ens_cell == NULL || arr->ens_value == NULL ||
+		    arr->ens_count == NULL || arr->ens_size == NULL) {
+			fprintf(stderr, "[ARRIVAL_INIT] Out of Memory for %lu tiles!\n", (unsigned long) tiles);
+			return NULL;
+		}
+		memset(arr->ens_count, 0, tiles * sizeof(unsigned int));
+		memset(arr->ens_size, 0, tiles * sizeof(unsigned int));
+	}
+	return arr;
+}
+
+/* The stamp of a cell, its tile allocated first. RETURN: NULL if out of memory */
+static unsigned int *stamp_of(
+Arrival *arr,
+int row,
+int col)
+{
+	unsigned int *tile;
+
+	tile = arr->tiles[(row / ARRIVAL_TILE) * arr->tiles_x + col / ARRIVAL_TILE];
+	if (tile == NULL) {
+		tile = (unsigned int *) GC_MALLOC_ATOMIC(TILE_CELLS * sizeof(unsigned int));
+		if (tile == NULL) return NULL;
+		memset(tile, 0, TILE_CELLS * sizeof(unsigned int));
+		arr->tiles[(row / ARRIVAL_TILE) * arr->tiles_x + col / ARRIVAL_TILE] = tile;
+	}
+	return tile + (row % ARRIVAL_TILE) * ARRIVAL_TILE + col % ARRIVAL_TILE;
+}
+
+/* Stamp the current pulse on a cell reached for the first time in this run */
+int ARRIVAL_MARK(
+Arrival *arr,
+int row,
+int col)
+{
+	unsigned int *cell;
+
+	cell = stamp_of(arr, row, col);
+	if (cell == NULL) {
+		fprintf(stderr, "[ARRIVAL_MARK] Out of Memory for the tile of cell (%d, %d)!\n", row, col);
+		return 1;
+	}
+	if (!*cell) *cell = arr->pulse;
+	return 0;
+}
+
+unsigned int ARRIVAL_STAMP(
+Arrival *arr,
+int row,
+int col)
+{
+	unsigned int *tile;
+
+	tile = arr->tiles[(row / ARRIVAL_TILE) * arr->tiles_x + col / ARRIVAL_TILE];
+	if (tile == NULL) return 0;
+	return tile[(row % ARRIVAL_TILE) * ARRIVAL_TILE + col % ARRIVAL_TILE];
+}
+
+int ARRIVAL_SET(
+Arrival *arr,
+int row,
+int col,
+unsigned int pulse)
+{
+	unsigned int *cell;
+
+	if (!pulse) return 0;   /* not reached: nothing to allocate */
+	cell = stamp_of(arr, row, col);
+	if (cell == NULL) {
+		fprintf(stderr, "[ARRIVAL_SET] Out of Memory for the tile of cell (%d, %d)!\n", row, col);
+		return 1;
+	}
+	*cell = pulse;
+	return 0;
+}
+
+/* Erupted volume after [pulse] pulses of a run */
+static float pulse_volume(
+FlowFootprint *fp,
+unsigned int pulse)
+{
+	double volume = (double) pulse * fp->pulsevolume;
+
+	return (float) ((volume < fp->volume) ? volume : fp->volume);
+}
+
+int ARRIVAL_END(
+Arrival *arr,
+FlowFootprint *fp)
+{
+	unsigned int c, *tile, *cell;
+	int t, row, col;
+
+	for (c = 0; c < fp->count; c++) {
+		row = fp->cells[c].row;
+		col = fp->cells[c].col;
+		t = (row / ARRIVAL_TILE) * arr->tiles_x + col / ARRIVAL_TILE;
+		tile = arr->tiles[t];
+		if (tile == NULL) continue;
+		cell = tile + (row % ARRIVAL_TILE) * ARRIVAL_TILE + col % ARRIVAL_TILE;
+		fp->cells[c].arrival = *cell;
+		*cell = 0; /* stamps are only on footprint cells, so this clears the run */
+	}
+	return 0;
+}
+
+int ARRIVAL_ADD(
+Arrival *arr,
+FlowFootprint *fp)
+{
+	unsigned int c, n;
+	unsigned short *grown_cell;
+	float *grown_value;
+	int t, row, col;
+
+	if (!arr->ensemble) return 0;
+	for (c = 0; c < fp->count; c++) {
+		if (!fp->cells[c].arrival) continue;
+		row = fp->cells[c].row;
+		col = fp->cells[c].col;
+		t = (row / ARRIVAL_TILE) * arr->tiles_x + col / ARRIVAL_TILE;
+		n = arr->ens_count[t];
+		if (n == arr->ens_size[t]) {
+			arr->ens_size[t] = (n) ? 2 * n : 1024;
+			grown_cell = (unsigned short *) GC_REALLOC(arr->ens_cell[t], arr->ens_size[t] * sizeof(unsigned short));
+			grown_value = (float *) GC_REALLOC(arr->ens_value[t], arr->ens_size[t] * sizeof(float));
+			if (grown_cell == NULL || grown_value == NULL) {
+				fprintf(stderr, "[ARRIVAL_ADD] Out of Memory for %u ensemble arrivals in a tile!\n", arr->ens_size[t]);
+				return 1;
+			}
+			arr->ens_cell[t] = grown_cell;
+			arr->ens_value[t] = grown_value;
+		}
+		arr->ens_cell[t][n] = (unsigned short) ((row % ARRIVAL_TILE) * ARRIVAL_TILE + col % ARRIVAL_TILE);
+		arr->ens_value[t][n] = (arr->volume) ? pulse_volume(fp, fp->cells[c].arrival) : (float) fp->cells[c].arrival;
+		arr->ens_count[t]++;
+	}
+	return 0;
+}
+
+int ARRIVAL_WRITE_RUN(
+Arrival *arr,
+FlowFootprint *fp,
+Outputs *Out,
+double *gridinfo)
+{
+	char file[FILENAME_MAX];
+	size_t cells = (size_t) arr->cols * arr->rows, k;
+	unsigned int c;
+	void *data;
+
+	/* Both types are 4 bytes; rasters are written top row first */
+	data = GC_MALLOC_ATOMIC(cells * sizeof(float));
+	if (data == NULL) {
+		fprintf(stderr, "[ARRIVAL_WRITE_RUN] Out of Memory for the arrival raster of run %d!\n", fp->run);
+		return 1;
+	}
+	memset(data, 0, cells * sizeof(float));
+	for (c = 0; c < fp->count; c++) {
+		if (!fp->cells[c].arrival) continue;
+		k = (size_t) (arr->rows - 1 - fp->cells[c].row) * arr->cols + fp->cells[c].col;
+		if (arr->volume) ((float *) data)[k] = pulse_volume(fp, fp->cells[c].arrival);
+		else ((GUInt32 *) data)[k] = fp->cells[c].arrival;
+	}
+	snprintf(file, sizeof file, "%s%d.tif", Out->arrival_file, fp->run);
+	return WRITE_RASTER(file, data, (arr->volume) ? GDT_Float32 : GDT_UInt32, 1, Out, arr->In, gridinfo);
+}
+
+static int compare_float(
+const void *a,
+const void *b)
+{
+	float x = *(const float *) a, y = *(const float *) b;
+
+	return (x > y) - (x < y);
+}
+
+int ARRIVAL_WRITE(
+Arrival *arr,
+Outputs *Out,
+double *gridinfo)
+{
+	char file[FILENAME_MAX];
+	size_t cells = (size_t) arr->cols * arr->rows, k;
+	float *min, *median, *sorted, *values;
+	unsigned int start[TILE_CELLS + 1], fill[TILE_CELLS], i, n, size = 0;
+	int t, tx, ty, cell, row, col, ret;
+
+	min = (float *) GC_MALLOC_ATOMIC(cells * sizeof(float));
+	median = (float *) GC_MALLOC_ATOMIC(cells * sizeof(float));
+	if (min == NULL || median == NULL) {
+		fprintf(stderr, "[ARRIVAL_WRITE] Out of Memory for the ensemble arrival rasters!\n");
+		return 1;
+	}
+	memset(min, 0, cells * sizeof(float));
+	memset(median, 0, cells * sizeof(float));
+	sorted = NULL;
+
+	for (t = 0; t < arr->tiles_x * arr->tiles_y; t++) {
+		n = arr->ens_count[t];
+		if (!n) continue;
+		if (n > size) {
+			size = n;
+			sorted = (float *) GC_MALLOC_ATOMIC(size * sizeof(float));
+			if (sorted == NULL) {
+				fprintf(stderr, "[ARRIVAL_WRITE] Out of Memory sorting %u arrivals!\n", n);
+				return 1;
+			}
+		}
+		/* Group the arrivals of the tile by cell (counting sort) */
+		memset(start, 0, sizeof start);
+		for (i = 0; i < n; i++) start[arr->ens_cell[t][i] + 1]++;
+		for (cell = 0; cell < TILE_CELLS; cell++) {
+			start[cell + 1] += start[cell];
+			fill[cell] = start[cell];
+		}
+		for (i = 0; i < n; i++) sorted[fill[arr->ens_cell[t][i]]++] = arr->ens_value[t][i];
+
+		ty = t / arr->tiles_x;
+		tx = t % arr->tiles_x;
+		for (cell = 0; cell < TILE_CELLS; cell++) {
+			n = start[cell + 1] - start[cell];
+			if (!n) continue;
+			values = sorted + start[cell];
+			qsort(values, n, sizeof(float), compare_float);
+			row = ty * ARRIVAL_TILE + cell / ARRIVAL_TILE;
+			col = tx * ARRIVAL_TILE + cell % ARRIVAL_TILE;
+			k = (size_t) (arr->rows - 1 - row) * arr->cols + col;
+			min[k] = values[0];
+			median[k] = (n % 2) ? values[n / 2] : 0.5f * (values[n / 2 - 1] + values[n / 2]);
+		}
+	}
+
+	snprintf(file, sizeof file, "%s_min.tif", Out->arrival_ensemble_file);
+	ret = WRITE_RASTER(file, min, GDT_Float32, 1, Out, arr->In, gridinfo);
+	snprintf(file, sizeof file, "%s_median.tif", Out->arrival_ensemble_file);
+	ret |= WRITE_RASTER(file, median, GDT_Float32, 1, Out, arr->In, gridinfo);
+	return ret;
+}
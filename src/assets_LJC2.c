@@ -0,0 +1,393 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+#include <strings.h>
+
+/*****************************
+MODULE: ASSETS
+Report which assets (roads, pipelines, power stations, ...) each run
+inundates, without writing flow maps.
+
+ASSETS_LOAD     read ASSETS_FILE and rasterise every asset onto the grid
+                once, into a list of (cell, asset) pairs sorted by cell
+ASSETS_RUN      after a run, match its footprint against the list and
+                write one line per asset hit:
+                run,asset,name,cells_hit,max_thickness
+ASSETS_SUMMARY  after the last run, write one line per asset:
+                asset,name,type,cells,runs_hit,probability,
+                mean_max_thickness,max_thickness
+
+Output files: ASSET_IMPACTS.csv and ASSET_IMPACTS_summary.csv.
+
+ASSETS_FILE format (GMT multiple segment style, same units as the DEM):
+	> NAME TYPE       start an asset, TYPE is point, line or polygon
+	easting northing  one vertex per line
+Lines starting with # are comments. A point asset may list several
+points. A polygon is closed automatically; it covers the cells whose
+centre is inside it, and the cells its outline crosses.
+A cell is in row (northing - lower left y) / resolution, as vents are.
+*******************************/
+
+/* Add a (cell, asset) pair, growing the list when needed */
+static int add_pair(
+AssetIndex *ai,
+int row,
+int col,
+int asset)
+{
+	unsigned long long *cells;
+	int *assets;
+
+	if (row < 0 || row >= ai->rows || col < 0 || col >= ai->cols) return 0; /* off the DEM */
+	if (ai->num_pairs == ai->size) {
+		ai->size = ai->size ? 2 * ai->size : 1024;
+		cells = (unsigned long long *) GC_REALLOC(ai->cell, ai->size * sizeof(unsigned long long));
+		assets = (int *) GC_REALLOC(ai->asset, ai->size * sizeof(int));
+		if (cells == NULL || assets == NULL) {
+			fprintf(stderr, "[ASSETS_LOAD] Out of Memory rasterising assets!\n");
+			return 1;
+		}
+		ai->cell = cells;
+		ai->asset = assets;
+	}
+	ai->cell[ai->num_pairs] = (unsigned long long) row * ai->cols + col;
+	ai->asset[ai->num_pairs++] = asset;
+	return 0;
+}
+
+/* Mark the cells along a segment, sampled every quarter cell */
+static int rasterise_segment(
+AssetIndex *ai,
+double *gridinfo,
+double x0, double y0,
+double x1, double y1,
+int asset)
+{
+	double length = hypot(x1 - x0, y1 - y0), x, y;
+	int steps = (int) ceil(4.0 * length / gridinfo[1]), s;
+
+	for (s = 0; s <= steps; s++) {
+		x = steps ? x0 + (x1 - x0) * s / steps : x0;
+		y = steps ? y0 + (y1 - y0) * s / steps : y0;
+		if (add_pair(ai, (int) floor((y - gridinfo[3]) / gridinfo[5]),
+		             (int) floor((x - gridinfo[0]) / gridinfo[1]), asset)) return 1;
+	}
+	return 0;
+}
+
+/* Mark the cells whose centre is inside the polygon (even-odd rule),
+   one row at a time */
+static int rasterise_polygon(
+AssetIndex *ai,
+double *gridinfo,
+double *x,
+double *y,
+int n,
+int asset)
+{
+	double ymin = y[0], ymax = y[0], yc, xc, *cross, t;
+	int row, row0, row1, col, col0, col1, i, j, k, nc;
+
+	for (i = 1; i < n; i++) {
+		if (y[i] < ymin) ymin = y[i];
+		if (y[i] > ymax) ymax = y[i];
+	}
+	cross = (double *) GC_MALLOC_ATOMIC((n + 1) * sizeof(double));
+	if (cross == NULL) {
+		fprintf(stderr, "[ASSETS_LOAD] Out of Memory rasterising polygon!\n");
+		return 1;
+	}
+	row0 = (int) floor((ymin - gridinfo[3]) / gridinfo[5]);
+	row1 = (int) floor((ymax - gridinfo[3]) / gridinfo[5]);
+	if (row0 < 0) row0 = 0;
+	if (row1 >= ai->rows) row1 = ai->rows - 1;
+	for (row = row0; row <= row1; row++) {
+		yc = gridinfo[3] + (row + 0.5) * gridinfo[5];
+		nc = 0;
+		for (i = 0, j = n - 1; i < n; j = i++) {
+			if ((y[i] > yc) != (y[j] > yc))
+				cross[nc++] = x[j] + (yc - y[j]) * (x[i] - x[j]) / (y[i] - y[j]);
+		}
+		for (i = 1; i < nc; i++) { /* few crossings: insertion sort */
+			for (t = cross[i], k = i; k > 0 && cross[k-1] > t; k--) cross[k] = cross[k-1];
+			cross[k] = t;
+		}
+		for (i = 0; i + 1 < nc; i += 2) {
+			col0 = (int) ceil((cross[i] - gridinfo[0]) / gridinfo[1] - 0.5);
+			col1 = (int) floor((cross[i+1] - gridinfo[0]) / gridinfo[1] - 0.5);
+			if (col0 < 0) col0 = 0;
+			if (col1 >= ai->cols) col1 = ai->cols - 1;
+			for (col = col0; col <= col1; col++) {
+				xc = gridinfo[0] + (col + 0.5) * gridinfo[1];
+				if (xc >= cross[i] && xc <= cross[i+1] && add_pair(ai, row, col, asset)) return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/* Rasterise the vertices read for one asset */
+static int rasterise_asset(
+AssetIndex *ai,
+double *gridinfo,
+double *x,
+double *y,
+int n,
+int asset)
+{
+	int i;
+
+	switch (ai->types[asset]) {
+		case 'p' : /* point(s) */
+			for (i = 0; i < n; i++)
+				if (rasterise_segment(ai, gridinfo, x[i], y[i], x[i], y[i], asset)) return 1;
+		break;
+		case 'P' : /* polygon: interior, then the closed outline */
+			if (n > 2 && rasterise_polygon(ai, gridinfo, x, y, n, asset)) return 1;
+			if (n > 1 && rasterise_segment(ai, gridinfo, x[n-1], y[n-1], x[0], y[0], asset)) return 1;
+			/* fall through */
+		default : /* line */
+			for (i = 1; i < n; i++)
+				if (rasterise_segment(ai, gridinfo, x[i-1], y[i-1], x[i], y[i], asset)) return 1;
+			if (n == 1 && rasterise_segment(ai, gridinfo, x[0], y[0], x[0], y[0], asset)) return 1;
+	}
+	return 0;
+}
+
+/* Order (cell, asset) pairs by cell, then asset */
+static AssetIndex *sort_index;
+static int compare_pairs(
+const void *a,
+const void *b)
+{
+	unsigned int i = *(const unsigned int *) a, j = *(const unsigned int *) b;
+
+	if (sort_index->cell[i] != sort_index->cell[j]) return (sort_index->cell[i] < sort_index->cell[j]) ? -1 : 1;
+	return sort_index->asset[i] - sort_index->asset[j];
+}
+
+AssetIndex *ASSETS_LOAD(
+char *file,
+double *gridinfo)
+{
+	AssetIndex *ai;
+	FILE *in;
+	char line[256], name[256], type[256];
+	double *x = NULL, *y = NULL;
+	int n = 0, size = 0, asset = -1, i;
+	unsigned int *order, k, kept;
+	unsigned long long *cells;
+	int *assets;
+	char **names;
+	int *types;
+
+	in = fopen(file, "r");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open ASSETS file=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	ai = (AssetIndex *) GC_MALLOC(sizeof(AssetIndex));
+	if (ai == NULL) {
+		fprintf(stderr, "[ASSETS_LOAD] Out of Memory!\n");
+		return NULL;
+	}
+	ai->cols = (int) gridinfo[2];
+	ai->rows = (int) gridinfo[4];
+
+	while (fgets(line, sizeof line, in) != NULL) {
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+		if (line[0] == '>') { /* new asset: rasterise the previous one */
+			if (asset >= 0 && rasterise_asset(ai, gridinfo, x, y, n, asset)) return NULL;
+			type[0] = '\0';
+			if (sscanf(line + 1, "%255s %255s", name, type) < 1) snprintf(name, sizeof name, "asset%d", asset + 1);
+			asset++;
+			names = (char **) GC_REALLOC(ai->names, (asset + 1) * sizeof(char *));
+			types = (int *) GC_REALLOC(ai->types, (asset + 1) * sizeof(int));
+			if (names == NULL || types == NULL) {
+				fprintf(stderr, "[ASSETS_LOAD] Out of Memory reading assets!\n");
+				return NULL;
+			}
+			ai->names = names;
+			ai->types = types;
+			ai->names[asset] = (char *) GC_MALLOC_ATOMIC(strlen(name) + 1);
+			if (ai->names[asset] == NULL) return NULL;
+			strcpy(ai->names[asset], name);
+			if (!strncasecmp(type, "point", 5)) ai->types[asset] = 'p';
+			else if (!strncasecmp(type, "polygon", 7)) ai->types[asset] = 'P';
+			else if (!type[0] || !strncasecmp(type, "line", 4)) ai->types[asset] = 'l';
+			else {
+				fprintf(stderr, "[ASSETS_LOAD] %s: asset type must be point, line or polygon: [%s]\n", name, type);
+				return NULL;
+			}
+			n = 0;
+			continue;
+		}
+		if (asset < 0) {
+			fprintf(stderr, "[ASSETS_LOAD] %s: coordinates before the first '> NAME TYPE' line\n", file);
+			return NULL;
+		}
+		if (n == size) {
+			size = size ? 2 * size : 256;
+			x = (double *) GC_REALLOC(x, size * sizeof(double));
+			y = (double *) GC_REALLOC(y, size * sizeof(double));
+			if (x == NULL || y == NULL) {
+				fprintf(stderr, "[ASSETS_LOAD] Out of Memory reading assets!\n");
+				return NULL;
+			}
+		}
+		if (sscanf(line, "%lf %lf", x + n, y + n) != 2) {
+			fprintf(stderr, "[ASSETS_LOAD] %s: cannot read coordinates [%s]\n", ai->names[asset], line);
+			return NULL;
+		}
+		n++;
+	}
+	fclose(in);
+	if (asset >= 0 && rasterise_asset(ai, gridinfo, x, y, n, asset)) return NULL;
+	ai->num_assets = asset + 1;
+
+	/* Sort the pairs by cell and drop duplicates */
+	order = (unsigned int *) GC_MALLOC_ATOMIC((ai->num_pairs + 1) * sizeof(unsigned int));
+	cells = (unsigned long long *) GC_MALLOC_ATOMIC((ai->num_pairs + 1) * sizeof(unsigned long long));
+	assets = (int *) GC_MALLOC_ATOMIC((ai->num_pairs + 1) * sizeof(int));
+	ai->cells = (unsigned int *) GC_MALLOC_ATOMIC((ai->num_assets + 1) * sizeof(unsigned int));
+	ai->runs_hit = (unsigned int *) GC_MALLOC_ATOMIC((ai->num_assets + 1) * sizeof(unsigned int));
+	ai->cells_hit = (unsigned int *) GC_MALLOC_ATOMIC((ai->num_assets + 1) * sizeof(unsigned int));
+	ai->run_max = (double *) GC_MALLOC_ATOMIC((ai->num_assets + 1) * sizeof(double));
+	ai->sum_max = (double *) GC_MALLOC_ATOMIC((ai->num_assets + 1) * sizeof(double));
+	ai->max_max = (double *) GC_MALLOC_ATOMIC((ai->num_assets + 1) * sizeof(double));
+	if (order == NULL || cells == NULL || assets == NULL || ai->cells == NULL || ai->runs_hit == NULL ||
+	    ai->cells_hit == NULL || ai->run_max == NULL || ai->sum_max == NULL || ai->max_max == NULL) {
+		fprintf(stderr, "[ASSETS_LOAD] Out of Memory indexing assets!\n");
+		return NULL;
+	}
+	for (k = 0; k < ai->num_pairs; k++) order[k] = k;
+	sort_index = ai;
+	qsort(order, ai->num_pairs, sizeof(unsigned int), compare_pairs);
+	for (i = 0; i < ai->num_assets; i++) {
+		ai->cells[i] = ai->runs_hit[i] = ai->cells_hit[i] = 0;
+		ai->run_max[i] = ai->sum_max[i] = ai->max_max[i] = 0.0;
+	}
+	for (k = kept = 0; k < ai->num_pairs; k++) {
+		if (kept && cells[kept-1] == ai->cell[order[k]] && assets[kept-1] == ai->asset[order[k]]) continue;
+		cells[kept] = ai->cell[order[k]];
+		assets[kept++] = ai->asset[order[k]];
+		ai->cells[ai->asset[order[k]]]++;
+	}
+	ai->cell = cells;
+	ai->asset = assets;
+	ai->num_pairs = ai->size = kept;
+
+	fprintf(stdout, "Assets: %d from %s on %u grid cells.\n", ai->num_assets, file, kept);
+	for (i = 0; i < ai->num_assets; i++)
+		if (!ai->cells[i]) fprintf(stderr, "[ASSETS_LOAD] Asset %s is outside the DEM.\n", ai->names[i]);
+	return ai;
+}
+
+int ASSETS_RUN(
+AssetIndex *ai,
+FlowFootprint *fp,
+char *prefix)
+{
+	char file[FILENAME_MAX];
+	unsigned int c = 0, k = 0;
+	unsigned long long cell;
+	double x;
+	int i, a;
+
+	if (ai->out == NULL) {
+		snprintf(file, sizeof file, "%s.csv", prefix);
+		ai->out = fopen(file, "w");
+		if (ai->out == NULL) {
+			fprintf(stderr, "Cannot open ASSET IMPACTS file=[%s]:[%s]!\n", file, strerror(errno));
+			return 1;
+		}
+		fprintf(ai->out, "run,asset,name,cells_hit,max_thickness\n");
+	}
+
+	/* Both lists are sorted by cell index: merge them */
+	while (c < fp->count && k < ai->num_pairs) {
+		cell = (unsigned long long) fp->cells[c].row * ai->cols + fp->cells[c].col;
+		if (cell < ai->cell[k]) c++;
+		else if (cell > ai->cell[k]) k++;
+		else {
+			x = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+			for (; k < ai->num_pairs && ai->cell[k] == cell; k++) {
+				a = ai->asset[k];
+				ai->cells_hit[a]++;
+				if (x > ai->run_max[a]) ai->run_max[a] = x;
+			}
+			c++;
+		}
+	}
+
+	for (i = 0; i < ai->num_assets; i++) {
+		if (!ai->cells_hit[i]) continue;
+		fprintf(ai->out, "%d,%d,%s,%u,%f\n", fp->run, i, ai->names[i], ai->cells_hit[i], ai->run_max[i]);
+		ai->runs_hit[i]++;
+		ai->sum_max[i] += ai->run_max[i];
+		if (ai->run_max[i] > ai->max_max[i]) ai->max_max[i] = ai->run_max[i];
+		ai->cells_hit[i] = 0;
+		ai->run_max[i] = 0.0;
+	}
+	ai->runs++;
+	if (fflush(ai->out)) {
+		fprintf(stderr, "Cannot write ASSET IMPACTS file for run %d:[%s]!\n", fp->run, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+int ASSETS_SUMMARY(
+AssetIndex *ai,
+char *prefix)
+{
+	char file[FILENAME_MAX];
+	FILE *out;
+	int i;
+
+	if (ai->out != NULL) fclose(ai->out);
+	ai->out = NULL;
+	snprintf(file, sizeof file, "%s_summary.csv", prefix);
+	out = fopen(file, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot open ASSET SUMMARY file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	fprintf(out, "asset,name,type,cells,runs_hit,probability,mean_max_thickness,max_thickness\n");
+	for (i = 0; i < ai->num_assets; i++) {
+		fprintf(out, "%d,%s,%s,%u,%u,%f,%f,%f\n", i, ai->names[i],
+		        (ai->types[i] == 'p') ? "point" : (ai->types[i] == 'P') ? "polygon" : "line",
+		        ai->cells[i], ai->runs_hit[i],
+		        ai->runs ? (double) ai->runs_hit[i] / ai->runs : 0.0,
+		        ai->runs_hit[i] ? ai->sum_max[i] / ai->runs_hit[i] : 0.0,
+		        ai->max_max[i]);
+	}
+	if (fclose(out)) {
+		fprintf(stderr, "Cannot write ASSET SUMMARY file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	fprintf(stdout, "Asset summary: %s (%d runs)\n", file, ai->runs);
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: CELL_STATS
+Ensemble statistics of lava thickness in each cell, kept while the
+runs go (CELL_STATS = file prefix in the config file):
+
+CELL_STATS_INIT    allocate the accumulators
+CELL_STATS_UPDATE  add a finished run, visiting only its inundated cells
+CELL_STATS_WRITE   write the statistics rasters after the last run
+
+Per cell, over the runs that inundated it (Welford's algorithm):
+	count   hit_count of the data grid, incremented before the update
+	mean    mean += (x - mean) / count
+	M2      M2 += (x - mean_old) * (x - mean_new)
+	max     largest thickness
+Rasters (Float32, see WRITE_RASTER):
+	prefix_mean.tif  mean thickness where inundated
+	prefix_std.tif   sample standard deviation, sqrt(M2 / (count - 1))
+	prefix_max.tif   max thickness
+Cells that were never inundated are 0.
+
+Each accumulator is stored as Float64 or Float32, or not kept at all
+(CELL_STATS_PRECISION), to trade precision for memory on large grids.
+The standard deviation needs the mean.
+*******************************/
+
+/* Allocate a zeroed accumulator grid, NULL if not kept */
+static void *stat_grid(
+GDALDataType type,
+size_t cells)
+{
+	void *grid;
+	size_t size;
+
+	if (type == GDT_Float64) size = sizeof(double);
+	else if (type == GDT_Float32) size = sizeof(float);
+	else return NULL;
+	grid = GC_MALLOC_ATOMIC(cells * size);
+	if (grid != NULL) memset(grid, 0, cells * size);
+	return grid;
+}
+
+static double stat_get(
+void *grid,
+GDALDataType type,
+size_t k)
+{
+	return (type == GDT_Float64) ? ((double *) grid)[k] : (double) ((float *) grid)[k];
+}
+
+static void stat_set(
+void *grid,
+GDALDataType type,
+size_t k,
+double value)
+{
+	if (type == GDT_Float64) ((double *) grid)[k] = value;
+	else ((float *) grid)[k] = (float) value;
+}
+
+CellStats *CELL_STATS_INIT(
+Outputs *Out,
+double *gridinfo)
+{
+	CellStats *cs;
+	size_t cells;
+
+	cs = (CellStats *) GC_MALLOC(sizeof(CellStats));
+	if (cs == NULL) {
+		fprintf(stderr, "[CELL_STATS_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	cs->cols = (int) gridinfo[2];
+	cs->rows = (int) gridinfo[4];
+	cells = (size_t) cs->cols * (size_t) cs->rows;
+	cs->mean_type = Out->cell_stats_type[0];
+	cs->m2_type = Out->cell_stats_type[1];
+	cs->max_type = Out->cell_stats_type[2];
+	if (cs->mean_type == GDT_Unknown) cs->m2_type = GDT_Unknown; /* std needs the mean */
+	cs->mean = stat_grid(cs->mean_type, cells);
+	cs->m2 = stat_grid(cs->m2_type, cells);
+	cs->max = stat_grid(cs->max_type, cells);
+	if ((cs->mean_type != GDT_Unknown && cs->mean == NULL) ||
+	    (cs->m2_type != GDT_Unknown && cs->m2 == NULL) ||
+	    (cs->max_type != GDT_Unknown && cs->max == NULL)) {
+		fprintf(stderr, "[CELL_STATS_INIT] Out of Memory for %d x %d cell statistics!\n",
+		        cs->cols, cs->rows);
+		return NULL;
+	}
+	return cs;
+}
+
+void CELL_STATS_UPDATE(
+CellStats *cs,
+FlowFootprint *fp,
+DataCell **grid)
+{
+	unsigned int c;
+	size_t k;
+	int row, col;
+	double x, n, mean, delta;
+
+	for (c = 0; c < fp->count; c++) {
+		row = fp->cells[c].row;
+		col = fp->cells[c].col;
+		k = (size_t) row * cs->cols + col;
+		x = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+		if (cs->mean != NULL) {
+			n = (double) grid[row][col].hit_count;
+			mean = stat_get(cs->mean, cs->mean_type, k);
+			delta = x - mean;
+			mean += delta / n;
+			stat_set(cs->mean, cs->mean_type, k, mean);
+			if (cs->m2 != NULL)
+				stat_set(cs->m2, cs->m2_type, k, stat_get(cs->m2, cs->m2_type, k) + delta * (x - mean));
+		}
+		if (cs->max != NULL && x > stat_get(cs->max, cs->max_type, k))
+			stat_set(cs->max, cs->max_type, k, x);
+	}
+}
+
+int CELL_STATS_WRITE(
+CellStats *cs,
+DataCell **grid,
+Outputs *Out,
+Inputs *In,
+double *gridinfo)
+{
+	char file[FILENAME_MAX];
+	float *data;
+	int row, col, n, ret = 0;
+	size_t k, j;
+
+	data = (float *) GC_MALLOC_ATOMIC((size_t) cs->cols * (size_t) cs->rows * sizeof(float));
+	if (data == NULL) {
+		fprintf(stderr, "[CELL_STATS_WRITE] Out of Memory creating raster data!\n");
+		return 1;
+	}
+
+	if (cs->mean != NULL) { /* rasters are written top row first */
+		for (j = 0, row = cs->rows - 1; row >= 0; row--)
+			for (col = 0, k = (size_t) row * cs->cols; col < cs->cols; col++, k++)
+				data[j++] = (float) stat_get(cs->mean, cs->mean_type, k);
+		snprintf(file, sizeof file, "%s_mean.tif", Out->cell_stats_file);
+		ret |= WRITE_RASTER(file, data, GDT_Float32, 1, Out, In, gridinfo);
+	}
+	if (cs->m2 != NULL) {
+		for (j = 0, row = cs->rows - 1; row >= 0; row--) {
+			for (col = 0, k = (size_t) row * cs->cols; col < cs->cols; col++, k++) {
+				n = grid[row][col].hit_count;
+				data[j++] = (n > 1) ? (float) sqrt(stat_get(cs->m2, cs->m2_type, k) / (n - 1)) : 0.0f;
+			}
+		}
+		snprintf(file, sizeof file, "%s_std.tif", Out->cell_stats_file);
+		ret |= WRITE_RASTER(file, data, GDT_Float32, 1, Out, In, gridinfo);
+	}
+	if (cs->max != NULL) {
+		for (j = 0, row = cs->rows - 1; row >= 0; row--)
+			for (col = 0, k = (size_t) row * cs->cols; col < cs->cols; col++, k++)
+				data[j++] = (float) stat_get(cs->max, cs->max_type, k);
+		snprintf(file, sizeof file, "%s_max.tif", Out->cell_stats_file);
+		ret |= WRITE_RASTER(file, data, GDT_Float32, 1, Out, In, gridinfo);
+	}
+	return ret;
+}
@@ -90,34 +90,31 @@ Inputs *In,
 Vent *vent,
 SpatialDensity *grid) 
 {
-	double sum_lambda = 0, sum = 0, half, random, left, right, top, bot, new_east, new_north;
-	int ct, i, num_grids, grid_spacing;
+	Sampler *s = In->sample;
+	double half, random, u, left, right, top, bot, new_east, new_north;
+	int i, grid_spacing;
 	/* SpatialDensity *grid = vent->spd_grd; */
 	
-	num_grids = In->num_grids;
 	grid_spacing = In->spd_grid_spacing;
 	
-	/*Sum data values over area of interest*/
-	for (ct = 0; ct < num_grids; ct++) 
-	{
-		sum_lambda += (grid+ct)->prob;
+	/* The cumulative spatial density, summed by SAMPLE_INIT */
+	if (s == NULL || s->cum == NULL) {
+		fprintf(stderr, "[CHOOSE_NEW_VENT] No spatial density sampler!\n");
+		return 1;
 	}
 #ifdef PRINT 
-	fprintf (stderr, "spatial density sums to: %0.2g\n", sum_lambda);
+	fprintf (stderr, "spatial density sums to: %0.2g\n", s->cum[s->num_cells]);
 #endif
 	half = (double)grid_spacing/2.0;
-	/* Choose a random number between 0 and calculated sum of data values */
-	random = (double) genunf ( (float) 0, (float) sum_lambda ); /*random_uniform(1,0,$sum_lambda); */
-	sum = 0;
-	i = 0;
+	/* Choose a number between 0 and the sum of data values: the point of
+	   the run in the SAMPLING design, or random */
+	if (SAMPLE_POINT(s, SAMPLE_VENT, &u)) random = u * s->cum[s->num_cells];
+	else random = (double) genunf ( (float) 0, (float) s->cum[s->num_cells] ); /*random_uniform(1,0,$sum_lambda); */
 #ifdef PRINT 
-	fprintf (stderr, "Random Value chosen: %g\n",random); */
+	fprintf (stderr, "Random Value chosen: %g\n",random);
 #endif
 	/* Select grid value for new vent based on the random value */
-	while (sum < random) 
-	{
-		sum += (grid + i++)->prob;
-	}
+	i = SAMPLE_CELL(s, random);
 	 /* Choose random and northing and easting for new vent within chosen grid cell */
 	left = (double)(grid + i)->easting - half;
 	right = (double)(grid + i)->easting + half;
@@ -0,0 +1,216 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: CONVERGE
+Stop an ensemble when its hit probabilities have converged, RUNS being
+the most runs (CONVERGE_EPSILON and/or CONVERGE_DELTA in the config file):
+
+CONVERGE_INIT   allocate the counters
+CONVERGE_ADD    count the cells of a run, after their hit counts
+CONVERGE_CHECK  every CONVERGE_EVERY runs, and after the last run:
+                report the precision, RETURN 1 when the criteria are met
+
+The hit probability of a cell after n runs is p = hits / n. Criteria:
+	CONVERGE_EPSILON  the largest 95% Wilson confidence half-width of p,
+	                  over the cells with p >= CONVERGE_FLOOR, is below it
+	CONVERGE_DELTA    the largest change of p of any cell since the
+	                  check before (CONVERGE_EVERY runs) is below it
+Both must be met when both are given.
+
+Nothing scans the grid. The half-width only depends on p(1 - p), so the
+widest cell is found in the histogram of the hit counts (cells by hit
+count, 0 to n), updated from the footprint of each run. A cell not hit
+since the last check changed by hits (1/n_last - 1/n), largest for the
+largest hit count among those cells: the histogram of the last check,
+less the cells hit since (kept in a list), gives it. The cells hit since
+the last check are compared one by one.
+*******************************/
+
+#define CONVERGE_Z 1.959964	/* 95% two-sided */
+
+/* grow the histograms to hold hit count h */
+static int grow(
+Convergence *cv,
+unsigned int h)
+{
+	unsigned int *hist, *check, size = cv->size;
+
+	if (h < size) return 0;
+	while (size <= h) size *= 2;
+	hist = (unsigned int *) GC_REALLOC(cv->hist, size * sizeof(unsigned int));
+	check = (unsigned int *) GC_REALLOC(cv->hist_check, size * sizeof(unsigned int));
+	if (hist == NULL || check == NULL) {
+		fprintf(stderr, "[CONVERGE_ADD] Out of Memory!\n");
+		return 1;
+	}
+	memset(hist + cv->size, 0, (size - cv->size) * sizeof(unsigned int));
+	memset(check + cv->size, 0, (size - cv->size) * sizeof(unsigned int));
+	cv->hist = hist;
+	cv->hist_check = check;
+	cv->size = size;
+	return 0;
+}
+
+Convergence *CONVERGE_INIT(
+Inputs *In,
+double *gridinfo)
+{
+	Convergence *cv;
+	size_t cells = (size_t) gridinfo[2] * (size_t) gridinfo[4];
+
+	cv = (Convergence *) GC_MALLOC(sizeof(Convergence));
+	if (cv == NULL) {
+		fprintf(stderr, "[CONVERGE_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	cv->cols = (int) gridinfo[2];
+	cv->epsilon = In->converge_epsilon;
+	cv->floor = In->converge_floor;
+	cv->delta = In->converge_delta;
+	cv->every = In->converge_every;
+	cv->runs = cv->runs_check = 0;
+	cv->next_check = cv->every;
+	cv->size = (In->runs < 1023) ? 1024 : (unsigned int) In->runs + 1;
+	cv->hist = (unsigned int *) GC_MALLOC_ATOMIC(cv->size * sizeof(unsigned int));
+	cv->hist_check = (unsigned int *) GC_MALLOC_ATOMIC(cv->size * sizeof(unsigned int));
+	cv->touched = (unsigned char *) GC_MALLOC_ATOMIC((cells + 7) / 8);
+	cv->num_touched = 0;
+	cv->max_touched = 4096;
+	cv->touched_cell = (unsigned long long *) GC_MALLOC_ATOMIC(cv->max_touched * sizeof(unsigned long long));
+	cv->touched_hits = (unsigned int *) GC_MALLOC_ATOMIC(cv->max_touched * sizeof(unsigned int));
+	if (cv->hist == NULL || cv->hist_check == NULL || cv->touched == NULL ||
+	    cv->touched_cell == NULL || cv->touched_hits == NULL) {
+		fprintf(stderr, "[CONVERGE_INIT] Out of Memory for %lu cells!\n", (unsigned long) cells);
+		return NULL;
+	}
+	memset(cv->hist, 0, cv->size * sizeof(unsigned int));
+	memset(cv->hist_check, 0, cv->size * sizeof(unsigned int));
+	memset(cv->touched, 0, (cells + 7) / 8);
+	cv->hist[0] = cv->hist_check[0] = (unsigned int) cells;
+	cv->halfwidth = cv->change = -1.0;
+	cv->num_floor = 0;
+	cv->converged = 0;
+	fprintf(stdout, "Convergence: every %d runs, at most %d runs", cv->every, In->runs);
+	if (cv->epsilon > 0) fprintf(stdout, ", half-width < %g where p >= %g", cv->epsilon, cv->floor);
+	if (cv->delta > 0) fprintf(stdout, ", change < %g", cv->delta);
+	fprintf(stdout, "\n");
+	return cv;
+}
+
+int CONVERGE_ADD(
+Convergence *cv,
+DataCell **grid,
+FlowFootprint *fp)
+{
+	unsigned long long cell;
+	unsigned long long *grown_cell;
+	unsigned int c, h, *grown_hits;
+
+	cv->runs++;
+	for (c = 0; c < fp->count; c++) {
+		h = (unsigned int) grid[fp->cells[c].row][fp->cells[c].col].hit_count;
+		if (grow(cv, h)) return 1;
+		cv->hist[h - 1]--;
+		cv->hist[h]++;
+
+		/* first hit since the last check: remember its count then */
+		cell = (unsigned long long) fp->cells[c].row * cv->cols + fp->cells[c].col;
+		if (cv->touched[cell / 8] & (1 << (cell % 8))) continue;
+		cv->touched[cell / 8] |= (unsigned char) (1 << (cell % 8));
+		if (cv->num_touched == cv->max_touched) {
+			cv->max_touched *= 2;
+			grown_cell = (unsigned long long *) GC_REALLOC(cv->touched_cell, cv->max_touched * sizeof(unsigned long long));
+			grown_hits = (unsigned int *) GC_REALLOC(cv->touched_hits, cv->max_touched * sizeof(unsigned int));
+			if (grown_cell == NULL || grown_hits == NULL) {
+				fprintf(stderr, "[CONVERGE_ADD] Out of Memory for %u cells!\n", cv->max_touched);
+				return 1;
+			}
+			cv->touched_cell = grown_cell;
+			cv->touched_hits = grown_hits;
+		}
+		cv->touched_cell[cv->num_touched] = cell;
+		cv->touched_hits[cv->num_touched++] = h - 1;
+	}
+	return 0;
+}
+
+int CONVERGE_CHECK(
+Convergence *cv,
+DataCell **grid,
+int last_run)
+{
+	double n = (double) cv->runs, last = (double) cv->runs_check, z2 = CONVERGE_Z * CONVERGE_Z;
+	double p, widest = -1.0, change = 0.0, x;
+	unsigned long long cell;
+	unsigned int h, hmin, i, top;
+
+	if (cv->runs < cv->next_check && !(last_run && cv->runs > cv->runs_check)) return cv->converged;
+	cv->next_check = cv->runs + cv->every;
+
+	/* the cell of largest p(1 - p) above the floor, from the histogram */
+	hmin = (unsigned int) ceil(cv->floor * n - 1e-9);
+	if (hmin < 1) hmin = 1;
+	cv->num_floor = 0;
+	for (h = hmin; h <= (unsigned int) cv->runs && h < cv->size; h++) {
+		if (!cv->hist[h]) continue;
+		cv->num_floor += cv->hist[h];
+		p = h / n;
+		if (p * (1.0 - p) > widest) widest = p * (1.0 - p);
+	}
+	/* Wilson score interval */
+	cv->halfwidth = (widest < 0) ? 0.0 :
+	                CONVERGE_Z * sqrt(widest / n + z2 / (4.0 * n * n)) / (1.0 + z2 / n);
+
+	/* the largest change since the last check */
+	for (i = 0; i < cv->num_touched; i++) {
+		cell = cv->touched_cell[i];
+		h = (unsigned int) grid[cell / cv->cols][cell % cv->cols].hit_count;
+		if (cv->runs_check) {
+			x = fabs(h / n - cv->touched_hits[i] / last);
+			if (x > change) change = x;
+		}
+		cv->hist_check[cv->touched_hits[i]]--;
+		cv->touched[cell / 8] &= (unsigned char) ~(1 << (cell % 8));
+	}
+	if (cv->runs_check) {
+		for (top = cv->size - 1; top > 0 && !cv->hist_check[top]; top--);
+		x = top * (1.0 / last - 1.0 / n);
+		if (x > change) change = x;
+		cv->change = change;
+	}
+	memcpy(cv->hist_check, cv->hist, cv->size * sizeof(unsigned int));
+	cv->num_touched = 0;
+	cv->runs_check = cv->runs;
+
+	cv->converged = (cv->epsilon <= 0 || cv->halfwidth < cv->epsilon) &&
+	            (cv->delta <= 0 || (cv->change >= 0 && cv->change < cv->delta));
+	fprintf(stdout, "Convergence after %d runs: half-width %.5f over %u cells with p >= %g",
+	        cv->runs, cv->halfwidth, cv->num_floor, cv->floor);
+	if (cv->change >= 0) fprintf(stdout, ", change %.5f", cv->change);
+	fprintf(stdout, "%s\n", cv->converged ? ", converged" : "");
+	return cv->converged;
+}
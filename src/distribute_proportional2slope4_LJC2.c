@@ -82,7 +82,8 @@ unsigned int *CAListSize,
 unsigned int *activeCount,
 Neighbor *activeNeighbor,
 double *gridinfo,
-Inputs *in
+Inputs *in,
+unsigned int *rand_state /* of the context, see FLOW_ERUPT */
 /*Vent *vent*/)
 {
 
@@ -100,6 +101,8 @@ Inputs *in
   int excess = 0;
  
 	*activeCount = 1;
+	/* the vent cell is reached with the first pulse, see ARRIVAL */
+	if (in->arrival != NULL && ARRIVAL_MARK(in->arrival, activeList->row, activeList->col)) return 1;
 	do { /* for all active cells */
 	  
 		myResidual = grid[(activeList+ct)->row][(activeList+ct)->col].residual;
@@ -131,7 +134,7 @@ Inputs *in
 		
       if (neighborCount > 1) { /* then shuffle list */
         for (i = 0; i < neighborCount-1; i++) {
-         r = (rand() % max);
+         r = (rand_r(rand_state) % max);
   	     temp = shuffle[r];
          shuffle[r] = shuffle[max];
   	     shuffle[max] = temp;
@@ -207,6 +210,9 @@ Inputs *in
            /*(activeList + *activeCount)->excess = 1;*/
 					 grid[(activeNeighbor+n)->row][(activeNeighbor+n)->col].active = *activeCount;
 					 *activeCount += 1;				
+					 /* Stamp the pulse if this is the first time the cell has excess lava */
+					 if (in->arrival != NULL && 
+					     ARRIVAL_MARK(in->arrival, (activeNeighbor+n)->row, (activeNeighbor+n)->col)) return 1;
 						
 						if (*activeCount == *CAListSize) { /* resize active list if more space is needed */
 							fprintf (stderr, 
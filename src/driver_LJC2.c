@@ -118,13 +118,409 @@ File Output type (int):
 0 = flow_map, format = X Y Z, easting northing thickness(m)
 */
 
+/* Set up scenario s of the table from the config file's In, Out and
+   ActiveFlow. RETURN: 0, 1 on error */
+static int apply_scenario(
+ScenarioTable *Scenarios,
+int s,
+Inputs *In,
+Outputs *Out,
+Lava_flow *ActiveFlow,
+Inputs *ScenarioIn,
+Outputs *ScenarioOut,
+Lava_flow *ScenarioFlow)
+{
+	*ScenarioIn = *In;
+	*ScenarioOut = *Out;
+	*ScenarioFlow = *ActiveFlow;
+	if (SCENARIO_APPLY(Scenarios, s, ScenarioIn, ScenarioOut, ScenarioFlow)) {
+		fprintf(stderr, "[MAIN]: Error returned from [SCENARIO_APPLY]. Exiting.\n");
+		return 1;
+	}
+	return 0;
+}
+
+/* Run the ensemble of one configuration, the config file or a scenario
+   of its SCENARIO_FILE, on the loaded DEM: open its outputs, run its
+   flows from run number start, and write its ensemble outputs.
+   With Pool the runs are made by its worker threads (scenario of Pool).
+   RETURN: 0, 1 on error */
+static int run_ensemble(
+MolassesContext *Ctx,
+Inputs *In,
+Outputs *Out,
+Lava_flow *ActiveFlow,
+int start,
+RunPool *Pool,
+int scenario)
+{
+	DataCell **Grid = Ctx->grid;		/* data Grid */
+	double *DEMmetadata = Ctx->gridinfo;	/* Geographic Metadata from GDAL */
+	unsigned int ActiveCounter = 0;		/* current # of Active Cells */
+	FlowFootprint *Footprint = NULL;	/* inundated cells of a finished run */
+	OutputQueue *WriteQueue = NULL;		/* per-run outputs waiting to be written */
+	int i, ret;
+	unsigned int pulseCount  = 0;				/* Current number of Main PULSE loops */
+	unsigned int c;
+	double thickness;						/* thickness of lava in cell */
+	double areaInundated = 0;
+	double volumeErupted = 0;		/* Total Lava Volume in All Active Cells */
+	double volumeRemaining = 0;	/* Volume Remaining to be Erupted */
+	double total = 0;						/* Difference between volumeErupted-Flow.volumeToErupt */
+	double distance, nearest;			/* cell to vent distances, for the runout */
+	int run = 0;			/* Current lava flow run */ 
+	int endrun = 0;   /* Last lava flow run */
+	int first = start;	/* first run to simulate, after those of a checkpoint */
+	int slot = 0;			/* run of the loop, before a flow off the grid is run again */
+	int attempt = 0;		/* times slot was run before, see SEED */
+	int retry = 0;			/* attempt of the next run */
+	int stopped = 0;		/* 1: at TIME_BUDGET, 2: a flow was abandoned there */
+	EnsembleState *Resume = In->resume_ensemble;	/* RESUME_ENSEMBLE, see ENSEMBLE_STATE */
+	unsigned char *Done = NULL;	/* completed runs, bit run - start */
+	RunResult Ran, *Made = NULL;	/* the run made, here or by a worker thread */
+	int unsaved = 0;		/* runs since the last ensemble checkpoint */
+	time_t saved = time(NULL);
+	
+	/* FLOW_ERUPT and DISTRIBUTE read the inputs of this ensemble */
+	Ctx->In = In;
+	
+	/* Open the flow archive, all runs are written into this one file */
+	if (strlen(Out->flow_archive_file) > 0) {
+		if (Resume != NULL)
+			Out->flow_archive = ENSSTATE_ARCHIVE(Resume, 0, Out->flow_archive_file, DEMmetadata, ARCHIVE_MAGIC);
+		else Out->flow_archive = ARCHIVE_OPEN(Out->flow_archive_file, DEMmetadata);
+		if (Out->flow_archive == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [ARCHIVE_OPEN]. Exiting.\n");
+			return 1;
+		}
+	}
+	
+	/* and/or the footprint index, for cross-run queries with molasses-query */
+	if (strlen(Out->footprint_index_file) > 0) {
+		if (Resume != NULL)
+			Out->footprint_index = ENSSTATE_ARCHIVE(Resume, 1, Out->footprint_index_file, DEMmetadata, FOOTINDEX_MAGIC);
+		else Out->footprint_index = FOOTINDEX_OPEN(Out->footprint_index_file, DEMmetadata);
+		if (Out->footprint_index == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [FOOTINDEX_OPEN]. Exiting.\n");
+			return 1;
+		}
+	}
+	
+	/* Snapshot frames of each run as it advances */
+	if (strlen(Out->snapshot_file) > 0) {
+		if (DEM_PROJECTION(In) == NULL) return 1;
+		Out->snapshot = SNAPSHOT_INIT(Out, In->dem_projection, DEMmetadata);
+		if (Out->snapshot == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [SNAPSHOT_INIT]. Exiting.\n");
+			return 1;
+		}
+	}
+	
+	/* The flows at smaller erupted volumes, taken by FLOW_ERUPT */
+	if (strlen(Out->volume_steps_file) > 0) {
+		if (!Out->num_volume_steps) {
+			fprintf(stderr, "[MAIN]: VOLUME_STEPS_FILE needs VOLUME_STEPS. Exiting.\n");
+			return 1;
+		}
+		/* an abandoned flow has its steps taken already, and a resumed
+		   ensemble would take them again */
+		if (In->time_budget_abandon && In->time_budget > 0) {
+			fprintf(stderr, "[MAIN]: VOLUME_STEPS_FILE cannot be used with TIME_BUDGET_ABANDON. Exiting.\n");
+			return 1;
+		}
+		Out->volume_steps = VOLSTEPS_INIT(In, Out, DEMmetadata);
+		if (Out->volume_steps == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [VOLSTEPS_INIT]. Exiting.\n");
+			return 1;
+		}
+		In->volume_steps = Out->volume_steps;
+	}
+	
+	/* Per-run outputs are written from flow footprints, see OUTPUT_QUEUE */
+	WriteQueue = OUTPUT_QUEUE_INIT(Out->output_threads, Out->output_queue_size, Out, DEMmetadata);
+	if (WriteQueue == NULL) {
+		fprintf(stderr, "[MAIN]: Error returned from [OUTPUT_QUEUE_INIT]. Exiting.\n");
+		return 1;
+	}
+	
+	/* The runs of a shard go to its shard file, the ensemble outputs
+	   are written by molasses-merge */
+	if (In->shard_count) {
+		Out->shard = SHARD_OPEN(In, Out, DEMmetadata, start);
+		if (Out->shard == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [SHARD_OPEN]. Exiting.\n");
+			return 1;
+		}
+	}
+	
+	/* Hit counts, outlines, quick-looks, arrivals and the ensemble accumulators */
+	if (ENSEMBLE_OPEN(Grid, In, Out, DEMmetadata)) {
+		fprintf(stderr, "[MAIN]: Error returned from [ENSEMBLE_OPEN]. Exiting.\n");
+		return 1;
+	}
+	
+	/* Stop early when the hit probabilities have converged, see CONVERGE */
+	if (In->converge_epsilon > 0 || In->converge_delta > 0) {
+		Out->converge = CONVERGE_INIT(In, DEMmetadata);
+		if (Out->converge == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [CONVERGE_INIT]. Exiting.\n");
+			return 1;
+		}
+	}
+	
+	/* The draws of the vents and flow parameters of the runs, see SAMPLING
+	   (set up with the scenarios for SCENARIO_THREADS) */
+	if (In->sample == NULL) In->sample = SAMPLE_INIT(In, ActiveFlow);
+	if (In->sample == NULL) {
+		fprintf(stderr, "[MAIN]: Error returned from [SAMPLE_INIT]. Exiting.\n");
+		return 1;
+	}
+	
+	/* Runs completed, for the ensemble checkpoints */
+	Done = (unsigned char *) GC_MALLOC_ATOMIC((In->runs + 7) / 8);
+	if (Done == NULL) {
+		fprintf(stderr, "[MAIN]: Out of Memory!\n");
+		return 1;
+	}
+	memset(Done, 0, (In->runs + 7) / 8);
+	
+	/* Go on with the ensemble of a checkpoint: hit counts, ensemble
+	   outputs and random number generators as they were after its last run */
+	if (Resume != NULL) {
+		if (Resume->runs != In->runs) {
+			fprintf(stderr, "[MAIN]: %s is of an ensemble of %d runs, not RUNS = %d. Exiting.\n",
+			        Resume->file, Resume->runs, In->runs);
+			return 1;
+		}
+		if (ENSSTATE_RESTORE(Resume, Grid, DEMmetadata, Out)) {
+			fprintf(stderr, "[MAIN]: Error returned from [ENSSTATE_RESTORE]. Exiting.\n");
+			return 1;
+		}
+		memcpy(Done, Resume->done, (In->runs + 7) / 8);
+		Ctx->rand_state = Resume->rand_seed;
+		first = Resume->next;
+		retry = Resume->attempt;
+	}
+	
+	endrun = In->runs + start;
+	if (Out->converge != NULL && Out->converge->converged) endrun = first;
+	for (run = first; run < endrun; run++) {
+		/* TIME_BUDGET: no run starts after the deadline */
+		if (RUN_PAST_DEADLINE(In)) {
+			stopped = 1;
+			break;
+		}
+		/* The runs of the other shards, see --shard */
+		if (In->shard_count && (run - start) % In->shard_count != In->shard_index - 1) continue;
+		pulseCount = 0; /* Keeps tract of number of lava pulses per run. */
+		ActiveCounter = 0; /* Keeps track of the current number of active cells. */
+		fprintf (stderr, "RUN #%d\n\n", run);
+		fprintf (stdout, "\nRUN #%d\n", run);
+		
+		/* With SEED each run has its own random numbers */
+		slot = run;
+		attempt = retry;
+		if (Pool != NULL) {
+			/* made by a worker thread, see RUN_POOL */
+			Made = RUN_POOL_TAKE(Pool, scenario, run, attempt);
+			if (Made == NULL && Pool->stopped) {
+				stopped = 1;	/* not made, the workers stopped at TIME_BUDGET */
+				break;
+			}
+			if (Made == NULL) {
+				fprintf (stderr, "[MAIN] Error returned from [RUN_POOL_TAKE]. Exiting\n");
+				return 1;
+			}
+			*ActiveFlow = Made->flow;
+			for (i = 0; i < ActiveFlow->num_vents; i++) {
+				fprintf (stderr, "[Run: %d] Vent: EASTING: %f\tNorthing: %f\n", run, (ActiveFlow->source+i)->easting, (ActiveFlow->source+i)->northing);
+				fprintf (stdout, "[Run: %d] Vent: EASTING: %f\tNorthing: %f\n", run, (ActiveFlow->source+i)->easting, (ActiveFlow->source+i)->northing);
+			}
+		}
+		else {
+			/* Set up the run, erupt the flow and copy it out of the grid */
+			Made = &Ran;
+			if (RUN_MAKE(Ctx, ActiveFlow, Out->snapshot, start, run, attempt, NULL, Made)) {
+				fprintf (stderr, "[MAIN] Error returned from [RUN_MAKE]. Exiting\n");
+				return 1;
+			}
+		}
+		ret = Made->ret;
+		pulseCount = Made->pulses;
+		volumeRemaining = Made->remaining;
+		Footprint = Made->fp;
+		/* TIME_BUDGET_ABANDON: the flow stopped at the deadline is not
+		   part of the ensemble, only its arrival stamps are cleared */
+		if (ret == 0 && volumeRemaining > 0) {
+			if (Pool == NULL) FLOW_RESET(Ctx);
+			retry = attempt;
+			stopped = 2;
+			break;
+		}
+		retry = 0;
+		if (ret < 0 && run > 0) {
+			fprintf(stdout, "Starting a new run.\n");
+			run--;
+			retry = attempt + 1;
+		}
+
+		volumeErupted = 0.0;
+		ActiveCounter = Footprint->count;
+		ActiveFlow->stats.max_thickness = 0.0;
+		ActiveFlow->stats.runout = 0.0;
+		/* Sum lava volume in each active flow cell */
+		for (c = 0; c < Footprint->count; c++) {
+			thickness = Footprint->cells[c].eff_elev - Footprint->cells[c].dem_elev;
+			volumeErupted += (thickness * DEMmetadata[1] * DEMmetadata[5]);
+			if (thickness > ActiveFlow->stats.max_thickness) ActiveFlow->stats.max_thickness = thickness;
+			/* Runout: distance of the cell from its nearest vent */
+			nearest = DBL_MAX;
+			for (i = 0; i < ActiveFlow->num_vents; i++) {
+				distance = hypot(DEMmetadata[0] + DEMmetadata[1] * Footprint->cells[c].col - ActiveFlow->source[i].easting,
+				                 DEMmetadata[3] + DEMmetadata[5] * Footprint->cells[c].row - ActiveFlow->source[i].northing);
+				if (distance < nearest) nearest = distance;
+			}
+			if (nearest > ActiveFlow->stats.runout) ActiveFlow->stats.runout = nearest;
+		}
+		areaInundated = ActiveCounter *  DEMmetadata[1] * DEMmetadata[5];
+		areaInundated /= 1e6;
+      fprintf(stdout, "Final Distribute: %d cells inundated.\n\n", ActiveCounter);
+      fprintf(stdout, "Area inundated:    %12.3f square km\n\n", areaInundated);
+		fprintf(stdout, "Conservation of mass check\n");
+		fprintf(stdout, " Total (IN) volume pulsed from vents:   %12.3f\n", ActiveFlow->volumeToErupt);
+		fprintf(stdout, " Total (OUT) volume found in cells:     %12.3f\n\n", volumeErupted);
+
+		total = volumeErupted - ActiveFlow->volumeToErupt;
+		if(abs(total) > 1e-8) fprintf(stderr, " ERROR: MASS NOT CONSERVED! Excess: %12.3f\n", total);
+		fprintf(stderr, "----------------------------------------\n");
+		
+		/* Per-run summary line */
+		ActiveFlow->stats.run = run;
+		ActiveFlow->stats.vent_count = ActiveFlow->num_vents;
+		ActiveFlow->stats.residual = ActiveFlow->residual;
+		ActiveFlow->stats.total_volume = ActiveFlow->volumeToErupt;
+		ActiveFlow->stats.remaining_volume = volumeRemaining;
+		ActiveFlow->stats.pulse_volume = ActiveFlow->pulsevolume;
+		ActiveFlow->stats.pulse_count = pulseCount;
+		ActiveFlow->stats.active_count = ActiveCounter;
+		ActiveFlow->stats.area = areaInundated;
+		ActiveFlow->stats.mass_error = total;
+		
+		/* Add the run to the ensemble outputs, or to the shard file */
+		if (Out->shard != NULL) {
+			if (SHARD_WRITE_RUN(Out->shard, slot, attempt, ActiveFlow, Footprint)) {
+				fprintf (stderr, "[MAIN] Error returned from [SHARD_WRITE_RUN]. Exiting\n");
+				return 1;
+			}
+		}
+		else if (ENSEMBLE_ADD(Grid, In, Out, ActiveFlow, Footprint, DEMmetadata)) {
+			fprintf (stderr, "[MAIN] Error returned from [ENSEMBLE_ADD]. Exiting\n");
+			return 1;
+		}
+		
+		/* RUNS is the most runs when the ensemble can converge */
+		if (Out->converge != NULL) {
+			if (CONVERGE_ADD(Out->converge, Grid, Footprint)) {
+				fprintf (stderr, "[MAIN] Error returned from [CONVERGE_ADD]. Exiting\n");
+				return 1;
+			}
+			if (!retry && CONVERGE_CHECK(Out->converge, Grid, 0)) endrun = run + 1;
+		}
+		
+		/* Save the flow thickness for each run to a file and/or 
+		   append it to the flow archive; with OUTPUT_THREADS this is 
+		   done by the writer threads while the next run starts */
+		ret = OUTPUT_QUEUE_PUSH(WriteQueue, Footprint);
+		if (ret) fprintf(stderr, "OUTPUT ERROR!\n");
+		fprintf(stdout, "OK\n");
+		if (Pool == NULL) FLOW_RESET(Ctx); /* reinitialize the data grid for the next flow */
+		
+		if (In->ensemble_checkpoint_file != NULL || Resume != NULL) {
+			if (run >= start) Done[(run - start) / 8] |= (unsigned char) (1 << ((run - start) % 8));
+			unsaved++;
+		}
+		if (In->ensemble_checkpoint_file != NULL &&
+		    ((In->ensemble_checkpoint_runs && unsaved >= In->ensemble_checkpoint_runs) ||
+		     (In->ensemble_checkpoint_seconds && time(NULL) - saved >= In->ensemble_checkpoint_seconds))) {
+			if (OUTPUT_QUEUE_FLUSH(WriteQueue)) fprintf(stderr, "OUTPUT ERROR!\n");
+			if (ENSSTATE_SAVE(In->ensemble_checkpoint_file, Grid, DEMmetadata, Out,
+			                  start, In->runs, run + 1, retry, Done, Ctx->rand_state)) {
+				fprintf(stderr, "[MAIN] Error returned from [ENSSTATE_SAVE]. Exiting\n");
+				return 1;
+			}
+			unsaved = 0;
+			saved = time(NULL);
+		}
+	} /* END:  for (run = start; run < (In->runs+start); run++) { */	
+	
+	/* At TIME_BUDGET the ensemble keeps a checkpoint to go on with later,
+	   with the random number generators as the abandoned run started */
+	if (stopped) {
+		fprintf(stdout, "TIME_BUDGET of %g seconds reached: the ensemble of runs %d to %d stops at run %d\n",
+		        In->time_budget, start, start + In->runs - 1, run);
+		if (In->ensemble_checkpoint_file != NULL && unsaved) {
+			if (OUTPUT_QUEUE_FLUSH(WriteQueue)) fprintf(stderr, "OUTPUT ERROR!\n");
+			if (stopped == 2) {
+				cg_set(cgn_get(), ActiveFlow->stats.seed1, ActiveFlow->stats.seed2);
+				Ctx->rand_state = Made->rand_state;
+			}
+			if (ENSSTATE_SAVE(In->ensemble_checkpoint_file, Grid, DEMmetadata, Out,
+			                  start, In->runs, run, retry, Done, Ctx->rand_state)) {
+				fprintf(stderr, "[MAIN] Error returned from [ENSSTATE_SAVE]. Exiting\n");
+				return 1;
+			}
+		}
+		endrun = run;
+	}
+	if (OUTPUT_QUEUE_CLOSE(WriteQueue)) fprintf(stderr, "OUTPUT ERROR!\n");
+	if (Out->flow_archive != NULL) {
+		if (ARCHIVE_CLOSE(Out->flow_archive)) fprintf(stderr, "Flow archive OUTPUT ERROR!\n");
+	}
+	if (Out->footprint_index != NULL) {
+		if (FOOTINDEX_CLOSE(Out->footprint_index)) fprintf(stderr, "Footprint index OUTPUT ERROR!\n");
+	}
+	if (Out->shard != NULL) {
+		if (SHARD_CLOSE(Out->shard, run)) fprintf(stderr, "Shard file OUTPUT ERROR!\n");
+	}
+	/* The ensemble outputs are of the runs made */
+	if (Out->converge != NULL) {
+		if (Out->converge->converged)
+			fprintf(stdout, "Converged after %d of at most %d runs\n", endrun - start, In->runs);
+		else if (!CONVERGE_CHECK(Out->converge, Grid, 1))
+			fprintf(stdout, "Not converged after %d runs\n", endrun - start);
+	}
+	In->runs = endrun - start;
+	fprintf(stdout, "OK\n");
+	ENSEMBLE_WRITE(Grid, In, Out, ActiveFlow, DEMmetadata, run);
+	if (Out->volume_steps != NULL) {
+		if (VOLSTEPS_WRITE(Out->volume_steps, Out, In, DEMmetadata)) 
+			fprintf(stderr, "Volume steps OUTPUT ERROR!\n");
+	}
+	fprintf(stdout, "OK\n");
+	if (In->flow_field > 0 && strlen(Out->raster_post_dem_file) > 2) {
+		ret = OUTPUT(
+		run,             /* run number */
+		raster_post,      /* file output type */
+		Out,            /* (type=Outputs*) 1D Output parameters structure */
+		In,             /* (type=Inputs*) 1D Input parameters structure */
+		Grid,            /* (type = DataCell *) Global Data Grid */ 
+		ActiveFlow,           /* (type=Lava_flow*) Lava_flow Data structure */
+		DEMmetadata);    /* (type=double*) Metadata array */ 
+
+		if (ret) fprintf(stderr, "Raster post dem OUTPUT ERROR!\n");
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[]) {
 
-	DataCell **Grid = NULL;			/* data Grid */
-	ActiveList *CAList = NULL;		/* Active Cell list */
-	Neighbor NeighborList[8];		/* Each cell can have at most 4 or 8 neighbors. */
+	MolassesContext *Ctx = NULL;		/* DEM, data grid and active list, see CONTEXT_OPEN */
 	Lava_flow ActiveFlow;						/* Lava_flow structure */
-	unsigned int ActiveCounter = 0;		/* current # of Active Cells */
+	ScenarioTable *Scenarios = NULL;	/* SCENARIO_FILE, see SCENARIO_LOAD */
+	Inputs *ScenarioIn = NULL;		/* In, Out and ActiveFlow of each scenario */
+	Outputs *ScenarioOut = NULL;
+	Lava_flow *ScenarioFlow = NULL;
+	RunPool *Pool = NULL;			/* SCENARIO_THREADS, see RUN_POOL */
 	
 	Inputs In;				/* Structure to hold model inputs named in Config file */
 	Outputs Out;			/* Structure to hold model outputs named in config file */
@@ -132,24 +528,15 @@ int main(int argc, char *argv[]) {
 	char *phrase;			/* seed phrase for random number generator */
 	int seed1;				/* random seed number */
 	int seed2;				/* random seed number */
-	int i,j, ret;  
-	unsigned int CAListSize  = 0;				/* Current size of active list, see INIT_FLOW */
-	unsigned int pulseCount  = 0;				/* Current number of Main PULSE loops */
-	double thickness;						/* thickness of lava in cell */
-	double areaInundated = 0;
-	double DEMmetadata[6];				/* Geographic Metadata from GDAL */
-	double volumeErupted = 0;		/* Total Lava Volume in All Active Cells */
-	double volumeRemaining = 0;	/* Volume Remaining to be Erupted */
-	double total = 0;						/* Difference between volumeErupted-Flow.volumeToErupt */
+	int s, a, ret;  
 
-	int run = 0;			/* Current lava flow run */ 
 	int start = 0;		/* Starting run number, from command line or 0 */
-	int endrun = 0;   /* Last lava flow run */
-	int current_vent = 0; /* Keep track of which vent is currently erupting */
+	int shard_index = 0, shard_count = 0;	/* --shard K/N */
+	struct timespec Started;	/* TIME_BUDGET counts from here */
   
 	GC_INIT();
+	clock_gettime(CLOCK_MONOTONIC, &Started);
 	startTime = time(NULL); 
-	srand(time(NULL));
 	
 	phrase = (char *)GC_MALLOC_ATOMIC(((size_t)size * sizeof(char)));	
   if (phrase == NULL) {
@@ -165,11 +552,20 @@ int main(int argc, char *argv[]) {
 	fprintf(stdout, "\n\n               MOLASSES is a lava flow simulator.\n\n");
 	
 	if(argc < 2) {
-		fprintf(stderr, "Usage: %s config-filename\n",argv[0]);
+		fprintf(stderr, "Usage: %s config-filename [start-run] [--shard K/N]\n",argv[0]);
 		return 1;
 	}
-	if (argc > 2) {
-		start = atoi(argv[2]);
+	for (a = 2; a < argc; a++) {
+		/* run shard K of N of the ensemble, see SHARD */
+		if (!strcmp(argv[a], "--shard")) {
+			if (a + 1 == argc || sscanf(argv[++a], "%d/%d", &shard_index, &shard_count) != 2 ||
+			    shard_count < 1 || shard_index < 1 || shard_index > shard_count) {
+				fprintf(stderr, "[MAIN]: --shard K/N, 1 <= K <= N. Exiting.\n");
+				return 1;
+			}
+			continue;
+		}
+		start = atoi(argv[a]);
 		fprintf(stderr, "Starting with run #%d\n", start);
 		if (start < 0) start = 0;
 	}
@@ -191,256 +587,131 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
+	/* TIME_BUDGET: the ensemble stops at the deadline, DEM loading included */
+	if (In.time_budget > 0) {
+		In.deadline = Started.tv_sec + 1e-9 * Started.tv_nsec + In.time_budget;
+		fprintf(stdout, "Time budget: %g seconds%s\n", In.time_budget,
+		        In.time_budget_abandon ? ", the flow erupting then is abandoned" : "");
+	}
+	
+	/* The runs of a shard must not depend on the runs of the other shards */
+	In.shard_index = shard_index;
+	In.shard_count = shard_count;
+	if (In.shard_count) {
+		if (In.seed < 0) {
+			fprintf(stderr, "[MAIN]: --shard needs SEED in the config file. Exiting.\n");
+			return 1;
+		}
+		if (In.scenario_file != NULL || In.flow_field || In.resume_file != NULL ||
+		    strlen(Out.volume_steps_file) > 0 || In.converge_epsilon > 0 || In.converge_delta > 0) {
+			fprintf(stderr, "[MAIN]: --shard cannot be used with SCENARIO_FILE, CREATE_FLOW_FIELD, RESUME_FLOW, VOLUME_STEPS_FILE or CONVERGE_. Exiting.\n");
+			return 1;
+		}
+		fprintf(stdout, "Shard %d of %d\n", In.shard_index, In.shard_count);
+	}
+	
 	/* Read in the DEM using the gdal library */
-	Grid = DEM_LOADER(
-	In.dem_file,	/* (type=char*)  DEM file name */
-	DEMmetadata,	/* (type=double*) 1D Metadata array */
-	Grid,			/* (type=DataCell**)  pointer ->2D Data Grid */
-	"TOPOG");		/* (type=string) Code for topography grid */
-	                        
-	if(Grid == NULL){
-		fprintf(stderr, "[MAIN]: Error returned from [DEM_LOADER]. Exiting.\n");
+	Ctx = CONTEXT_OPEN(&In);	/* (type=Inputs*) dem_file, elev_uncert, uncert_map */
+	if (Ctx == NULL) {
+		fprintf(stderr, "[MAIN]: Error returned from [CONTEXT_OPEN]. Exiting.\n");
 		return 1;
 	}
+	Ctx->verbose = 1;
+	Ctx->rand_state = (unsigned int) startTime;	/* DISTRIBUTE, see SEED */
 	
-	/* This is the pixel resolution. Assumes both dimensions are the same. */
-	/* In.cell_size = DEMmetadata[5]; */
-	
-	if(In.elev_uncert == -1) { /* user input an elevation uncertainty map*/
-		Grid = DEM_LOADER(		/* see file demloader.c) */
-		In.uncert_map,		/* (type=char*) uncertainty-grid filename*/
-		DEMmetadata, 		/* (type=double*) Metadata array */
-		Grid,    			/* (type=DataCell**)  pointer ->2D Data Grid */
-		"T_UNC");			/* (type=string) Code for elevation uncertainty */
-    
-		if(Grid == NULL){
-      	fprintf(stderr, "[MAIN]: Error returned from [DEM_LOADER]. Exiting.\n");
-      	return 1;
-    	}
+	/* Go on with the ensemble of a checkpoint, after its last saved run */
+	if (In.resume_ensemble_file != NULL) {
+		if (In.scenario_file != NULL || In.flow_field || In.resume_file != NULL) {
+			fprintf(stderr, "[MAIN]: RESUME_ENSEMBLE cannot be used with SCENARIO_FILE, CREATE_FLOW_FIELD or RESUME_FLOW. Exiting.\n");
+			return 1;
+		}
+		if (In.sampling != SAMPLE_MC && In.seed < 0) {
+			fprintf(stderr, "[MAIN]: RESUME_ENSEMBLE with SAMPLING other than MC needs SEED in the config file. Exiting.\n");
+			return 1;
+		}
+		In.resume_ensemble = ENSSTATE_LOAD(In.resume_ensemble_file, Ctx->gridinfo);
+		if (In.resume_ensemble == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [ENSSTATE_LOAD]. Exiting.\n");
+			return 1;
+		}
+		start = In.resume_ensemble->start;
+		fprintf(stdout, "Starting with run #%d\n", In.resume_ensemble->next);
 	}
-	else {		/* Select uncertainty value from config file */
-		for(i=0;i<DEMmetadata[4];i++) {
-			for(j=0;j<DEMmetadata[2];j++) {
-				Grid[i][j].elev_uncert = In.elev_uncert;
-			}
+	
+	/* Go on with the flow of a checkpoint, from its run */
+	if (In.resume_file != NULL) {
+		if (In.scenario_file != NULL || In.flow_field) {
+			fprintf(stderr, "[MAIN]: RESUME_FLOW cannot be used with SCENARIO_FILE or CREATE_FLOW_FIELD. Exiting.\n");
+			return 1;
 		}
+		In.resume = FLOWSTATE_LOAD(In.resume_file, Ctx->gridinfo, In.resume_volume);
+		if (In.resume == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [FLOWSTATE_LOAD]. Exiting.\n");
+			return 1;
+		}
+		/* the cells the flow reached before the checkpoint keep their arrival */
+		if (In.resume->arrival == NULL && (strlen(Out.arrival_file) > 0 || strlen(Out.arrival_ensemble_file) > 0)) {
+			fprintf(stderr, "[MAIN]: RESUME_FLOW with ARRIVAL_MAP or ARRIVAL_ENSEMBLE needs a checkpoint saved with them. Exiting.\n");
+			return 1;
+		}
+		start = In.resume->run;
+		fprintf(stdout, "Starting with run #%d\n", start);
 	}
 	
-	endrun = In.runs + start;
-	for (run = start; run < endrun; run++) {
-		pulseCount = 0; /* Keeps tract of number of lava pulses per run. */
-		ActiveCounter = 0; /* Keeps track of the current number of active cells. */
-		fprintf (stderr, "RUN #%d\n\n", run);
-		fprintf (stdout, "\nRUN #%d\n", run);
-		
-		ret = SET_FLOW_PARAMS(	/* see file set_flow_params.c  */
-				&In,				/* (type=Inputs*) 1D Input parameters structure  */
-				&ActiveFlow,			/* (Lava_flow*) Flow Structure */
-				DEMmetadata,	/* (type=double*) Metadata array */
-				Grid);			/* (type=DataCell**)  2D Data Grid */
-		
-		/* Select new vent from spatial density grid 
-		   OR
-		   If a vent coordinate is given, then use this coordinate. 
-		*/
-		if (In.spd_file != NULL) {
-			do { 
-				ret = CHOOSE_NEW_VENT(&In, ActiveFlow.source, ActiveFlow.spd_grd );
-				if (ret) {
-					fprintf (stderr, "\n[MAIN] Error returned from [CHOOSE_NEW_VENT].\nExiting!\n");
-					return 1;
-				}
-				ret = CHECK_VENT_LOCATION(ActiveFlow.source, DEMmetadata, Grid); /*Check for Vent outside of map region*/
-				if (ret) {
-					ActiveFlow.source->easting = 0;
-					ActiveFlow.source->northing = 0;
-					continue; /* select another vent location */
-				}
-			} while (!ActiveFlow.source->easting || !ActiveFlow.source->northing);
-		}
-		for (i = 0; i < ActiveFlow.num_vents; i++) {
-		  ret = CHECK_VENT_LOCATION(ActiveFlow.source+i, DEMmetadata, Grid); /*Check for Vent outside of map region*/
-		  if (ret) {
-			  fprintf (stderr, "[MAIN]Vent location outside of the grid area. Exiting\n");
-		    return 1;
-		  }
-      fprintf (stderr, "[Run: %d] Vent: EASTING: %f\tNorthing: %f\n", run, (ActiveFlow.source+i)->easting, (ActiveFlow.source+i)->northing);
-      fprintf (stdout, "[Run: %d] Vent: EASTING: %f\tNorthing: %f\n", run, (ActiveFlow.source+i)->easting, (ActiveFlow.source+i)->northing);
-      /*row = (int) ( ( Vent.northing - DEMmetadata[3]) / DEMmetadata[5]); / Row (Y) of vent cell */
-      /*col = (int) ((Vent.easting - DEMmetadata[0]) / DEMmetadata[1]); /Col (X) of vent cell */
-     /* Grid[row][col].active = 0; / vent cell */
-    }
-		/* Initialize the lava flow data structures and initialize vent cell. 
-		   TODO: try to figure out the maximum size possible for the active list */
-		CAList = INIT_FLOW(
-		Grid,					/* (type=DataCell**)  2D Data Grid */
-		/* CAList,				type=ActiveList*) 1D Active Cells List */
-		ActiveFlow.source,				/* (type=Lava_flow*) Lava_flow Data structure */
-		ActiveFlow.num_vents, /* Number of erupting vents */
-		&CAListSize,		/* (type= unsigned int*)  Max size of active List */
-		/* &ActiveCounter, 	 (type= unsigned int*) Active list current cell count */
-		DEMmetadata);		 /* (type=double*) Metadata array */
-
-		if (CAList == NULL) { 
-			fprintf (stderr, "[MAIN] Error returned from [INIT_FLOW]. Exiting\n");
+	if (In.scenario_file == NULL) {
+		if (run_ensemble(Ctx, &In, &Out, &ActiveFlow, start, NULL, 0)) return 1;
+	}
+	else {
+		/* Every scenario runs on the DEM loaded above */
+		if (In.flow_field) {
+			fprintf(stderr, "[MAIN]: SCENARIO_FILE cannot be used with CREATE_FLOW_FIELD. Exiting.\n");
 			return 1;
 		}
-
-		/* fprintf(stdout, "\nRunning Flow #%d from (%d, %d)\n", run, CAList->row, CAList->col); */
-		/* Initialize the remaining volume to be the volume of lava to erupt. */
-		volumeRemaining = ActiveFlow.volumeToErupt; 
-		//current_vent = (current_vent + 1) % (ActiveFlow.num_vents);
-    current_vent = 0;
-		/* Run the flow until the volume to erupt is exhausted. */
-		while(volumeRemaining > (double) 0.0) {
-      
-			/* vent cell gets a new pulse of lava to distribute 
-			   see file: pulse.c 
-			*/
-			current_vent = (current_vent + 1) % (ActiveFlow.num_vents);
-			
-			CAList->row = (ActiveFlow.source+current_vent)->row;
-			CAList->col = (ActiveFlow.source+current_vent)->col;
-			
-			if (!(pulseCount % 100))
-				fprintf(stdout, "[R%d]Vent: %6.0f %6.0f; Active Cells: %-3u; Volume Remaining: %10.3f Pulse count: %3u \n",
-				run,	
-				(ActiveFlow.source+current_vent)->easting,
-				(ActiveFlow.source+current_vent)->northing,		
-				ActiveCounter,
-				volumeRemaining,
-				pulseCount);
-			
-			
-			PULSE(
-			/* &ActiveCounter, 	 (type= unsigned int*) Active list current cell count */
-			CAList,				/* (type=ActiveList*) 1D Active Cells List */
-			&ActiveFlow,				/* (type=Lava_flow*) Lava_flow Data structure */
-			Grid,					/* (type=DataCell**)  2D Data Grid */
-			&volumeRemaining,	/* (type=double) Lava volume not yet erupted */
-			DEMmetadata);		/* (type=double*) Metadata array */
-		
-			pulseCount++;
-
-			/* Distribute lava to active cells and their 8 neighbors. */
-			ret = DISTRIBUTE(
-			Grid,					/* (type=DataCell**)  2D Data Grid */
-			CAList,				/* (type=ActiveList*) 1D Active Cells List */
-			&CAListSize,	/* (type=unsigned int) Max size of Active list */
-			&ActiveCounter,	/* (type=unsigned int*) Active list current cell count */
-			NeighborList,  	/* (type=Neighbor*) 8 element list of cell-neighbors info */
-			DEMmetadata,		/* (type=double*) Metadata array */
-			&In					/* (type=Inputs*) Inputs structure */
-			/* &ActiveFlow.source				(type=Lava_flow*) Lava_flow Data structure */
-			);
-
-			if (ret) {
-				fprintf (stderr, "[MAIN} Error returned from [DISTRIBUTE].ret=%d.. ", ret);
-				if (ret < 0) { 
-					if (run > 0) {
-					 fprintf(stdout, "Starting a new run.\n");
-					 run--;
-					}
-					volumeRemaining = 0.0;
-				}
-			}	
-		} /* while(volumeRemaining > (double)0.0) */
-			
-		
-
-		volumeErupted = 0.0;
-		ActiveCounter = 0;
-		/* Sum lava volume in each active flow cell */
-		
-		for(i = 0; i < DEMmetadata[4]; i++) {
-			for(j = 0; j < DEMmetadata[2]; j++) {
-				thickness = Grid[i][j].eff_elev - Grid[i][j].dem_elev;
-					/*if (Grid[i][j].active > -1)*/
-				if (thickness > 0) {  
-				  Grid[i][j].hit_count++; /* Increment hit codouble areaInundated = 0;unt */
-				  ActiveCounter++;
-				}
-				volumeErupted += (thickness * DEMmetadata[1] * DEMmetadata[5]);
+		Scenarios = SCENARIO_LOAD(In.scenario_file);
+		if (Scenarios == NULL) {
+			fprintf(stderr, "[MAIN]: Error returned from [SCENARIO_LOAD]. Exiting.\n");
+			return 1;
+		}
+		ScenarioIn = (Inputs *) GC_MALLOC((size_t) Scenarios->num_scenarios * sizeof(Inputs));
+		ScenarioOut = (Outputs *) GC_MALLOC((size_t) Scenarios->num_scenarios * sizeof(Outputs));
+		ScenarioFlow = (Lava_flow *) GC_MALLOC((size_t) Scenarios->num_scenarios * sizeof(Lava_flow));
+		if (ScenarioIn == NULL || ScenarioOut == NULL || ScenarioFlow == NULL) {
+			fprintf(stderr, "[MAIN]: Out of Memory for %d scenarios. Exiting.\n", Scenarios->num_scenarios);
+			return 1;
+		}
+		/* With SCENARIO_THREADS the scenarios are set up first: worker
+		   threads make their runs, the outputs are written here */
+		for (s = 0; s < Scenarios->num_scenarios && In.scenario_threads > 1; s++) {
+			if (apply_scenario(Scenarios, s, &In, &Out, &ActiveFlow, ScenarioIn + s, ScenarioOut + s, ScenarioFlow + s))
+				return 1;
+			if (ScenarioIn[s].seed < 0 || strlen(ScenarioOut[s].snapshot_file) > 0 ||
+			    strlen(ScenarioOut[s].volume_steps_file) > 0 || ScenarioIn[s].flow_checkpoint_file != NULL ||
+			    ScenarioIn[s].ensemble_checkpoint_file != NULL || ScenarioIn[s].converge_epsilon > 0 ||
+			    ScenarioIn[s].converge_delta > 0) {
+				fprintf(stderr, "[MAIN]: SCENARIO_THREADS needs SEED, and cannot be used with SNAPSHOT_FILE, VOLUME_STEPS_FILE, FLOW_CHECKPOINT, ENSEMBLE_CHECKPOINT or CONVERGE_. Exiting.\n");
+				return 1;
 			}
-		} 
-		areaInundated = ActiveCounter *  DEMmetadata[1] * DEMmetadata[5];
-		areaInundated /= 1e6;
-      fprintf(stdout, "Final Distribute: %d cells inundated.\n\n", ActiveCounter);
-      fprintf(stdout, "Area inundated:    %12.3f square km\n\n", areaInundated);
-		fprintf(stdout, "Conservation of mass check\n");
-		fprintf(stdout, " Total (IN) volume pulsed from vents:   %12.3f\n", ActiveFlow.volumeToErupt);
-		fprintf(stdout, " Total (OUT) volume found in cells:     %12.3f\n\n", volumeErupted);
-
-		total = volumeErupted - ActiveFlow.volumeToErupt;
-		if(abs(total) > 1e-8) fprintf(stderr, " ERROR: MASS NOT CONSERVED! Excess: %12.3f\n", total);
-		fprintf(stderr, "----------------------------------------\n");
-		
-		/* Save the flow thickness for each run to a file */
-		ret = OUTPUT(
-		run,             /* run number */
-		ascii_flow,      /* file output type */
-		&Out,            /* (type=Outputs*) 1D Output parameters structure */
-		&In,             /* (type=Inputs*) 1D Input parameters structure */
-		Grid,            /* (type = DataCell *) Global Data Grid */ 
-		&ActiveFlow,           /* (type=Lava_flow*) Lava_flow Data structure */
-		DEMmetadata);    /* (type=double*) Metadata array */ 
-		if (ret) fprintf(stderr, "OUTPUT ERROR!\n");
-		fprintf(stdout, "OK\n");
-		if (In.flow_field) { /* reinitialize the data grid using new dem*/
-			for(i = 0; i < DEMmetadata[4]; i++) {
-				for(j = 0; j < DEMmetadata[2]; j++) {
-					Grid[i][j].dem_elev = Grid[i][j].eff_elev;
-					Grid[i][j].active = -1;
-					Grid[i][j].parentcode = 0;
-				}
+			ScenarioIn[s].sample = SAMPLE_INIT(ScenarioIn + s, ScenarioFlow + s);
+			if (ScenarioIn[s].sample == NULL) {
+				fprintf(stderr, "[MAIN]: Error returned from [SAMPLE_INIT]. Exiting.\n");
+				return 1;
 			}
 		}
-		else { /* just reinitialize the data grid for new flow */
-			for(i = 0; i < DEMmetadata[4]; i++) {
-				for(j = 0; j < DEMmetadata[2]; j++) {
-					Grid[i][j].eff_elev = Grid[i][j].dem_elev;
-					Grid[i][j].active = -1;
-					Grid[i][j].parentcode = 0;
-			 }
+		if (In.scenario_threads > 1) {
+			Pool = RUN_POOL_START(Ctx, In.scenario_threads, ScenarioIn, ScenarioOut, ScenarioFlow,
+			                      Scenarios->num_scenarios, start);
+			if (Pool == NULL) {
+				fprintf(stderr, "[MAIN]: Error returned from [RUN_POOL_START]. Exiting.\n");
+				return 1;
 			}
 		}
-	} /* END:  for (run = start; run < (In.runs+start); run++) { */	
-	fprintf(stdout, "OK\n");
-	if (strlen(Out.ascii_hits_file) > 2) {
-	ret = OUTPUT(
-		run,             /* run number */
-		ascii_hits,      /* file output type */
-		&Out,            /* (type=Outputs*) 1D Output parameters structure */
-		&In,             /* (type=Inputs*) 1D Input parameters structure */
-		Grid,            /* (type = DataCell *) Global Data Grid */ 
-		&ActiveFlow,           /* (type=Lava_flow*) Lava_flow Data structure */
-		DEMmetadata);    /* (type=double*) Metadata array */ 
-	if (ret) fprintf(stderr, "Ascii hits OUTPUT ERROR!\n");
-	}
-	fprintf(stdout, "OK\n");
-	if (strlen(Out.raster_hits_file) > 2) {
-	ret = OUTPUT(
-		run,             /* run number */
-		raster_hits,      /* file output type */
-		&Out,            /* (type=Outputs*) 1D Output parameters structure */
-		&In,             /* (type=Inputs*) 1D Input parameters structure */
-		Grid,            /* (type = DataCell *) Global Data Grid */ 
-		&ActiveFlow,           /* (type=Lava_flow*) Lava_flow Data structure */
-		DEMmetadata);    /* (type=double*) Metadata array */ 
-	if (ret) fprintf(stderr, "Raster hits OUTPUT ERROR!\n");
-	}
-	fprintf(stdout, "OK\n");
-	if (In.flow_field > 0 && strlen(Out.raster_post_dem_file) > 2) {
-		ret = OUTPUT(
-		run,             /* run number */
-		raster_post,      /* file output type */
-		&Out,            /* (type=Outputs*) 1D Output parameters structure */
-		&In,             /* (type=Inputs*) 1D Input parameters structure */
-		Grid,            /* (type = DataCell *) Global Data Grid */ 
-		&ActiveFlow,           /* (type=Lava_flow*) Lava_flow Data structure */
-		DEMmetadata);    /* (type=double*) Metadata array */ 
-
-		if (ret) fprintf(stderr, "Raster post dem OUTPUT ERROR!\n");
+		for (s = 0; s < Scenarios->num_scenarios; s++) {
+			if (Pool == NULL &&
+			    apply_scenario(Scenarios, s, &In, &Out, &ActiveFlow, ScenarioIn + s, ScenarioOut + s, ScenarioFlow + s))
+				return 1;
+			if (run_ensemble(Ctx, ScenarioIn + s, ScenarioOut + s, ScenarioFlow + s, start, Pool, s)) return 1;
+		}
+		if (Pool != NULL) RUN_POOL_STOP(Pool);
 	}
 	fprintf(stdout, "OK\n");
 	endTime = time(NULL); /* Calculate simulation time elapsed */
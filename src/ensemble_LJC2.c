@@ -0,0 +1,198 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: ENSEMBLE
+The outputs of an ensemble of runs, added up run by run, for the
+driver and for molasses-merge (shard_merge.c):
+
+ENSEMBLE_OPEN   clear the hit counts, set up the outlines, quick-looks,
+                arrival stamps and the ensemble accumulators
+ENSEMBLE_ADD    add a finished run: hit counts, CELL_STATS, EXCEEDANCE_MAP,
+                ARRIVAL_ENSEMBLE, asset impacts and its STATS_FILE line
+ENSEMBLE_WRITE  write the ensemble outputs after the last run, of
+                In->runs runs (fewer than RUNS if the ensemble stopped
+                early), also the RUNS metadata item of its rasters
+
+The runs must be added in run order: the cell statistics, the ensemble
+arrivals and the CSV files depend on it.
+*******************************/
+
+int ENSEMBLE_OPEN(
+DataCell **grid,
+Inputs *In,
+Outputs *Out,
+double *gridinfo)
+{
+	int i, j;
+
+	/* Hit counts are of this ensemble */
+	for (i = 0; i < gridinfo[4]; i++)
+		for (j = 0; j < gridinfo[2]; j++)
+			grid[i][j].hit_count = 0;
+
+	/* Flow outlines take the CRS of the DEM */
+	if (strlen(Out->flow_outline_file) > 0 || strlen(Out->hit_outline_file) > 0) {
+		if (OUTLINE_INIT(In, Out)) {
+			fprintf(stderr, "[ENSEMBLE_OPEN] Error returned from [OUTLINE_INIT].\n");
+			return 1;
+		}
+	}
+
+	/* Shade the DEM once for the quick-look images */
+	if (strlen(Out->quicklook_flow_file) > 0 || strlen(Out->quicklook_hits_file) > 0) {
+		Out->quicklook = QUICKLOOK_INIT(grid, Out, gridinfo);
+		if (Out->quicklook == NULL) {
+			fprintf(stderr, "[ENSEMBLE_OPEN] Error returned from [QUICKLOOK_INIT].\n");
+			return 1;
+		}
+	}
+
+	/* Arrival of the lava at each cell, stamped by DISTRIBUTE;
+	   the runs of a shard keep theirs for molasses-merge */
+	if (strlen(Out->arrival_file) > 0 || strlen(Out->arrival_ensemble_file) > 0 || In->shard_count) {
+		Out->arrival = ARRIVAL_INIT(In, Out, gridinfo);
+		if (Out->arrival == NULL) {
+			fprintf(stderr, "[ENSEMBLE_OPEN] Error returned from [ARRIVAL_INIT].\n");
+			return 1;
+		}
+		In->arrival = Out->arrival;
+	}
+
+	/* Per-cell ensemble statistics of lava thickness */
+	if (strlen(Out->cell_stats_file) > 0) {
+		Out->cell_stats = CELL_STATS_INIT(Out, gridinfo);
+		if (Out->cell_stats == NULL) {
+			fprintf(stderr, "[ENSEMBLE_OPEN] Error returned from [CELL_STATS_INIT].\n");
+			return 1;
+		}
+	}
+
+	/* Exceedance probabilities of lava thickness thresholds */
+	if (strlen(Out->exceedance_file) > 0) {
+		if (!Out->num_thresholds) {
+			fprintf(stderr, "[ENSEMBLE_OPEN] EXCEEDANCE_MAP needs THICKNESS_THRESHOLDS.\n");
+			return 1;
+		}
+		Out->exceedance = EXCEEDANCE_INIT(Out, In->runs, gridinfo);
+		if (Out->exceedance == NULL) {
+			fprintf(stderr, "[ENSEMBLE_OPEN] Error returned from [EXCEEDANCE_INIT].\n");
+			return 1;
+		}
+	}
+
+	/* Assets to check each run against */
+	if (In->assets_file != NULL) {
+		Out->assets = ASSETS_LOAD(In->assets_file, gridinfo);
+		if (Out->assets == NULL) {
+			fprintf(stderr, "[ENSEMBLE_OPEN] Error returned from [ASSETS_LOAD].\n");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int ENSEMBLE_ADD(
+DataCell **grid,
+Inputs *In,
+Outputs *Out,
+Lava_flow *flow,
+FlowFootprint *fp,
+double *gridinfo)
+{
+	unsigned int c;
+
+	for (c = 0; c < fp->count; c++)
+		grid[fp->cells[c].row][fp->cells[c].col].hit_count++;
+	if (Out->arrival != NULL && ARRIVAL_ADD(Out->arrival, fp)) {
+		fprintf(stderr, "[ENSEMBLE_ADD] Error returned from [ARRIVAL_ADD].\n");
+		return 1;
+	}
+	if (Out->cell_stats != NULL) CELL_STATS_UPDATE(Out->cell_stats, fp, grid);
+	if (Out->exceedance != NULL && EXCEEDANCE_UPDATE(Out->exceedance, fp)) {
+		fprintf(stderr, "[ENSEMBLE_ADD] Error returned from [EXCEEDANCE_UPDATE].\n");
+		return 1;
+	}
+	if (Out->assets != NULL) {
+		if (ASSETS_RUN(Out->assets, fp, Out->asset_impacts_file))
+			fprintf(stderr, "Asset impacts OUTPUT ERROR!\n");
+	}
+	if (strlen(Out->stats_file) > 0) {
+		if (OUTPUT(fp->run, stats_file, Out, In, grid, flow, gridinfo))
+			fprintf(stderr, "Stats file OUTPUT ERROR!\n");
+	}
+	return 0;
+}
+
+int ENSEMBLE_WRITE(
+DataCell **grid,
+Inputs *In,
+Outputs *Out,
+Lava_flow *flow,
+double *gridinfo,
+int run)
+{
+	if (Out->stats != NULL) {
+		fclose(Out->stats);
+		Out->stats = NULL;
+	}
+	Out->ensemble_runs = In->runs;
+	if (strlen(Out->ascii_hits_file) > 2) {
+		if (OUTPUT(run, ascii_hits, Out, In, grid, flow, gridinfo))
+			fprintf(stderr, "Ascii hits OUTPUT ERROR!\n");
+	}
+	if (strlen(Out->raster_hits_file) > 2) {
+		if (OUTPUT(run, raster_hits, Out, In, grid, flow, gridinfo))
+			fprintf(stderr, "Raster hits OUTPUT ERROR!\n");
+	}
+	if (Out->cell_stats != NULL) {
+		if (CELL_STATS_WRITE(Out->cell_stats, grid, Out, In, gridinfo))
+			fprintf(stderr, "Cell statistics OUTPUT ERROR!\n");
+	}
+	if (Out->assets != NULL) {
+		if (ASSETS_SUMMARY(Out->assets, Out->asset_impacts_file))
+			fprintf(stderr, "Asset summary OUTPUT ERROR!\n");
+	}
+	if (Out->exceedance != NULL) {
+		if (EXCEEDANCE_WRITE(Out->exceedance, Out, In, gridinfo))
+			fprintf(stderr, "Exceedance map OUTPUT ERROR!\n");
+	}
+	if (strlen(Out->arrival_ensemble_file) > 0) {
+		if (ARRIVAL_WRITE(Out->arrival, Out, gridinfo))
+			fprintf(stderr, "Ensemble arrival OUTPUT ERROR!\n");
+	}
+	if (strlen(Out->hit_outline_file) > 0) {
+		if (OUTLINE_HITS(grid, In->runs, Out, gridinfo))
+			fprintf(stderr, "Hit outline OUTPUT ERROR!\n");
+	}
+	if (strlen(Out->quicklook_hits_file) > 0) {
+		if (QUICKLOOK_HITS(Out->quicklook, grid, In->runs, flow->source,
+		                   (In->vents_file != NULL) ? flow->num_vents : 0, Out->quicklook_hits_file))
+			fprintf(stderr, "Quick-look hits OUTPUT ERROR!\n");
+	}
+	Out->ensemble_runs = 0;
+	return 0;
+}
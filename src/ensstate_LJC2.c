@@ -0,0 +1,607 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*****************************
+MODULE: ENSEMBLE_STATE
+Checkpoints of an ensemble between two runs (ENSEMBLE_CHECKPOINT = file),
+rewritten every ENSEMBLE_CHECKPOINT_RUNS runs and/or after the run that
+passes ENSEMBLE_CHECKPOINT_SECONDS seconds since the last one. The
+ensemble goes on from the file with RESUME_ENSEMBLE = file, and ends
+with the outputs the uninterrupted ensemble would have written.
+
+ENSSTATE_SAVE     write the ensemble after a run
+ENSSTATE_LOAD     read the run numbers, random number generators and
+                  output file sizes of a checkpoint
+ENSSTATE_ARCHIVE  reopen the flow archive, footprint index or a volume
+                  step archive at its size of the checkpoint
+ENSSTATE_REOPEN   reopen a CSV output at its size of the checkpoint
+ENSSTATE_RESTORE  read the hit counts and the ensemble accumulators,
+                  set the ranlib state (the driver sets DISTRIBUTE's)
+
+A checkpoint holds the hit counts, the completed runs, the ranlib state
+(flow parameters and vents of the next run) and the rand_r() state of
+DISTRIBUTE (MolassesContext), saved as they are, so the runs do not
+depend on whether or when checkpoints are taken. It also holds the
+accumulators of the ensemble outputs that are on: CELL_STATS,
+EXCEEDANCE_MAP, VOLUME_STEPS_FILE, ARRIVAL_ENSEMBLE and ASSETS_FILE,
+which must be the same when resuming, and the convergence counters
+(CONVERGE_EPSILON, CONVERGE_DELTA).
+The writer threads are flushed first (OUTPUT_QUEUE_FLUSH), so the files
+of the finished runs are complete. Files appended run by run (STATS_FILE,
+asset impacts, volume step csv, archives, the shard file of --shard) are
+cut back to their size at the checkpoint when resuming; per-run files
+are written again.
+The file is written to file.tmp and renamed, so an ensemble killed while
+writing keeps the previous checkpoint.
+
+File layout, a gzip stream, native byte order:
+	char   magic[8]        "MOLENSC1"
+	int    cols, rows
+	double gridinfo[6]     (must match the DEM of the resumed ensemble)
+	int    start, runs     (first run and runs of the ensemble)
+	int    next            (run to go on with)
+	int    attempt         (of run next, see SEED)
+	unsigned int rand_seed
+	int    seed1, seed2    (ranlib state)
+	int    kept            (ENSSTATE_* accumulators)
+	long long stats_size, impacts_size, steps_size, shard_size  (bytes, < 0: no file)
+	int    num_archives    (flow archive, footprint index, volume step archives)
+	per archive:
+	int    written         (0: none, nothing follows)
+	long long size
+	unsigned int count
+	int run, long long offset of its record  (x count)
+	unsigned char done[(runs + 7) / 8]  (bit run - start: completed)
+	int    hit_count[rows][cols]
+	CELL_STATS:     int type[3] (mean, M2, max), then each kept grid
+	EXCEEDANCE_MAP: int thresholds, wide, runs, then the counts
+	VOLUME_STEPS:   int steps, wide, int runs[steps], then the counts
+	ARRIVAL_ENSEMBLE: per tile unsigned int n,
+	                unsigned short cell[n], float value[n]
+	ASSETS_FILE:    int assets, runs, unsigned int runs_hit[assets],
+	                double sum_max[assets], double max_max[assets]
+	CONVERGE:       int runs, runs_check, next_check, converged,
+	                double halfwidth, change, unsigned int size,
+	                unsigned int hist[size], hist_check[size], touched,
+	                unsigned long long cell[touched], unsigned int hits[touched]
+	char   magic[8]        "MOLENEND"
+*******************************/
+
+#define ENSSTATE_END_MAGIC "MOLENEND"
+#define ENSSTATE_CHUNK (1 << 30)	/* largest gzread/gzwrite */
+
+/* accumulators of the ensemble outputs, bits of EnsembleState.kept */
+#define ENSSTATE_CELL_STATS 1
+#define ENSSTATE_EXCEEDANCE 2
+#define ENSSTATE_VOLUME_STEPS 4
+#define ENSSTATE_ARRIVAL 8
+#define ENSSTATE_ASSETS 16
+#define ENSSTATE_CONVERGE 32
+
+static int kept_outputs(
+Outputs *Out)
+{
+	int kept = 0;
+
+	if (Out->cell_stats != NULL) kept |= ENSSTATE_CELL_STATS;
+	if (Out->exceedance != NULL) kept |= ENSSTATE_EXCEEDANCE;
+	if (Out->volume_steps != NULL) kept |= ENSSTATE_VOLUME_STEPS;
+	if (Out->arrival != NULL && Out->arrival->ensemble) kept |= ENSSTATE_ARRIVAL;
+	if (Out->assets != NULL) kept |= ENSSTATE_ASSETS;
+	if (Out->converge != NULL) kept |= ENSSTATE_CONVERGE;
+	return kept;
+}
+
+/* RETURN: 0, 1 if it could not be written */
+static int put(
+gzFile gz,
+const void *buf,
+size_t size)
+{
+	const char *p = (const char *) buf;
+	unsigned int n;
+
+	while (size > 0) {
+		n = (size > ENSSTATE_CHUNK) ? ENSSTATE_CHUNK : (unsigned int) size;
+		if (gzwrite(gz, p, n) != (int) n) return 1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/* RETURN: 0, 1 if the file ends first or is corrupt */
+static int get(
+gzFile gz,
+void *buf,
+size_t size)
+{
+	char *p = (char *) buf;
+	unsigned int n;
+
+	while (size > 0) {
+		n = (size > ENSSTATE_CHUNK) ? ENSSTATE_CHUNK : (unsigned int) size;
+		if (gzread(gz, p, n) != (int) n) return 1;
+		p += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/* bytes of an open output, after flushing it, -1 if not open */
+static long long file_size(
+FILE *fp)
+{
+	if (fp == NULL || fflush(fp)) return -1;
+	return (long long) ftello(fp);
+}
+
+static int put_archive(
+gzFile gz,
+FlowArchive *archive)
+{
+	long long size;
+	int written = (archive != NULL), ret;
+
+	ret = put(gz, &written, sizeof(int));
+	if (!written) return ret;
+	size = file_size(archive->fp);
+	ret |= (size < 0);
+	ret |= put(gz, &size, sizeof(long long));
+	ret |= put(gz, &archive->count, sizeof(unsigned int));
+	ret |= put(gz, archive->runs, archive->count * sizeof(int));
+	ret |= put(gz, archive->offsets, archive->count * sizeof(long long));
+	return ret;
+}
+
+static size_t stat_size(
+int type)
+{
+	if (type == GDT_Float64) return sizeof(double);
+	if (type == GDT_Float32) return sizeof(float);
+	return 0;
+}
+
+int ENSSTATE_SAVE(
+char *file,
+DataCell **grid,
+double *gridinfo,
+Outputs *Out,
+int start,
+int runs,
+int next,
+int attempt,
+unsigned char *done,
+unsigned int rand_seed)
+{
+	gzFile gz;
+	char tmp[FILENAME_MAX];
+	int cols = (int) gridinfo[2], rows = (int) gridinfo[4];
+	int row, col, i, seed1, seed2, kept, num_archives, ret = 0;
+	int *hits, types[3];
+	long long sizes[4];
+	size_t cells = (size_t) cols * (size_t) rows, tiles;
+	CellStats *cs = Out->cell_stats;
+	Exceedance *ex = Out->exceedance;
+	VolumeSteps *vs = Out->volume_steps;
+	Arrival *arr = Out->arrival;
+	AssetIndex *ai = Out->assets;
+	Convergence *cv = Out->converge;
+
+	hits = (int *) GC_MALLOC_ATOMIC(cols * sizeof(int));
+	if (hits == NULL) {
+		fprintf(stderr, "[ENSSTATE_SAVE] Out of Memory!\n");
+		return 1;
+	}
+	get_state(&seed1, &seed2);
+	kept = kept_outputs(Out);
+	sizes[0] = file_size(Out->stats);
+	sizes[1] = (ai != NULL) ? file_size(ai->out) : -1;
+	sizes[2] = (vs != NULL) ? file_size(vs->stats) : -1;
+	sizes[3] = (Out->shard != NULL) ? file_size(Out->shard->fp) : -1;
+	num_archives = ENSSTATE_STEP_ARCHIVES + ((vs != NULL && vs->archives != NULL) ? vs->num_steps : 0);
+
+	snprintf(tmp, sizeof tmp, "%s.tmp", file);
+	gz = gzopen(tmp, "wb6");
+	if (gz == NULL) {
+		fprintf(stderr, "[ENSSTATE_SAVE] Cannot open [%s]:[%s]!\n", tmp, strerror(errno));
+		return 1;
+	}
+	ret |= put(gz, ENSSTATE_MAGIC, 8);
+	ret |= put(gz, &cols, sizeof(int));
+	ret |= put(gz, &rows, sizeof(int));
+	ret |= put(gz, gridinfo, 6 * sizeof(double));
+	ret |= put(gz, &start, sizeof(int));
+	ret |= put(gz, &runs, sizeof(int));
+	ret |= put(gz, &next, sizeof(int));
+	ret |= put(gz, &attempt, sizeof(int));
+	ret |= put(gz, &rand_seed, sizeof(unsigned int));
+	ret |= put(gz, &seed1, sizeof(int));
+	ret |= put(gz, &seed2, sizeof(int));
+	ret |= put(gz, &kept, sizeof(int));
+	ret |= put(gz, sizes, sizeof sizes);
+	ret |= put(gz, &num_archives, sizeof(int));
+	ret |= put_archive(gz, Out->flow_archive);
+	ret |= put_archive(gz, Out->footprint_index);
+	for (i = ENSSTATE_STEP_ARCHIVES; i < num_archives; i++)
+		ret |= put_archive(gz, vs->archives[i - ENSSTATE_STEP_ARCHIVES]);
+	ret |= put(gz, done, (runs + 7) / 8);
+
+	for (row = 0; row < rows; row++) {
+		for (col = 0; col < cols; col++) hits[col] = grid[row][col].hit_count;
+		ret |= put(gz, hits, cols * sizeof(int));
+	}
+	if (kept & ENSSTATE_CELL_STATS) {
+		types[0] = cs->mean_type;
+		types[1] = cs->m2_type;
+		types[2] = cs->max_type;
+		ret |= put(gz, types, sizeof types);
+		ret |= put(gz, cs->mean, cells * stat_size(cs->mean_type));
+		ret |= put(gz, cs->m2, cells * stat_size(cs->m2_type));
+		ret |= put(gz, cs->max, cells * stat_size(cs->max_type));
+	}
+	if (kept & ENSSTATE_EXCEEDANCE) {
+		ret |= put(gz, &ex->num_thresholds, sizeof(int));
+		ret |= put(gz, &ex->wide, sizeof(int));
+		ret |= put(gz, &ex->runs, sizeof(int));
+		ret |= put(gz, ex->counts, cells * ex->num_thresholds *
+		           (ex->wide ? sizeof(unsigned int) : sizeof(unsigned short)));
+	}
+	if (kept & ENSSTATE_VOLUME_STEPS) {
+		ret |= put(gz, &vs->num_steps, sizeof(int));
+		ret |= put(gz, &vs->wide, sizeof(int));
+		ret |= put(gz, vs->runs, vs->num_steps * sizeof(int));
+		ret |= put(gz, vs->counts, cells * vs->num_steps *
+		           (vs->wide ? sizeof(unsigned int) : sizeof(unsigned short)));
+	}
+	if (kept & ENSSTATE_ARRIVAL) {
+		tiles = (size_t) arr->tiles_x * arr->tiles_y;
+		for (i = 0; i < (int) tiles; i++) {
+			ret |= put(gz, arr->ens_count + i, sizeof(unsigned int));
+			ret |= put(gz, arr->ens_cell[i], arr->ens_count[i] * sizeof(unsigned short));
+			ret |= put(gz, arr->ens_value[i], arr->ens_count[i] * sizeof(float));
+		}
+	}
+	if (kept & ENSSTATE_ASSETS) {
+		ret |= put(gz, &ai->num_assets, sizeof(int));
+		ret |= put(gz, &ai->runs, sizeof(int));
+		ret |= put(gz, ai->runs_hit, ai->num_assets * sizeof(unsigned int));
+		ret |= put(gz, ai->sum_max, ai->num_assets * sizeof(double));
+		ret |= put(gz, ai->max_max, ai->num_assets * sizeof(double));
+	}
+	if (kept & ENSSTATE_CONVERGE) {
+		ret |= put(gz, &cv->runs, sizeof(int));
+		ret |= put(gz, &cv->runs_check, sizeof(int));
+		ret |= put(gz, &cv->next_check, sizeof(int));
+		ret |= put(gz, &cv->converged, sizeof(int));
+		ret |= put(gz, &cv->halfwidth, sizeof(double));
+		ret |= put(gz, &cv->change, sizeof(double));
+		ret |= put(gz, &cv->size, sizeof(unsigned int));
+		ret |= put(gz, cv->hist, cv->size * sizeof(unsigned int));
+		ret |= put(gz, cv->hist_check, cv->size * sizeof(unsigned int));
+		ret |= put(gz, &cv->num_touched, sizeof(unsigned int));
+		ret |= put(gz, cv->touched_cell, cv->num_touched * sizeof(unsigned long long));
+		ret |= put(gz, cv->touched_hits, cv->num_touched * sizeof(unsigned int));
+	}
+	ret |= put(gz, ENSSTATE_END_MAGIC, 8);
+	if (gzclose(gz) != Z_OK || ret) {
+		fprintf(stderr, "[ENSSTATE_SAVE] Cannot write [%s]:[%s]!\n", tmp, strerror(errno));
+		remove(tmp);
+		return 1;
+	}
+	if (rename(tmp, file)) {
+		fprintf(stderr, "[ENSSTATE_SAVE] Cannot rename [%s] to [%s]:[%s]!\n", tmp, file, strerror(errno));
+		return 1;
+	}
+	fprintf(stdout, "Ensemble checkpoint %s: runs %d to %d done\n", file, start, next - 1);
+	return 0;
+}
+
+EnsembleState *ENSSTATE_LOAD(
+char *file,
+double *gridinfo)
+{
+	gzFile gz;
+	EnsembleState *state;
+	FlowArchive *archive;
+	char magic[8];
+	int cols, rows, i, written;
+	long long sizes[4];
+	double info[6];
+
+	gz = gzopen(file, "rb");
+	if (gz == NULL) {
+		fprintf(stderr, "[ENSSTATE_LOAD] Cannot open ensemble checkpoint=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	state = (EnsembleState *) GC_MALLOC(sizeof(EnsembleState));
+	if (state == NULL) {
+		fprintf(stderr, "[ENSSTATE_LOAD] Out of Memory!\n");
+		gzclose(gz);
+		return NULL;
+	}
+	if (get(gz, magic, 8) || memcmp(magic, ENSSTATE_MAGIC, 8) || get(gz, &cols, sizeof(int)) ||
+	    get(gz, &rows, sizeof(int)) || get(gz, info, sizeof info)) {
+		fprintf(stderr, "[ENSSTATE_LOAD] [%s] is not an ensemble checkpoint!\n", file);
+		gzclose(gz);
+		return NULL;
+	}
+	if (cols != (int) gridinfo[2] || rows != (int) gridinfo[4] || memcmp(info, gridinfo, sizeof info)) {
+		fprintf(stderr, "[ENSSTATE_LOAD] [%s] is of another DEM (%d x %d cells)!\n", file, cols, rows);
+		gzclose(gz);
+		return NULL;
+	}
+	if (get(gz, &state->start, sizeof(int)) || get(gz, &state->runs, sizeof(int)) ||
+	    get(gz, &state->next, sizeof(int)) || get(gz, &state->attempt, sizeof(int)) ||
+	    get(gz, &state->rand_seed, sizeof(unsigned int)) ||
+	    get(gz, &state->seed1, sizeof(int)) || get(gz, &state->seed2, sizeof(int)) ||
+	    get(gz, &state->kept, sizeof(int)) || get(gz, sizes, sizeof sizes) ||
+	    get(gz, &state->num_archives, sizeof(int)) || state->runs < 1 ||
+	    state->num_archives < ENSSTATE_STEP_ARCHIVES) {
+		fprintf(stderr, "[ENSSTATE_LOAD] [%s] is truncated!\n", file);
+		gzclose(gz);
+		return NULL;
+	}
+	state->stats_size = sizes[0];
+	state->impacts_size = sizes[1];
+	state->steps_size = sizes[2];
+	state->shard_size = sizes[3];
+	state->archives = (FlowArchive **) GC_MALLOC(state->num_archives * sizeof(FlowArchive *));
+	state->archive_size = (long long *) GC_MALLOC_ATOMIC(state->num_archives * sizeof(long long));
+	state->done = (unsigned char *) GC_MALLOC_ATOMIC((state->runs + 7) / 8);
+	if (state->archives == NULL || state->archive_size == NULL || state->done == NULL) {
+		fprintf(stderr, "[ENSSTATE_LOAD] Out of Memory!\n");
+		gzclose(gz);
+		return NULL;
+	}
+	for (i = 0; i < state->num_archives; i++) {
+		if (get(gz, &written, sizeof(int))) break;
+		if (!written) continue;
+		archive = (FlowArchive *) GC_MALLOC(sizeof(FlowArchive));
+		if (archive == NULL || get(gz, state->archive_size + i, sizeof(long long)) ||
+		    get(gz, &archive->count, sizeof(unsigned int))) break;
+		archive->runs = (int *) GC_MALLOC_ATOMIC((archive->count + 1) * sizeof(int));
+		archive->offsets = (long long *) GC_MALLOC_ATOMIC((archive->count + 1) * sizeof(long long));
+		if (archive->runs == NULL || archive->offsets == NULL ||
+		    get(gz, archive->runs, archive->count * sizeof(int)) ||
+		    get(gz, archive->offsets, archive->count * sizeof(long long))) break;
+		state->archives[i] = archive;
+	}
+	if (i < state->num_archives || get(gz, state->done, (state->runs + 7) / 8)) {
+		fprintf(stderr, "[ENSSTATE_LOAD] [%s] is truncated!\n", file);
+		gzclose(gz);
+		return NULL;
+	}
+	state->file = file;
+	state->in = gz;
+	fprintf(stdout, "Resuming the ensemble of %s: runs %d to %d of %d to %d done\n",
+	        file, state->start, state->next - 1, state->start, state->start + state->runs - 1);
+	return state;
+}
+
+FlowArchive *ENSSTATE_ARCHIVE(
+EnsembleState *state,
+int k,
+char *file,
+double *gridinfo,
+const char *magic)
+{
+	if (k >= state->num_archives || state->archives[k] == NULL) {
+		fprintf(stderr, "[ENSSTATE_ARCHIVE] %s was not written when %s was saved!\n", file, state->file);
+		return NULL;
+	}
+	return ARCHIVE_REOPEN(file, gridinfo, magic, state->archives[k], state->archive_size[k]);
+}
+
+FILE *ENSSTATE_REOPEN(
+char *file,
+long long size)
+{
+	struct stat st;
+	FILE *fp;
+
+	if (stat(file, &st) || (long long) st.st_size < size) {
+		fprintf(stderr, "[ENSSTATE_REOPEN] [%s] is missing or shorter than at the checkpoint!\n", file);
+		return NULL;
+	}
+	if (truncate(file, (off_t) size) || (fp = fopen(file, "a")) == NULL) {
+		fprintf(stderr, "[ENSSTATE_REOPEN] Cannot reopen [%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	return fp;
+}
+
+int ENSSTATE_RESTORE(
+EnsembleState *state,
+DataCell **grid,
+double *gridinfo,
+Outputs *Out)
+{
+	gzFile gz = (gzFile) state->in;
+	char file[FILENAME_MAX], magic[8];
+	int cols = (int) gridinfo[2], rows = (int) gridinfo[4];
+	int row, col, i, n[3], ret = 0;
+	int *hits;
+	unsigned int size;
+	unsigned long long cell;
+	size_t cells = (size_t) cols * (size_t) rows, tiles;
+	CellStats *cs = Out->cell_stats;
+	Exceedance *ex = Out->exceedance;
+	VolumeSteps *vs = Out->volume_steps;
+	Arrival *arr = Out->arrival;
+	AssetIndex *ai = Out->assets;
+	Convergence *cv = Out->converge;
+
+	if (state->kept != kept_outputs(Out)) {
+		fprintf(stderr, "[ENSSTATE_RESTORE] %s kept other ensemble outputs than the config file asks for!\n",
+		        state->file);
+		gzclose(gz);
+		return 1;
+	}
+	hits = (int *) GC_MALLOC_ATOMIC(cols * sizeof(int));
+	if (hits == NULL) {
+		fprintf(stderr, "[ENSSTATE_RESTORE] Out of Memory!\n");
+		gzclose(gz);
+		return 1;
+	}
+	for (row = 0; row < rows && !ret; row++) {
+		ret |= get(gz, hits, cols * sizeof(int));
+		for (col = 0; col < cols; col++) grid[row][col].hit_count = hits[col];
+	}
+	if (!ret && cs != NULL) {
+		ret |= get(gz, n, sizeof n);
+		if (!ret && (n[0] != cs->mean_type || n[1] != cs->m2_type || n[2] != cs->max_type)) {
+			fprintf(stderr, "[ENSSTATE_RESTORE] CELL_STATS_PRECISION is not that of %s!\n", state->file);
+			ret = 2;
+		}
+		if (!ret) {
+			ret |= get(gz, cs->mean, cells * stat_size(cs->mean_type));
+			ret |= get(gz, cs->m2, cells * stat_size(cs->m2_type));
+			ret |= get(gz, cs->max, cells * stat_size(cs->max_type));
+		}
+	}
+	if (!ret && ex != NULL) {
+		ret |= get(gz, n, sizeof n);
+		/* the counters were widened in the checkpointed runs */
+		if (!ret && n[1] && !ex->wide && EXCEEDANCE_WIDEN(ex)) ret = 1;
+		if (!ret && (n[0] != ex->num_thresholds || n[1] != ex->wide)) {
+			fprintf(stderr, "[ENSSTATE_RESTORE] THICKNESS_THRESHOLDS are not those of %s!\n", state->file);
+			ret = 2;
+		}
+		ex->runs = n[2];
+		if (!ret) ret |= get(gz, ex->counts, cells * ex->num_thresholds *
+		                     (ex->wide ? sizeof(unsigned int) : sizeof(unsigned short)));
+	}
+	if (!ret && vs != NULL) {
+		ret |= get(gz, n, 2 * sizeof(int));
+		if (!ret && n[1] && !vs->wide && VOLSTEPS_WIDEN(vs)) ret = 1;
+		if (!ret && (n[0] != vs->num_steps || n[1] != vs->wide)) {
+			fprintf(stderr, "[ENSSTATE_RESTORE] VOLUME_STEPS are not those of %s!\n", state->file);
+			ret = 2;
+		}
+		if (!ret) {
+			ret |= get(gz, vs->runs, vs->num_steps * sizeof(int));
+			ret |= get(gz, vs->counts, cells * vs->num_steps *
+			           (vs->wide ? sizeof(unsigned int) : sizeof(unsigned short)));
+		}
+	}
+	if (!ret && (state->kept & ENSSTATE_ARRIVAL)) {
+		tiles = (size_t) arr->tiles_x * arr->tiles_y;
+		for (i = 0; i < (int) tiles && !ret; i++) {
+			ret |= get(gz, arr->ens_count + i, sizeof(unsigned int));
+			if (ret || !arr->ens_count[i]) continue;
+			arr->ens_size[i] = arr->ens_count[i];
+			arr->ens_cell[i] = (unsigned short *) GC_MALLOC_ATOMIC(arr->ens_size[i] * sizeof(unsigned short));
+			arr->ens_value[i] = (float *) GC_MALLOC_ATOMIC(arr->ens_size[i] * sizeof(float));
+			if (arr->ens_cell[i] == NULL || arr->ens_value[i] == NULL) {
+				fprintf(stderr, "[ENSSTATE_RESTORE] Out of Memory for the ensemble arrivals!\n");
+				ret = 2;
+				break;
+			}
+			ret |= get(gz, arr->ens_cell[i], arr->ens_count[i] * sizeof(unsigned short));
+			ret |= get(gz, arr->ens_value[i], arr->ens_count[i] * sizeof(float));
+		}
+	}
+	if (!ret && ai != NULL) {
+		ret |= get(gz, n, 2 * sizeof(int));
+		if (!ret && n[0] != ai->num_assets) {
+			fprintf(stderr, "[ENSSTATE_RESTORE] ASSETS_FILE is not that of %s!\n", state->file);
+			ret = 2;
+		}
+		ai->runs = n[1];
+		if (!ret) {
+			ret |= get(gz, ai->runs_hit, ai->num_assets * sizeof(unsigned int));
+			ret |= get(gz, ai->sum_max, ai->num_assets * sizeof(double));
+			ret |= get(gz, ai->max_max, ai->num_assets * sizeof(double));
+		}
+	}
+	if (!ret && cv != NULL) {
+		ret |= get(gz, n, sizeof n);
+		ret |= get(gz, &cv->converged, sizeof(int));
+		ret |= get(gz, &cv->halfwidth, sizeof(double));
+		ret |= get(gz, &cv->change, sizeof(double));
+		ret |= get(gz, &size, sizeof(unsigned int));
+		cv->runs = n[0];
+		cv->runs_check = n[1];
+		cv->next_check = n[2];
+		if (!ret && size > cv->size) {
+			cv->hist = (unsigned int *) GC_MALLOC_ATOMIC(size * sizeof(unsigned int));
+			cv->hist_check = (unsigned int *) GC_MALLOC_ATOMIC(size * sizeof(unsigned int));
+			if (cv->hist == NULL || cv->hist_check == NULL) {
+				fprintf(stderr, "[ENSSTATE_RESTORE] Out of Memory for the convergence counters!\n");
+				ret = 2;
+			}
+		}
+		if (!ret) {
+			if (size > cv->size) cv->size = size;
+			memset(cv->hist, 0, cv->size * sizeof(unsigned int));
+			memset(cv->hist_check, 0, cv->size * sizeof(unsigned int));
+			ret |= get(gz, cv->hist, size * sizeof(unsigned int));
+			ret |= get(gz, cv->hist_check, size * sizeof(unsigned int));
+			ret |= get(gz, &cv->num_touched, sizeof(unsigned int));
+		}
+		if (!ret && cv->num_touched > cv->max_touched) {
+			cv->max_touched = cv->num_touched;
+			cv->touched_cell = (unsigned long long *) GC_MALLOC_ATOMIC(cv->max_touched * sizeof(unsigned long long));
+			cv->touched_hits = (unsigned int *) GC_MALLOC_ATOMIC(cv->max_touched * sizeof(unsigned int));
+			if (cv->touched_cell == NULL || cv->touched_hits == NULL) {
+				fprintf(stderr, "[ENSSTATE_RESTORE] Out of Memory for the convergence counters!\n");
+				ret = 2;
+			}
+		}
+		if (!ret) {
+			ret |= get(gz, cv->touched_cell, cv->num_touched * sizeof(unsigned long long));
+			ret |= get(gz, cv->touched_hits, cv->num_touched * sizeof(unsigned int));
+		}
+		/* the cells hit since the last check */
+		for (i = 0; !ret && i < (int) cv->num_touched; i++) {
+			cell = cv->touched_cell[i];
+			if (cell >= cells) ret = 1;
+			else cv->touched[cell / 8] |= (unsigned char) (1 << (cell % 8));
+		}
+	}
+	if (!ret && (get(gz, magic, 8) || memcmp(magic, ENSSTATE_END_MAGIC, 8))) ret = 1;
+	gzclose(gz);
+	if (ret) {
+		if (ret == 1) fprintf(stderr, "[ENSSTATE_RESTORE] [%s] is truncated or corrupt!\n", state->file);
+		return 1;
+	}
+
+	/* the run-by-run files go on after the runs of the checkpoint */
+	if (strlen(Out->stats_file) > 0 && state->stats_size >= 0) {
+		Out->stats = ENSSTATE_REOPEN(Out->stats_file, state->stats_size);
+		if (Out->stats == NULL) return 1;
+	}
+	if (ai != NULL && state->impacts_size >= 0) {
+		snprintf(file, sizeof file, "%s.csv", Out->asset_impacts_file);
+		ai->out = ENSSTATE_REOPEN(file, state->impacts_size);
+		if (ai->out == NULL) return 1;
+	}
+	cg_set(cgn_get(), state->seed1, state->seed2);  /* set_seed would go back to the initial seed */
+	return 0;
+}
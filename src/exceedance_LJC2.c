@@ -0,0 +1,148 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: EXCEEDANCE
+Count, for each cell and each thickness threshold (THICKNESS_THRESHOLDS),
+the runs that left lava thicker than the threshold, and write the
+probabilities count / runs as one multi-band raster (EXCEEDANCE_MAP).
+
+EXCEEDANCE_INIT    allocate the counters
+EXCEEDANCE_UPDATE  add a finished run, visiting only its inundated cells
+EXCEEDANCE_WIDEN   make the counters 32 bit
+EXCEEDANCE_WRITE   write the Float32 probability raster, one band per
+                   threshold in increasing order
+
+Counters are 16 bit when the ensemble has at most 65535 runs,
+32 bit otherwise; runs that left the grid are retried and counted
+too, so 16 bit counters are widened before they would overflow.
+The thresholds are sorted, so a cell stops at the
+first threshold its lava does not exceed.
+*******************************/
+
+Exceedance *EXCEEDANCE_INIT(
+Outputs *Out,
+int runs,
+double *gridinfo)
+{
+	Exceedance *ex;
+	size_t bytes;
+
+	ex = (Exceedance *) GC_MALLOC(sizeof(Exceedance));
+	if (ex == NULL) {
+		fprintf(stderr, "[EXCEEDANCE_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	ex->cols = (int) gridinfo[2];
+	ex->rows = (int) gridinfo[4];
+	ex->num_thresholds = Out->num_thresholds;
+	ex->thresholds = Out->thresholds;
+	ex->wide = (runs > USHRT_MAX);
+	ex->runs = 0;
+	bytes = (size_t) ex->cols * (size_t) ex->rows * (size_t) ex->num_thresholds *
+	        (ex->wide ? sizeof(unsigned int) : sizeof(unsigned short));
+	ex->counts = GC_MALLOC_ATOMIC(bytes);
+	if (ex->counts == NULL) {
+		fprintf(stderr, "[EXCEEDANCE_INIT] Out of Memory for %d thresholds on %d x %d cells!\n",
+		        ex->num_thresholds, ex->cols, ex->rows);
+		return NULL;
+	}
+	memset(ex->counts, 0, bytes);
+	return ex;
+}
+
+int EXCEEDANCE_WIDEN(
+Exceedance *ex)
+{
+	size_t n = (size_t) ex->cols * (size_t) ex->rows * (size_t) ex->num_thresholds, k;
+	unsigned int *counts;
+
+	counts = (unsigned int *) GC_MALLOC_ATOMIC(n * sizeof(unsigned int));
+	if (counts == NULL) {
+		fprintf(stderr, "[EXCEEDANCE_WIDEN] Out of Memory for %d thresholds on %d x %d cells!\n",
+		        ex->num_thresholds, ex->cols, ex->rows);
+		return 1;
+	}
+	for (k = 0; k < n; k++) counts[k] = ((unsigned short *) ex->counts)[k];
+	ex->counts = counts;
+	ex->wide = 1;
+	return 0;
+}
+
+int EXCEEDANCE_UPDATE(
+Exceedance *ex,
+FlowFootprint *fp)
+{
+	size_t band = (size_t) ex->cols * (size_t) ex->rows, k;
+	unsigned int c;
+	int t;
+	double x;
+
+	/* a count is at most the runs added */
+	if (!ex->wide && ex->runs >= USHRT_MAX && EXCEEDANCE_WIDEN(ex)) return 1;
+	for (c = 0; c < fp->count; c++) {
+		x = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+		k = (size_t) fp->cells[c].row * ex->cols + fp->cells[c].col;
+		for (t = 0; t < ex->num_thresholds && x > ex->thresholds[t]; t++) {
+			if (ex->wide) ((unsigned int *) ex->counts)[t * band + k]++;
+			else ((unsigned short *) ex->counts)[t * band + k]++;
+		}
+	}
+	ex->runs++;
+	return 0;
+}
+
+int EXCEEDANCE_WRITE(
+Exceedance *ex,
+Outputs *Out,
+Inputs *In,
+double *gridinfo)
+{
+	size_t band = (size_t) ex->cols * (size_t) ex->rows, k, j = 0;
+	float *data;
+	double count;
+	int t, row, col;
+
+	if (!ex->runs) return 0;
+	data = (float *) GC_MALLOC_ATOMIC(band * ex->num_thresholds * sizeof(float));
+	if (data == NULL) {
+		fprintf(stderr, "[EXCEEDANCE_WRITE] Out of Memory creating raster data!\n");
+		return 1;
+	}
+	/* band sequential, top row first */
+	for (t = 0; t < ex->num_thresholds; t++) {
+		for (row = ex->rows - 1; row >= 0; row--) {
+			for (col = 0, k = t * band + (size_t) row * ex->cols; col < ex->cols; col++, k++) {
+				count = ex->wide ? ((unsigned int *) ex->counts)[k] : ((unsigned short *) ex->counts)[k];
+				data[j++] = (float) (count / ex->runs);
+			}
+		}
+	}
+	fprintf(stdout, "Exceedance probabilities over %d runs, thresholds (m):", ex->runs);
+	for (t = 0; t < ex->num_thresholds; t++) fprintf(stdout, " %g", ex->thresholds[t]);
+	fprintf(stdout, "\n");
+	return WRITE_RASTER(Out->exceedance_file, data, GDT_Float32, ex->num_thresholds, Out, In, gridinfo);
+}
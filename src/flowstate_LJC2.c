@@ -0,0 +1,435 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: FLOW_STATE
+Checkpoints of a flow while it erupts (FLOW_CHECKPOINT = prefix), one
+file per run, prefix<run>.mfc, rewritten every FLOW_CHECKPOINT_PULSES
+pulses and/or FLOW_CHECKPOINT_SECONDS seconds, and at the end of the
+run. A flow is resumed from its file with RESUME_FLOW = file; with
+RESUME_VOLUME the flow erupts that volume from the checkpoint instead
+of what it had left, so a finished flow can be extended.
+
+FLOWSTATE_SAVE     write the state of the flow between two pulses
+FLOWSTATE_LOAD     read a checkpoint
+FLOWSTATE_PARAMS   set the flow parameters of the resumed run
+                   (instead of SET_FLOW_PARAMS)
+FLOWSTATE_RESTORE  put the flow back on the grid (in FLOW_ERUPT)
+
+Between pulses DISTRIBUTE keeps the lava and the parent codes on the
+grid; the active list is rebuilt from the vent at each pulse, so the
+grid marks nothing active. The random number generators are saved
+too, as they are: the ranlib state (flow parameters of the next runs)
+and the rand_r() state of DISTRIBUTE, so a resumed flow goes on as the
+original did, and a checkpoint does not change the flow. With
+ARRIVAL_MAP or ARRIVAL_ENSEMBLE the arrival stamps of the cells are
+saved too, and a flow resumed with them on needs them.
+Files are written to prefix<run>.mfc.tmp and renamed, so a run killed
+while writing leaves the previous checkpoint.
+
+File layout, native byte order:
+	char   magic[8]        "MOLSTAT1"
+	int    cols, rows
+	double gridinfo[6]     (must match the DEM of the resumed run)
+	int    run
+	unsigned int pulses    (pulses erupted)
+	int    current_vent    (vent of the last pulse)
+	double volume, remaining volume, pulse volume, residual
+	int    num_vents
+	double easting, northing  (x num_vents)
+	unsigned int rand_state (of DISTRIBUTE)
+	int    run_seed1, run_seed2  (ranlib state at the start of the run)
+	int    seed1, seed2          (ranlib state at the checkpoint)
+	unsigned int cells     (cells with lava or a parent code)
+	int    arrivals        (1: the block holds the arrival stamps)
+	unsigned long long raw_size, packed_size
+	packed_size bytes      zlib compressed block of raw_size bytes:
+	                       cells varints: cell index (row*cols+col) minus previous index
+	                       cells doubles: lava thickness
+	                       cells bytes:   parent code
+	                       cells uint32:  arrival pulse, 0: not reached (if arrivals)
+*******************************/
+
+/* A cell of the flow: lava on it, or a parent code */
+static int in_flow(
+DataCell **grid,
+int r0, int r1, int c0, int c1)
+{
+	int row, col;
+
+	for (row = r0; row <= r1; row++)
+		for (col = c0; col <= c1; col++)
+			if (grid[row][col].eff_elev != grid[row][col].dem_elev || grid[row][col].parentcode) return 1;
+	return 0;
+}
+
+/* The box of the vents, grown until its border is free of the flow
+   (as SNAPSHOT's grow_box): the flow spreads from the vents cell by
+   cell, so nothing of it lies outside. box = rmin, rmax, cmin, cmax */
+static void flow_box(
+DataCell **grid,
+int rows,
+int cols,
+Lava_flow *flow,
+int *box)
+{
+	int i, grown;
+
+	box[0] = rows; box[1] = -1;
+	box[2] = cols; box[3] = -1;
+	for (i = 0; i < flow->num_vents; i++) {
+		if (flow->source[i].row < box[0]) box[0] = flow->source[i].row;
+		if (flow->source[i].row > box[1]) box[1] = flow->source[i].row;
+		if (flow->source[i].col < box[2]) box[2] = flow->source[i].col;
+		if (flow->source[i].col > box[3]) box[3] = flow->source[i].col;
+	}
+	do {
+		grown = 0;
+		if (box[0] > 0 && in_flow(grid, box[0], box[0], box[2], box[3])) {
+			box[0]--; grown = 1;
+		}
+		if (box[1] < rows - 1 && in_flow(grid, box[1], box[1], box[2], box[3])) {
+			box[1]++; grown = 1;
+		}
+		if (box[2] > 0 && in_flow(grid, box[0], box[1], box[2], box[2])) {
+			box[2]--; grown = 1;
+		}
+		if (box[3] < cols - 1 && in_flow(grid, box[0], box[1], box[3], box[3])) {
+			box[3]++; grown = 1;
+		}
+	} while (grown);
+}
+
+int FLOWSTATE_SAVE(
+char *prefix,
+DataCell **grid,
+double *gridinfo,
+Lava_flow *flow,
+int run,
+unsigned int pulses,
+int current_vent,
+unsigned int rand_state,
+Arrival *arr)
+{
+	FILE *out;
+	char file[1024], tmp[1040];
+	unsigned char *raw, *packed, *p;
+	uLongf packed_len;
+	unsigned long long raw_size, packed_size, k, prev = 0;
+	unsigned int cells = 0, stamp;
+	int arrivals = (arr != NULL);
+	int cols = (int) gridinfo[2], rows = (int) gridinfo[4];
+	int row, col, i, seed1, seed2, box[4];
+	double thickness;
+
+	/* only the box of the flow is scanned, not the whole grid */
+	flow_box(grid, rows, cols, flow, box);
+	for (row = box[0]; row <= box[1]; row++)
+		for (col = box[2]; col <= box[3]; col++)
+			if (in_flow(grid, row, row, col, col)) cells++;
+	raw = (unsigned char *) GC_MALLOC_ATOMIC((size_t) cells * (10 + sizeof(double) + 1 + sizeof(unsigned int)) + 1);
+	if (raw == NULL) {
+		fprintf(stderr, "[FLOWSTATE_SAVE] Out of Memory for %u cells of run %d!\n", cells, run);
+		return 1;
+	}
+	/* cell indices, then thicknesses, then parent codes, then arrivals */
+	p = raw;
+	for (row = box[0]; row <= box[1]; row++)
+		for (col = box[2]; col <= box[3]; col++)
+			if (in_flow(grid, row, row, col, col)) {
+				k = (unsigned long long) row * cols + col;
+				p += varint_put(p, k - prev);
+				prev = k;
+			}
+	for (row = box[0]; row <= box[1]; row++)
+		for (col = box[2]; col <= box[3]; col++)
+			if (in_flow(grid, row, row, col, col)) {
+				thickness = grid[row][col].eff_elev - grid[row][col].dem_elev;
+				memcpy(p, &thickness, sizeof(double));
+				p += sizeof(double);
+			}
+	for (row = box[0]; row <= box[1]; row++)
+		for (col = box[2]; col <= box[3]; col++)
+			if (in_flow(grid, row, row, col, col))
+				*p++ = grid[row][col].parentcode;
+	if (arrivals)
+		for (row = box[0]; row <= box[1]; row++)
+			for (col = box[2]; col <= box[3]; col++)
+				if (in_flow(grid, row, row, col, col)) {
+					stamp = ARRIVAL_STAMP(arr, row, col);
+					memcpy(p, &stamp, sizeof(unsigned int));
+					p += sizeof(unsigned int);
+				}
+	raw_size = (unsigned long long) (p - raw);
+	packed_len = compressBound(raw_size);
+	packed = (unsigned char *) GC_MALLOC_ATOMIC(packed_len);
+	if (packed == NULL) {
+		fprintf(stderr, "[FLOWSTATE_SAVE] Out of Memory for %u cells of run %d!\n", cells, run);
+		return 1;
+	}
+	if (compress2(packed, &packed_len, raw, raw_size, 6) != Z_OK) {
+		fprintf(stderr, "[FLOWSTATE_SAVE] zlib could not compress run %d!\n", run);
+		return 1;
+	}
+	packed_size = packed_len;
+
+	get_state(&seed1, &seed2);
+
+	snprintf(file, sizeof file, "%s%d.mfc", prefix, run);
+	snprintf(tmp, sizeof tmp, "%s.tmp", file);
+	out = fopen(tmp, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "[FLOWSTATE_SAVE] Cannot open [%s]:[%s]!\n", tmp, strerror(errno));
+		return 1;
+	}
+	fwrite(FLOWSTATE_MAGIC, 1, 8, out);
+	fwrite(&cols, sizeof(int), 1, out);
+	fwrite(&rows, sizeof(int), 1, out);
+	fwrite(gridinfo, sizeof(double), 6, out);
+	fwrite(&run, sizeof(int), 1, out);
+	fwrite(&pulses, sizeof(unsigned int), 1, out);
+	fwrite(&current_vent, sizeof(int), 1, out);
+	fwrite(&flow->volumeToErupt, sizeof(double), 1, out);
+	fwrite(&flow->currentvolume, sizeof(double), 1, out);
+	fwrite(&flow->pulsevolume, sizeof(double), 1, out);
+	fwrite(&flow->residual, sizeof(double), 1, out);
+	fwrite(&flow->num_vents, sizeof(int), 1, out);
+	for (i = 0; i < flow->num_vents; i++) {
+		fwrite(&flow->source[i].easting, sizeof(double), 1, out);
+		fwrite(&flow->source[i].northing, sizeof(double), 1, out);
+	}
+	fwrite(&rand_state, sizeof(unsigned int), 1, out);
+	fwrite(&flow->stats.seed1, sizeof(int), 1, out);
+	fwrite(&flow->stats.seed2, sizeof(int), 1, out);
+	fwrite(&seed1, sizeof(int), 1, out);
+	fwrite(&seed2, sizeof(int), 1, out);
+	fwrite(&cells, sizeof(unsigned int), 1, out);
+	fwrite(&arrivals, sizeof(int), 1, out);
+	fwrite(&raw_size, sizeof(unsigned long long), 1, out);
+	fwrite(&packed_size, sizeof(unsigned long long), 1, out);
+	fwrite(packed, 1, packed_size, out);
+	i = ferror(out);
+	if (fclose(out) || i) {
+		fprintf(stderr, "[FLOWSTATE_SAVE] Cannot write [%s]:[%s]!\n", tmp, strerror(errno));
+		remove(tmp);
+		return 1;
+	}
+	if (rename(tmp, file)) {
+		fprintf(stderr, "[FLOWSTATE_SAVE] Cannot rename [%s] to [%s]:[%s]!\n", tmp, file, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+FlowState *FLOWSTATE_LOAD(
+char *file,
+double *gridinfo,
+double remaining)
+{
+	FILE *in;
+	FlowState *state;
+	char magic[8];
+	int cols, rows, i, arrivals;
+	double info[6];
+	unsigned char *raw, *packed, *p, *end;
+	unsigned long long raw_size, packed_size, delta, k = 0;
+	uLongf raw_len;
+	unsigned int c;
+	size_t n;
+
+	in = fopen(file, "rb");
+	if (in == NULL) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] Cannot open flow checkpoint=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	state = (FlowState *) GC_MALLOC(sizeof(FlowState));
+	if (state == NULL) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] Out of Memory!\n");
+		fclose(in);
+		return NULL;
+	}
+	n = fread(magic, 1, 8, in);
+	n += fread(&cols, sizeof(int), 1, in);
+	n += fread(&rows, sizeof(int), 1, in);
+	n += fread(info, sizeof(double), 6, in);
+	if (n != 16 || memcmp(magic, FLOWSTATE_MAGIC, 8)) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] [%s] is not a flow checkpoint!\n", file);
+		fclose(in);
+		return NULL;
+	}
+	if (cols != (int) gridinfo[2] || rows != (int) gridinfo[4] || memcmp(info, gridinfo, sizeof info)) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] [%s] is of another DEM (%d x %d cells)!\n", file, cols, rows);
+		fclose(in);
+		return NULL;
+	}
+	n = fread(&state->run, sizeof(int), 1, in);
+	n += fread(&state->pulses, sizeof(unsigned int), 1, in);
+	n += fread(&state->current_vent, sizeof(int), 1, in);
+	n += fread(&state->volume, sizeof(double), 1, in);
+	n += fread(&state->remaining, sizeof(double), 1, in);
+	n += fread(&state->pulsevolume, sizeof(double), 1, in);
+	n += fread(&state->residual, sizeof(double), 1, in);
+	n += fread(&state->num_vents, sizeof(int), 1, in);
+	if (n != 8 || state->num_vents < 1) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] [%s] is truncated!\n", file);
+		fclose(in);
+		return NULL;
+	}
+	state->vents = (Vent *) GC_MALLOC_ATOMIC(state->num_vents * sizeof(Vent));
+	if (state->vents == NULL) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] Out of Memory!\n");
+		fclose(in);
+		return NULL;
+	}
+	for (i = 0, n = 0; i < state->num_vents; i++) {
+		n += fread(&state->vents[i].easting, sizeof(double), 1, in);
+		n += fread(&state->vents[i].northing, sizeof(double), 1, in);
+	}
+	n += fread(&state->rand_seed, sizeof(unsigned int), 1, in);
+	n += fread(&state->run_seed1, sizeof(int), 1, in);
+	n += fread(&state->run_seed2, sizeof(int), 1, in);
+	n += fread(&state->seed1, sizeof(int), 1, in);
+	n += fread(&state->seed2, sizeof(int), 1, in);
+	n += fread(&state->count, sizeof(unsigned int), 1, in);
+	n += fread(&arrivals, sizeof(int), 1, in);
+	n += fread(&raw_size, sizeof(unsigned long long), 1, in);
+	n += fread(&packed_size, sizeof(unsigned long long), 1, in);
+	if (n != (size_t) (2 * state->num_vents + 9)) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] [%s] is truncated!\n", file);
+		fclose(in);
+		return NULL;
+	}
+	raw = (unsigned char *) GC_MALLOC_ATOMIC(raw_size + 1);
+	packed = (unsigned char *) GC_MALLOC_ATOMIC(packed_size + 1);
+	state->cell = (unsigned long long *) GC_MALLOC_ATOMIC((state->count + 1) * sizeof(unsigned long long));
+	state->thickness = (double *) GC_MALLOC_ATOMIC((state->count + 1) * sizeof(double));
+	state->parentcode = (unsigned char *) GC_MALLOC_ATOMIC(state->count + 1);
+	state->arrival = NULL;
+	if (arrivals) state->arrival = (unsigned int *) GC_MALLOC_ATOMIC((state->count + 1) * sizeof(unsigned int));
+	if (raw == NULL || packed == NULL || state->cell == NULL || state->thickness == NULL ||
+	    state->parentcode == NULL || (arrivals && state->arrival == NULL)) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] Out of Memory for %u cells!\n", state->count);
+		fclose(in);
+		return NULL;
+	}
+	n = fread(packed, 1, packed_size, in);
+	fclose(in);
+	raw_len = raw_size;
+	if (n != packed_size || uncompress(raw, &raw_len, packed, packed_size) != Z_OK || raw_len != raw_size) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] The cells of [%s] are corrupt!\n", file);
+		return NULL;
+	}
+	p = raw;
+	end = raw + raw_size;
+	for (c = 0; c < state->count; c++) {
+		n = varint_get(p, end, &delta);
+		k += delta;
+		if (!n || k >= (unsigned long long) cols * rows) {
+			fprintf(stderr, "[FLOWSTATE_LOAD] The cells of [%s] are corrupt!\n", file);
+			return NULL;
+		}
+		state->cell[c] = k;
+		p += n;
+	}
+	if ((size_t) (end - p) != state->count * (sizeof(double) + 1 + ((arrivals) ? sizeof(unsigned int) : 0))) {
+		fprintf(stderr, "[FLOWSTATE_LOAD] The cells of [%s] are corrupt!\n", file);
+		return NULL;
+	}
+	memcpy(state->thickness, p, state->count * sizeof(double));
+	p += state->count * sizeof(double);
+	memcpy(state->parentcode, p, state->count);
+	p += state->count;
+	if (arrivals) memcpy(state->arrival, p, state->count * sizeof(unsigned int));
+
+	fprintf(stdout, "Resuming run %d from %s: %u pulses, %u cells, %.3f of %.3f m^3 erupted\n",
+	        state->run, file, state->pulses, state->count, state->volume - state->remaining, state->volume);
+	if (remaining >= 0) {        /* RESUME_VOLUME */
+		state->volume += remaining - state->remaining;
+		state->remaining = remaining;
+		fprintf(stdout, "  erupting %.3f m^3 more\n", remaining);
+	}
+	return state;
+}
+
+int FLOWSTATE_PARAMS(
+FlowState *state,
+Lava_flow *flow,
+double *gridinfo,
+DataCell **grid)
+{
+	int i, j;
+
+	flow->source = (Vent *) GC_MALLOC_ATOMIC(state->num_vents * sizeof(Vent));
+	if (flow->source == NULL) {
+		fprintf(stderr, "[FLOWSTATE_PARAMS] Out of Memory!\n");
+		return 1;
+	}
+	memcpy(flow->source, state->vents, state->num_vents * sizeof(Vent));
+	flow->num_vents = state->num_vents;
+	flow->residual = state->residual;
+	flow->volumeToErupt = state->volume;
+	flow->currentvolume = state->remaining;
+	flow->pulsevolume = state->pulsevolume;
+	flow->stats.seed1 = state->run_seed1;
+	flow->stats.seed2 = state->run_seed2;
+	cg_set(cgn_get(), state->seed1, state->seed2);  /* set_seed would go back to the initial seed */
+	fprintf(stdout, "Flow residual: %0.2f (meters)\n", flow->residual);
+	fprintf(stdout, "Total lava volume: %0.2g (cubic meters)\n", flow->volumeToErupt);
+	fprintf(stdout, "Flow pulse volume: %0.2g (cubic meters)\n", flow->pulsevolume);
+	for (i = 0; i < gridinfo[4]; i++)
+		for (j = 0; j < gridinfo[2]; j++)
+			grid[i][j].residual = flow->residual;
+	return 0;
+}
+
+int FLOWSTATE_RESTORE(
+FlowState *state,
+DataCell **grid,
+double *gridinfo,
+unsigned int *pulses,
+int *current_vent,
+unsigned int *rand_state,
+Arrival *arr)
+{
+	unsigned int c;
+	int row, col;
+
+	if (arr != NULL && state->arrival == NULL) {
+		fprintf(stderr, "[FLOWSTATE_RESTORE] The checkpoint of run %d was saved without ARRIVAL_MAP or ARRIVAL_ENSEMBLE, it has no arrival stamps!\n", state->run);
+		return 1;
+	}
+	for (c = 0; c < state->count; c++) {
+		row = (int) (state->cell[c] / (unsigned long long) gridinfo[2]);
+		col = (int) (state->cell[c] % (unsigned long long) gridinfo[2]);
+		grid[row][col].eff_elev = grid[row][col].dem_elev + state->thickness[c];
+		grid[row][col].parentcode = state->parentcode[c];
+		if (arr != NULL && ARRIVAL_SET(arr, row, col, state->arrival[c])) return 1;
+	}
+	*pulses = state->pulses;
+	*current_vent = state->current_vent;
+	*rand_state = state->rand_seed;
+	return 0;
+}
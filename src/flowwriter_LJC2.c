@@ -0,0 +1,230 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+/*****************************
+MODULE: FLOW_WRITER
+Write the inundated cells of a run (its footprint) as a flow map:
+
+WRITE_ASCII_FLOW   ASCII_FLOW_MAP,  text, one line per cell:
+                   easting northing thickness new_elev orig_elev
+WRITE_BINARY_FLOW  BINARY_FLOW_MAP, the same five columns as
+                   native-endian doubles, no header
+
+Only the inundated cells are visited. Lines are formatted with
+format_fixed into a large buffer that is written with a few write()
+calls, instead of five printf conversions per cell. The ASCII file is
+byte for byte the file fprintf("%0.3f ... %f") writes.
+*******************************/
+
+#define FLOW_WRITER_BUFSIZE (1 << 20)
+#define FLOW_WRITER_LINE    256    /* room left for the longest line */
+
+static const double pow10_table[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+/* Format value like printf("%.*f", decimals, value) (decimals 0 to 9),
+   without the locale and varargs machinery.
+   The value is scaled and rounded in double precision; when the scaled
+   value is too large to be exact or too close to a rounding tie,
+   snprintf does it instead, so the result is always the same.
+   RETURN: number of characters written (no terminating null) */
+size_t format_fixed(
+char *buf,
+double value,
+int decimals)
+{
+	char digits[24];
+	double a, scaled, whole, frac;
+	unsigned long long u;
+	size_t n = 0, len = 0;
+	int i;
+
+	a = fabs(value);
+	if (decimals < 0 || decimals > 9 || !(a < 1e9)) /* also NaN, Inf */
+		return (size_t) snprintf(buf, 64, "%.*f", decimals, value);
+
+	scaled = a * pow10_table[decimals];
+	whole = floor(scaled);
+	frac = scaled - whole;
+	/* a * 10^d is within an ulp of the exact product: only near .5
+	   can that change the rounding */
+	if (fabs(frac - 0.5) <= scaled * 1e-15 + 1e-12)
+		return (size_t) snprintf(buf, 64, "%.*f", decimals, value);
+	u = (unsigned long long) whole + (frac > 0.5);
+
+	if (signbit(value)) buf[n++] = '-'; /* printf keeps the sign of -0.0 */
+	/* digits of the fraction, then of the integer part, backwards */
+	for (i = 0; i < decimals; i++) {
+		digits[len++] = (char) ('0' + u % 10);
+		u /= 10;
+	}
+	if (decimals) digits[len++] = '.';
+	do {
+		digits[len++] = (char) ('0' + u % 10);
+		u /= 10;
+	} while (u);
+	while (len) buf[n++] = digits[--len];
+	return n;
+}
+
+/* write() all of buf, RETURN 0 or 1 on error */
+static int write_all(
+int fd,
+const char *buf,
+size_t size)
+{
+	ssize_t done;
+
+	while (size) {
+		done = write(fd, buf, size);
+		if (done < 0) {
+			if (errno == EINTR) continue;
+			return 1;
+		}
+		buf += done;
+		size -= (size_t) done;
+	}
+	return 0;
+}
+
+/* Open the output file for a run: file name + run number */
+static int open_flow_file(
+char *name,
+int run,
+char *file,
+size_t file_size)
+{
+	snprintf(file, file_size, "%s%d", name, run);
+	return open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+}
+
+int WRITE_ASCII_FLOW(
+FlowFootprint *fp,
+char *name,
+double *geotransform)
+{
+	char file[FILENAME_MAX];
+	char *buf;
+	size_t n = 0;
+	unsigned int c;
+	int fd, i, ret;
+	double easting, northing;
+
+	buf = (char *) GC_MALLOC_ATOMIC(FLOW_WRITER_BUFSIZE);
+	if (buf == NULL) {
+		fprintf(stderr, "[WRITE_ASCII_FLOW] Out of Memory writing run %d!\n", fp->run);
+		return 1;
+	}
+	fd = open_flow_file(name, fp->run, file, sizeof file);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open ASCII FLOW file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+
+	/* File header */
+	n += snprintf(buf + n, FLOW_WRITER_LINE, "# VOLUME PULSE RESIDUAL VENTS\n");
+	n += snprintf(buf + n, FLOW_WRITER_LINE, "# %0.4f\t%0.4f\t%0.1f ",
+	              fp->volume, fp->pulsevolume, fp->residual);
+	for (i = 0; i < fp->num_vents; i++) {
+		if (n > FLOW_WRITER_BUFSIZE - FLOW_WRITER_LINE) {
+			if (write_all(fd, buf, n)) break;
+			n = 0;
+		}
+		n += snprintf(buf + n, FLOW_WRITER_LINE, " %0.3f\t%.03f\t",
+		              fp->vents[i].easting, fp->vents[i].northing);
+	}
+	n += snprintf(buf + n, FLOW_WRITER_LINE, "\n# EAST NORTH THICKNESS NEW_ELEV ORIG_ELEV");
+
+	/* One line per inundated cell */
+	for (c = 0; c < fp->count; c++) {
+		if (n > FLOW_WRITER_BUFSIZE - FLOW_WRITER_LINE) {
+			if (write_all(fd, buf, n)) break;
+			n = 0;
+		}
+		easting = geotransform[0] + (geotransform[1] * fp->cells[c].col);
+		northing = geotransform[3] + (geotransform[5] * fp->cells[c].row);
+		buf[n++] = '\n';
+		n += format_fixed(buf + n, easting, 3);
+		buf[n++] = '\t';
+		n += format_fixed(buf + n, northing, 3);
+		buf[n++] = '\t';
+		n += format_fixed(buf + n, fp->cells[c].eff_elev - fp->cells[c].dem_elev, 6);
+		buf[n++] = '\t';
+		n += format_fixed(buf + n, fp->cells[c].eff_elev, 6);
+		buf[n++] = '\t';
+		n += format_fixed(buf + n, fp->cells[c].dem_elev, 6);
+	}
+
+	ret = (c < fp->count || i < fp->num_vents || write_all(fd, buf, n));
+	if (close(fd) || ret) {
+		fprintf(stderr, "Cannot write ASCII FLOW file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	fprintf(stderr, " ASCII Output file: %s successfully written.\n \n", file);
+	return 0;
+}
+
+int WRITE_BINARY_FLOW(
+FlowFootprint *fp,
+char *name,
+double *geotransform)
+{
+	char file[FILENAME_MAX];
+	double *buf;
+	size_t n = 0, rows = FLOW_WRITER_BUFSIZE / (5 * sizeof(double));
+	unsigned int c;
+	int fd, ret;
+
+	buf = (double *) GC_MALLOC_ATOMIC(rows * 5 * sizeof(double));
+	if (buf == NULL) {
+		fprintf(stderr, "[WRITE_BINARY_FLOW] Out of Memory writing run %d!\n", fp->run);
+		return 1;
+	}
+	fd = open_flow_file(name, fp->run, file, sizeof file);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open BINARY FLOW file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	for (c = 0; c < fp->count; c++) {
+		if (n == rows * 5) {
+			if (write_all(fd, (char *) buf, n * sizeof(double))) break;
+			n = 0;
+		}
+		buf[n++] = geotransform[0] + (geotransform[1] * fp->cells[c].col);
+		buf[n++] = geotransform[3] + (geotransform[5] * fp->cells[c].row);
+		buf[n++] = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+		buf[n++] = fp->cells[c].eff_elev;
+		buf[n++] = fp->cells[c].dem_elev;
+	}
+	ret = (c < fp->count || write_all(fd, (char *) buf, n * sizeof(double)));
+	if (close(fd) || ret) {
+		fprintf(stderr, "Cannot write BINARY FLOW file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	fprintf(stderr, " Binary Output file: %s successfully written.\n \n", file);
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: FOOTPRINT_INDEX
+Store the set of inundated cells of every run as a compressed bitmap
+(FOOTPRINT_INDEX = file), for cross-run queries with molasses-query.
+All values are written in native byte order.
+
+A cell is numbered row * cols + col. As in roaring bitmaps, the high
+16 bits of the number pick a container and the low 16 bits are stored
+in it: as a sorted array of unsigned shorts when the container holds
+4096 cells or less, as a 65536 bit bitmap otherwise.
+
+File layout:
+	HEADER
+	char   magic[8]        "MOLFIDX1"
+	int    cols, rows
+	double gridinfo[6]     (this code's metadata format, see DEM_LOADER)
+
+	RUN RECORD (one per run)
+	char   tag[4]          "FRUN"
+	int    run
+	double volume, pulse volume, residual
+	int    num_vents
+	double easting, northing  (x num_vents)
+	unsigned int cells, containers
+	CONTAINER (x containers, increasing key)
+		unsigned int key, cardinality
+		cardinality <= 4096: unsigned short low bits (x cardinality), increasing
+		cardinality >  4096: unsigned long long words[1024], bit i of word w is cell w*64+i
+
+	INDEX (written when the index is closed)
+	char   tag[4]          "FIDX"
+	unsigned int count
+	int run, long long offset of its record  (x count)
+
+	FOOTER
+	long long offset of INDEX
+	char   magic[8]        "MOLFIEND"
+
+The writer uses the FlowArchive structure and locking of the flow
+archive, so runs can be added from the output threads.
+*******************************/
+
+FlowArchive *FOOTINDEX_OPEN(
+char *file,
+double *gridinfo)
+{
+	FlowArchive *index;
+	int cols = (int) gridinfo[2];
+	int rows = (int) gridinfo[4];
+
+	if ((double) cols * (double) rows > (double) UINT_MAX) {
+		fprintf(stderr, "[FOOTINDEX_OPEN] Grid of %d x %d cells is too large to index!\n", cols, rows);
+		return NULL;
+	}
+	index = (FlowArchive *) GC_MALLOC(sizeof(FlowArchive));
+	if (index == NULL) {
+		fprintf(stderr, "[FOOTINDEX_OPEN] Out of Memory creating footprint index!\n");
+		return NULL;
+	}
+	index->size = 1024;
+	index->count = 0;
+	index->runs = (int *) GC_MALLOC_ATOMIC(index->size * sizeof(int));
+	index->offsets = (long long *) GC_MALLOC_ATOMIC(index->size * sizeof(long long));
+	if (index->runs == NULL || index->offsets == NULL) {
+		fprintf(stderr, "[FOOTINDEX_OPEN] Out of Memory creating footprint index!\n");
+		return NULL;
+	}
+	index->fp = fopen(file, "wb");
+	if (index->fp == NULL) {
+		fprintf(stderr, "Cannot open FOOTPRINT INDEX file=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	index->cols = cols;
+	index->rows = rows;
+	pthread_mutex_init(&index->lock, NULL);
+	fwrite(FOOTINDEX_MAGIC, 1, 8, index->fp);
+	fwrite(&cols, sizeof(int), 1, index->fp);
+	fwrite(&rows, sizeof(int), 1, index->fp);
+	fwrite(gridinfo, sizeof(double), 6, index->fp);
+	if (ferror(index->fp)) {
+		fprintf(stderr, "[FOOTINDEX_OPEN] Cannot write header of [%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	fprintf(stdout, "Writing footprint index: %s\n", file);
+	return index;
+}
+
+/* Add the cells of one run. The containers are built by the calling
+   thread; only the file write is serialized. */
+int FOOTINDEX_WRITE_RUN(
+FlowArchive *index,
+FlowFootprint *fp)
+{
+	unsigned int cells = fp->count, c, first, key, card, containers = 0, low;
+	unsigned long long *words;
+	unsigned char *buf;
+	unsigned short array_low;
+	size_t n = 0, size;
+	int i, *grown_runs;
+	long long *grown_offsets;
+
+	/* Worst case: an 8 byte container header per cell, plus 2 bytes
+	   per cell (arrays) or 8192 bytes per more than 4096 cells (bitmaps) */
+	size = 12 * (size_t) cells + 16;
+	buf = (unsigned char *) GC_MALLOC_ATOMIC(size);
+	words = (unsigned long long *) GC_MALLOC_ATOMIC(1024 * sizeof(unsigned long long));
+	if (buf == NULL || words == NULL) {
+		fprintf(stderr, "[FOOTINDEX_WRITE_RUN] Out of Memory indexing run %d!\n", fp->run);
+		return 1;
+	}
+
+	/* Footprint cells are in increasing cell number: group them by key */
+	for (c = 0; c < cells; c = first + card) {
+		first = c;
+		key = (unsigned int) (((unsigned long long) fp->cells[c].row * index->cols + fp->cells[c].col) >> 16);
+		for (card = 0; first + card < cells &&
+		     (unsigned int) (((unsigned long long) fp->cells[first + card].row * index->cols +
+		                      fp->cells[first + card].col) >> 16) == key; card++);
+		memcpy(buf + n, &key, sizeof(unsigned int)); n += sizeof(unsigned int);
+		memcpy(buf + n, &card, sizeof(unsigned int)); n += sizeof(unsigned int);
+		if (card > FOOTINDEX_ARRAY_MAX) memset(words, 0, 1024 * sizeof(unsigned long long));
+		for (i = 0; i < (int) card; i++) {
+			low = (unsigned int) (((unsigned long long) fp->cells[first + i].row * index->cols +
+			                       fp->cells[first + i].col) & 0xffff);
+			if (card > FOOTINDEX_ARRAY_MAX) words[low >> 6] |= 1ULL << (low & 63);
+			else {
+				array_low = (unsigned short) low;
+				memcpy(buf + n, &array_low, sizeof(unsigned short));
+				n += sizeof(unsigned short);
+			}
+		}
+		if (card > FOOTINDEX_ARRAY_MAX) {
+			memcpy(buf + n, words, 1024 * sizeof(unsigned long long));
+			n += 1024 * sizeof(unsigned long long);
+		}
+		containers++;
+	}
+
+	pthread_mutex_lock(&index->lock);
+	if (index->count == index->size) {
+		index->size *= 2;
+		grown_runs = (int *) GC_REALLOC(index->runs, index->size * sizeof(int));
+		grown_offsets = (long long *) GC_REALLOC(index->offsets, index->size * sizeof(long long));
+		if (grown_runs == NULL || grown_offsets == NULL) {
+			fprintf(stderr, "[FOOTINDEX_WRITE_RUN] Out of Memory growing footprint index!\n");
+			pthread_mutex_unlock(&index->lock);
+			return 1;
+		}
+		index->runs = grown_runs;
+		index->offsets = grown_offsets;
+	}
+	index->runs[index->count] = fp->run;
+	index->offsets[index->count++] = (long long) ftello(index->fp);
+
+	fwrite("FRUN", 1, 4, index->fp);
+	fwrite(&fp->run, sizeof(int), 1, index->fp);
+	fwrite(&fp->volume, sizeof(double), 1, index->fp);
+	fwrite(&fp->pulsevolume, sizeof(double), 1, index->fp);
+	fwrite(&fp->residual, sizeof(double), 1, index->fp);
+	fwrite(&fp->num_vents, sizeof(int), 1, index->fp);
+	for (i = 0; i < fp->num_vents; i++) {
+		fwrite(&fp->vents[i].easting, sizeof(double), 1, index->fp);
+		fwrite(&fp->vents[i].northing, sizeof(double), 1, index->fp);
+	}
+	fwrite(&cells, sizeof(unsigned int), 1, index->fp);
+	fwrite(&containers, sizeof(unsigned int), 1, index->fp);
+	fwrite(buf, 1, n, index->fp);
+	if (ferror(index->fp)) {
+		fprintf(stderr, "[FOOTINDEX_WRITE_RUN] Cannot write run %d:[%s]!\n", fp->run, strerror(errno));
+		pthread_mutex_unlock(&index->lock);
+		return 1;
+	}
+	pthread_mutex_unlock(&index->lock);
+	return 0;
+}
+
+/* Write the run table and footer, then close the index */
+int FOOTINDEX_CLOSE(
+FlowArchive *index)
+{
+	long long table_offset;
+	int i;
+
+	table_offset = (long long) ftello(index->fp);
+	fwrite("FIDX", 1, 4, index->fp);
+	fwrite(&index->count, sizeof(unsigned int), 1, index->fp);
+	for (i = 0; i < (int) index->count; i++) {
+		fwrite(index->runs + i, sizeof(int), 1, index->fp);
+		fwrite(index->offsets + i, sizeof(long long), 1, index->fp);
+	}
+	fwrite(&table_offset, sizeof(long long), 1, index->fp);
+	fwrite(FOOTINDEX_END_MAGIC, 1, 8, index->fp);
+	if (ferror(index->fp) || fclose(index->fp)) {
+		fprintf(stderr, "[FOOTINDEX_CLOSE] Cannot write footprint index table:[%s]!\n", strerror(errno));
+		return 1;
+	}
+	fprintf(stderr, "Footprint index closed: %u runs.\n", index->count);
+	return 0;
+}
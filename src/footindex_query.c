@@ -0,0 +1,496 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*
+MOLASSES-QUERY:
+Answers cross-run questions from a footprint index written with
+FOOTPRINT_INDEX (see footindex_LJC2.c).
+
+Usage:
+	molasses-query index list
+		runs with their parameters and inundated cell counts
+	molasses-query index cell easting northing
+		runs that inundated the cell
+	molasses-query index box xmin ymin xmax ymax
+	molasses-query index polygon file
+		runs that inundated any cell of the area (cell centre inside),
+		with the number of cells; the polygon file has one
+		"easting northing" vertex per line
+	molasses-query index union [min_volume [file]]
+		cells inundated by any run with volume > min_volume;
+		the cells are written to file as "easting northing runs"
+	molasses-query index count [min_volume]
+		runs with volume > min_volume, their mean cell count and the
+		cells of their union and intersection
+
+Areas and unions are dense bitmaps of the grid; counting uses
+__builtin_popcountll over 1024 word containers, which the compiler
+turns into vector popcounts with -march=native on CPUs that have them.
+Query times, without loading the index, are printed on stderr.
+*/
+
+typedef struct Container {
+	unsigned int key;
+	unsigned int card;
+	unsigned short *array;    /* card <= FOOTINDEX_ARRAY_MAX */
+	unsigned long long *bits; /* otherwise, 1024 words */
+} Container;
+
+typedef struct RunSet {
+	int run;
+	double volume, pulse, residual;
+	unsigned int cells;
+	unsigned int num_containers;
+	Container *containers;
+} RunSet;
+
+static int cols, rows;
+static double gridinfo[6];
+static unsigned int num_keys;   /* containers covering the grid */
+
+static double ms_since(
+struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return 1e3 * (double) (now.tv_sec - start->tv_sec) + 1e-6 * (double) (now.tv_nsec - start->tv_nsec);
+}
+
+/* Read the run record at the current file position. RETURN 0 or 1 on error */
+static int read_run(
+FILE *in,
+RunSet *rs)
+{
+	char tag[4];
+	int num_vents;
+	unsigned int c;
+	Container *k;
+
+	if (fread(tag, 1, 4, in) != 4 || memcmp(tag, "FRUN", 4) ||
+	    fread(&rs->run, sizeof(int), 1, in) != 1 ||
+	    fread(&rs->volume, sizeof(double), 1, in) != 1 ||
+	    fread(&rs->pulse, sizeof(double), 1, in) != 1 ||
+	    fread(&rs->residual, sizeof(double), 1, in) != 1 ||
+	    fread(&num_vents, sizeof(int), 1, in) != 1 ||
+	    fseeko(in, 2 * sizeof(double) * num_vents, SEEK_CUR) ||
+	    fread(&rs->cells, sizeof(unsigned int), 1, in) != 1 ||
+	    fread(&rs->num_containers, sizeof(unsigned int), 1, in) != 1) return 1;
+	rs->containers = (Container *) calloc(rs->num_containers + 1, sizeof(Container));
+	if (rs->containers == NULL) return 1;
+	for (c = 0; c < rs->num_containers; c++) {
+		k = rs->containers + c;
+		if (fread(&k->key, sizeof(unsigned int), 1, in) != 1 ||
+		    fread(&k->card, sizeof(unsigned int), 1, in) != 1 || k->key >= num_keys) return 1;
+		if (k->card > FOOTINDEX_ARRAY_MAX) {
+			k->bits = (unsigned long long *) malloc(1024 * sizeof(unsigned long long));
+			if (k->bits == NULL || fread(k->bits, sizeof(unsigned long long), 1024, in) != 1024) return 1;
+		}
+		else {
+			k->array = (unsigned short *) malloc((k->card + 1) * sizeof(unsigned short));
+			if (k->array == NULL || fread(k->array, sizeof(unsigned short), k->card, in) != k->card) return 1;
+		}
+	}
+	return 0;
+}
+
+/* Load all runs, from the run table or by scanning the records.
+   RETURN number of runs, -1 on error */
+static int load_index(
+FILE *in,
+RunSet **runs)
+{
+	char magic[8], tag[4];
+	long long table_offset, *offsets = NULL;
+	unsigned int count = 0, i, size;
+	int run;
+
+	if (!fseeko(in, -16, SEEK_END) &&
+	    fread(&table_offset, sizeof(long long), 1, in) == 1 &&
+	    fread(magic, 1, 8, in) == 8 && !memcmp(magic, FOOTINDEX_END_MAGIC, 8) &&
+	    !fseeko(in, table_offset, SEEK_SET) &&
+	    fread(tag, 1, 4, in) == 4 && !memcmp(tag, "FIDX", 4) &&
+	    fread(&count, sizeof(unsigned int), 1, in) == 1) {
+		offsets = (long long *) malloc((count + 1) * sizeof(long long));
+		*runs = (RunSet *) calloc(count + 1, sizeof(RunSet));
+		if (offsets == NULL || *runs == NULL) return -1;
+		for (i = 0; i < count; i++) {
+			if (fread(&run, sizeof(int), 1, in) != 1 ||
+			    fread(offsets + i, sizeof(long long), 1, in) != 1) return -1;
+		}
+		for (i = 0; i < count; i++) {
+			if (fseeko(in, offsets[i], SEEK_SET) || read_run(in, *runs + i)) {
+				fprintf(stderr, "[molasses-query] Corrupt run record at offset %lld\n", offsets[i]);
+				return -1;
+			}
+		}
+		free(offsets);
+		return (int) count;
+	}
+
+	fprintf(stderr, "No run table found (index not closed?), scanning records.\n");
+	size = 1024;
+	*runs = (RunSet *) calloc(size, sizeof(RunSet));
+	if (*runs == NULL) return -1;
+	if (fseeko(in, 8 + 2 * sizeof(int) + 6 * sizeof(double), SEEK_SET)) return -1;
+	while (!read_run(in, *runs + count)) {
+		if (++count == size) {
+			size *= 2;
+			*runs = (RunSet *) realloc(*runs, size * sizeof(RunSet));
+			if (*runs == NULL) return -1;
+		}
+	}
+	return (int) count;
+}
+
+/* Is cell number [cell] in the run? */
+static int run_has_cell(
+RunSet *rs,
+unsigned int cell)
+{
+	unsigned int key = cell >> 16, low = cell & 0xffff, lo = 0, hi = rs->num_containers, mid;
+	Container *k;
+
+	while (lo < hi) { /* containers are in increasing key order */
+		mid = (lo + hi) / 2;
+		if (rs->containers[mid].key < key) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo == rs->num_containers || rs->containers[lo].key != key) return 0;
+	k = rs->containers + lo;
+	if (k->bits != NULL) return (int) ((k->bits[low >> 6] >> (low & 63)) & 1);
+	lo = 0;
+	hi = k->card;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (k->array[mid] < low) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < k->card && k->array[lo] == low;
+}
+
+/* Number of cells of the run that are set in the dense bitmap */
+static unsigned long long run_and_count(
+RunSet *rs,
+unsigned long long *dense)
+{
+	unsigned long long count = 0, *area;
+	unsigned int c, i;
+	Container *k;
+
+	for (c = 0; c < rs->num_containers; c++) {
+		k = rs->containers + c;
+		area = dense + (size_t) k->key * 1024;
+		if (k->bits != NULL) {
+			for (i = 0; i < 1024; i++) count += __builtin_popcountll(k->bits[i] & area[i]);
+		}
+		else {
+			for (i = 0; i < k->card; i++) count += (area[k->array[i] >> 6] >> (k->array[i] & 63)) & 1;
+		}
+	}
+	return count;
+}
+
+/* dense |= run */
+static void run_or(
+RunSet *rs,
+unsigned long long *dense)
+{
+	unsigned long long *area;
+	unsigned int c, i;
+	Container *k;
+
+	for (c = 0; c < rs->num_containers; c++) {
+		k = rs->containers + c;
+		area = dense + (size_t) k->key * 1024;
+		if (k->bits != NULL) for (i = 0; i < 1024; i++) area[i] |= k->bits[i];
+		else for (i = 0; i < k->card; i++) area[k->array[i] >> 6] |= 1ULL << (k->array[i] & 63);
+	}
+}
+
+/* dense &= run */
+static void run_and(
+RunSet *rs,
+unsigned long long *dense,
+unsigned long long *scratch)
+{
+	unsigned int c = 0, key, i;
+	Container *k;
+
+	for (key = 0; key < num_keys; key++) {
+		if (c < rs->num_containers && rs->containers[c].key == key) {
+			k = rs->containers + c++;
+			if (k->bits != NULL) memcpy(scratch, k->bits, 1024 * sizeof(unsigned long long));
+			else {
+				memset(scratch, 0, 1024 * sizeof(unsigned long long));
+				for (i = 0; i < k->card; i++) scratch[k->array[i] >> 6] |= 1ULL << (k->array[i] & 63);
+			}
+			for (i = 0; i < 1024; i++) dense[(size_t) key * 1024 + i] &= scratch[i];
+		}
+		else memset(dense + (size_t) key * 1024, 0, 1024 * sizeof(unsigned long long));
+	}
+}
+
+static unsigned long long dense_count(
+unsigned long long *dense)
+{
+	unsigned long long count = 0;
+	size_t i, words = (size_t) num_keys * 1024;
+
+	for (i = 0; i < words; i++) count += __builtin_popcountll(dense[i]);
+	return count;
+}
+
+static void dense_set(
+unsigned long long *dense,
+int row,
+int col)
+{
+	unsigned long long cell = (unsigned long long) row * cols + col;
+
+	dense[cell >> 6] |= 1ULL << (cell & 63);
+}
+
+/* Set the cells whose centre is inside the polygon (even-odd rule) */
+static void dense_polygon(
+unsigned long long *dense,
+double *x,
+double *y,
+int n)
+{
+	double yc, xc, t, *cross;
+	int row, col, i, j, k, nc;
+
+	cross = (double *) malloc((n + 1) * sizeof(double));
+	if (cross == NULL) return;
+	for (row = 0; row < rows; row++) {
+		yc = gridinfo[3] + (row + 0.5) * gridinfo[5];
+		nc = 0;
+		for (i = 0, j = n - 1; i < n; j = i++)
+			if ((y[i] > yc) != (y[j] > yc))
+				cross[nc++] = x[j] + (yc - y[j]) * (x[i] - x[j]) / (y[i] - y[j]);
+		for (i = 1; i < nc; i++) {
+			for (t = cross[i], k = i; k > 0 && cross[k-1] > t; k--) cross[k] = cross[k-1];
+			cross[k] = t;
+		}
+		for (i = 0; i + 1 < nc; i += 2) {
+			for (col = (int) ceil((cross[i] - gridinfo[0]) / gridinfo[1] - 0.5); col < cols; col++) {
+				if (col < 0) continue;
+				xc = gridinfo[0] + (col + 0.5) * gridinfo[1];
+				if (xc > cross[i+1]) break;
+				if (xc >= cross[i]) dense_set(dense, row, col);
+			}
+		}
+	}
+	free(cross);
+}
+
+/* Write the cells of the union with the number of selected runs
+   that inundated each. RETURN 0 or 1 on error */
+static int write_union(
+char *file,
+RunSet *runs,
+int count,
+double min_volume)
+{
+	FILE *out;
+	unsigned int *freq, c, j;
+	unsigned long long base, cell;
+	Container *k;
+	int i;
+
+	freq = (unsigned int *) calloc((size_t) cols * rows, sizeof(unsigned int));
+	out = fopen(file, "w");
+	if (freq == NULL || out == NULL) {
+		fprintf(stderr, "Cannot write union file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	for (i = 0; i < count; i++) {
+		if (runs[i].volume <= min_volume) continue;
+		for (c = 0; c < runs[i].num_containers; c++) {
+			k = runs[i].containers + c;
+			base = (unsigned long long) k->key << 16;
+			if (k->bits != NULL) {
+				for (j = 0; j < 65536; j++)
+					if ((k->bits[j >> 6] >> (j & 63)) & 1) freq[base + j]++;
+			}
+			else for (j = 0; j < k->card; j++) freq[base + k->array[j]]++;
+		}
+	}
+	fprintf(out, "# EAST NORTH RUNS");
+	for (cell = 0; cell < (unsigned long long) cols * rows; cell++) {
+		if (!freq[cell]) continue;
+		fprintf(out, "\n%0.3f\t%0.3f\t%u", gridinfo[0] + gridinfo[1] * (double) (cell % cols),
+		        gridinfo[3] + gridinfo[5] * (double) (cell / cols), freq[cell]);
+	}
+	fprintf(out, "\n");
+	free(freq);
+	return fclose(out) ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	FILE *in;
+	char magic[8], line[256];
+	RunSet *runs = NULL;
+	int count, i, selected = 0, row, col, n = 0, size = 256;
+	unsigned long long *dense, *scratch, hits, cell;
+	double min_volume = -1.0, easting, northing, cells_sum = 0.0, *x, *y;
+	struct timespec start;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s index-file list|cell|box|polygon|union|count [arguments]\n", argv[0]);
+		return 1;
+	}
+	in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open footprint index=[%s]:[%s]!\n", argv[1], strerror(errno));
+		return 1;
+	}
+	if (fread(magic, 1, 8, in) != 8 || memcmp(magic, FOOTINDEX_MAGIC, 8) ||
+	    fread(&cols, sizeof(int), 1, in) != 1 ||
+	    fread(&rows, sizeof(int), 1, in) != 1 ||
+	    fread(gridinfo, sizeof(double), 6, in) != 6) {
+		fprintf(stderr, "[%s] is not a MOLASSES footprint index!\n", argv[1]);
+		return 1;
+	}
+	num_keys = (unsigned int) (((unsigned long long) cols * rows + 65535) >> 16);
+	count = load_index(in, &runs);
+	fclose(in);
+	if (count < 0) {
+		fprintf(stderr, "Cannot read the runs of [%s]!\n", argv[1]);
+		return 1;
+	}
+	dense = (unsigned long long *) calloc((size_t) num_keys * 1024, sizeof(unsigned long long));
+	scratch = (unsigned long long *) malloc(1024 * sizeof(unsigned long long));
+	if (dense == NULL || scratch == NULL) {
+		fprintf(stderr, "[molasses-query] Out of Memory for a %d x %d grid\n", cols, rows);
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (!strcmp(argv[2], "list")) {
+		fprintf(stdout, "# %s: %d runs, grid %d cols x %d rows\n", argv[1], count, cols, rows);
+		fprintf(stdout, "# RUN VOLUME PULSE RESIDUAL CELLS CONTAINERS\n");
+		for (i = 0; i < count; i++)
+			fprintf(stdout, "%d\t%0.4f\t%0.4f\t%0.4f\t%u\t%u\n", runs[i].run, runs[i].volume,
+			        runs[i].pulse, runs[i].residual, runs[i].cells, runs[i].num_containers);
+	}
+	else if (!strcmp(argv[2], "cell") && argc > 4) {
+		easting = strtod(argv[3], NULL);
+		northing = strtod(argv[4], NULL);
+		row = (int) floor((northing - gridinfo[3]) / gridinfo[5]);
+		col = (int) floor((easting - gridinfo[0]) / gridinfo[1]);
+		if (row < 0 || row >= rows || col < 0 || col >= cols) {
+			fprintf(stderr, "%s %s is outside the grid!\n", argv[3], argv[4]);
+			return 1;
+		}
+		cell = (unsigned long long) row * cols + col;
+		fprintf(stdout, "# RUN VOLUME (runs inundating cell row %d col %d)\n", row, col);
+		for (i = 0; i < count; i++) {
+			if (run_has_cell(runs + i, (unsigned int) cell)) {
+				fprintf(stdout, "%d\t%0.4f\n", runs[i].run, runs[i].volume);
+				selected++;
+			}
+		}
+		fprintf(stdout, "# %d of %d runs\n", selected, count);
+	}
+	else if ((!strcmp(argv[2], "box") && argc > 6) || (!strcmp(argv[2], "polygon") && argc > 3)) {
+		x = (double *) malloc(size * sizeof(double));
+		y = (double *) malloc(size * sizeof(double));
+		if (x == NULL || y == NULL) return 1;
+		if (!strcmp(argv[2], "box")) {
+			x[0] = x[3] = strtod(argv[3], NULL);
+			y[0] = y[1] = strtod(argv[4], NULL);
+			x[1] = x[2] = strtod(argv[5], NULL);
+			y[2] = y[3] = strtod(argv[6], NULL);
+			n = 4;
+		}
+		else {
+			in = fopen(argv[3], "r");
+			if (in == NULL) {
+				fprintf(stderr, "Cannot open polygon file=[%s]:[%s]!\n", argv[3], strerror(errno));
+				return 1;
+			}
+			while (fgets(line, sizeof line, in) != NULL) {
+				if (line[0] == '#' || line[0] == '>') continue;
+				if (n == size) {
+					size *= 2;
+					x = (double *) realloc(x, size * sizeof(double));
+					y = (double *) realloc(y, size * sizeof(double));
+					if (x == NULL || y == NULL) return 1;
+				}
+				if (sscanf(line, "%lf %lf", x + n, y + n) == 2) n++;
+			}
+			fclose(in);
+		}
+		dense_polygon(dense, x, y, n);
+		fprintf(stdout, "# RUN VOLUME CELLS_IN_AREA (area of %llu cells)\n", dense_count(dense));
+		for (i = 0; i < count; i++) {
+			hits = run_and_count(runs + i, dense);
+			if (hits) {
+				fprintf(stdout, "%d\t%0.4f\t%llu\n", runs[i].run, runs[i].volume, hits);
+				selected++;
+			}
+		}
+		fprintf(stdout, "# %d of %d runs\n", selected, count);
+	}
+	else if (!strcmp(argv[2], "union")) {
+		if (argc > 3) min_volume = strtod(argv[3], NULL);
+		for (i = 0; i < count; i++) {
+			if (runs[i].volume <= min_volume) continue;
+			run_or(runs + i, dense);
+			selected++;
+		}
+		hits = dense_count(dense);
+		fprintf(stdout, "# %d runs with volume > %g: union of %llu cells, %0.6f square km\n",
+		        selected, min_volume, hits, hits * gridinfo[1] * gridinfo[5] / 1e6);
+		if (argc > 4 && write_union(argv[4], runs, count, min_volume)) return 1;
+	}
+	else if (!strcmp(argv[2], "count")) {
+		if (argc > 3) min_volume = strtod(argv[3], NULL);
+		for (i = 0; i < count; i++) {
+			if (runs[i].volume <= min_volume) continue;
+			run_or(runs + i, dense);
+			cells_sum += runs[i].cells;
+			selected++;
+		}
+		fprintf(stdout, "runs\t%d\n", selected);
+		fprintf(stdout, "mean_cells\t%0.1f\n", selected ? cells_sum / selected : 0.0);
+		fprintf(stdout, "union_cells\t%llu\n", dense_count(dense));
+		for (i = 0; i < count; i++) {
+			if (runs[i].volume <= min_volume) continue;
+			run_and(runs + i, dense, scratch);
+		}
+		fprintf(stdout, "intersection_cells\t%llu\n", selected ? dense_count(dense) : 0ULL);
+	}
+	else {
+		fprintf(stderr, "Unknown or incomplete query [%s]\n", argv[2]);
+		return 1;
+	}
+	fprintf(stderr, "Query time: %0.3f ms over %d runs\n", ms_since(&start), count);
+	return 0;
+}
@@ -0,0 +1,95 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: FOOTPRINT_SNAPSHOT
+Copy the footprint of a finished flow out of the data grid:
+the flow parameters, the vents and every inundated cell (thickness > 0),
+in row-major order.
+The snapshot does not point into the grid, so it stays valid after the grid
+is reset for the next run and can be written out by another thread.
+
+INPUTS:
+DataCell **grid
+Lava_flow *active_flow
+double *gridinfo
+int run
+
+RETURN:
+FlowFootprint * or NULL on error
+*******************************/
+FlowFootprint *FOOTPRINT_SNAPSHOT(
+DataCell **grid,
+Lava_flow *active_flow,
+double *gridinfo,
+int run)
+{
+	FlowFootprint *fp;
+	FootprintCell *more;
+	unsigned int size = 4096;
+	int row, col, i;
+
+	fp = (FlowFootprint *) GC_MALLOC(sizeof(FlowFootprint));
+	if (fp == NULL) {
+		fprintf(stderr, "[FOOTPRINT_SNAPSHOT] Out of Memory for run %d!\n", run);
+		return NULL;
+	}
+	fp->run = run;
+	fp->volume = active_flow->volumeToErupt;
+	fp->pulsevolume = active_flow->pulsevolume;
+	fp->residual = active_flow->residual;
+	fp->num_vents = active_flow->num_vents;
+	fp->vents = (Vent *) GC_MALLOC_ATOMIC((size_t) active_flow->num_vents * sizeof(Vent));
+	fp->cells = (FootprintCell *) GC_MALLOC_ATOMIC(size * sizeof(FootprintCell));
+	if (fp->vents == NULL || fp->cells == NULL) {
+		fprintf(stderr, "[FOOTPRINT_SNAPSHOT] Out of Memory for run %d!\n", run);
+		return NULL;
+	}
+	for (i = 0; i < active_flow->num_vents; i++) fp->vents[i] = active_flow->source[i];
+	fp->count = 0;
+
+	for (row = 0; row < gridinfo[4]; row++) {
+		for (col = 0; col < gridinfo[2]; col++) {
+			if (grid[row][col].eff_elev - grid[row][col].dem_elev > 0) {
+				if (fp->count == size) {
+					size *= 2;
+					more = (FootprintCell *) GC_REALLOC(fp->cells, size * sizeof(FootprintCell));
+					if (more == NULL) {
+						fprintf(stderr, "[FOOTPRINT_SNAPSHOT] Out of Memory for %u cells in run %d!\n", size, run);
+						return NULL;
+					}
+					fp->cells = more;
+				}
+				fp->cells[fp->count].row = row;
+				fp->cells[fp->count].col = col;
+				fp->cells[fp->count].eff_elev = grid[row][col].eff_elev;
+				fp->cells[fp->count].arrival = 0;
+				fp->cells[fp->count++].dem_elev = grid[row][col].dem_elev;
+			}
+		}
+	}
+	return fp;
+}
@@ -0,0 +1,154 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+/*
+libmolasses: run MOLASSES lava flows from another program.
+
+A context loads a DEM once and runs any number of flows on it:
+
+	MolassesContext *ctx = molasses_open("dem.tif");
+	MolassesVent vent = {501500.0, 4001500.0};
+	MolassesCell cells[100000];
+	unsigned int count;
+	if (molasses_run(ctx, &vent, 1, 1e6, 100.0, 2.0, 1, cells, 100000, &count))
+		fprintf(stderr, "%s\n", molasses_error(ctx));
+	molasses_close(ctx);
+
+A context is used by one thread at a time; threads running flows at
+the same time each open their own context. Each flow draws its random
+numbers from the seed it is given, so contexts run at the same time
+give the flows they would give one after the other. Memory is managed by the
+Boehm collector (libgc): a thread that was not started with the
+collector's pthread_create is registered when it first opens or runs
+a context, and must call molasses_thread_exit() before it ends.
+
+Link with -lmolasses -lgdal -lgc -lran -lz -lm -lpthread.
+*/
+
+#ifndef _MOLASSES_H_
+#define _MOLASSES_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MOLASSES_OK        0
+#define MOLASSES_ERROR     1
+#define MOLASSES_TRUNCATED 2  /* more cells than the buffer holds, see molasses_run */
+
+/* Grids of molasses_raster */
+#define MOLASSES_ELEVATION 0  /* DEM elevation, double */
+#define MOLASSES_THICKNESS 1  /* lava thickness of the last flow, double */
+#define MOLASSES_HITS      2  /* flows that inundated the cell, int */
+#define MOLASSES_MEAN      3  /* mean thickness over the flows that inundated the cell, double */
+#define MOLASSES_M2        4  /* sum of squared differences from that mean, double:
+                                 the sample deviation is sqrt(M2 / (hits - 1)) */
+#define MOLASSES_MAX       5  /* largest thickness, double */
+
+typedef struct MolassesContext MolassesContext;
+
+typedef struct MolassesVent {
+	double easting;
+	double northing;
+} MolassesVent;
+
+/* A grid in place in the context: the value of (row, col) is at
+   data + row * row_stride + col * col_stride bytes. Row 0 is the south row. */
+typedef struct MolassesRaster {
+	void *data;
+	int rows;
+	int cols;
+	long row_stride;
+	long col_stride;
+	char format;              /* 'd' double, 'i' int, as the struct module */
+} MolassesRaster;
+
+/* An inundated cell of a flow. Row 0 is the south row of the grid. */
+typedef struct MolassesCell {
+	int row;
+	int col;
+	double easting;           /* of the cell, like the ASCII flow maps */
+	double northing;
+	double thickness;         /* lava thickness, meters */
+	double dem_elev;          /* elevation before the flow */
+} MolassesCell;
+
+/* Called for each inundated cell, in row-major order;
+   a nonzero return stops the delivery and is returned by molasses_run_callback */
+typedef int (*MolassesCellFunc)(const MolassesCell *cell, void *user);
+
+/* Load a DEM (any GDAL raster). RETURN the context, NULL on error */
+MolassesContext *molasses_open(const char *dem_file);
+
+/* Grid size and GDAL geotransform (north-up, [5] negative) of the DEM */
+void molasses_grid(const MolassesContext *ctx, int *cols, int *rows, double geotransform[6]);
+
+/* Bytes of memory held by the context: the grid and the active list */
+size_t molasses_memory(const MolassesContext *ctx);
+
+/* Erupt volume (cubic meters) in pulses of pulse_volume, from the vents in
+   turn, leaving residual meters of lava in each cell it crosses; seed
+   sets the random order in which the lava spreads, the same seed gives
+   the same flow. The inundated cells are copied into cells[0..max_cells-1] and counted
+   in *count. RETURN MOLASSES_OK, MOLASSES_TRUNCATED if *count > max_cells
+   (the first max_cells cells are copied), MOLASSES_ERROR on error */
+int molasses_run(MolassesContext *ctx, const MolassesVent *vents, int num_vents,
+                 double volume, double pulse_volume, double residual, unsigned int seed,
+                 MolassesCell *cells, unsigned int max_cells, unsigned int *count);
+
+/* As molasses_run, handing each inundated cell to func.
+   RETURN MOLASSES_OK, MOLASSES_ERROR, or the nonzero value from func */
+int molasses_run_callback(MolassesContext *ctx, const MolassesVent *vents, int num_vents,
+                          double volume, double pulse_volume, double residual, unsigned int seed,
+                          MolassesCellFunc func, void *user);
+
+/* Keep the ensemble grids (MOLASSES_THICKNESS to MOLASSES_MAX) of the
+   flows run from now on, starting from zero; keep 0 drops them.
+   RETURN MOLASSES_OK, MOLASSES_ERROR if out of memory */
+int molasses_ensemble(MolassesContext *ctx, int keep);
+
+/* Flows in the ensemble */
+unsigned int molasses_flows(const MolassesContext *ctx);
+
+/* Where a grid is: the values change in place as flows run, and stay
+   valid until molasses_ensemble or molasses_close.
+   RETURN MOLASSES_OK, MOLASSES_ERROR if the grid is not kept */
+int molasses_raster(MolassesContext *ctx, int which, MolassesRaster *raster);
+
+/* What went wrong in the last call on ctx */
+const char *molasses_error(const MolassesContext *ctx);
+
+/* Release the context and its grid */
+void molasses_close(MolassesContext *ctx);
+
+/* Unregister the calling thread from the collector, see above */
+void molasses_thread_exit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MOLASSES_H_ */
@@ -1,7 +1,11 @@
 #include "structs_LJC2.h"  /* Global Structures and Variables*/
+#include "molasses.h"     /* libmolasses API */
 #include <gdal.h>     /* GDAL */
 #include <cpl_conv.h> /* GDAL for CPLMalloc() */
+#include <cpl_string.h> /* GDAL for CSLSetNameValue() */
+#define GC_THREADS    /* output threads are registered with the collector */
 #include <gc.h>
+#include <zlib.h>
 #include <ranlib.h>
 #include <rnglib.h>
 
@@ -21,6 +25,155 @@ int vent
 return: int
 */
 
+/*#######################
+# MODULE ARCHIVE
+########################*/
+FlowArchive *ARCHIVE_OPEN(char *, double *);
+/* args:
+char *file (flow archive file name)
+double *gridinfo (Metadata array)
+OUTPUTS:
+FlowArchive * or NULL on error
+*/
+FlowArchive *ARCHIVE_REOPEN(char *, double *, const char *, FlowArchive *, long long);
+/* args:
+char *file (archive or footprint index of a checkpointed ensemble)
+double *gridinfo (Metadata array)
+const char *magic (ARCHIVE_MAGIC or FOOTINDEX_MAGIC)
+FlowArchive *saved (its index at the checkpoint, see ENSSTATE_LOAD)
+long long size (its bytes at the checkpoint)
+OUTPUTS:
+FlowArchive * or NULL on error
+*/
+int ARCHIVE_WRITE_RUN(FlowArchive *, FlowFootprint *);
+/* args:
+FlowArchive *archive
+FlowFootprint *fp (snapshot of the run, see FOOTPRINT_SNAPSHOT)
+OUTPUTS:
+int (0 on success, 1 on error)
+*/
+int ARCHIVE_CLOSE(FlowArchive *);
+/* Functions local to ARCHIVE */
+size_t varint_put(unsigned char *, unsigned long long);
+size_t varint_get(const unsigned char *, const unsigned char *, unsigned long long *);
+
+/*########################
+# MODULE ARRIVAL
+########################*/
+Arrival *ARRIVAL_INIT(Inputs *, Outputs *, double *);
+/* args:
+Inputs *In (projection of the rasters)
+Outputs *Out (arrival_units, arrival_ensemble_file)
+double *gridinfo (Metadata array)
+OUTPUTS:
+Arrival * or NULL on error */
+
+Arrival *ARRIVAL_STAMPS(double *);
+/* args:
+double *gridinfo (Metadata array)
+OUTPUTS:
+Arrival * for ARRIVAL_MARK and ARRIVAL_END only, or NULL on error */
+
+int ARRIVAL_MARK(Arrival *, int, int);
+/* args:
+Arrival *arr (pulse: current pulse of the run)
+int row, int col (cell above its residual)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+unsigned int ARRIVAL_STAMP(Arrival *, int, int);
+/* args:
+Arrival *arr
+int row, int col
+OUTPUTS:
+unsigned int (pulse the cell was reached at in this run, 0: not yet) */
+
+int ARRIVAL_SET(Arrival *, int, int, unsigned int);
+/* args:
+Arrival *arr
+int row, int col
+unsigned int pulse (stamp of the cell, as ARRIVAL_STAMP gave it)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int ARRIVAL_END(Arrival *, FlowFootprint *);
+/* args:
+Arrival *arr
+FlowFootprint *fp (snapshot of the run, arrival is set)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int ARRIVAL_ADD(Arrival *, FlowFootprint *);
+/* args:
+Arrival *arr (nothing is kept unless ARRIVAL_ENSEMBLE is on)
+FlowFootprint *fp (footprint with its arrivals, see ARRIVAL_END)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int ARRIVAL_WRITE_RUN(Arrival *, FlowFootprint *, Outputs *, double *);
+/* args:
+Arrival *arr
+FlowFootprint *fp (snapshot of the run)
+Outputs *Out (arrival_file: raster is prefix<run>.tif)
+double *gridinfo (Metadata array)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int ARRIVAL_WRITE(Arrival *, Outputs *, double *);
+/* args:
+Arrival *arr
+Outputs *Out (arrival_ensemble_file: prefix_min.tif, prefix_median.tif)
+double *gridinfo (Metadata array)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+/*#############################
+# MODULE ASSETS
+##############################*/
+AssetIndex *ASSETS_LOAD(char *, double *);
+/* args:
+char *file (ASSETS_FILE)
+double *gridinfo (Metadata array)
+OUTPUTS:
+AssetIndex * or NULL on error
+*/
+int ASSETS_RUN(AssetIndex *, FlowFootprint *, char *);
+/* args:
+AssetIndex *ai
+FlowFootprint *fp (snapshot of the run)
+char *prefix (ASSET_IMPACTS)
+OUTPUTS:
+int (0 on success, 1 on error)
+*/
+int ASSETS_SUMMARY(AssetIndex *, char *);
+
+/*#############################
+# MODULE CELL_STATS
+##############################*/
+CellStats *CELL_STATS_INIT(Outputs *, double *);
+/* args:
+Outputs *Out (cell_stats_type: what to keep)
+double *gridinfo (Metadata array)
+OUTPUTS:
+CellStats * or NULL on error
+*/
+void CELL_STATS_UPDATE(CellStats *, FlowFootprint *, DataCell **);
+/* args:
+CellStats *cs
+FlowFootprint *fp (snapshot of the run)
+DataCell **grid (hit_count already includes this run)
+*/
+int CELL_STATS_WRITE(CellStats *, DataCell **, Outputs *, Inputs *, double *);
+/* args:
+CellStats *cs
+DataCell **grid
+Outputs *Out
+Inputs *In
+double *gridinfo (Metadata array)
+OUTPUTS:
+int (0 on success, 1 on error)
+*/
+
 /*#############################
 # MODULE CHOOSE_NEW_VENT
 ##############################*/
@@ -38,6 +191,32 @@ int load_spd_data(FILE *, Lava_flow*, int *);
 int count_rows(char file[], long len);
 
 
+/*#######################
+# MODULE CONVERGE
+########################*/
+Convergence *CONVERGE_INIT(Inputs *, double *);
+/* args:
+Inputs *In (CONVERGE_* and RUNS)
+double *gridinfo (Metadata array)
+OUTPUTS:
+Convergence * or NULL on error */
+
+int CONVERGE_ADD(Convergence *, DataCell **, FlowFootprint *);
+/* args:
+Convergence *cv
+DataCell **grid (hit counts, the run added)
+FlowFootprint *fp (the run)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int CONVERGE_CHECK(Convergence *, DataCell **, int);
+/* args:
+Convergence *cv
+DataCell **grid (hit counts)
+int last_run (1: check the runs since the last check, whenever they end)
+OUTPUTS:
+int (1: converged at the last check, 0: not yet) */
+
 /*#######################
 # MODULE DEMLOADER
 ########################*/
@@ -55,7 +234,7 @@ DataCell **grid (or NULL on error)
 /*########################
 # MODULE DISTRIBUTE
 ########################*/
-int DISTRIBUTE(DataCell**,ActiveList*,unsigned int*,unsigned int*,Neighbor*,double*,Inputs*);
+int DISTRIBUTE(DataCell**,ActiveList*,unsigned int*,unsigned int*,Neighbor*,double*,Inputs*,unsigned int*);
 /* args:
 INPUTS:
 DataCell **grid
@@ -65,10 +244,209 @@ int *activeCount,
 Neighbor *activeNeighbor
 double *gridMetadata
 Inputs *in
+unsigned int *rand_state (rand_r() state of the neighbor shuffles)
 OUTPUTS:
 int (O for success; <0 for error)
 */
 
+/*#############################
+# MODULE ENSEMBLE
+##############################*/
+int ENSEMBLE_OPEN(DataCell **, Inputs *, Outputs *, double *);
+/* args:
+DataCell **grid (hit counts are cleared)
+Inputs *In, Outputs *Out (outputs of the ensemble)
+double *gridinfo (Metadata array)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int ENSEMBLE_ADD(DataCell **, Inputs *, Outputs *, Lava_flow *, FlowFootprint *, double *);
+/* args:
+DataCell **grid, Inputs *In, Outputs *Out
+Lava_flow *flow (vents and stats of the run, for STATS_FILE)
+FlowFootprint *fp (the run, arrivals set by ARRIVAL_END)
+double *gridinfo
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int ENSEMBLE_WRITE(DataCell **, Inputs *, Outputs *, Lava_flow *, double *, int);
+/* args:
+DataCell **grid, Inputs *In, Outputs *Out
+Lava_flow *flow (vents of the quick-look hits)
+double *gridinfo
+int run (after the last run, in the hit map file names)
+OUTPUTS:
+int (0) */
+
+/*#############################
+# MODULE ENSEMBLE_STATE
+##############################*/
+int ENSSTATE_SAVE(char *, DataCell **, double *, Outputs *, int, int, int, int, unsigned char *, unsigned int);
+/* args:
+char *file (ensemble checkpoint)
+DataCell **grid (hit counts)
+double *gridinfo (Metadata array)
+Outputs *Out (ensemble accumulators and open outputs, flushed first)
+int start, int runs (first run and runs of the ensemble)
+int next (run to go on with)
+int attempt (of run next, see SEED)
+unsigned char *done (completed runs, bit run - start)
+unsigned int rand_seed (rand_r() state of DISTRIBUTE)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+EnsembleState *ENSSTATE_LOAD(char *, double *);
+/* args:
+char *file (ensemble checkpoint)
+double *gridinfo (Metadata array of the DEM)
+OUTPUTS:
+EnsembleState * or NULL on error, the per-cell blocks are left for ENSSTATE_RESTORE */
+
+FlowArchive *ENSSTATE_ARCHIVE(EnsembleState *, int, char *, double *, const char *);
+/* args:
+EnsembleState *state
+int k (0: flow archive, 1: footprint index, ENSSTATE_STEP_ARCHIVES + step: volume step archive)
+char *file, double *gridinfo, const char *magic (see ARCHIVE_REOPEN)
+OUTPUTS:
+FlowArchive * or NULL on error */
+
+FILE *ENSSTATE_REOPEN(char *, long long);
+/* args:
+char *file (output appended run by run)
+long long size (its bytes at the checkpoint)
+OUTPUTS:
+FILE * open for appending, or NULL on error */
+
+int ENSSTATE_RESTORE(EnsembleState *, DataCell **, double *, Outputs *);
+/* args:
+EnsembleState *state
+DataCell **grid (gets the hit counts)
+double *gridinfo
+Outputs *Out (ensemble accumulators, as initialized for the ensemble)
+OUTPUTS:
+int (0 on success, 1 on error); the rand_r() state of DISTRIBUTE is
+left in state->rand_seed */
+
+/*#############################
+# MODULE EXCEEDANCE
+##############################*/
+Exceedance *EXCEEDANCE_INIT(Outputs *, int, double *);
+/* args:
+Outputs *Out (thresholds)
+int runs (runs in the ensemble, sets the counter size)
+double *gridinfo (Metadata array)
+OUTPUTS:
+Exceedance * or NULL on error
+*/
+int EXCEEDANCE_UPDATE(Exceedance *, FlowFootprint *);
+/* args:
+Exceedance *ex
+FlowFootprint *fp (a finished run)
+OUTPUTS:
+int (0 on success, 1 on error)
+*/
+int EXCEEDANCE_WIDEN(Exceedance *);
+/* args:
+Exceedance *ex (16 bit counters)
+OUTPUTS:
+int (0 on success, 1 on error)
+*/
+int EXCEEDANCE_WRITE(Exceedance *, Outputs *, Inputs *, double *);
+/* args:
+Exceedance *ex
+Outputs *Out
+Inputs *In
+double *gridinfo (Metadata array)
+OUTPUTS:
+int (0 on success, 1 on error)
+*/
+
+/*########################
+# MODULE FLOW_STATE
+########################*/
+int FLOWSTATE_SAVE(char *, DataCell **, double *, Lava_flow *, int, unsigned int, int, unsigned int, Arrival *);
+/* args:
+char *prefix (file is prefix<run>.mfc)
+DataCell **grid (eff_elev, dem_elev, parentcode)
+double *gridinfo (Metadata array)
+Lava_flow *active_flow (volumes, residual, vents, stats.seed1 and seed2)
+int run
+unsigned int pulses (pulses erupted)
+int current_vent (vent of the last pulse)
+unsigned int rand_state (rand_r() state of DISTRIBUTE)
+Arrival *arr (arrival stamps of the flow, or NULL)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+FlowState *FLOWSTATE_LOAD(char *, double *, double);
+/* args:
+char *file (flow checkpoint)
+double *gridinfo (Metadata array of the DEM)
+double remaining (volume left to erupt, < 0: as saved)
+OUTPUTS:
+FlowState * or NULL on error */
+
+int FLOWSTATE_PARAMS(FlowState *, Lava_flow *, double *, DataCell **);
+/* args:
+FlowState *state
+Lava_flow *active_flow (gets the vents and flow parameters)
+double *gridinfo
+DataCell **grid (gets the residual)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int FLOWSTATE_RESTORE(FlowState *, DataCell **, double *, unsigned int *, int *, unsigned int *, Arrival *);
+/* args:
+FlowState *state
+DataCell **grid (reset, see FLOW_RESET)
+double *gridinfo
+unsigned int *pulses, int *current_vent (of FLOW_ERUPT)
+unsigned int *rand_state (gets the rand_r() state of DISTRIBUTE)
+Arrival *arr (gets the arrival stamps, cleared; or NULL)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+/*#############################
+# MODULE FLOW_WRITER
+##############################*/
+int WRITE_ASCII_FLOW(FlowFootprint *, char *, double *);
+int WRITE_BINARY_FLOW(FlowFootprint *, char *, double *);
+/* args:
+FlowFootprint *fp (snapshot of the run)
+char *name (file name, the run number is appended)
+double *geotransform (DEM transform metadata)
+OUTPUTS:
+int (0 on success, 1 on error)
+*/
+/* Functions local to FLOW_WRITER */
+size_t format_fixed(char *, double, int);
+
+/*#############################
+# MODULE FOOTPRINT_INDEX
+##############################*/
+FlowArchive *FOOTINDEX_OPEN(char *, double *);
+/* args:
+char *file (footprint index file name)
+double *gridinfo (Metadata array)
+OUTPUTS:
+FlowArchive * or NULL on error
+*/
+int FOOTINDEX_WRITE_RUN(FlowArchive *, FlowFootprint *);
+int FOOTINDEX_CLOSE(FlowArchive *);
+
+/*#############################
+# MODULE FOOTPRINT
+##############################*/
+FlowFootprint *FOOTPRINT_SNAPSHOT(DataCell **, Lava_flow *, double *, int);
+/* args:
+DataCell **grid
+Lava_flow *active_flow
+double *gridinfo (Metadata array)
+int run (run number)
+OUTPUTS:
+FlowFootprint * (inundated cells of the run) or NULL on error
+*/
+
 /*########################
 # MODULE INITFLOW
 ########################*/
@@ -98,6 +476,47 @@ Lava_flow *active_flow) (Active_flow structure)
 OUTPUTS:
 int (0 on success, 1 on error) 
 */
+int CONFIG_ASSIGN(Inputs *, Outputs *, Lava_flow *, char *, char *);
+/* args:
+Inputs *In
+Outputs *Out
+Lava_flow *active_flow
+char *var (configuration keyword)
+char *value (its value, may be changed)
+OUTPUTS:
+int (0 assigned, -1 not a keyword, 1 on error)
+*/
+
+/*########################
+# MODULE MOLASSES
+########################*/
+MolassesContext *CONTEXT_OPEN(Inputs *);
+/* args:
+Inputs *In (dem_file, elev_uncert, uncert_map; kept by the context)
+OUTPUTS:
+MolassesContext * (grid and gridinfo loaded) or NULL on error */
+
+MolassesContext *CONTEXT_COPY(MolassesContext *);
+/* args:
+MolassesContext *from (its grid is copied, no flow on it)
+OUTPUTS:
+MolassesContext * or NULL on error */
+
+int FLOW_ERUPT(MolassesContext *, Lava_flow *, Snapshot *, int, unsigned int *, double *);
+/* args:
+MolassesContext *ctx
+Lava_flow *active_flow (vents, volume, pulse volume)
+Snapshot *snap (or NULL)
+int run
+unsigned int *pulseCount (OUTPUT: pulses of the flow)
+double *volumeRemaining (OUTPUT: lava volume not erupted)
+OUTPUTS:
+int (0 on success, 1 on error, < 0 the flow left the grid, see DISTRIBUTE) */
+
+void FLOW_RESET(MolassesContext *);
+/* args:
+MolassesContext *ctx (In->flow_field: keep the lava as new ground)
+*/
 
 /*########################
 # MODULE NEIGHBOR
@@ -113,6 +532,33 @@ OUTPUTS:
 int neighbor count or <0 on error 
 */
 	
+/*########################
+# MODULE OUTLINE
+########################*/
+int OUTLINE_INIT(Inputs *, Outputs *);
+/* args:
+Inputs *In (for the DEM projection)
+Outputs *Out (outline_format; sets outline_wkt, outline_crs, outline_ext)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int OUTLINE_FOOTPRINT(FlowFootprint *, Outputs *, double *);
+/* args:
+FlowFootprint *fp (snapshot of the run)
+Outputs *Out
+double *gridinfo (Metadata array)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int OUTLINE_HITS(DataCell **, int, Outputs *, double *);
+/* args:
+DataCell **grid (hit_count)
+int runs (hit probability = hit_count / runs)
+Outputs *Out
+double *gridinfo (Metadata array)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
 /*########################
 # MODULE OUTPUT
 ########################*/
@@ -126,6 +572,47 @@ DataCell **grid (2D DEM Data Grid),
 Lava_flow *active_flow,
 double *geotransform (DEM transform metadata) */
 
+int WRITE_RASTER(char *, void *, GDALDataType, int, Outputs *, Inputs *, double *);
+/*args:
+char *file (raster file name),
+void *data (band sequential data block, top row first),
+GDALDataType data_type (GDT_UInt16, GDT_UInt32 or GDT_Float32),
+int bands (number of bands in data),
+Outputs *Out, 
+Inputs *In, 
+double *geotransform (DEM transform metadata)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+char *DEM_PROJECTION(Inputs *);
+/* args:
+Inputs *In (dem_file, and dem_projection once looked up)
+OUTPUTS:
+char * (WKT of the DEM, "" if it has none) or NULL on error */
+
+int OUTPUT_FOOTPRINT(FlowFootprint *, Outputs *, double *);
+/*args:
+FlowFootprint *fp (snapshot of the run),
+Outputs *Out,
+double *geotransform (DEM transform metadata)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+/*########################
+# MODULE OUTPUT_QUEUE
+########################*/
+OutputQueue *OUTPUT_QUEUE_INIT(int, int, Outputs *, double *);
+/*args:
+int threads (writer threads, 0 to write in the calling thread),
+int capacity (footprints that may wait),
+Outputs *Out,
+double *gridinfo (Metadata array)
+OUTPUTS:
+OutputQueue * or NULL on error */
+int OUTPUT_QUEUE_PUSH(OutputQueue *, FlowFootprint *);
+int OUTPUT_QUEUE_FLUSH(OutputQueue *);
+int OUTPUT_QUEUE_CLOSE(OutputQueue *);
+
 /*########################
 # MODULE PULSE
 ########################*/
@@ -138,6 +625,267 @@ double *volumeRemaining
 double *gridinfo
 */
 
+/*########################
+# MODULE QUICKLOOK
+########################*/
+QuickLook *QUICKLOOK_INIT(DataCell **, Outputs *, double *);
+/* args:
+DataCell **grid (dem_elev)
+Outputs *Out (quicklook_format, quicklook_width, quicklook_threads, output_threads)
+double *gridinfo (Metadata array)
+OUTPUTS:
+QuickLook * (shaded DEM) or NULL on error */
+
+int QUICKLOOK_FOOTPRINT(QuickLook *, FlowFootprint *, char *);
+/* args:
+QuickLook *ql
+FlowFootprint *fp (snapshot of the run)
+char *prefix (image file is prefix<run>.png or .ppm)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int QUICKLOOK_HITS(QuickLook *, DataCell **, int, Vent *, int, char *);
+/* args:
+QuickLook *ql
+DataCell **grid (hit_count)
+int runs (hit probability = hit_count / runs)
+Vent *vents, int num_vents (vents to mark)
+char *file (image file)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+/*########################
+# MODULE RUN_POOL
+########################*/
+int RUN_MAKE(MolassesContext *, Lava_flow *, Snapshot *, int, int, int, pthread_mutex_t *, RunResult *);
+/* args:
+MolassesContext *ctx (In: the inputs of the run)
+Lava_flow *active_flow (gets the parameters and vents of the run)
+Snapshot *snap (or NULL)
+int start (first run of the ensemble, see SAMPLING)
+int run, int attempt (times the run was run before, see SEED)
+pthread_mutex_t *draws (held while the random draws are made, or NULL)
+RunResult *made (OUTPUT: ret, pulses, remaining, rand_state, fp)
+OUTPUTS:
+int (0 on success, 1 on error); the flow is left on the grid */
+
+RunPool *RUN_POOL_START(MolassesContext *, int, Inputs *, Outputs *, Lava_flow *, int, int);
+/* args:
+MolassesContext *ctx (copied for each worker)
+int threads (SCENARIO_THREADS)
+Inputs *In, Outputs *Out, Lava_flow *flow (per scenario, set up with SAMPLE_INIT)
+int num_scenarios
+int start (first run of each scenario)
+OUTPUTS:
+RunPool * or NULL on error */
+
+RunResult *RUN_POOL_TAKE(RunPool *, int, int, int);
+/* args:
+RunPool *pool
+int scenario, int run, int attempt (in the order the driver makes them)
+OUTPUTS:
+RunResult * (waits until it is made) or NULL on error, or
+if it was not made by TIME_BUDGET (pool->stopped is set) */
+
+void RUN_POOL_STOP(RunPool *);
+
+int RUN_PAST_DEADLINE(Inputs *);
+/* args:
+Inputs *In (deadline of TIME_BUDGET, 0: none)
+OUTPUTS:
+int (1 once the deadline has passed, 0 before) */
+
+/*########################
+# MODULE SAMPLE
+########################*/
+Sampler *SAMPLE_INIT(Inputs *, Lava_flow *);
+/* args:
+Inputs *In (SAMPLING, SEED, RUNS, SPATIAL_DENSITY_FILE and MIN_/MAX_ parameters)
+Lava_flow *flow (spd_grd)
+OUTPUTS:
+Sampler * or NULL on error */
+
+int SAMPLE_RUN(Sampler *, int, int);
+/* args:
+Sampler *s
+int index (run - first run of the ensemble)
+int attempt (times the run was run before: 1 or more draw at random)
+OUTPUTS:
+int 0 */
+
+int SAMPLE_POINT(Sampler *, int, double *);
+/* args:
+Sampler *s (or NULL)
+int param (enum sample_param)
+double *u (the coordinate of param, uniform on [0,1))
+OUTPUTS:
+int (1: u is of the design, taken; 0: draw at random) */
+
+int SAMPLE_CELL(Sampler *, double);
+/* args:
+Sampler *s
+double r (0 to the sum of the spatial density)
+OUTPUTS:
+int (the spatial density cell holding r) */
+
+double SAMPLE_TRUNCATED_NORMAL(double, double, double, double, double);
+/* args:
+double u (uniform on [0,1))
+double mean, std
+double lo, hi (truncation)
+OUTPUTS:
+double (the u quantile of the normal truncated to [lo, hi]) */
+
+/*########################
+# MODULE SCENARIO
+########################*/
+ScenarioTable *SCENARIO_LOAD(char *);
+/* args:
+char *file (scenario table, CSV)
+OUTPUTS:
+ScenarioTable * or NULL on error */
+
+int SCENARIO_APPLY(ScenarioTable *, int, Inputs *, Outputs *, Lava_flow *);
+/* args:
+ScenarioTable *table
+int k (scenario)
+Inputs *In, Outputs *Out, Lava_flow *flow (copies of the config file's,
+  changed for scenario k)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+/*########################
+# MODULE SHARD
+########################*/
+Shard *SHARD_OPEN(Inputs *, Outputs *, double *, int);
+/* args:
+Inputs *In (SEED, RUNS, SHARD_FILE, shard index and count, resumed ensemble)
+Outputs *Out (the ensemble outputs are turned off)
+double *gridinfo (Metadata array)
+int start (first run of the ensemble)
+OUTPUTS:
+Shard * or NULL on error */
+
+int SHARD_WRITE_RUN(Shard *, int, int, Lava_flow *, FlowFootprint *);
+/* args:
+Shard *shard
+int slot, int attempt (run of the driver loop and times it was run before)
+Lava_flow *flow (stats of the run)
+FlowFootprint *fp (the run, arrivals set by ARRIVAL_END)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int SHARD_CLOSE(Shard *, int);
+/* args:
+Shard *shard
+int end (run the shard stopped at, start + runs if it made them all)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+Shard *SHARD_READ_OPEN(char *);
+/* args:
+char *file (shard file)
+OUTPUTS:
+Shard * with its header, or NULL on error */
+
+int SHARD_READ_RUN(Shard *);
+/* args:
+Shard *shard (gets slot, attempt, flow and footprint of the next run)
+OUTPUTS:
+int (1: a run, 0: the end of the shard (shard->end), -1 on error) */
+
+/*########################
+# MODULE SNAPSHOT
+########################*/
+Snapshot *SNAPSHOT_INIT(Outputs *, char *, double *);
+/* args:
+Outputs *Out (snapshot_file, snapshot_pulses, snapshot_volume)
+char *projection (WKT of the DEM, see DEM_PROJECTION)
+double *gridinfo (Metadata array)
+OUTPUTS:
+Snapshot * or NULL on error */
+
+int SNAPSHOT_BEGIN(Snapshot *, Lava_flow *, int);
+/* args:
+Snapshot *snap
+Lava_flow *active_flow (vents, volume, pulse volume, residual)
+int run (file is prefix<run>.mfs)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int SNAPSHOT_PULSE(Snapshot *, DataCell **, double);
+/* args:
+Snapshot *snap
+DataCell **grid (eff_elev, dem_elev)
+double erupted (volume erupted so far)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int SNAPSHOT_END(Snapshot *, DataCell **, double);
+/* args:
+Snapshot *snap
+DataCell **grid (eff_elev, dem_elev)
+double erupted (volume erupted in the run)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+/*########################
+# MODULE VOLUME_STEPS
+########################*/
+VolumeSteps *VOLSTEPS_INIT(Inputs *, Outputs *, double *);
+/* args:
+Inputs *In (runs)
+Outputs *Out (volume_steps_file, step_volumes, volume_steps_archive)
+double *gridinfo (Metadata array)
+OUTPUTS:
+VolumeSteps * or NULL on error */
+
+void VOLSTEPS_BEGIN(VolumeSteps *, double);
+/* args:
+VolumeSteps *vs
+double erupted (volume erupted before the first pulse, 0 unless resumed) */
+
+double VOLSTEPS_PULSE(VolumeSteps *, double, double);
+/* args:
+VolumeSteps *vs
+double erupted (volume erupted so far)
+double pulsevolume
+OUTPUTS:
+double (the pulse volume, up to the next step) */
+
+int VOLSTEPS_REACHED(VolumeSteps *, DataCell **, Lava_flow *, double *, int, unsigned int, double);
+/* args:
+VolumeSteps *vs
+DataCell **grid
+Lava_flow *active_flow
+double *gridinfo
+int run
+unsigned int pulses (pulses so far)
+double erupted (volume erupted so far)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int VOLSTEPS_COMMIT(VolumeSteps *, double *);
+/* args:
+VolumeSteps *vs (the steps taken by the run)
+double *gridinfo
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int VOLSTEPS_WIDEN(VolumeSteps *);
+/* args:
+VolumeSteps *vs (16 bit hit counters)
+OUTPUTS:
+int (0 on success, 1 on error) */
+
+int VOLSTEPS_WRITE(VolumeSteps *, Outputs *, Inputs *, double *);
+/* args:
+VolumeSteps *vs
+Outputs *Out, Inputs *In (raster options)
+double *gridinfo
+OUTPUTS:
+int (0 on success, 1 on error) */
+
 /***************************
  MODULE CHECK_VENT
 ****************************/
@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <float.h>
 #include <string.h>
+#include <pthread.h>
 #include <ctype.h>
 
 
@@ -53,6 +54,25 @@ typedef struct Vent {
 	int col;          /* X of vent cell */
 } Vent;
 
+/* Per-run summary, written to STATS_FILE */
+typedef struct FlowStats {
+	unsigned ca_list_size;    /* size the active list grew to */
+	unsigned active_count;    /* inundated cells */
+	unsigned vent_count;
+	unsigned run;
+	double residual;
+	double remaining_volume;
+	double total_volume;
+	int seed1, seed2;         /* rnglib state (get_state) when the run started */
+	double pulse_volume;
+	unsigned pulse_count;
+	double area;              /* inundated area, square km */
+	double max_thickness;
+	double runout;            /* farthest inundated cell from its nearest vent */
+	double mass_error;        /* volume found in cells - volume erupted */
+	double wall_time;         /* seconds */
+} FlowStats;
+
 /*Vent Information*/
 typedef struct Lava_flow {
 	Vent *source;             /* Input - pointer to an array of erupting vents */
@@ -62,6 +82,7 @@ typedef struct Lava_flow {
 	double pulsevolume;       /* Input - pulse volume */
 	double residual;          /* Input - residual thickness */
 	SpatialDensity *spd_grd;  /* pointer to spatial density grid */
+	FlowStats stats;          /* Output - summary of the current run */
 } Lava_flow;
 
 /*Input parameters*/
@@ -92,17 +113,96 @@ typedef struct Inputs {
 	int flows;
 	int parents;
 	int flow_field;
+	char *assets_file;        /* assets to report on, see ASSETS_LOAD */
+	char *dem_projection;     /* WKT of the DEM, copied to output rasters */
+	struct Arrival *arrival;  /* first arrival stamps, set by DISTRIBUTE (same as Out->arrival) */
+	struct VolumeSteps *volume_steps; /* flows at VOLUME_STEPS, taken by FLOW_ERUPT (same as Out->volume_steps) */
+	char *scenario_file;      /* scenario table, see scenario_LJC2.c */
+	int scenario_threads;     /* worker threads making its runs, see runpool_LJC2.c */
+	long long seed;           /* SEED of every run's random numbers, < 0: from the clock */
+	char *flow_checkpoint_file; /* prefix of the flow checkpoints, see flowstate_LJC2.c */
+	unsigned int flow_checkpoint_pulses; /* a checkpoint every this many pulses, 0: none */
+	int flow_checkpoint_seconds; /* and/or every this many seconds, 0: none */
+	char *resume_file;        /* flow checkpoint to resume */
+	double resume_volume;     /* volume to erupt from the checkpoint, < 0: what it had left */
+	struct FlowState *resume; /* loaded resume_file, taken by FLOW_ERUPT */
+	char *ensemble_checkpoint_file; /* ensemble checkpoint, see ensstate_LJC2.c */
+	int ensemble_checkpoint_runs; /* a checkpoint every this many runs, 0: none */
+	int ensemble_checkpoint_seconds; /* and/or after a run, every this many seconds, 0: none */
+	char *resume_ensemble_file; /* ensemble checkpoint to resume */
+	struct EnsembleState *resume_ensemble; /* loaded resume_ensemble_file */
+	int shard_index;          /* --shard K/N: this process runs shard K (1 to N) */
+	int shard_count;          /* of N, 0: all runs */
+	char *shard_file;         /* prefix of the shard files, see shard_LJC2.c */
+	double converge_epsilon;  /* stop at this hit probability half-width, see converge_LJC2.c */
+	double converge_floor;    /* over the cells of at least this hit probability */
+	double converge_delta;    /* and/or this change of the hit probabilities */
+	int converge_every;       /* runs between checks */
+	double time_budget;       /* TIME_BUDGET: seconds from the start, 0: none */
+	int time_budget_abandon;  /* stop the flow erupting at the deadline */
+	double deadline;          /* CLOCK_MONOTONIC seconds of TIME_BUDGET, 0: none */
+	int sampling;             /* SAMPLING design, see sample_LJC2.c */
+	struct Sampler *sample;   /* draws of the runs of the ensemble */
 } Inputs;
 
 /*Program Outputs*/
 typedef struct Outputs {
 	char *ascii_flow_file;
+	char *binary_flow_file;   /* ascii_flow columns as native doubles */
 	char *ascii_hits_file;
 	char *raster_hits_file;
 	char *raster_flow_file;
 	char *raster_post_dem_file;
 	char *raster_pre_dem_file;
 	char *stats_file;
+	FILE *stats;              /* open stats file, one line per run */
+	char *flow_archive_file;
+	struct FlowArchive *flow_archive; /* open flow archive, see archive_LJC2.c */
+	char *footprint_index_file;
+	struct FlowArchive *footprint_index; /* open footprint index, see footindex_LJC2.c */
+	char *raster_compression; /* GeoTIFF COMPRESS option: NONE, DEFLATE, ZSTD, LZW */
+	int raster_hits_type;     /* GDALDataType of the hits raster: GDT_UInt16 or GDT_UInt32 */
+	char *cell_stats_file;    /* prefix of the per-cell ensemble statistics rasters */
+	int cell_stats_type[3];   /* GDALDataType kept for mean, M2, max (GDT_Unknown: off) */
+	struct CellStats *cell_stats;
+	char *exceedance_file;    /* multi-band probability raster of THICKNESS_THRESHOLDS */
+	int num_thresholds;
+	double *thresholds;       /* lava thickness thresholds (m), increasing */
+	struct Exceedance *exceedance;
+	char *asset_impacts_file; /* prefix of the asset impact files */
+	struct AssetIndex *assets;
+	char *flow_outline_file;  /* prefix of the per-run outline files, see outline_LJC2.c */
+	char *hit_outline_file;   /* hit probability contours */
+	int num_hit_levels;
+	double *hit_levels;       /* hit probabilities to contour, increasing */
+	char *outline_format;     /* GeoJSON or an OGR vector driver name */
+	char *outline_ext;        /* file name extension of outline_format */
+	char *outline_wkt;        /* projection of the DEM */
+	char *outline_crs;        /* GeoJSON crs name of the DEM projection, "" if unknown */
+	char *quicklook_flow_file;  /* prefix of the per-run quick-look images */
+	char *quicklook_hits_file;  /* hit probability quick-look image */
+	char *quicklook_format;   /* PNG or PPM */
+	int quicklook_width;      /* largest image width in pixels, 0: a pixel per cell */
+	int quicklook_threads;    /* threads rendering an image, 0: all cpus */
+	struct QuickLook *quicklook;
+	char *snapshot_file;      /* prefix of the per-run snapshot files */
+	unsigned int snapshot_pulses; /* a frame every this many pulses, 0: none */
+	double snapshot_volume;   /* and/or every this many cubic meters erupted, 0: none */
+	struct Snapshot *snapshot;
+	char *arrival_file;       /* prefix of the per-run arrival rasters */
+	char *arrival_ensemble_file; /* prefix of the min and median arrival rasters */
+	char *arrival_units;      /* PULSE or VOLUME */
+	struct Arrival *arrival;
+	char *volume_steps_file;  /* prefix of the volume step outputs, see volsteps_LJC2.c */
+	int num_volume_steps;
+	double *step_volumes;     /* erupted volumes (m^3), increasing */
+	int volume_steps_archive; /* write the flows at each step to archives */
+	struct VolumeSteps *volume_steps;
+	struct Shard *shard;      /* shard file of --shard, see shard_LJC2.c */
+	struct Convergence *converge; /* CONVERGE_EPSILON / CONVERGE_DELTA, see converge_LJC2.c */
+	int output_threads;       /* writer threads for per-run outputs (0: write in the driver) */
+	int output_queue_size;    /* finished runs that may wait for the writers */
+	int ensemble_runs;        /* runs of the ensemble rasters being written (RUNS metadata) */
 } Outputs;
 
 /* last value is number of file types */
@@ -114,18 +214,396 @@ typedef enum  {
 	raster_post,
 	raster_pre,
 	stats_file,
+	flow_archive,
+	binary_flow,
 	num_types
 } File_output_type;
 
-typedef struct FlowStats {
-	unsigned ca_list_size;
-	unsigned active_count;
-	unsigned vent_count;
-	unsigned run;
+/* Flow archive: all runs of an ensemble in one indexed file */
+#define ARCHIVE_MAGIC "MOLFLOW1"
+#define ARCHIVE_END_MAGIC "MOLFLEND"
+
+typedef struct FlowArchive {
+	FILE *fp;
+	int cols;
+	int rows;
+	unsigned int count;       /* runs written */
+	unsigned int size;        /* allocated index entries */
+	int *runs;                /* run number of each record */
+	long long *offsets;       /* file offset of each record */
+	pthread_mutex_t lock;     /* serializes record writes from output threads */
+} FlowArchive;
+
+/* Per-cell ensemble statistics of lava thickness, see cellstats_LJC2.c */
+typedef struct CellStats {
+	int cols;
+	int rows;
+	int mean_type;            /* GDT_Float64, GDT_Float32 or GDT_Unknown (not kept) */
+	int m2_type;
+	int max_type;
+	void *mean;               /* row-major, row 0 is the south row like the grid */
+	void *m2;                 /* sum of squared differences from the mean */
+	void *max;
+} CellStats;
+
+/* Per-cell counts of runs thicker than each threshold, see exceedance_LJC2.c */
+typedef struct Exceedance {
+	int cols;
+	int rows;
+	int num_thresholds;
+	double *thresholds;
+	int wide;                 /* counts are unsigned int, otherwise unsigned short */
+	int runs;                 /* runs counted */
+	void *counts;             /* [threshold][row][col], row 0 is the south row */
+} Exceedance;
+
+/* A flow between two pulses, see flowstate_LJC2.c */
+#define FLOWSTATE_MAGIC "MOLSTAT1"
+typedef struct FlowState {
+	int run;
+	unsigned int pulses;      /* pulses erupted */
+	int current_vent;
+	double volume;            /* volume to erupt */
+	double remaining;         /* not yet erupted */
+	double pulsevolume;
 	double residual;
-	double remaining_volume;
-	double total_volume;
-} FlowStats;
+	int num_vents;
+	Vent *vents;
+	unsigned int rand_seed;   /* rand_r() state of DISTRIBUTE */
+	int run_seed1, run_seed2; /* ranlib state at the start of the run */
+	int seed1, seed2;         /* ranlib state at the checkpoint */
+	unsigned int count;       /* cells with lava or a parent code */
+	unsigned long long *cell; /* row * cols + col, increasing */
+	double *thickness;
+	unsigned char *parentcode;
+	unsigned int *arrival;    /* arrival stamps of the cells, NULL if not saved */
+} FlowState;
+
+/* An ensemble between two runs, see ensstate_LJC2.c */
+#define ENSSTATE_MAGIC "MOLENSC1"
+#define ENSSTATE_STEP_ARCHIVES 2  /* archives[] after the flow archive and footprint index */
+typedef struct EnsembleState {
+	char *file;
+	int start;                /* first run of the ensemble */
+	int runs;
+	int next;                 /* run to go on with */
+	int attempt;              /* of run next, > 0 if it is run again (see SEED) */
+	unsigned char *done;      /* completed runs, bit run - start */
+	unsigned int rand_seed;   /* rand_r() state of DISTRIBUTE */
+	int seed1, seed2;         /* ranlib state */
+	int kept;                 /* ENSSTATE_* accumulators in the file */
+	long long stats_size;     /* bytes of STATS_FILE, < 0: not written yet */
+	long long impacts_size;   /* of the asset impacts file */
+	long long steps_size;     /* of the VOLUME_STEPS_FILE csv */
+	long long shard_size;     /* of the shard file */
+	int num_archives;         /* flow archive, footprint index, volume step archives */
+	FlowArchive **archives;   /* index of each (fp is not open), NULL if not written */
+	long long *archive_size;  /* bytes of each */
+	void *in;                 /* gzFile of the per-cell blocks, read by ENSSTATE_RESTORE */
+} EnsembleState;
+
+/* Flows at increasing erupted volumes, see volsteps_LJC2.c */
+typedef struct VolumeSteps {
+	int cols;
+	int rows;
+	int num_steps;
+	double *volumes;
+	int next;                 /* next step of the current run */
+	int first;                /* first step taken by the current run */
+	struct FlowFootprint **taken; /* flows of the steps first .. next-1 */
+	unsigned int *pulses;     /* and the pulses to each of them */
+	int *runs;                /* runs that reached each step */
+	int wide;                 /* counts are unsigned int, otherwise unsigned short */
+	void *counts;             /* [step][row][col], row 0 is the south row */
+	FILE *stats;              /* prefix.csv */
+	struct FlowArchive **archives; /* prefix_<volume>.mla, or NULL */
+} VolumeSteps;
+
+/* Counters of the convergence of the hit probabilities, see converge_LJC2.c */
+typedef struct Convergence {
+	int cols;
+	double epsilon;
+	double floor;
+	double delta;
+	int every;
+	int runs;                 /* runs added */
+	int runs_check;           /* runs at the last check */
+	int next_check;
+	unsigned int size;        /* of the histograms */
+	unsigned int *hist;       /* cells by hit count */
+	unsigned int *hist_check; /* at the last check */
+	unsigned char *touched;   /* bit of each cell hit since the last check */
+	unsigned int num_touched;
+	unsigned int max_touched;
+	unsigned long long *touched_cell; /* those cells, row * cols + col */
+	unsigned int *touched_hits;       /* and their hit counts at the last check */
+	double halfwidth;         /* of the last check, < 0: none yet */
+	double change;
+	unsigned int num_floor;   /* cells above the floor */
+	int converged;            /* at the last check */
+} Convergence;
+
+/* Designs of the vent and flow parameter draws of the runs, see sample_LJC2.c */
+enum sample_design {
+	SAMPLE_MC,                /* independent draws */
+	SAMPLE_STRATIFIED,        /* joint strata of the parameters, in random order */
+	SAMPLE_LHS,               /* Latin hypercube over the runs */
+	SAMPLE_SOBOL              /* Owen-scrambled Sobol points */
+};
+enum sample_param {           /* parameters of a design, in this order */
+	SAMPLE_VENT,              /* spatial density cell of the vent */
+	SAMPLE_VOLUME,
+	SAMPLE_RESIDUAL,
+	SAMPLE_PULSE,
+	SAMPLE_PARAMS
+};
+typedef struct Sampler {
+	int design;
+	int runs;                 /* points of the design (RUNS) */
+	int dims;                 /* parameters drawn, dimensions of the design */
+	int dim[SAMPLE_PARAMS];   /* dimension of each parameter, -1: not drawn */
+	unsigned long long seed;  /* of the permutations and scrambles */
+	int strata;               /* STRATIFIED: strata per dimension */
+	int cells;                /* STRATIFIED: joint strata, strata^dims */
+	int cycle;                /* STRATIFIED: cycle of runs (cells each) in order */
+	int *order;               /* STRATIFIED: joint strata in run order; LHS: [dim][run] strata */
+	double u[SAMPLE_PARAMS];  /* point of the run, uniform on [0,1) */
+	int have;                 /* u holds the design point of the run */
+	int num_cells;            /* spatial density cells */
+	double *cum;              /* cumulative spatial density, num_cells + 1 */
+} Sampler;
+
+/* Assets rasterised onto the grid, see assets_LJC2.c */
+typedef struct AssetIndex {
+	int cols;
+	int rows;
+	int num_assets;
+	char **names;
+	int *types;               /* 'p' point, 'l' line, 'P' polygon */
+	unsigned int num_pairs;   /* (cell, asset) pairs, sorted by cell */
+	unsigned int size;
+	unsigned long long *cell; /* row * cols + col */
+	int *asset;
+	unsigned int *cells;      /* cells covered by each asset */
+	unsigned int *cells_hit;  /* per run */
+	double *run_max;          /* per run: max thickness on the asset */
+	unsigned int *runs_hit;   /* over the ensemble */
+	double *sum_max;
+	double *max_max;
+	int runs;
+	FILE *out;                /* per-run impacts file */
+} AssetIndex;
+
+/* Shaded DEM for the quick-look images, see quicklook_LJC2.c */
+typedef struct QuickLook {
+	int cols;
+	int rows;
+	double x0, y0;            /* lower left corner of the grid */
+	double dx, dy;            /* cell size */
+	double min_elev, max_elev;
+	int scale;                /* cells per pixel, in each direction */
+	int width;                /* pixels */
+	int height;
+	int png;                  /* PNG, otherwise PPM */
+	int threads;
+	int run_threads;          /* per-run images: 1 on writer threads */
+	unsigned char *base;      /* RGB shaded relief, top row first */
+} QuickLook;
+
+/* Snapshot frames of a run: the cells changed since the previous
+   frame, see snapshot_LJC2.c */
+#define SNAPSHOT_MAGIC "MOLSNAP1"
+#define SNAPSHOT_END_MAGIC "MOLSNEND"
+
+typedef struct Snapshot {
+	FILE *fp;
+	int cols;
+	int rows;
+	double gridinfo[6];
+	char *prefix;
+	char *projection;         /* WKT of the DEM */
+	unsigned int every_pulses;
+	double every_volume;
+	int run;
+	unsigned int pulses;      /* pulses of this run so far */
+	unsigned int next_pulse;  /* pulse count of the next frame */
+	double next_volume;       /* erupted volume of the next frame */
+	unsigned int frame_pulse; /* pulse count of the last frame */
+	int rmin, rmax, cmin, cmax; /* box around the flow, see grow_box */
+	float *last;              /* thickness at the last frame, row * cols + col */
+	unsigned int frames;      /* frames written */
+	unsigned int size;        /* allocated index entries */
+	long long *offsets;       /* file offset of each frame */
+	size_t scratch_size;
+	unsigned char *scratch;   /* frame being packed */
+} Snapshot;
+
+/* First arrival of the lava at each cell, see arrival_LJC2.c */
+#define ARRIVAL_TILE 64           /* tiles of ARRIVAL_TILE x ARRIVAL_TILE cells */
+
+typedef struct Arrival {
+	int cols;
+	int rows;
+	int tiles_x;
+	int tiles_y;
+	int volume;               /* write erupted volumes, otherwise pulse numbers */
+	int ensemble;             /* keep the arrivals of all runs */
+	unsigned int pulse;       /* current pulse of the run, 1 for the first */
+	unsigned int **tiles;     /* stamps of the run, NULL where never reached */
+	unsigned short **ens_cell; /* per tile: cell in the tile of each arrival */
+	float **ens_value;        /* per tile: arrival, in the units written */
+	unsigned int *ens_count;
+	unsigned int *ens_size;
+	struct Inputs *In;        /* projection of the rasters */
+} Arrival;
+
+/* A loaded DEM and the state to run flows on it, see molasses_LJC2.c.
+   Callers of libmolasses see it as opaque (include/molasses.h). */
+struct MolassesContext {
+	Inputs *In;               /* the driver's inputs, or defaults for the library */
+	DataCell **grid;
+	double gridinfo[6];
+	ActiveList *active;       /* active list, allocated by the first flow */
+	unsigned int active_size;
+	unsigned int active_count;
+	Neighbor neighbors[8];
+	unsigned int rand_state;  /* rand_r() state of DISTRIBUTE, see FLOW_ERUPT */
+	double grid_residual;     /* residual written into the grid, < 0: none yet */
+	Lava_flow flow;           /* flow of the library calls */
+	int verbose;              /* progress on stdout every 100 pulses */
+	char error[256];
+	/* ensemble grids of the library flows, see molasses_ensemble */
+	CellStats *stats;         /* NULL: not kept */
+	double *thickness;        /* of the last flow, row-major */
+	struct FlowFootprint *last; /* cells of the last flow, to clear thickness */
+	unsigned int flows;       /* flows in the ensemble */
+};
+
+/* Scenarios of SCENARIO_FILE, see scenario_LJC2.c */
+#define SCENARIO_MAX_COLUMNS 64
+typedef struct ScenarioTable {
+	int num_columns;
+	char **columns;           /* config keywords, NAME and VENT */
+	int num_scenarios;
+	char ***values;           /* [scenario][column], "" keeps the config file's */
+} ScenarioTable;
+
+/* Footprint index: every run's inundated cells as a compressed bitmap,
+   written through a FlowArchive, see footindex_LJC2.c */
+#define FOOTINDEX_MAGIC "MOLFIDX1"
+#define FOOTINDEX_END_MAGIC "MOLFIEND"
+#define FOOTINDEX_ARRAY_MAX 4096  /* larger containers are stored as bitmaps */
+
+/* Inundated cells of a finished run, copied out of the grid
+   so the grid can be reset while the run is written */
+typedef struct FootprintCell {
+	int row;
+	int col;
+	double eff_elev;          /* elevation with lava */
+	double dem_elev;          /* elevation before the flow */
+	unsigned int arrival;     /* pulse the lava arrived, 0 if not recorded (see ARRIVAL) */
+} FootprintCell;
+
+typedef struct FlowFootprint {
+	int run;
+	double volume;            /* lava volume erupted */
+	double pulsevolume;
+	double residual;
+	int num_vents;
+	Vent *vents;
+	unsigned int count;       /* inundated cells, in row-major order */
+	FootprintCell *cells;
+} FlowFootprint;
+
+/* The runs of one shard of an ensemble (--shard K/N), written by the
+   driver and replayed by molasses-merge, see shard_LJC2.c */
+#define SHARD_MAGIC "MOLSHRD1"
+typedef struct Shard {
+	FILE *fp;
+	char *file;
+	int cols;
+	int rows;
+	double gridinfo[6];
+	long long seed;           /* SEED of the ensemble */
+	int start;                /* first run of the ensemble */
+	int runs;                 /* runs of the ensemble */
+	int index;                /* shard index, 1 to count */
+	int count;
+	int end;                  /* run the shard stopped at (TIME_BUDGET), from the end tag */
+	int slot;                 /* record read: run of the driver loop */
+	int attempt;              /* and its attempt */
+	Lava_flow flow;           /* vents and stats of the record read */
+	FlowFootprint *footprint; /* cells of the record read */
+} Shard;
+
+/* Bounded queue of footprints waiting for the output threads */
+typedef struct OutputQueue {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	pthread_cond_t idle;      /* a footprint was written, see OUTPUT_QUEUE_FLUSH */
+	FlowFootprint **slots;
+	int capacity;
+	int head;                 /* oldest waiting footprint */
+	int count;                /* footprints waiting */
+	int nthreads;
+	pthread_t *threads;
+	int closing;
+	Outputs *Out;
+	double *gridinfo;
+	unsigned long pushed;     /* statistics */
+	unsigned long written;
+	unsigned long long depth_sum;
+	int max_depth;
+	unsigned long stalls;
+	double stall_seconds;
+	int errors;
+} OutputQueue;
+
+/* A run set up, erupted and copied out of the grid, see RUN_MAKE */
+typedef struct RunResult {
+	int ret;                  /* of FLOW_ERUPT: < 0 the flow left the grid */
+	unsigned int pulses;      /* pulses erupted */
+	double remaining;         /* volume left, > 0 if abandoned at TIME_BUDGET */
+	unsigned int rand_state;  /* rand_r() state of DISTRIBUTE as the run started */
+	FlowFootprint *fp;        /* inundated cells, with their arrivals */
+	Lava_flow flow;           /* parameters, vents and stats of a run of RUN_POOL */
+} RunResult;
+
+/* Worker threads making the scenario x run pairs of a SCENARIO_FILE
+   ahead of the driver, see runpool_LJC2.c */
+typedef struct RunPool {
+	pthread_mutex_t lock;
+	pthread_cond_t made;      /* a pair was made */
+	pthread_cond_t taken;     /* a pair was handed to the driver */
+	pthread_mutex_t draws;    /* ranlib and the samplers are shared by the workers */
+	int nthreads;
+	pthread_t *threads;
+	struct RunWorker *workers;
+	int num_scenarios;
+	Inputs *In;               /* per scenario, as the driver set it up */
+	Lava_flow *flow;
+	int *arrival;             /* per scenario: 1 if the runs need arrival stamps */
+	int *first;               /* per scenario: pair of its first run */
+	int start;                /* run number of the first run of each scenario */
+	int pairs;                /* scenario x run pairs */
+	int window;               /* pairs made ahead of the driver at most */
+	int next;                 /* pair to make next */
+	int handed;               /* pairs handed to the driver */
+	RunResult **results;      /* per pair: its attempts, NULL until made */
+	int *attempts;            /* per pair: attempts made, 0 until made */
+	int error;                /* a worker could not make its pair */
+	int stopped;              /* past TIME_BUDGET: the pairs from next on are not made */
+	int closing;
+} RunPool;
+
+typedef struct RunWorker {
+	RunPool *pool;
+	struct MolassesContext *ctx; /* copy of the driver's context */
+	struct Arrival *stamps;   /* arrival stamps of its runs */
+} RunWorker;
+
+
 
 
 enum {
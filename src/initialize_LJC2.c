@@ -71,6 +71,927 @@ Vent *load_vent_data(FILE *in, int *num_vents) {
 	
 	return new_vent;
 }
+
+/* Assign the value of one configuration keyword (see INITIALIZE).
+   Scenario rows (see SCENARIO_APPLY) are assigned with it too.
+   RETURN: 0 assigned, -1 not a keyword, 1 error */
+int CONFIG_ASSIGN(
+Inputs *In, /* Structure of input parmaeters */
+Outputs *Out, /* Structure of model outputs */
+Lava_flow *active_flow, /* Active_flow structure */
+char *var, /* keyword */
+char *value) /* value, may be changed by strtok */
+{
+	char *ptr;
+	FILE* Opener;     /*Dummy File variable to test valid output file paths */
+	double dval;
+	int ret = 0;
+	int i;
+	
+	if (!strncmp(var, "DEM_FILE", strlen("DEM_FILE"))) 
+	{
+		In->dem_file = (char*) GC_MALLOC(sizeof(char) * (strlen(value)+1));
+		if (In->dem_file == NULL) 
+		{
+			fprintf(stderr, 
+			        "\n[INITIALIZE] Out of Memory assigning filenames!\n");
+			return 1;
+		}
+		strncpy(In->dem_file, value, strlen(value)+1);
+	}		
+	else if (!strncmp(var, "RESIDUAL", strlen("RESIDUAL"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (strlen(ptr) > 0) 
+		{
+			In->slope_map = (char *) GC_MALLOC(sizeof(char) * (strlen(ptr)+1));
+			if (In->dem_file == NULL) 
+			{
+				fprintf(stderr, 
+				        "\n[INITIALIZE] Out of Memory assigning filenames!\n");
+				return 1;
+			}
+			strncpy(In->slope_map, ptr, strlen(ptr)+1);
+			In->residual = -1;
+			Opener = fopen(In->slope_map, "r");
+			if (Opener == NULL) 
+			{
+				fprintf(stderr, 
+				        "\nERROR [INITIALIZE]: Failed to open input file at [%s]:[%s]!\n", 
+				        In->slope_map, strerror(errno));
+				return 1;
+			}
+			else (void) fclose(Opener);
+		}
+		else if (dval > 0) In->residual = dval;
+	}
+	else if (!strncmp(var, "ELEVATION_UNCERT", strlen("ELEVATION_UNCERT"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (strlen(ptr) > 0) 
+		{
+			In->uncert_map = (char *) GC_MALLOC(sizeof(char) * (strlen(ptr)+1));
+			if (In->uncert_map == NULL) 
+			{
+				fprintf(stderr, "\n[INITIALIZE] Out of Memory assigning filenames!\n");
+				return 1;
+			}
+			strncpy(In->uncert_map, ptr, strlen(ptr)+1);
+			In->elev_uncert = -1;
+			Opener = fopen(In->uncert_map, "r");
+			if (Opener == NULL) 
+			{
+				fprintf(stderr, 
+							"\nERROR [INITIALIZE]: Failed to open input file: [%s]:[%s]!\n",
+							In->uncert_map, strerror(errno));
+				return 1;
+			}
+			(void) fclose(Opener);
+		}
+		else if (dval > 0) 	In->elev_uncert = dval;
+	}
+	else if (!strncmp(var, "SPATIAL_DENSITY_FILE", strlen("SPATIAL_DENSITY_FILE"))) 
+	{
+		In->spd_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->spd_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for spatial density file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strncpy(In->spd_file, value, strlen(value)+1);
+		Opener = fopen(In->spd_file, "r");
+		if (Opener == NULL) 
+		{
+			fprintf(stderr, 
+						"\nERROR [INITIALIZE]: Failed to open input file: [%s]:[%s]!\n",
+						In->spd_file, strerror(errno));
+			return 1;
+		}
+		ret = load_spd_data(Opener, active_flow, &In->num_grids);
+		(void)fclose(Opener);
+		if (ret) 
+		{
+			fprintf (stderr, 
+						"\nERROR []INITIALIZE: error returned from [load_spd_file].\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "VENTS_FILE", strlen("VENTS_FILE"))) 
+	{
+		In->vents_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->vents_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for vents file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strncpy(In->vents_file, value, strlen(value)+1);
+		Opener = fopen(In->vents_file, "r");
+		if (Opener == NULL) 
+		{
+			fprintf(stderr, 
+						"\nERROR [INITIALIZE]: Failed to open vents file: [%s]:[%s]!\n",
+						In->vents_file, strerror(errno));
+			return 1;
+		}
+		active_flow->source = load_vent_data(Opener, &active_flow->num_vents);
+		if (active_flow->source == NULL) 
+		{
+			fprintf (stderr, 
+						"\nERROR []INITIALIZE: error returned from [load_vent_data].\n");
+			return 1;
+		} 
+		(void)fclose(Opener);
+		
+	}
+	else if (!strncmp(var, "SPD_GRID_SPACING", strlen("SPD_GRID_SPACING"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->spd_grid_spacing = dval;
+		else 
+		{
+			fprintf(stderr, 
+						"\nERROR [INITIALIZE]: unable to read in a value for the spatial density grid spacing!\n");
+			fprintf(stderr, 
+			        "Please set a value for SPD_GRID_SPACING in config file\n" );
+			return 1;
+		}
+	}
+	
+	else if (!strncmp(var, "ASCII_FLOW_MAP", strlen("ASCII_FLOW_MAP"))) 
+	{
+		/* Add extra room for a nujmber at end of file name */
+		Out->ascii_flow_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));
+		if (Out->ascii_flow_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for ascii_flow file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strncpy(Out->ascii_flow_file, value, strlen(value)+1);
+	}
+	else if (!strncmp(var, "ASCII_HIT_MAP", strlen("ASCII_HIT_MAP"))) 
+	{
+		Out->ascii_hits_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->ascii_hits_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for ascii_hits file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strncpy(Out->ascii_hits_file, value, strlen(value)+1);
+	}
+	else if (!strncmp(var, "RASTER_FLOW_MAP", strlen("RASTER_FLOW_MAP"))) 
+	{
+		Out->raster_flow_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->raster_flow_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for raster flow file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strncpy(Out->raster_flow_file, value, strlen(value)+1);
+	}
+			else if (!strncmp(var, "RASTER_HIT_MAP", strlen("RASTER_HIT_MAP"))) 
+	{
+		Out->raster_hits_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->raster_hits_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for raster hits file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strncpy(Out->raster_hits_file, value, strlen(value)+1);
+	}
+	else if (!strncmp(var, "RASTER_POST_DEM", strlen("RASTER_POST_DEM"))) 
+	{
+		Out->raster_post_dem_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->raster_post_dem_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for post raster dem file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strncpy(Out->raster_post_dem_file, value, strlen(value)+1);
+	}
+	/* CELL_STATS_PRECISION must be tested before CELL_STATS */
+	else if (!strncmp(var, "CELL_STATS_PRECISION", strlen("CELL_STATS_PRECISION"))) 
+	{
+		/* mean:Float64,std:Float32,max:None */
+		for (ptr = strtok(value, ","); ptr != NULL; ptr = strtok(NULL, ",")) 
+		{
+			if (!strncmp(ptr, "mean:", 5)) i = 0;
+			else if (!strncmp(ptr, "std:", 4)) i = 1;
+			else if (!strncmp(ptr, "max:", 4)) i = 2;
+			else i = -1;
+			if (i >= 0 && !strcmp(strchr(ptr, ':') + 1, "Float64")) Out->cell_stats_type[i] = GDT_Float64;
+			else if (i >= 0 && !strcmp(strchr(ptr, ':') + 1, "Float32")) Out->cell_stats_type[i] = GDT_Float32;
+			else if (i >= 0 && !strcmp(strchr(ptr, ':') + 1, "None")) Out->cell_stats_type[i] = GDT_Unknown;
+			else 
+			{
+				fprintf(stderr, 
+				        "\n[INITIALIZE]: CELL_STATS_PRECISION entries are mean:, std: or max: followed by Float64, Float32 or None [%s]\n", ptr);
+				return 1;
+			}
+		}
+	}
+	else if (!strncmp(var, "CELL_STATS", strlen("CELL_STATS"))) 
+	{
+		Out->cell_stats_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->cell_stats_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for cell stats file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->cell_stats_file, value);
+	}
+	else if (!strncmp(var, "ASSETS_FILE", strlen("ASSETS_FILE"))) 
+	{
+		In->assets_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->assets_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for assets file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(In->assets_file, value);
+	}
+	else if (!strncmp(var, "ASSET_IMPACTS", strlen("ASSET_IMPACTS"))) 
+	{
+		Out->asset_impacts_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->asset_impacts_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for asset impacts file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->asset_impacts_file, value);
+	}
+	else if (!strncmp(var, "THICKNESS_THRESHOLDS", strlen("THICKNESS_THRESHOLDS"))) 
+	{
+		/* comma separated list, e.g. 0.5,1,2,5 */
+		Out->num_thresholds = 1;
+		for (ptr = value; *ptr; ptr++) if (*ptr == ',') Out->num_thresholds++;
+		Out->thresholds = (double *)GC_MALLOC_ATOMIC(Out->num_thresholds * sizeof(double));
+		if (Out->thresholds == NULL) 
+		{
+			fprintf(stderr, "\n[INITIALIZE] Out of Memory reading THICKNESS_THRESHOLDS!\n");
+			return 1;
+		}
+		for (i = 0, ptr = strtok(value, ","); ptr != NULL; ptr = strtok(NULL, ","), i++) 
+		{
+			Out->thresholds[i] = strtod(ptr, NULL);
+			if (Out->thresholds[i] < 0 || (i && Out->thresholds[i] <= Out->thresholds[i-1])) 
+			{
+				fprintf(stderr, 
+				        "\n[INITIALIZE]: THICKNESS_THRESHOLDS must be increasing thicknesses >= 0\n");
+				return 1;
+			}
+		}
+		Out->num_thresholds = i;
+	}
+	else if (!strncmp(var, "EXCEEDANCE_MAP", strlen("EXCEEDANCE_MAP"))) 
+	{
+		Out->exceedance_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->exceedance_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for exceedance map file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->exceedance_file, value);
+	}
+	else if (!strncmp(var, "STATS_FILE", strlen("STATS_FILE"))) 
+	{
+		Out->stats_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->stats_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for stats file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->stats_file, value);
+	}
+	else if (!strncmp(var, "BINARY_FLOW_MAP", strlen("BINARY_FLOW_MAP"))) 
+	{
+		Out->binary_flow_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->binary_flow_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for binary flow file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->binary_flow_file, value);
+	}
+	else if (!strncmp(var, "FOOTPRINT_INDEX", strlen("FOOTPRINT_INDEX"))) 
+	{
+		Out->footprint_index_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->footprint_index_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for footprint index file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->footprint_index_file, value);
+	}
+	else if (!strncmp(var, "FLOW_ARCHIVE", strlen("FLOW_ARCHIVE"))) 
+	{
+		Out->flow_archive_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->flow_archive_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for flow archive file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->flow_archive_file, value);
+	}
+	else if (!strncmp(var, "FLOW_OUTLINE", strlen("FLOW_OUTLINE"))) 
+	{
+		Out->flow_outline_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->flow_outline_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for flow outline file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->flow_outline_file, value);
+	}
+	else if (!strncmp(var, "HIT_OUTLINE_LEVELS", strlen("HIT_OUTLINE_LEVELS"))) 
+	{
+		/* comma separated list of probabilities, e.g. 0,0.1,0.5 */
+		Out->num_hit_levels = 1;
+		for (ptr = value; *ptr; ptr++) if (*ptr == ',') Out->num_hit_levels++;
+		Out->hit_levels = (double *)GC_MALLOC_ATOMIC(Out->num_hit_levels * sizeof(double));
+		if (Out->hit_levels == NULL) 
+		{
+			fprintf(stderr, "\n[INITIALIZE] Out of Memory reading HIT_OUTLINE_LEVELS!\n");
+			return 1;
+		}
+		for (i = 0, ptr = strtok(value, ","); ptr != NULL; ptr = strtok(NULL, ","), i++) 
+		{
+			Out->hit_levels[i] = strtod(ptr, NULL);
+			if (Out->hit_levels[i] < 0 || Out->hit_levels[i] >= 1 ||
+			    (i && Out->hit_levels[i] <= Out->hit_levels[i-1])) 
+			{
+				fprintf(stderr, 
+				        "\n[INITIALIZE]: HIT_OUTLINE_LEVELS must be increasing probabilities, 0 <= p < 1\n");
+				return 1;
+			}
+		}
+		Out->num_hit_levels = i;
+	}
+	else if (!strncmp(var, "HIT_OUTLINE", strlen("HIT_OUTLINE"))) 
+	{
+		Out->hit_outline_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->hit_outline_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for hit outline file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->hit_outline_file, value);
+	}
+	else if (!strncmp(var, "OUTLINE_FORMAT", strlen("OUTLINE_FORMAT"))) 
+	{
+		Out->outline_format = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->outline_format == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for outline format:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->outline_format, value);
+	}
+	else if (!strncmp(var, "QUICKLOOK_FLOW", strlen("QUICKLOOK_FLOW"))) 
+	{
+		Out->quicklook_flow_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->quicklook_flow_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for quick-look flow images:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->quicklook_flow_file, value);
+	}
+	else if (!strncmp(var, "QUICKLOOK_HITS", strlen("QUICKLOOK_HITS"))) 
+	{
+		Out->quicklook_hits_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->quicklook_hits_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for quick-look hits image:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->quicklook_hits_file, value);
+	}
+	else if (!strncmp(var, "QUICKLOOK_FORMAT", strlen("QUICKLOOK_FORMAT"))) 
+	{
+		for (ptr = value; *ptr; ptr++) *ptr = toupper(*ptr);
+		if (!strcmp(value, "PNG")) Out->quicklook_format = "PNG";
+		else if (!strcmp(value, "PPM")) Out->quicklook_format = "PPM";
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: QUICKLOOK_FORMAT must be PNG or PPM, not %s\n", value);
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "QUICKLOOK_WIDTH", strlen("QUICKLOOK_WIDTH"))) 
+	{
+		Out->quicklook_width = (int)strtol(value, &ptr, 10);
+		if (Out->quicklook_width < 0) Out->quicklook_width = 0;
+	}
+	else if (!strncmp(var, "QUICKLOOK_THREADS", strlen("QUICKLOOK_THREADS"))) 
+	{
+		Out->quicklook_threads = (int)strtol(value, &ptr, 10);
+		if (Out->quicklook_threads < 0) Out->quicklook_threads = 0;
+	}
+	else if (!strncmp(var, "ARRIVAL_MAP", strlen("ARRIVAL_MAP"))) 
+	{
+		Out->arrival_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->arrival_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for arrival maps:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->arrival_file, value);
+	}
+	else if (!strncmp(var, "ARRIVAL_ENSEMBLE", strlen("ARRIVAL_ENSEMBLE"))) 
+	{
+		Out->arrival_ensemble_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->arrival_ensemble_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for ensemble arrival maps:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->arrival_ensemble_file, value);
+	}
+	else if (!strncmp(var, "ARRIVAL_UNITS", strlen("ARRIVAL_UNITS"))) 
+	{
+		for (ptr = value; *ptr; ptr++) *ptr = toupper(*ptr);
+		if (!strcmp(value, "PULSE")) Out->arrival_units = "PULSE";
+		else if (!strcmp(value, "VOLUME")) Out->arrival_units = "VOLUME";
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: ARRIVAL_UNITS must be PULSE or VOLUME, not %s\n", value);
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "SNAPSHOT_FILE", strlen("SNAPSHOT_FILE"))) 
+	{
+		Out->snapshot_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->snapshot_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for snapshot files:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->snapshot_file, value);
+	}
+	else if (!strncmp(var, "SNAPSHOT_PULSES", strlen("SNAPSHOT_PULSES"))) 
+	{
+		Out->snapshot_pulses = (unsigned int)strtoul(value, &ptr, 10);
+	}
+	else if (!strncmp(var, "SNAPSHOT_VOLUME", strlen("SNAPSHOT_VOLUME"))) 
+	{
+		Out->snapshot_volume = strtod(value, &ptr);
+		if (Out->snapshot_volume < 0) Out->snapshot_volume = 0;
+	}
+	else if (!strncmp(var, "VOLUME_STEPS_FILE", strlen("VOLUME_STEPS_FILE"))) 
+	{
+		Out->volume_steps_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->volume_steps_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for volume step files:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->volume_steps_file, value);
+	}
+	else if (!strncmp(var, "VOLUME_STEPS_ARCHIVE", strlen("VOLUME_STEPS_ARCHIVE"))) 
+	{
+		Out->volume_steps_archive = (toupper(value[0]) == 'Y');
+	}
+	else if (!strncmp(var, "VOLUME_STEPS", strlen("VOLUME_STEPS"))) 
+	{
+		/* comma separated list of erupted volumes, e.g. 1e6,5e6,1e7 */
+		Out->num_volume_steps = 1;
+		for (ptr = value; *ptr; ptr++) if (*ptr == ',') Out->num_volume_steps++;
+		Out->step_volumes = (double *)GC_MALLOC_ATOMIC(Out->num_volume_steps * sizeof(double));
+		if (Out->step_volumes == NULL) 
+		{
+			fprintf(stderr, "\n[INITIALIZE] Out of Memory reading VOLUME_STEPS!\n");
+			return 1;
+		}
+		for (i = 0, ptr = strtok(value, ","); ptr != NULL; ptr = strtok(NULL, ","), i++) 
+		{
+			Out->step_volumes[i] = strtod(ptr, NULL);
+			if (Out->step_volumes[i] <= 0 || (i && Out->step_volumes[i] <= Out->step_volumes[i-1])) 
+			{
+				fprintf(stderr, 
+				        "\n[INITIALIZE]: VOLUME_STEPS must be increasing volumes > 0\n");
+				return 1;
+			}
+		}
+		Out->num_volume_steps = i;
+	}
+	else if (!strncmp(var, "RASTER_COMPRESSION", strlen("RASTER_COMPRESSION"))) 
+	{
+		for (ptr = value; *ptr; ptr++) *ptr = toupper(*ptr);
+		if (strcmp(value, "NONE") && strcmp(value, "DEFLATE") && 
+		    strcmp(value, "ZSTD") && strcmp(value, "LZW")) 
+		{
+			fprintf(stderr, 
+						"\n[INITIALIZE]: RASTER_COMPRESSION must be NONE, DEFLATE, ZSTD or LZW\n");
+			return 1;
+		}
+		Out->raster_compression = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (Out->raster_compression == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for raster compression:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(Out->raster_compression, value);
+	}
+	else if (!strncmp(var, "RASTER_HIT_TYPE", strlen("RASTER_HIT_TYPE"))) 
+	{
+		if (!strcmp(value, "UInt16")) Out->raster_hits_type = GDT_UInt16;
+		else if (!strcmp(value, "UInt32")) Out->raster_hits_type = GDT_UInt32;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: RASTER_HIT_TYPE must be UInt16 or UInt32\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "OUTPUT_THREADS", strlen("OUTPUT_THREADS"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (ptr != value && dval >= 0) Out->output_threads = (int)dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: Unable to read value for OUTPUT_THREADS\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "OUTPUT_QUEUE_SIZE", strlen("OUTPUT_QUEUE_SIZE"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval >= 1) Out->output_queue_size = (int)dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: Unable to read value for OUTPUT_QUEUE_SIZE\n");
+			return 1;
+		}
+	}
+	
+	/*VENT PARAMETERS*/
+	else if (!strncmp(var, "MIN_PULSE_VOLUME", strlen("MIN_PULSE_VOLUME"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->min_pulse_volume = dval;
+		else 
+		{
+			fprintf(stderr, 
+						"\n[INITIALIZE]: Unable to read value for MIN_PULSE_VOLUME\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "MAX_PULSE_VOLUME", strlen("MAX_PULSE_VOLUME"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->max_pulse_volume = dval;
+		else 
+		{
+			fprintf(stderr, 
+						"\n[INITIALIZE]: Unable to read value for MAX_PULSE_VOLUME\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "MIN_TOTAL_VOLUME", strlen("MIN_TOTAL_VOLUME"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->min_total_volume = dval;
+		else 
+		{
+			fprintf(stderr, 
+						"\n[INITIALIZE]: Unable to read value for MIN_TOTAL_VOLUME\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "MAX_TOTAL_VOLUME", strlen("MAX_TOTAL_VOLUME"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->max_total_volume = dval;
+		else {
+			fprintf(stderr, 
+						"\n[INITIALIZE]: Unable to read value for MAX_TOTAL_VOLUME\n");
+			return 1;
+		}
+	}		
+	else if (!strncmp(var, "LOG_MEAN_TOTAL_VOLUME", strlen("LOG_MEAN_TOTAL_VOLUME"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->log_mean_volume = dval;
+		else 
+		{
+			fprintf(stderr, 
+						"\n[INITIALIZE]: Unable to read value for LOG_MEAN_TOTAL_VOLUME\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "LOG_STD_DEV_TOTAL_VOLUME", strlen("LOG_STD_DEV_TOTAL_VOLUME"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->log_std_volume = dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: Unable to read value for LOG_STD_DEV_TOTAL_VOLUME\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "MIN_RESIDUAL", strlen("MIN_RESIDUAL"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->min_residual = dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: Unable to read value for MIN_RESIDUAL\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "MAX_RESIDUAL", strlen("MAX_RESIDUAL"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->max_residual = dval;
+		else 
+		{
+			fprintf(stderr, 
+						"\n[INITIALIZE]: Unable to read value for MAX_RESIDUAL\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "LOG_MEAN_RESIDUAL", strlen("LOG_MEAN_RESIDUAL"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->log_mean_residual = dval;
+		else 
+		{
+			fprintf(stderr, 
+						"\n[INITIALIZE]: Unable to read value for LOG_MEAN_RESIDUAL\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "LOG_STD_DEV_RESIDUAL", strlen("LOG_STD_DEV_RESIDUAL"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->log_std_residual = dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: Unable to read value for LOG_STD_DEV_RESIDUAL\n");
+			return 1;
+		}
+	}
+	
+	else if (!strncmp(var, "FLOWS", strlen("FLOWS"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->flows = (int)dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: Unable to read value for number of lava flows\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "RUNS", strlen("RUNS"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (dval > 0) In->runs = (int)dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: Unable to read value for RUNS\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "CREATE_FLOW_FIELD", strlen("CREATE_FLOW_FIELD"))) 
+	{
+		In->flow_field = 1;
+	}
+	else if (!strncmp(var, "PARENTS", strlen("PARENTS"))) 
+	{
+		In->parents = 1;
+	}
+	else if (!strncmp(var, "FLOW_CHECKPOINT_PULSES", strlen("FLOW_CHECKPOINT_PULSES"))) 
+	{
+		In->flow_checkpoint_pulses = (unsigned int)strtoul(value, &ptr, 10);
+	}
+	else if (!strncmp(var, "FLOW_CHECKPOINT_SECONDS", strlen("FLOW_CHECKPOINT_SECONDS"))) 
+	{
+		In->flow_checkpoint_seconds = (int)strtol(value, &ptr, 10);
+		if (In->flow_checkpoint_seconds < 0) In->flow_checkpoint_seconds = 0;
+	}
+	else if (!strncmp(var, "FLOW_CHECKPOINT", strlen("FLOW_CHECKPOINT"))) 
+	{
+		In->flow_checkpoint_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->flow_checkpoint_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for flow checkpoints:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(In->flow_checkpoint_file, value);
+	}
+	else if (!strncmp(var, "ENSEMBLE_CHECKPOINT_RUNS", strlen("ENSEMBLE_CHECKPOINT_RUNS"))) 
+	{
+		In->ensemble_checkpoint_runs = (int)strtol(value, &ptr, 10);
+		if (In->ensemble_checkpoint_runs < 0) In->ensemble_checkpoint_runs = 0;
+	}
+	else if (!strncmp(var, "ENSEMBLE_CHECKPOINT_SECONDS", strlen("ENSEMBLE_CHECKPOINT_SECONDS"))) 
+	{
+		In->ensemble_checkpoint_seconds = (int)strtol(value, &ptr, 10);
+		if (In->ensemble_checkpoint_seconds < 0) In->ensemble_checkpoint_seconds = 0;
+	}
+	else if (!strncmp(var, "ENSEMBLE_CHECKPOINT", strlen("ENSEMBLE_CHECKPOINT"))) 
+	{
+		In->ensemble_checkpoint_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->ensemble_checkpoint_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for ensemble checkpoint:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(In->ensemble_checkpoint_file, value);
+	}
+	else if (!strncmp(var, "RESUME_ENSEMBLE", strlen("RESUME_ENSEMBLE"))) 
+	{
+		In->resume_ensemble_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->resume_ensemble_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for resume file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(In->resume_ensemble_file, value);
+	}
+	else if (!strncmp(var, "CONVERGE_EPSILON", strlen("CONVERGE_EPSILON"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (ptr == value || dval < 0 || dval >= 1) {
+			fprintf(stderr, "CONVERGE_EPSILON must be >= 0 and < 1 [%s]\n", value);
+			return 1;
+		}
+		In->converge_epsilon = dval;
+	}
+	else if (!strncmp(var, "CONVERGE_FLOOR", strlen("CONVERGE_FLOOR"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (ptr == value || dval < 0 || dval > 1) {
+			fprintf(stderr, "CONVERGE_FLOOR must be from 0 to 1 [%s]\n", value);
+			return 1;
+		}
+		In->converge_floor = dval;
+	}
+	else if (!strncmp(var, "CONVERGE_DELTA", strlen("CONVERGE_DELTA"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (ptr == value || dval < 0 || dval >= 1) {
+			fprintf(stderr, "CONVERGE_DELTA must be >= 0 and < 1 [%s]\n", value);
+			return 1;
+		}
+		In->converge_delta = dval;
+	}
+	else if (!strncmp(var, "TIME_BUDGET_ABANDON", strlen("TIME_BUDGET_ABANDON"))) 
+	{
+		In->time_budget_abandon = (toupper(value[0]) == 'Y');
+	}
+	else if (!strncmp(var, "TIME_BUDGET", strlen("TIME_BUDGET"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (ptr == value || dval < 0) {
+			fprintf(stderr, "TIME_BUDGET must be >= 0 seconds [%s]\n", value);
+			return 1;
+		}
+		In->time_budget = dval;
+	}
+	else if (!strncmp(var, "CONVERGE_EVERY", strlen("CONVERGE_EVERY"))) 
+	{
+		In->converge_every = (int)strtol(value, &ptr, 10);
+		if (In->converge_every < 1) {
+			fprintf(stderr, "CONVERGE_EVERY must be at least 1 [%s]\n", value);
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "SAMPLING", strlen("SAMPLING"))) 
+	{
+		for (ptr = value; *ptr; ptr++) *ptr = toupper(*ptr);
+		if (!strcmp(value, "MC")) In->sampling = SAMPLE_MC;
+		else if (!strcmp(value, "STRATIFIED")) In->sampling = SAMPLE_STRATIFIED;
+		else if (!strcmp(value, "LHS")) In->sampling = SAMPLE_LHS;
+		else if (!strcmp(value, "SOBOL")) In->sampling = SAMPLE_SOBOL;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: SAMPLING must be MC, STRATIFIED, LHS or SOBOL, not %s\n", value);
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "SHARD_FILE", strlen("SHARD_FILE"))) 
+	{
+		In->shard_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->shard_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for shard file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(In->shard_file, value);
+	}
+	else if (!strncmp(var, "RESUME_FLOW", strlen("RESUME_FLOW"))) 
+	{
+		In->resume_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->resume_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for resume file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(In->resume_file, value);
+	}
+	else if (!strncmp(var, "RESUME_VOLUME", strlen("RESUME_VOLUME"))) 
+	{
+		In->resume_volume = strtod(value, &ptr);
+		if (In->resume_volume < 0) 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: RESUME_VOLUME must be >= 0\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "SCENARIO_FILE", strlen("SCENARIO_FILE"))) 
+	{
+		In->scenario_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
+		if (In->scenario_file == NULL) 
+		{
+			fprintf(stderr, 
+						"Cannot malloc memory for scenario file:[%s]\n", 
+						strerror(errno));
+			return 1;
+		}
+		strcpy(In->scenario_file, value);
+	}
+	else if (!strncmp(var, "SCENARIO_THREADS", strlen("SCENARIO_THREADS"))) 
+	{
+		dval = strtod(value, &ptr);
+		if (ptr != value && dval >= 1) In->scenario_threads = (int)dval;
+		else 
+		{
+			fprintf(stderr, "\n[INITIALIZE]: SCENARIO_THREADS must be 1 or more\n");
+			return 1;
+		}
+	}
+	else if (!strncmp(var, "SEED", strlen("SEED"))) 
+	{
+		In->seed = strtoll(value, &ptr, 10);
+		if (ptr == value || In->seed < 0) {
+			fprintf(stderr, "SEED must be a whole number >= 0 [%s]\n", value);
+			return 1;
+		}
+	}
+	else return -1;
+	return 0;
+}
+
 /*Module INITIALIZE
 	Accepts a configuration file and returns model variables. 
 	(format: keyword = value):
@@ -123,11 +1044,9 @@ Lava_flow *active_flow) /* Active_flow structure */
 	char line[256];             /* (type =string) Line from file */
 	char var[64];               /* (type=string) Parameter Name  in each line*/
 	char value[256];            /* (type=string) Parameter Value in each line*/
-	char *ptr;
 	FILE* ConfigFile;
-	FILE* Opener;     /*Dummy File variable to test valid output file paths */
 	/* enum ASCII_types ascii_file; */
-	double dval;
+	static double hit_any = 0.0; /* default HIT_OUTLINE_LEVELS */
 	int ret = 0;
 	int i;
 	
@@ -163,16 +1082,97 @@ Lava_flow *active_flow) /* Active_flow structure */
 	In->runs = 1;
 	In->flows = 1;
 	In->flow_field = 0;
+	In->dem_projection = NULL;
+	In->assets_file = NULL;
+	In->arrival = NULL;
+	In->volume_steps = NULL;
+	In->scenario_file = NULL;
+	In->scenario_threads = 1;
+	In->seed = -1;
+	In->flow_checkpoint_file = NULL;
+	In->flow_checkpoint_pulses = 0;
+	In->flow_checkpoint_seconds = 600;
+	In->resume_file = NULL;
+	In->resume_volume = -1;
+	In->resume = NULL;
+	In->ensemble_checkpoint_file = NULL;
+	In->ensemble_checkpoint_runs = 0;
+	In->ensemble_checkpoint_seconds = 600;
+	In->resume_ensemble_file = NULL;
+	In->resume_ensemble = NULL;
+	In->shard_index = 0;
+	In->shard_count = 0;
+	In->shard_file = "shard";
+	In->converge_epsilon = 0;
+	In->converge_floor = 0.05;
+	In->converge_delta = 0;
+	In->converge_every = 100;
+	In->time_budget = 0;
+	In->time_budget_abandon = 0;
+	In->deadline = 0;
+	In->sampling = SAMPLE_MC;
+	In->sample = NULL;
 	
 	
 	/* Initialize output parmaeters */
 	Out->ascii_flow_file = "";
+	Out->binary_flow_file = "";
 	Out->ascii_hits_file = "";
 	Out->raster_hits_file = "";
 	Out->raster_flow_file = "";
 	Out->raster_post_dem_file = "";
 	Out->raster_pre_dem_file = "";
 	Out->stats_file = "";
+	Out->stats = NULL;
+	Out->cell_stats_file = "";
+	Out->cell_stats_type[0] = GDT_Float64; /* mean */
+	Out->cell_stats_type[1] = GDT_Float64; /* M2, for the standard deviation */
+	Out->cell_stats_type[2] = GDT_Float32; /* max */
+	Out->cell_stats = NULL;
+	Out->exceedance_file = "";
+	Out->num_thresholds = 0;
+	Out->thresholds = NULL;
+	Out->exceedance = NULL;
+	Out->asset_impacts_file = "asset_impacts";
+	Out->assets = NULL;
+	Out->flow_archive_file = "";
+	Out->flow_archive = NULL;
+	Out->footprint_index_file = "";
+	Out->footprint_index = NULL;
+	Out->flow_outline_file = "";
+	Out->hit_outline_file = "";
+	Out->num_hit_levels = 1;
+	Out->hit_levels = &hit_any;   /* outline of the cells ever hit */
+	Out->outline_format = "GeoJSON";
+	Out->outline_ext = ".geojson";
+	Out->outline_wkt = "";
+	Out->outline_crs = "";
+	Out->quicklook_flow_file = "";
+	Out->quicklook_hits_file = "";
+	Out->quicklook_format = "PNG";
+	Out->quicklook_width = 0;
+	Out->quicklook_threads = 0;
+	Out->quicklook = NULL;
+	Out->snapshot_file = "";
+	Out->snapshot_pulses = 100;
+	Out->snapshot_volume = 0;
+	Out->snapshot = NULL;
+	Out->arrival_file = "";
+	Out->arrival_ensemble_file = "";
+	Out->arrival_units = "PULSE";
+	Out->arrival = NULL;
+	Out->volume_steps_file = "";
+	Out->num_volume_steps = 0;
+	Out->step_volumes = NULL;
+	Out->volume_steps_archive = 0;
+	Out->volume_steps = NULL;
+	Out->shard = NULL;
+	Out->converge = NULL;
+	Out->ensemble_runs = 0;
+	Out->raster_compression = "DEFLATE";
+	Out->raster_hits_type = GDT_UInt32;
+	Out->output_threads = 0;
+	Out->output_queue_size = 4;
 	
 	fprintf(stdout, "Reading in Parameters...\n");
 	ConfigFile = fopen(In->config_file, "r"); /*open configuration file*/
@@ -196,338 +1196,9 @@ Lava_flow *active_flow) /* Active_flow structure */
 		fprintf(stdout, "%25s = %-25s ",var, value); /*print incoming parameter value*/
 		fflush(stdout);
 		
-		if (!strncmp(var, "DEM_FILE", strlen("DEM_FILE"))) 
-		{
-			In->dem_file = (char*) GC_MALLOC(sizeof(char) * (strlen(value)+1));
-			if (In->dem_file == NULL) 
-			{
-				fprintf(stderr, 
-				        "\n[INITIALIZE] Out of Memory assigning filenames!\n");
-				return 1;
-			}
-			strncpy(In->dem_file, value, strlen(value)+1);
-		}		
-		else if (!strncmp(var, "RESIDUAL", strlen("RESIDUAL"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (strlen(ptr) > 0) 
-			{
-				In->slope_map = (char *) GC_MALLOC(sizeof(char) * (strlen(ptr)+1));
-				if (In->dem_file == NULL) 
-				{
-					fprintf(stderr, 
-					        "\n[INITIALIZE] Out of Memory assigning filenames!\n");
-					return 1;
-				}
-				strncpy(In->slope_map, ptr, strlen(ptr)+1);
-				In->residual = -1;
-				Opener = fopen(In->slope_map, "r");
-				if (Opener == NULL) 
-				{
-					fprintf(stderr, 
-					        "\nERROR [INITIALIZE]: Failed to open input file at [%s]:[%s]!\n", 
-					        In->slope_map, strerror(errno));
-					return 1;
-				}
-				else (void) fclose(Opener);
-			}
-			else if (dval > 0) In->residual = dval;
-		}
-		else if (!strncmp(var, "ELEVATION_UNCERT", strlen("ELEVATION_UNCERT"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (strlen(ptr) > 0) 
-			{
-				In->uncert_map = (char *) GC_MALLOC(sizeof(char) * (strlen(ptr)+1));
-				if (In->uncert_map == NULL) 
-				{
-					fprintf(stderr, "\n[INITIALIZE] Out of Memory assigning filenames!\n");
-					return 1;
-				}
-				strncpy(In->uncert_map, ptr, strlen(ptr)+1);
-				In->elev_uncert = -1;
-				Opener = fopen(In->uncert_map, "r");
-				if (Opener == NULL) 
-				{
-					fprintf(stderr, 
-								"\nERROR [INITIALIZE]: Failed to open input file: [%s]:[%s]!\n",
-								In->uncert_map, strerror(errno));
-					return 1;
-				}
-				(void) fclose(Opener);
-			}
-			else if (dval > 0) 	In->elev_uncert = dval;
-		}
-		else if (!strncmp(var, "SPATIAL_DENSITY_FILE", strlen("SPATIAL_DENSITY_FILE"))) 
-		{
-			In->spd_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
-			if (In->spd_file == NULL) 
-			{
-				fprintf(stderr, 
-							"Cannot malloc memory for spatial density file:[%s]\n", 
-							strerror(errno));
-				return 1;
-			}
-			strncpy(In->spd_file, value, strlen(value)+1);
-			Opener = fopen(In->spd_file, "r");
-			if (Opener == NULL) 
-			{
-				fprintf(stderr, 
-							"\nERROR [INITIALIZE]: Failed to open input file: [%s]:[%s]!\n",
-							In->spd_file, strerror(errno));
-				return 1;
-			}
-			ret = load_spd_data(Opener, active_flow, &In->num_grids);
-			(void)fclose(Opener);
-			if (ret) 
-			{
-				fprintf (stderr, 
-							"\nERROR []INITIALIZE: error returned from [load_spd_file].\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "VENTS_FILE", strlen("VENTS_FILE"))) 
-		{
-			In->vents_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
-			if (In->vents_file == NULL) 
-			{
-				fprintf(stderr, 
-							"Cannot malloc memory for vents file:[%s]\n", 
-							strerror(errno));
-				return 1;
-			}
-			strncpy(In->vents_file, value, strlen(value)+1);
-			Opener = fopen(In->vents_file, "r");
-			if (Opener == NULL) 
-			{
-				fprintf(stderr, 
-							"\nERROR [INITIALIZE]: Failed to open vents file: [%s]:[%s]!\n",
-							In->vents_file, strerror(errno));
-				return 1;
-			}
-			active_flow->source = load_vent_data(Opener, &active_flow->num_vents);
-			if (active_flow->source == NULL) 
-			{
-				fprintf (stderr, 
-							"\nERROR []INITIALIZE: error returned from [load_vent_data].\n");
-				return 1;
-			} 
-			(void)fclose(Opener);
-			
-		}
-		else if (!strncmp(var, "SPD_GRID_SPACING", strlen("SPD_GRID_SPACING"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->spd_grid_spacing = dval;
-			else 
-			{
-				fprintf(stderr, 
-							"\nERROR [INITIALIZE]: unable to read in a value for the spatial density grid spacing!\n");
-				fprintf(stderr, 
-				        "Please set a value for SPD_GRID_SPACING in config file\n" );
-				return 1;
-			}
-		}
-		
-		else if (!strncmp(var, "ASCII_FLOW_MAP", strlen("ASCII_FLOW_MAP"))) 
-		{
-			/* Add extra room for a nujmber at end of file name */
-			Out->ascii_flow_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));
-			if (Out->ascii_flow_file == NULL) 
-			{
-				fprintf(stderr, 
-							"Cannot malloc memory for ascii_flow file:[%s]\n", 
-							strerror(errno));
-				return 1;
-			}
-			strncpy(Out->ascii_flow_file, value, strlen(value)+1);
-		}
-		else if (!strncmp(var, "ASCII_HIT_MAP", strlen("ASCII_HIT_MAP"))) 
-		{
-			Out->ascii_hits_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
-			if (Out->ascii_hits_file == NULL) 
-			{
-				fprintf(stderr, 
-							"Cannot malloc memory for ascii_hits file:[%s]\n", 
-							strerror(errno));
-				return 1;
-			}
-			strncpy(Out->ascii_hits_file, value, strlen(value)+1);
-		}
-		else if (!strncmp(var, "RASTER_FLOW_MAP", strlen("RASTER_FLOW_MAP"))) 
-		{
-			Out->raster_flow_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
-			if (Out->raster_flow_file == NULL) 
-			{
-				fprintf(stderr, 
-							"Cannot malloc memory for raster flow file:[%s]\n", 
-							strerror(errno));
-				return 1;
-			}
-			strncpy(Out->raster_flow_file, value, strlen(value)+1);
-		}
-				else if (!strncmp(var, "RASTER_HIT_MAP", strlen("RASTER_HIT_MAP"))) 
-		{
-			Out->raster_hits_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
-			if (Out->raster_hits_file == NULL) 
-			{
-				fprintf(stderr, 
-							"Cannot malloc memory for raster hits file:[%s]\n", 
-							strerror(errno));
-				return 1;
-			}
-			strncpy(Out->raster_hits_file, value, strlen(value)+1);
-		}
-		else if (!strncmp(var, "RASTER_POST_DEM", strlen("RASTER_POST_DEM"))) 
-		{
-			Out->raster_post_dem_file = (char *)GC_MALLOC(((strlen(value)+1) * sizeof(char)));	
-			if (Out->raster_post_dem_file == NULL) 
-			{
-				fprintf(stderr, 
-							"Cannot malloc memory for post raster dem file:[%s]\n", 
-							strerror(errno));
-				return 1;
-			}
-			strncpy(Out->raster_post_dem_file, value, strlen(value)+1);
-		}
-		
-		/*VENT PARAMETERS*/
-		else if (!strncmp(var, "MIN_PULSE_VOLUME", strlen("MIN_PULSE_VOLUME"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->min_pulse_volume = dval;
-			else 
-			{
-				fprintf(stderr, 
-							"\n[INITIALIZE]: Unable to read value for MIN_PULSE_VOLUME\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "MAX_PULSE_VOLUME", strlen("MAX_PULSE_VOLUME"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->max_pulse_volume = dval;
-			else 
-			{
-				fprintf(stderr, 
-							"\n[INITIALIZE]: Unable to read value for MAX_PULSE_VOLUME\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "MIN_TOTAL_VOLUME", strlen("MIN_TOTAL_VOLUME"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->min_total_volume = dval;
-			else 
-			{
-				fprintf(stderr, 
-							"\n[INITIALIZE]: Unable to read value for MIN_TOTAL_VOLUME\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "MAX_TOTAL_VOLUME", strlen("MAX_TOTAL_VOLUME"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->max_total_volume = dval;
-			else {
-				fprintf(stderr, 
-							"\n[INITIALIZE]: Unable to read value for MAX_TOTAL_VOLUME\n");
-				return 1;
-			}
-		}		
-		else if (!strncmp(var, "LOG_MEAN_TOTAL_VOLUME", strlen("LOG_MEAN_TOTAL_VOLUME"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->log_mean_volume = dval;
-			else 
-			{
-				fprintf(stderr, 
-							"\n[INITIALIZE]: Unable to read value for LOG_MEAN_TOTAL_VOLUME\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "LOG_STD_DEV_TOTAL_VOLUME", strlen("LOG_STD_DEV_TOTAL_VOLUME"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->log_std_volume = dval;
-			else 
-			{
-				fprintf(stderr, "\n[INITIALIZE]: Unable to read value for LOG_STD_DEV_TOTAL_VOLUME\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "MIN_RESIDUAL", strlen("MIN_RESIDUAL"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->min_residual = dval;
-			else 
-			{
-				fprintf(stderr, "\n[INITIALIZE]: Unable to read value for MIN_RESIDUAL\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "MAX_RESIDUAL", strlen("MAX_RESIDUAL"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->max_residual = dval;
-			else 
-			{
-				fprintf(stderr, 
-							"\n[INITIALIZE]: Unable to read value for MAX_RESIDUAL\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "LOG_MEAN_RESIDUAL", strlen("LOG_MEAN_RESIDUAL"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->log_mean_residual = dval;
-			else 
-			{
-				fprintf(stderr, 
-							"\n[INITIALIZE]: Unable to read value for LOG_MEAN_RESIDUAL\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "LOG_STD_DEV_RESIDUAL", strlen("LOG_STD_DEV_RESIDUAL"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->log_std_residual = dval;
-			else 
-			{
-				fprintf(stderr, "\n[INITIALIZE]: Unable to read value for LOG_STD_DEV_RESIDUAL\n");
-				return 1;
-			}
-		}
-		
-		else if (!strncmp(var, "FLOWS", strlen("FLOWS"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->flows = (int)dval;
-			else 
-			{
-				fprintf(stderr, "\n[INITIALIZE]: Unable to read value for number of lava flows\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "RUNS", strlen("RUNS"))) 
-		{
-			dval = strtod(value, &ptr);
-			if (dval > 0) In->runs = (int)dval;
-			else 
-			{
-				fprintf(stderr, "\n[INITIALIZE]: Unable to read value for RUNS\n");
-				return 1;
-			}
-		}
-		else if (!strncmp(var, "CREATE_FLOW_FIELD", strlen("CREATE_FLOW_FIELD"))) 
-		{
-			In->flow_field = 1;
-		}
-		else if (!strncmp(var, "PARENTS", strlen("PARENTS"))) 
-		{
-			In->parents = 1;
-		}
-		else 
+		ret = CONFIG_ASSIGN(In, Out, active_flow, var, value);
+		if (ret > 0) return 1;
+		if (ret < 0) 
 		{
 			fprintf (stderr, "[not assigned]\n");
 			continue;
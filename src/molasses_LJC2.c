@@ -0,0 +1,539 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: MOLASSES (simulation context)
+The simulation core shared by the molasses program (driver_LJC2.c)
+and libmolasses (include/molasses.h):
+
+CONTEXT_OPEN  load the DEM (and elevation uncertainty) of the inputs
+CONTEXT_COPY  a context on a copy of the grid of another, for a thread
+              of its own (SCENARIO_THREADS, see RUN_POOL)
+FLOW_ERUPT    pulse and distribute a flow until its volume is erupted
+FLOW_RESET    clear the flow from the grid for the next run
+
+The context keeps the grid and the active list, so flows after the
+first allocate nothing but their footprint.
+*******************************/
+
+MolassesContext *CONTEXT_OPEN(
+Inputs *In)
+{
+	MolassesContext *ctx;
+	int i, j;
+
+	/* Uncollectable: library callers may keep the context in memory
+	   the collector does not scan; molasses_close frees it */
+	ctx = (MolassesContext *) GC_MALLOC_UNCOLLECTABLE(sizeof(MolassesContext));
+	if (ctx == NULL) {
+		fprintf(stderr, "[CONTEXT_OPEN] Out of Memory!\n");
+		return NULL;
+	}
+	memset(ctx, 0, sizeof(MolassesContext));
+	ctx->In = In;
+	ctx->grid_residual = -1.0;
+
+	/* Read in the DEM using the gdal library */
+	ctx->grid = DEM_LOADER(In->dem_file, ctx->gridinfo, NULL, "TOPOG");
+	if (ctx->grid == NULL) {
+		fprintf(stderr, "[CONTEXT_OPEN]: Error returned from [DEM_LOADER].\n");
+		GC_FREE(ctx);
+		return NULL;
+	}
+	if (In->elev_uncert == -1) { /* user input an elevation uncertainty map*/
+		ctx->grid = DEM_LOADER(In->uncert_map, ctx->gridinfo, ctx->grid, "T_UNC");
+		if (ctx->grid == NULL) {
+			fprintf(stderr, "[CONTEXT_OPEN]: Error returned from [DEM_LOADER].\n");
+			GC_FREE(ctx);
+			return NULL;
+		}
+	}
+	else {		/* Select uncertainty value from config file */
+		for (i = 0; i < ctx->gridinfo[4]; i++)
+			for (j = 0; j < ctx->gridinfo[2]; j++)
+				ctx->grid[i][j].elev_uncert = In->elev_uncert;
+	}
+	return ctx;
+}
+
+MolassesContext *CONTEXT_COPY(
+MolassesContext *from)
+{
+	MolassesContext *ctx;
+	int rows = (int) from->gridinfo[4], cols = (int) from->gridinfo[2];
+
+	ctx = (MolassesContext *) GC_MALLOC(sizeof(MolassesContext));
+	if (ctx == NULL) {
+		fprintf(stderr, "[CONTEXT_COPY] Out of Memory!\n");
+		return NULL;
+	}
+	memset(ctx, 0, sizeof(MolassesContext));
+	ctx->In = from->In;
+	memcpy(ctx->gridinfo, from->gridinfo, sizeof ctx->gridinfo);
+	ctx->grid_residual = -1.0;
+	ctx->rand_state = from->rand_state;
+	/* the cells are one block, see GLOBALDATA_INIT */
+	ctx->grid = GLOBALDATA_INIT(rows, cols);
+	if (ctx->grid == NULL) {
+		fprintf(stderr, "[CONTEXT_COPY]: Error returned from [GLOBALDATA_INIT].\n");
+		return NULL;
+	}
+	memcpy(ctx->grid[0], from->grid[0], (size_t) rows * cols * sizeof(DataCell));
+	return ctx;
+}
+
+/* Run the flow until the volume to erupt is exhausted.
+   flow: vents (checked with CHECK_VENT_LOCATION), volumeToErupt,
+   currentvolume, pulsevolume; the grid holds the residual.
+   With In->resume the flow goes on from that checkpoint (see FLOW_STATE),
+   with In->flow_checkpoint_file it is checkpointed as it goes.
+   With In->time_budget_abandon the flow stops erupting when In->deadline
+   passes, leaving *volumeRemaining > 0 (see TIME_BUDGET).
+   RETURN: 0, or the negative code of DISTRIBUTE if the flow left the
+   grid (the flow stops there) */
+int FLOW_ERUPT(
+MolassesContext *ctx,
+Lava_flow *flow,
+Snapshot *snap,
+int run,
+unsigned int *pulseCount,
+double *volumeRemaining)
+{
+	VolumeSteps *steps = ctx->In->volume_steps;
+	double pulsevolume = flow->pulsevolume;
+	time_t saved = time(NULL);           /* last flow checkpoint */
+	struct timespec now;
+	int i, ret = 0, current_vent = 0;
+
+	/* Initialize the lava flow data structures and the vent cells.
+	   The active list of the first flow is kept for the next ones. */
+	if (ctx->active == NULL) {
+		ctx->active = INIT_FLOW(ctx->grid, flow->source, flow->num_vents, &ctx->active_size, ctx->gridinfo);
+		if (ctx->active == NULL) {
+			fprintf(stderr, "[FLOW_ERUPT] Error returned from [INIT_FLOW].\n");
+			return 1;
+		}
+	}
+	else {
+		for (i = 0; i < flow->num_vents; i++) { /* as INIT_FLOW */
+			flow->source[i].row = (int) ((flow->source[i].northing - ctx->gridinfo[3]) / ctx->gridinfo[5]);
+			flow->source[i].col = (int) ((flow->source[i].easting - ctx->gridinfo[0]) / ctx->gridinfo[1]);
+		}
+	}
+	ctx->active_count = 0;
+	*pulseCount = 0;
+	*volumeRemaining = flow->volumeToErupt;
+	if (ctx->In->resume != NULL) {       /* see FLOWSTATE_PARAMS */
+		if (FLOWSTATE_RESTORE(ctx->In->resume, ctx->grid, ctx->gridinfo, pulseCount, &current_vent,
+		                      &ctx->rand_state, ctx->In->arrival)) return 1;
+		*volumeRemaining = flow->currentvolume;
+		ctx->In->resume = NULL;
+	}
+	if (snap != NULL && SNAPSHOT_BEGIN(snap, flow, run)) return 1;
+	if (steps != NULL) VOLSTEPS_BEGIN(steps, flow->volumeToErupt - *volumeRemaining);
+
+	while (*volumeRemaining > (double) 0.0) {
+
+		/* vent cell gets a new pulse of lava to distribute, see file: pulse.c */
+		current_vent = (current_vent + 1) % (flow->num_vents);
+		ctx->active->row = (flow->source+current_vent)->row;
+		ctx->active->col = (flow->source+current_vent)->col;
+
+		if (ctx->verbose && !(*pulseCount % 100))
+			fprintf(stdout, "[R%d]Vent: %6.0f %6.0f; Active Cells: %-3u; Volume Remaining: %10.3f Pulse count: %3u \n",
+			run,
+			(flow->source+current_vent)->easting,
+			(flow->source+current_vent)->northing,
+			ctx->active_count,
+			*volumeRemaining,
+			*pulseCount);
+
+		/* stop the pulse at the next volume step, see VOLSTEPS_PULSE */
+		if (steps != NULL) flow->pulsevolume = VOLSTEPS_PULSE(steps, flow->volumeToErupt - *volumeRemaining, pulsevolume);
+		PULSE(ctx->active, flow, ctx->grid, volumeRemaining, ctx->gridinfo);
+		flow->pulsevolume = pulsevolume;
+		(*pulseCount)++;
+		if (ctx->In->arrival != NULL) ctx->In->arrival->pulse = *pulseCount;
+
+		/* Distribute lava to active cells and their 8 neighbors. */
+		ret = DISTRIBUTE(ctx->grid, ctx->active, &ctx->active_size, &ctx->active_count,
+		                 ctx->neighbors, ctx->gridinfo, ctx->In, &ctx->rand_state);
+		if (ret) {
+			fprintf (stderr, "[FLOW_ERUPT] Error returned from [DISTRIBUTE].ret=%d.. ", ret);
+			if (ret < 0) *volumeRemaining = 0.0;
+		}
+		if (snap != NULL && SNAPSHOT_PULSE(snap, ctx->grid, flow->volumeToErupt - *volumeRemaining)) return 1;
+		if (steps != NULL && ret >= 0 &&      /* not if the flow left the grid */
+		    VOLSTEPS_REACHED(steps, ctx->grid, flow, ctx->gridinfo, run, *pulseCount,
+		                     flow->volumeToErupt - *volumeRemaining)) return 1;
+		if (ctx->In->flow_checkpoint_file != NULL && ret >= 0 && *volumeRemaining > 0 &&
+		    ((ctx->In->flow_checkpoint_pulses && !(*pulseCount % ctx->In->flow_checkpoint_pulses)) ||
+		     (ctx->In->flow_checkpoint_seconds && time(NULL) - saved >= ctx->In->flow_checkpoint_seconds))) {
+			if (FLOWSTATE_SAVE(ctx->In->flow_checkpoint_file, ctx->grid, ctx->gridinfo, flow, run,
+			                   *pulseCount, current_vent, ctx->rand_state, ctx->In->arrival)) return 1;
+			saved = time(NULL);
+		}
+		/* TIME_BUDGET_ABANDON: the flow is left where it is */
+		if (ctx->In->time_budget_abandon && ctx->In->deadline > 0 && *volumeRemaining > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec + 1e-9 * now.tv_nsec >= ctx->In->deadline) {
+				fprintf(stdout, "[R%d] TIME_BUDGET reached after %u pulses, the flow is abandoned\n", run, *pulseCount);
+				break;
+			}
+		}
+	}
+	/* the finished (or abandoned) flow, to be extended with RESUME_VOLUME */
+	if (ctx->In->flow_checkpoint_file != NULL && ret >= 0 &&
+	    FLOWSTATE_SAVE(ctx->In->flow_checkpoint_file, ctx->grid, ctx->gridinfo, flow, run,
+	                   *pulseCount, current_vent, ctx->rand_state, ctx->In->arrival)) return 1;
+	/* the steps of a flow that left the grid are dropped with its run */
+	if (steps != NULL && ret >= 0 && VOLSTEPS_COMMIT(steps, ctx->gridinfo)) return 1;
+	if (snap != NULL && SNAPSHOT_END(snap, ctx->grid, flow->volumeToErupt - *volumeRemaining)) return 1;
+	return (ret < 0) ? ret : 0;
+}
+
+/* Reinitialize the data grid for a new flow; with flow_field the
+   lava of this flow becomes the ground of the next one */
+void FLOW_RESET(
+MolassesContext *ctx)
+{
+	int i, j;
+
+	for (i = 0; i < ctx->gridinfo[4]; i++) {
+		for (j = 0; j < ctx->gridinfo[2]; j++) {
+			if (ctx->In->flow_field) ctx->grid[i][j].dem_elev = ctx->grid[i][j].eff_elev;
+			else ctx->grid[i][j].eff_elev = ctx->grid[i][j].dem_elev;
+			ctx->grid[i][j].active = -1;
+			ctx->grid[i][j].parentcode = 0;
+		}
+	}
+}
+
+/*****************************
+libmolasses, see include/molasses.h
+*******************************/
+
+static pthread_once_t library_once = PTHREAD_ONCE_INIT;
+
+static void library_init(void)
+{
+	GC_INIT();
+	GC_allow_register_threads();
+}
+
+/* Start the collector once and make sure it knows the calling thread */
+static void register_thread(void)
+{
+	struct GC_stack_base stack;
+
+	pthread_once(&library_once, library_init);
+	if (!GC_thread_is_registered() && GC_get_stack_base(&stack) == GC_SUCCESS)
+		GC_register_my_thread(&stack);
+}
+
+MolassesContext *molasses_open(
+const char *dem_file)
+{
+	Inputs *In;
+
+	register_thread();
+	In = (Inputs *) GC_MALLOC(sizeof(Inputs));
+	if (In == NULL) {
+		fprintf(stderr, "[molasses_open] Out of Memory!\n");
+		return NULL;
+	}
+	memset(In, 0, sizeof(Inputs));
+	In->dem_file = (char *) GC_MALLOC_ATOMIC(strlen(dem_file) + 1);
+	if (In->dem_file == NULL) {
+		fprintf(stderr, "[molasses_open] Out of Memory!\n");
+		return NULL;
+	}
+	strcpy(In->dem_file, dem_file);
+	return CONTEXT_OPEN(In);
+}
+
+void molasses_grid(
+const MolassesContext *ctx,
+int *cols,
+int *rows,
+double geotransform[6])
+{
+	*cols = (int) ctx->gridinfo[2];
+	*rows = (int) ctx->gridinfo[4];
+	/* this code's metadata back to GDAL format, as WRITE_RASTER */
+	geotransform[0] = ctx->gridinfo[0];
+	geotransform[1] = ctx->gridinfo[1];
+	geotransform[2] = geotransform[4] = 0;
+	geotransform[3] = ctx->gridinfo[3] + (ctx->gridinfo[5] * ctx->gridinfo[4]);
+	geotransform[5] = -1 * ctx->gridinfo[5];
+}
+
+size_t molasses_memory(
+const MolassesContext *ctx)
+{
+	return (size_t) ctx->gridinfo[4] * ((size_t) ctx->gridinfo[2] * sizeof(DataCell) + sizeof(DataCell *)) +
+	       (size_t) ctx->active_size * sizeof(ActiveList);
+}
+
+/* Add a flow to the ensemble grids, as the driver's footprint loop */
+static void library_ensemble(
+MolassesContext *ctx,
+FlowFootprint *fp)
+{
+	size_t cols = (size_t) ctx->gridinfo[2];
+	unsigned int c;
+
+	if (ctx->last != NULL)
+		for (c = 0; c < ctx->last->count; c++)
+			ctx->thickness[ctx->last->cells[c].row * cols + ctx->last->cells[c].col] = 0;
+	for (c = 0; c < fp->count; c++) {
+		ctx->grid[fp->cells[c].row][fp->cells[c].col].hit_count++;
+		ctx->thickness[fp->cells[c].row * cols + fp->cells[c].col] = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+	}
+	CELL_STATS_UPDATE(ctx->stats, fp, ctx->grid);
+	ctx->last = fp;
+	ctx->flows++;
+}
+
+/* Set up and erupt one flow of a library call, leaving it on the grid.
+   RETURN: the footprint, NULL on error (ctx->error says why) */
+static FlowFootprint *library_flow(
+MolassesContext *ctx,
+const MolassesVent *vents,
+int num_vents,
+double volume,
+double pulse_volume,
+double residual,
+unsigned int seed)
+{
+	Vent *grown;
+	FlowFootprint *fp;
+	unsigned int pulses;
+	double remaining;
+	int i, j;
+
+	register_thread();
+	ctx->error[0] = '\0';
+	if (num_vents < 1 || vents == NULL || !(volume > 0) || !(pulse_volume > 0) || !(residual >= 0)) {
+		snprintf(ctx->error, sizeof ctx->error,
+		         "need vents, a volume and pulse volume > 0 and a residual >= 0");
+		return NULL;
+	}
+	if (ctx->flow.source == NULL || num_vents > ctx->flow.num_vents) {
+		grown = (Vent *) GC_MALLOC_ATOMIC((size_t) num_vents * sizeof(Vent));
+		if (grown == NULL) {
+			snprintf(ctx->error, sizeof ctx->error, "out of memory for %d vents", num_vents);
+			return NULL;
+		}
+		ctx->flow.source = grown;
+	}
+	ctx->flow.num_vents = num_vents;
+	for (i = 0; i < num_vents; i++) {
+		ctx->flow.source[i].easting = vents[i].easting;
+		ctx->flow.source[i].northing = vents[i].northing;
+		if (CHECK_VENT_LOCATION(ctx->flow.source + i, ctx->gridinfo, ctx->grid)) {
+			snprintf(ctx->error, sizeof ctx->error, "vent %d (%.3f, %.3f) is outside of the grid",
+			         i, vents[i].easting, vents[i].northing);
+			return NULL;
+		}
+	}
+	ctx->flow.volumeToErupt = ctx->flow.currentvolume = volume;
+	ctx->flow.pulsevolume = pulse_volume;
+	ctx->flow.residual = residual;
+	/* Write residual value into 2D Global Data Array, as SET_FLOW_PARAMS,
+	   when it differs from the last flow's */
+	if (residual != ctx->grid_residual) {
+		for (i = 0; i < ctx->gridinfo[4]; i++)
+			for (j = 0; j < ctx->gridinfo[2]; j++)
+				ctx->grid[i][j].residual = residual;
+		ctx->grid_residual = residual;
+	}
+	ctx->rand_state = seed;
+
+	if (FLOW_ERUPT(ctx, &ctx->flow, NULL, 0, &pulses, &remaining) > 0) {
+		snprintf(ctx->error, sizeof ctx->error, "the flow could not be run");
+		FLOW_RESET(ctx);
+		return NULL;
+	}
+	fp = FOOTPRINT_SNAPSHOT(ctx->grid, &ctx->flow, ctx->gridinfo, 0);
+	FLOW_RESET(ctx);
+	if (fp == NULL) snprintf(ctx->error, sizeof ctx->error, "out of memory for the flow footprint");
+	else if (ctx->stats != NULL) library_ensemble(ctx, fp);
+	return fp;
+}
+
+static void library_cell(
+const MolassesContext *ctx,
+const FootprintCell *in,
+MolassesCell *out)
+{
+	out->row = in->row;
+	out->col = in->col;
+	out->easting = ctx->gridinfo[0] + ctx->gridinfo[1] * in->col;
+	out->northing = ctx->gridinfo[3] + ctx->gridinfo[5] * in->row;
+	out->thickness = in->eff_elev - in->dem_elev;
+	out->dem_elev = in->dem_elev;
+}
+
+int molasses_run(
+MolassesContext *ctx,
+const MolassesVent *vents,
+int num_vents,
+double volume,
+double pulse_volume,
+double residual,
+unsigned int seed,
+MolassesCell *cells,
+unsigned int max_cells,
+unsigned int *count)
+{
+	FlowFootprint *fp;
+	unsigned int c;
+
+	*count = 0;
+	fp = library_flow(ctx, vents, num_vents, volume, pulse_volume, residual, seed);
+	if (fp == NULL) return MOLASSES_ERROR;
+	*count = fp->count;
+	for (c = 0; c < fp->count && c < max_cells; c++) library_cell(ctx, fp->cells + c, cells + c);
+	if (fp->count > max_cells) {
+		snprintf(ctx->error, sizeof ctx->error, "%u cells inundated, the buffer holds %u", fp->count, max_cells);
+		return MOLASSES_TRUNCATED;
+	}
+	return MOLASSES_OK;
+}
+
+int molasses_run_callback(
+MolassesContext *ctx,
+const MolassesVent *vents,
+int num_vents,
+double volume,
+double pulse_volume,
+double residual,
+unsigned int seed,
+MolassesCellFunc func,
+void *user)
+{
+	FlowFootprint *fp;
+	MolassesCell cell;
+	unsigned int c;
+	int ret;
+
+	fp = library_flow(ctx, vents, num_vents, volume, pulse_volume, residual, seed);
+	if (fp == NULL) return MOLASSES_ERROR;
+	for (c = 0; c < fp->count; c++) {
+		library_cell(ctx, fp->cells + c, &cell);
+		if ((ret = func(&cell, user))) return ret;
+	}
+	return MOLASSES_OK;
+}
+
+int molasses_ensemble(
+MolassesContext *ctx,
+int keep)
+{
+	Outputs Out;
+	size_t cells = (size_t) ctx->gridinfo[2] * (size_t) ctx->gridinfo[4];
+	int i, j;
+
+	ctx->stats = NULL;
+	ctx->thickness = NULL;
+	ctx->last = NULL;
+	ctx->flows = 0;
+	for (i = 0; i < ctx->gridinfo[4]; i++)
+		for (j = 0; j < ctx->gridinfo[2]; j++)
+			ctx->grid[i][j].hit_count = 0;
+	if (!keep) return MOLASSES_OK;
+
+	memset(&Out, 0, sizeof Out);
+	Out.cell_stats_type[0] = Out.cell_stats_type[1] = Out.cell_stats_type[2] = GDT_Float64;
+	ctx->stats = CELL_STATS_INIT(&Out, ctx->gridinfo);
+	ctx->thickness = (double *) GC_MALLOC_ATOMIC(cells * sizeof(double));
+	if (ctx->stats == NULL || ctx->thickness == NULL) {
+		snprintf(ctx->error, sizeof ctx->error, "out of memory for the ensemble grids");
+		ctx->stats = NULL;
+		ctx->thickness = NULL;
+		return MOLASSES_ERROR;
+	}
+	memset(ctx->thickness, 0, cells * sizeof(double));
+	return MOLASSES_OK;
+}
+
+unsigned int molasses_flows(
+const MolassesContext *ctx)
+{
+	return ctx->flows;
+}
+
+int molasses_raster(
+MolassesContext *ctx,
+int which,
+MolassesRaster *raster)
+{
+	raster->rows = (int) ctx->gridinfo[4];
+	raster->cols = (int) ctx->gridinfo[2];
+	raster->row_stride = (long) (raster->cols * sizeof(DataCell));
+	raster->col_stride = (long) sizeof(DataCell);
+	raster->format = 'd';
+	if (which == MOLASSES_ELEVATION) {
+		raster->data = &ctx->grid[0][0].dem_elev;
+		return MOLASSES_OK;
+	}
+	if (which == MOLASSES_HITS) {
+		raster->data = &ctx->grid[0][0].hit_count;
+		raster->format = 'i';
+		return MOLASSES_OK;
+	}
+	raster->row_stride = (long) (raster->cols * sizeof(double));
+	raster->col_stride = (long) sizeof(double);
+	if (ctx->stats == NULL) raster->data = NULL;
+	else if (which == MOLASSES_THICKNESS) raster->data = ctx->thickness;
+	else if (which == MOLASSES_MEAN) raster->data = ctx->stats->mean;
+	else if (which == MOLASSES_M2) raster->data = ctx->stats->m2;
+	else if (which == MOLASSES_MAX) raster->data = ctx->stats->max;
+	else raster->data = NULL;
+	if (raster->data == NULL) {
+		snprintf(ctx->error, sizeof ctx->error, "grid %d is not kept, see molasses_ensemble", which);
+		return MOLASSES_ERROR;
+	}
+	return MOLASSES_OK;
+}
+
+const char *molasses_error(
+const MolassesContext *ctx)
+{
+	return ctx->error;
+}
+
+void molasses_close(
+MolassesContext *ctx)
+{
+	if (ctx != NULL) GC_FREE(ctx);
+}
+
+void molasses_thread_exit(void)
+{
+	if (GC_thread_is_registered()) GC_unregister_my_thread();
+}
@@ -0,0 +1,804 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+MOLASSES-DAEMON:
+Keeps DEMs loaded between requests and runs flows on them with
+libmolasses, so a request costs the flows and not the DEM load.
+
+Usage:
+	molasses-daemon [-s socket] [-m megabytes] [-d name=dem ...]
+		-s  listen on a local UNIX socket instead of stdin/stdout;
+		    clients are served one after the other
+		-m  memory budget of the loaded DEMs (default 2048 MB); past
+		    it the least recently used DEMs are dropped
+		-d  a short name for a DEM file, usable as "dem" in requests
+
+Requests and replies are JSON objects, one per line. A run request:
+	{"id":"a1", "dem":"etna", "vents":[[501500,4001500],[501600,4001500]],
+	 "volume":2e6, "pulse":100, "residual":[1,3], "runs":10, "seed":7,
+	 "outputs":["cells","hits"]}
+volume, pulse and residual are a value or a [min, max] range drawn for
+each run, as in the configuration file. With a seed, run k spreads its
+lava from seed + k, so a request gives the same flows every time. The replies, in order:
+	{"id":"a1","event":"dem","dem":"etna","cached":true,"ms":0.01,...}
+	{"id":"a1","event":"run","run":0,"runs":10,"cells":1931,...}  per run
+	{"id":"a1","event":"done","runs":10,"ms":412.5}
+"cells" adds the "flow" of each run, [easting, northing, thickness]
+per cell; "hits" adds to done the "hits" of the request, [easting,
+northing, runs] per inundated cell. A failed request gets
+	{"id":"a1","event":"error","message":"..."}
+Other requests: {"cmd":"load","dem":...} loads a DEM ahead of its runs,
+{"cmd":"evict"[,"dem":...]} drops one or all DEMs, {"cmd":"status"}
+lists them, and {"cmd":"quit"} stops the daemon.
+
+With stdin the replies go to stdout, and what the simulation prints
+goes to stderr.
+*/
+
+#define DAEMON_MAX_VENTS 256
+
+typedef struct Request {
+	char id[128];
+	char cmd[16];
+	char dem[1024];
+	double vents[2 * DAEMON_MAX_VENTS];
+	int num_vents;
+	double volume[2], pulse[2], residual[2];  /* min, max */
+	int runs;
+	long seed;
+	int seeded;
+	int cells, hits;                          /* outputs */
+} Request;
+
+typedef struct CachedDem {
+	char *file;
+	MolassesContext *ctx;
+	int cols, rows;
+	double gt[6];
+	size_t bytes;
+	unsigned long long used;    /* request count at the last use */
+	unsigned long runs;
+} CachedDem;
+
+/* What the cell callback of a run needs */
+typedef struct RunState {
+	FILE *out;
+	Request *rq;
+	CachedDem *dem;
+	int run;
+	unsigned int *hits;
+	unsigned int cells;
+	double max_thickness;
+} RunState;
+
+static CachedDem *cache;
+static int num_cached, cache_size;
+static size_t budget = (size_t) 2048 << 20, in_use;
+static unsigned long long requests;
+static char **alias_name, **alias_file;
+static int num_aliases;
+
+static double ms_since(
+struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return 1e3 * (double) (now.tv_sec - start->tv_sec) + 1e-6 * (double) (now.tv_nsec - start->tv_nsec);
+}
+
+/*****************************
+JSON: just what the requests use
+*******************************/
+
+static void skip_ws(
+const char **p)
+{
+	while (**p == ' ' || **p == '\t' || **p == '\r' || **p == '\n') (*p)++;
+}
+
+/* A string into out (truncated to size); \u escapes become '?'.
+   RETURN 0, 1 if it is not a string */
+static int parse_string(
+const char **p,
+char *out,
+size_t size)
+{
+	size_t n = 0;
+	char c;
+
+	skip_ws(p);
+	if (**p != '"') return 1;
+	(*p)++;
+	while (**p != '"') {
+		if (**p == '\0') return 1;
+		c = *(*p)++;
+		if (c == '\\') {
+			c = *(*p)++;
+			switch (c) {
+				case 'n': c = '\n'; break;
+				case 't': c = '\t'; break;
+				case 'r': c = '\r'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'u':
+					if (strlen(*p) < 4) return 1;
+					*p += 4;
+					c = '?';
+					break;
+				case '\0': return 1;
+				default: break;       /* " \ / */
+			}
+		}
+		if (n + 1 < size) out[n++] = c;
+	}
+	(*p)++;
+	if (size) out[n] = '\0';
+	return 0;
+}
+
+/* A number, or an array of numbers and arrays of numbers, flattened
+   into v[0..max-1]. RETURN the count, -1 on error */
+static int parse_numbers(
+const char **p,
+double *v,
+int max)
+{
+	int n = 0, depth = 0;
+	char *end;
+
+	skip_ws(p);
+	do {
+		skip_ws(p);
+		if (**p == '[') {
+			(*p)++;
+			depth++;
+			skip_ws(p);
+			if (**p == ']') {
+				(*p)++;
+				depth--;
+			}
+			else continue;
+		}
+		else {
+			if (n == max) return -1;
+			v[n] = strtod(*p, &end);
+			if (end == *p) return -1;
+			*p = end;
+			n++;
+		}
+		skip_ws(p);
+		while (depth > 0 && **p == ']') {
+			(*p)++;
+			depth--;
+			skip_ws(p);
+		}
+		if (depth > 0) {
+			if (**p != ',') return -1;
+			(*p)++;
+		}
+	} while (depth > 0);
+	return n;
+}
+
+/* Skip any value. RETURN 0, 1 on error */
+static int skip_value(
+const char **p)
+{
+	int depth = 0;
+	char scratch[2];
+
+	do {
+		skip_ws(p);
+		if (**p == '"') {
+			if (parse_string(p, scratch, sizeof scratch)) return 1;
+		}
+		else if (**p == '[' || **p == '{') {
+			depth++;
+			(*p)++;
+			continue;
+		}
+		else if (**p == ']' || **p == '}') {
+			if (!depth) return 1;
+			depth--;
+			(*p)++;
+		}
+		else if (**p == ',' || **p == ':') {
+			if (!depth) return 1;
+			(*p)++;
+			continue;
+		}
+		else if (**p == '\0') return 1;
+		else {
+			while (**p && strchr(",:]} \t\r\n", **p) == NULL) (*p)++;
+		}
+	} while (depth > 0);
+	return 0;
+}
+
+/* Two numbers as a [min, max] range, one as both */
+static int parse_range(
+const char **p,
+double *range)
+{
+	int n = parse_numbers(p, range, 2);
+
+	if (n == 1) range[1] = range[0];
+	return (n < 1);
+}
+
+/* RETURN 0, 1 with the reason in error */
+static int parse_request(
+const char *line,
+Request *rq,
+char *error,
+size_t size)
+{
+	const char *p = line;
+	char key[32], word[16];
+	char *end;
+	int n;
+
+	memset(rq, 0, sizeof(Request));
+	strcpy(rq->cmd, "run");
+	rq->runs = 1;
+	rq->volume[0] = rq->pulse[0] = rq->residual[0] = -1;
+
+	skip_ws(&p);
+	if (*p++ != '{') {
+		snprintf(error, size, "a request is a JSON object");
+		return 1;
+	}
+	skip_ws(&p);
+	if (*p == '}') return 0;
+	for (;;) {
+		if (parse_string(&p, key, sizeof key)) {
+			snprintf(error, size, "expected a key");
+			return 1;
+		}
+		skip_ws(&p);
+		if (*p++ != ':') {
+			snprintf(error, size, "expected ':' after \"%s\"", key);
+			return 1;
+		}
+		skip_ws(&p);
+		if (!strcmp(key, "id")) {
+			if (*p == '"') n = parse_string(&p, rq->id, sizeof rq->id);
+			else {               /* a number id, echoed as a string */
+				strtod(p, &end);
+				n = (end == p || end - p >= (long) sizeof rq->id);
+				if (!n) {
+					memcpy(rq->id, p, end - p);
+					p = end;
+				}
+			}
+		}
+		else if (!strcmp(key, "cmd")) n = parse_string(&p, rq->cmd, sizeof rq->cmd);
+		else if (!strcmp(key, "dem")) n = parse_string(&p, rq->dem, sizeof rq->dem);
+		else if (!strcmp(key, "vents")) {
+			rq->num_vents = parse_numbers(&p, rq->vents, 2 * DAEMON_MAX_VENTS);
+			n = (rq->num_vents < 2 || rq->num_vents % 2);
+			rq->num_vents /= 2;
+		}
+		else if (!strcmp(key, "volume")) n = parse_range(&p, rq->volume);
+		else if (!strcmp(key, "pulse")) n = parse_range(&p, rq->pulse);
+		else if (!strcmp(key, "residual")) n = parse_range(&p, rq->residual);
+		else if (!strcmp(key, "runs")) {
+			rq->runs = (int) strtol(p, &end, 10);
+			n = (end == p || rq->runs < 1);
+			p = end;
+		}
+		else if (!strcmp(key, "seed")) {
+			rq->seed = strtol(p, &end, 10);
+			n = (end == p);
+			rq->seeded = 1;
+			p = end;
+		}
+		else if (!strcmp(key, "outputs")) {
+			n = (*p++ != '[');
+			skip_ws(&p);
+			if (*p == ']') p++;
+			else while (!n) {
+				n = parse_string(&p, word, sizeof word);
+				if (!strcmp(word, "cells")) rq->cells = 1;
+				else if (!strcmp(word, "hits")) rq->hits = 1;
+				skip_ws(&p);
+				if (*p == ']') {
+					p++;
+					break;
+				}
+				if (*p++ != ',') n = 1;
+			}
+		}
+		else n = skip_value(&p);
+		if (n) {
+			snprintf(error, size, "bad value of \"%s\"", key);
+			return 1;
+		}
+		skip_ws(&p);
+		if (*p == '}') break;
+		if (*p++ != ',') {
+			snprintf(error, size, "expected ',' or '}' after \"%s\"", key);
+			return 1;
+		}
+		skip_ws(&p);
+	}
+	return 0;
+}
+
+static void put_string(
+FILE *out,
+const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') fprintf(out, "\\%c", *s);
+		else if (*s == '\n') fputs("\\n", out);
+		else if ((unsigned char) *s < 0x20) fprintf(out, "\\u%04x", (unsigned char) *s);
+		else fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+/* Start a reply: {"id":...,"event":event */
+static void reply(
+FILE *out,
+Request *rq,
+const char *event)
+{
+	fputs("{\"id\":", out);
+	put_string(out, rq->id);
+	fprintf(out, ",\"event\":\"%s\"", event);
+}
+
+static void reply_error(
+FILE *out,
+Request *rq,
+const char *message)
+{
+	reply(out, rq, "error");
+	fputs(",\"message\":", out);
+	put_string(out, message);
+	fputs("}\n", out);
+	fflush(out);
+}
+
+/*****************************
+DEM cache
+*******************************/
+
+/* The file of a DEM name: a -d name, or the name itself */
+static const char *dem_file(
+const char *name)
+{
+	int i;
+
+	for (i = 0; i < num_aliases; i++)
+		if (!strcmp(alias_name[i], name)) return alias_file[i];
+	return name;
+}
+
+static void dem_evict(
+int i)
+{
+	in_use -= cache[i].bytes;
+	molasses_close(cache[i].ctx);
+	free(cache[i].file);
+	cache[i] = cache[--num_cached];
+}
+
+/* Drop the least recently used DEMs, except *keep, until the loaded
+   ones fit the budget; *keep follows its entry as the cache packs.
+   RETURN the number dropped */
+static int dem_trim(
+CachedDem **keep)
+{
+	int i, oldest, dropped = 0;
+
+	while (in_use > budget && num_cached > 1) {
+		oldest = -1;
+		for (i = 0; i < num_cached; i++)
+			if (cache + i != *keep && (oldest < 0 || cache[i].used < cache[oldest].used)) oldest = i;
+		/* the last entry moves into the hole */
+		if (cache + num_cached - 1 == *keep) *keep = cache + oldest;
+		dem_evict(oldest);
+		dropped++;
+	}
+	if (dropped) GC_gcollect();
+	return dropped;
+}
+
+/* The loaded DEM of a request, loading it if need be. Replies "dem".
+   RETURN the DEM, NULL after replying the error */
+static CachedDem *dem_get(
+FILE *out,
+Request *rq)
+{
+	const char *file;
+	CachedDem *dem = NULL;
+	MolassesContext *ctx;
+	struct timespec start;
+	int i, dropped = 0;
+	char message[1200];
+
+	if (!rq->dem[0]) {
+		reply_error(out, rq, "no dem in the request");
+		return NULL;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	file = dem_file(rq->dem);
+	for (i = 0; i < num_cached; i++)
+		if (!strcmp(cache[i].file, file)) dem = cache + i;
+	if (dem == NULL) {
+		ctx = molasses_open(file);
+		if (ctx == NULL) {
+			snprintf(message, sizeof message, "cannot load the DEM [%s]", file);
+			reply_error(out, rq, message);
+			return NULL;
+		}
+		if (num_cached == cache_size) {
+			cache_size = 2 * cache_size + 4;
+			cache = (CachedDem *) realloc(cache, cache_size * sizeof(CachedDem));
+			if (cache == NULL) {
+				fprintf(stderr, "[molasses-daemon] Out of Memory!\n");
+				exit(1);
+			}
+		}
+		dem = cache + num_cached++;
+		memset(dem, 0, sizeof(CachedDem));
+		dem->file = strdup(file);
+		dem->ctx = ctx;
+		molasses_grid(ctx, &dem->cols, &dem->rows, dem->gt);
+		dem->bytes = molasses_memory(ctx);
+		in_use += dem->bytes;
+		dem->used = ++requests;
+		dropped = dem_trim(&dem);
+		reply(out, rq, "dem");
+		fputs(",\"dem\":", out);
+		put_string(out, rq->dem);
+		fprintf(out, ",\"cached\":false,\"ms\":%.3f,\"cols\":%d,\"rows\":%d,\"mb\":%.1f,\"evicted\":%d}\n",
+		        ms_since(&start), dem->cols, dem->rows, dem->bytes / 1048576.0, dropped);
+	}
+	else {
+		dem->used = ++requests;
+		reply(out, rq, "dem");
+		fputs(",\"dem\":", out);
+		put_string(out, rq->dem);
+		fprintf(out, ",\"cached\":true,\"ms\":%.3f,\"cols\":%d,\"rows\":%d,\"mb\":%.1f}\n",
+		        ms_since(&start), dem->cols, dem->rows, dem->bytes / 1048576.0);
+	}
+	fflush(out);
+	return dem;
+}
+
+/*****************************
+Requests
+*******************************/
+
+static double draw(
+double *range)
+{
+	if (range[1] > range[0]) return (double) genunf((float) range[0], (float) range[1]);
+	return range[0];
+}
+
+/* Lower left corner of a cell, as the flow maps */
+static double cell_easting(
+CachedDem *dem,
+int col)
+{
+	return dem->gt[0] + dem->gt[1] * col;
+}
+
+static double cell_northing(
+CachedDem *dem,
+int row)
+{
+	return dem->gt[3] + dem->gt[5] * (dem->rows - row);
+}
+
+static void run_header(
+RunState *st)
+{
+	reply(st->out, st->rq, "run");
+	fprintf(st->out, ",\"run\":%d,\"runs\":%d", st->run, st->rq->runs);
+}
+
+static int run_cell(
+const MolassesCell *cell,
+void *user)
+{
+	RunState *st = (RunState *) user;
+
+	if (st->rq->cells) {
+		if (!st->cells) {
+			run_header(st);
+			fputs(",\"flow\":[", st->out);
+		}
+		else fputc(',', st->out);
+		fprintf(st->out, "[%.3f,%.3f,%.4f]", cell->easting, cell->northing, cell->thickness);
+	}
+	if (st->hits != NULL) st->hits[(size_t) cell->row * st->dem->cols + cell->col]++;
+	if (cell->thickness > st->max_thickness) st->max_thickness = cell->thickness;
+	st->cells++;
+	return 0;
+}
+
+static void run_request(
+FILE *out,
+Request *rq)
+{
+	CachedDem *dem;
+	MolassesVent *vents;
+	RunState st;
+	struct timespec start, run_start;
+	double volume, pulse, residual;
+	char phrase[32], message[300];
+	int i, seed1, seed2, ret;
+	size_t bytes, c;
+
+	if (rq->num_vents < 1) {
+		reply_error(out, rq, "no vents in the request");
+		return;
+	}
+	if (rq->volume[0] <= 0 || rq->pulse[0] <= 0 || rq->residual[0] < 0 ||
+	    rq->volume[1] < rq->volume[0] || rq->pulse[1] < rq->pulse[0] || rq->residual[1] < rq->residual[0]) {
+		reply_error(out, rq, "need a volume and pulse > 0 and a residual >= 0");
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	dem = dem_get(out, rq);
+	if (dem == NULL) return;
+
+	vents = (MolassesVent *) malloc(rq->num_vents * sizeof(MolassesVent));
+	memset(&st, 0, sizeof st);
+	if (rq->hits) st.hits = (unsigned int *) calloc((size_t) dem->cols * dem->rows, sizeof(unsigned int));
+	if (vents == NULL || (rq->hits && st.hits == NULL)) {
+		reply_error(out, rq, "out of memory");
+		free(vents);
+		free(st.hits);
+		return;
+	}
+	for (i = 0; i < rq->num_vents; i++) {
+		vents[i].easting = rq->vents[2 * i];
+		vents[i].northing = rq->vents[2 * i + 1];
+	}
+	if (rq->seeded) {    /* as the driver seeds from its phrase */
+		snprintf(phrase, sizeof phrase, "%ld", rq->seed);
+		phrtsd(phrase, &seed1, &seed2);
+		set_initial_seed(seed1, seed2);
+	}
+	st.out = out;
+	st.rq = rq;
+	st.dem = dem;
+
+	for (st.run = 0; st.run < rq->runs; st.run++) {
+		clock_gettime(CLOCK_MONOTONIC, &run_start);
+		residual = draw(rq->residual);
+		pulse = draw(rq->pulse);
+		volume = draw(rq->volume);
+		st.cells = 0;
+		st.max_thickness = 0;
+		ret = molasses_run_callback(dem->ctx, vents, rq->num_vents, volume, pulse, residual,
+		                            rq->seeded ? (unsigned int) rq->seed + st.run : (unsigned int) rand(),
+		                            run_cell, &st);
+		if (ret) {
+			snprintf(message, sizeof message, "run %d: %s", st.run, molasses_error(dem->ctx));
+			if (st.cells && rq->cells) fputs("]}\n", out);
+			reply_error(out, rq, message);
+			break;
+		}
+		if (st.cells && rq->cells) fputc(']', out);
+		else run_header(&st);
+		fprintf(out, ",\"volume\":%.4f,\"pulse\":%.4f,\"residual\":%.4f,\"cells\":%u,"
+		        "\"area_km2\":%.6f,\"max_thickness\":%.6f,\"ms\":%.3f}\n",
+		        volume, pulse, residual, st.cells,
+		        st.cells * dem->gt[1] * -dem->gt[5] * 1e-6, st.max_thickness, ms_since(&run_start));
+		fflush(out);
+		dem->runs++;
+	}
+
+	if (st.run == rq->runs) {
+		reply(out, rq, "done");
+		fprintf(out, ",\"runs\":%d,\"ms\":%.3f", rq->runs, ms_since(&start));
+		if (st.hits != NULL) {
+			fputs(",\"hits\":[", out);
+			for (c = 0, i = 0; c < (size_t) dem->cols * dem->rows; c++) {
+				if (!st.hits[c]) continue;
+				fprintf(out, "%s[%.3f,%.3f,%u]", i++ ? "," : "",
+				        cell_easting(dem, (int) (c % dem->cols)), cell_northing(dem, (int) (c / dem->cols)), st.hits[c]);
+			}
+			fputc(']', out);
+		}
+		fputs("}\n", out);
+		fflush(out);
+	}
+	free(vents);
+	free(st.hits);
+
+	/* the first run allocates the active list */
+	bytes = molasses_memory(dem->ctx);
+	in_use += bytes - dem->bytes;
+	dem->bytes = bytes;
+	dem_trim(&dem);
+}
+
+static void status_request(
+FILE *out,
+Request *rq)
+{
+	int i;
+
+	reply(out, rq, "status");
+	fprintf(out, ",\"budget_mb\":%.1f,\"used_mb\":%.1f,\"dems\":[", budget / 1048576.0, in_use / 1048576.0);
+	for (i = 0; i < num_cached; i++) {
+		fputs(i ? ",{\"file\":" : "{\"file\":", out);
+		put_string(out, cache[i].file);
+		fprintf(out, ",\"cols\":%d,\"rows\":%d,\"mb\":%.1f,\"runs\":%lu,\"last_used\":%llu}",
+		        cache[i].cols, cache[i].rows, cache[i].bytes / 1048576.0, cache[i].runs, cache[i].used);
+	}
+	fputs("]}\n", out);
+	fflush(out);
+}
+
+static void evict_request(
+FILE *out,
+Request *rq)
+{
+	const char *file = rq->dem[0] ? dem_file(rq->dem) : NULL;
+	int i, dropped = 0;
+
+	for (i = num_cached - 1; i >= 0; i--) {
+		if (file == NULL || !strcmp(cache[i].file, file)) {
+			dem_evict(i);
+			dropped++;
+		}
+	}
+	if (dropped) GC_gcollect();
+	reply(out, rq, "evicted");
+	fprintf(out, ",\"dems\":%d,\"used_mb\":%.1f}\n", dropped, in_use / 1048576.0);
+	fflush(out);
+}
+
+/* Answer the requests of one client. RETURN 1 on quit */
+static int serve(
+FILE *in,
+FILE *out)
+{
+	char *line = NULL, error[128];
+	size_t size = 0;
+	Request rq;
+	const char *p;
+
+	while (getline(&line, &size, in) > 0) {
+		p = line;
+		skip_ws(&p);
+		if (*p == '\0') continue;
+		if (parse_request(line, &rq, error, sizeof error)) {
+			reply_error(out, &rq, error);
+			continue;
+		}
+		if (!strcmp(rq.cmd, "run")) run_request(out, &rq);
+		else if (!strcmp(rq.cmd, "load")) dem_get(out, &rq);
+		else if (!strcmp(rq.cmd, "status")) status_request(out, &rq);
+		else if (!strcmp(rq.cmd, "evict")) evict_request(out, &rq);
+		else if (!strcmp(rq.cmd, "quit")) {
+			reply(out, &rq, "bye");
+			fputs("}\n", out);
+			fflush(out);
+			free(line);
+			return 1;
+		}
+		else reply_error(out, &rq, "unknown cmd");
+	}
+	free(line);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	char *socket_path = NULL, *eq, phrase[32];
+	struct sockaddr_un addr;
+	FILE *in, *out;
+	int i, fd, client, quit = 0, seed1, seed2;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-s") && i + 1 < argc) socket_path = argv[++i];
+		else if (!strcmp(argv[i], "-m") && i + 1 < argc) budget = (size_t) (strtod(argv[++i], NULL) * 1048576.0);
+		else if (!strcmp(argv[i], "-d") && i + 1 < argc && (eq = strchr(argv[i + 1], '=')) != NULL) {
+			alias_name = (char **) realloc(alias_name, (num_aliases + 1) * sizeof(char *));
+			alias_file = (char **) realloc(alias_file, (num_aliases + 1) * sizeof(char *));
+			if (alias_name == NULL || alias_file == NULL) return 1;
+			*eq = '\0';
+			alias_name[num_aliases] = argv[++i];
+			alias_file[num_aliases++] = eq + 1;
+		}
+		else {
+			fprintf(stderr, "Usage: %s [-s socket] [-m megabytes] [-d name=dem ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	/* Seed as the driver does; requests with a seed reseed */
+	srand(time(NULL));
+	snprintf(phrase, sizeof phrase, "%d", (int) time(NULL));
+	initialize();
+	phrtsd(phrase, &seed1, &seed2);
+	set_initial_seed(seed1, seed2);
+
+	if (socket_path == NULL) {
+		/* replies on the real stdout, everything else on stderr */
+		out = fdopen(dup(STDOUT_FILENO), "w");
+		if (out == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+			fprintf(stderr, "[molasses-daemon] Cannot set up stdout:[%s]\n", strerror(errno));
+			return 1;
+		}
+		serve(stdin, out);
+		fclose(out);
+		return 0;
+	}
+
+	signal(SIGPIPE, SIG_IGN);   /* a client leaving early is not our end */
+	if (strlen(socket_path) >= sizeof addr.sun_path) {
+		fprintf(stderr, "[molasses-daemon] Socket path too long: [%s]\n", socket_path);
+		return 1;
+	}
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, socket_path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path);
+	if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof addr) || listen(fd, 8)) {
+		fprintf(stderr, "[molasses-daemon] Cannot listen on [%s]:[%s]\n", socket_path, strerror(errno));
+		return 1;
+	}
+	fprintf(stderr, "[molasses-daemon] Listening on %s, budget %.0f MB\n", socket_path, budget / 1048576.0);
+	while (!quit) {
+		client = accept(fd, NULL, NULL);
+		if (client < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "[molasses-daemon] accept:[%s]\n", strerror(errno));
+			break;
+		}
+		in = fdopen(client, "r");
+		out = fdopen(dup(client), "w");
+		if (in == NULL || out == NULL) {
+			close(client);
+			continue;
+		}
+		quit = serve(in, out);
+		fclose(in);
+		fclose(out);
+	}
+	close(fd);
+	unlink(socket_path);
+	return 0;
+}
@@ -0,0 +1,608 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+#include <ogr_api.h>
+#include <ogr_srs_api.h>
+
+/*****************************
+MODULE: OUTLINE
+Trace flow outlines as polygons with marching squares, straight from
+the grid, and write them as vector files:
+
+OUTLINE_INIT       look up the CRS of the DEM for the vector files
+OUTLINE_FOOTPRINT  FLOW_OUTLINE: per run, the outline of the inundated
+                   cells, plus thickness contours at THICKNESS_THRESHOLDS
+OUTLINE_HITS       HIT_OUTLINE: after the last run, contours of the hit
+                   probability (hits / runs) at HIT_OUTLINE_LEVELS
+
+Each level is one MultiPolygon feature. Polygon rings follow the
+right-hand rule: exteriors counter-clockwise, holes clockwise.
+
+Marching squares: the samples are the cell centers; a sample is inside
+when its value is > level. Each square of 4 samples gets 0, 1 or 2
+segments between the crossings on its edges, directed with the inside
+on the left; saddles are resolved by the mean of the 4 samples.
+A crossing is numbered by its edge, and next[edge] links the segments
+into closed rings. The grid is padded with a ring of outside samples,
+so every ring closes. The outline of the inundated cells is traced on
+a 0/1 mask at 0.5, which puts it halfway between cell centers;
+collinear vertices are dropped.
+
+Files are GeoJSON, written directly, with the (legacy) crs member
+naming the EPSG code of the DEM; OUTLINE_FORMAT names any other OGR
+vector driver (e.g. GPKG, "ESRI_Shapefile", with _ for spaces).
+*******************************/
+
+/* Rings traced at one level */
+typedef struct Rings {
+	double *x, *y;            /* vertices, ring after ring, not closed */
+	int nvert;
+	int vsize;
+	int *start;               /* first vertex of each ring, start[nrings] = nvert */
+	double *area;             /* signed area, > 0 for exteriors (counter-clockwise) */
+	int *outer;               /* exterior a hole belongs to, -1 for exteriors */
+	int nrings;
+	int rsize;
+} Rings;
+
+/* An open vector file, GeoJSON or OGR */
+typedef struct VectorFile {
+	FILE *json;
+	GDALDatasetH ds;
+	OGRLayerH layer;
+	int features;
+} VectorFile;
+
+static int rings_init(
+Rings *rg)
+{
+	rg->vsize = 1024;
+	rg->rsize = 64;
+	rg->x = (double *) GC_MALLOC_ATOMIC(rg->vsize * sizeof(double));
+	rg->y = (double *) GC_MALLOC_ATOMIC(rg->vsize * sizeof(double));
+	rg->start = (int *) GC_MALLOC_ATOMIC((rg->rsize + 1) * sizeof(int));
+	rg->area = (double *) GC_MALLOC_ATOMIC(rg->rsize * sizeof(double));
+	rg->outer = (int *) GC_MALLOC_ATOMIC(rg->rsize * sizeof(int));
+	rg->nvert = rg->nrings = 0;
+	return (rg->x == NULL || rg->y == NULL || rg->start == NULL || rg->area == NULL || rg->outer == NULL);
+}
+
+static int rings_add_vertex(
+Rings *rg,
+double x,
+double y)
+{
+	if (rg->nvert == rg->vsize) {
+		rg->vsize *= 2;
+		rg->x = (double *) GC_REALLOC(rg->x, rg->vsize * sizeof(double));
+		rg->y = (double *) GC_REALLOC(rg->y, rg->vsize * sizeof(double));
+		if (rg->x == NULL || rg->y == NULL) return 1;
+	}
+	rg->x[rg->nvert] = x;
+	rg->y[rg->nvert++] = y;
+	return 0;
+}
+
+/* Close the ring of vertices start[nrings] .. nvert-1: drop collinear
+   vertices and compute its signed area */
+static int rings_close(
+Rings *rg,
+double tolerance)
+{
+	int first = rg->start[rg->nrings], n = rg->nvert - first, i, kept = 0;
+	double *x = rg->x + first, *y = rg->y + first, px, py, cross, area = 0;
+
+	px = x[n - 1];
+	py = y[n - 1];
+	for (i = 0; i < n; i++) {
+		cross = (x[i] - px) * (y[(i + 1) % n] - y[i]) - (y[i] - py) * (x[(i + 1) % n] - x[i]);
+		if (fabs(cross) > tolerance) {
+			x[kept] = x[i];
+			y[kept++] = y[i];
+			px = x[i];
+			py = y[i];
+		}
+	}
+	rg->nvert = first + kept;
+	if (kept < 3) return 0;   /* nothing left of it */
+	for (i = 0; i < kept; i++) area += x[i] * y[(i + 1) % kept] - x[(i + 1) % kept] * y[i];
+
+	if (rg->nrings == rg->rsize) {
+		rg->rsize *= 2;
+		rg->start = (int *) GC_REALLOC(rg->start, (rg->rsize + 1) * sizeof(int));
+		rg->area = (double *) GC_REALLOC(rg->area, rg->rsize * sizeof(double));
+		rg->outer = (int *) GC_REALLOC(rg->outer, rg->rsize * sizeof(int));
+		if (rg->start == NULL || rg->area == NULL || rg->outer == NULL) return 1;
+	}
+	rg->area[rg->nrings++] = area / 2.0;
+	rg->start[rg->nrings] = rg->nvert;
+	return 0;
+}
+
+/* Crossing number test of a point against ring r */
+static int ring_contains(
+Rings *rg,
+int r,
+double px,
+double py)
+{
+	int i, j, inside = 0;
+	double *x = rg->x, *y = rg->y;
+
+	for (i = rg->start[r], j = rg->start[r + 1] - 1; i < rg->start[r + 1]; j = i++)
+		if (((y[i] > py) != (y[j] > py)) && (px < (x[j] - x[i]) * (py - y[i]) / (y[j] - y[i]) + x[i]))
+			inside = !inside;
+	return inside;
+}
+
+/* Trace the contour of v (R rows x C cols, row 0 south, padded with
+   outside samples) at level into rg. Sample (r, c) is at
+   (x0 + dx * c, y0 + dy * r). next holds 2 * R * C ints. */
+static int trace_level(
+const double *v,
+int R,
+int C,
+double level,
+double x0,
+double y0,
+double dx,
+double dy,
+int *next,
+Rings *rg)
+{
+	int r, c, k, j, e, cur, nx, edge[4], in[4], crossings, ret;
+	size_t hedges = (size_t) R * C, nedges = 2 * hedges, i;
+	const double *p, *q;
+	double t;
+
+	for (i = 0; i < nedges; i++) next[i] = -1;
+	rg->nvert = rg->nrings = 0;
+	rg->start[0] = 0;
+
+	for (r = 0; r < R - 1; r++) {
+		for (c = 0; c < C - 1; c++) {
+			/* corners counter-clockwise from the south-west; edge k runs from corner k to k+1 */
+			in[0] = v[r * C + c] > level;
+			in[1] = v[r * C + c + 1] > level;
+			in[2] = v[(r + 1) * C + c + 1] > level;
+			in[3] = v[(r + 1) * C + c] > level;
+			crossings = (in[0] != in[1]) + (in[1] != in[2]) + (in[2] != in[3]) + (in[3] != in[0]);
+			if (!crossings) continue;
+			edge[0] = r * C + c;                  /* south, horizontal edge of (r, c) */
+			edge[1] = (int) hedges + r * C + c + 1; /* east, vertical edge of (r, c+1) */
+			edge[2] = (r + 1) * C + c;            /* north */
+			edge[3] = (int) hedges + r * C + c;   /* west */
+			for (k = 0; k < 4; k++) {
+				if (!in[k] || in[(k + 1) % 4]) continue; /* not an exit */
+				/* link the exit to an entry: the next one when a saddle's
+				   center is inside, the one before it otherwise */
+				if (crossings == 4 && (v[r * C + c] + v[r * C + c + 1] +
+				    v[(r + 1) * C + c + 1] + v[(r + 1) * C + c]) / 4.0 > level) {
+					for (j = (k + 1) % 4; in[j] || !in[(j + 1) % 4]; j = (j + 1) % 4);
+				}
+				else {
+					for (j = (k + 3) % 4; in[j] || !in[(j + 1) % 4]; j = (j + 3) % 4);
+				}
+				next[edge[k]] = edge[j];
+			}
+		}
+	}
+
+	for (i = 0; i < nedges; i++) {
+		if (next[i] < 0) continue;
+		e = (int) i;
+		cur = e;
+		do {
+			/* crossing on the edge from sample p to sample q */
+			if (cur < (int) hedges) {
+				r = cur / C;
+				c = cur % C;
+				p = v + cur;
+				q = p + 1;
+			}
+			else {
+				r = (cur - (int) hedges) / C;
+				c = (cur - (int) hedges) % C;
+				p = v + (cur - (int) hedges);
+				q = p + C;
+			}
+			t = (level - *p) / (*q - *p);
+			if (t < 0.001) t = 0.001;       /* keep rings from touching at samples */
+			else if (t > 0.999) t = 0.999;
+			if (cur < (int) hedges) ret = rings_add_vertex(rg, x0 + dx * (c + t), y0 + dy * r);
+			else ret = rings_add_vertex(rg, x0 + dx * c, y0 + dy * (r + t));
+			if (ret) return 1;
+			nx = next[cur];
+			next[cur] = -1;
+			cur = nx;
+		} while (cur != e && cur >= 0);
+		if (rings_close(rg, 1e-9 * dx * dy)) return 1;
+	}
+
+	/* Each hole belongs to the smallest exterior around it */
+	for (r = 0; r < rg->nrings; r++) {
+		rg->outer[r] = -1;
+		if (rg->area[r] > 0) continue;
+		for (k = 0; k < rg->nrings; k++) {
+			if (rg->area[k] <= 0 || rg->area[k] < -rg->area[r]) continue;
+			if (rg->outer[r] >= 0 && rg->area[k] >= rg->area[rg->outer[r]]) continue;
+			if (ring_contains(rg, k, rg->x[rg->start[r]], rg->y[rg->start[r]])) rg->outer[r] = k;
+		}
+	}
+	return 0;
+}
+
+static int vector_open(
+VectorFile *vf,
+char *file,
+Outputs *Out,
+const char *layer,
+const char **fields,
+int nfields)
+{
+	OGRSpatialReferenceH srs = NULL;
+	OGRFieldDefnH field;
+	int i;
+
+	vf->json = NULL;
+	vf->ds = NULL;
+	vf->features = 0;
+	if (!strcmp(Out->outline_format, "GeoJSON")) {
+		vf->json = fopen(file, "w");
+		if (vf->json == NULL) {
+			fprintf(stderr, "Cannot open outline file=[%s]:[%s]!\n", file, strerror(errno));
+			return 1;
+		}
+		fprintf(vf->json, "{\"type\":\"FeatureCollection\",\"name\":\"%s\",\n", layer);
+		if (strlen(Out->outline_crs))
+			fprintf(vf->json, "\"crs\":{\"type\":\"name\",\"properties\":{\"name\":\"%s\"}},\n", Out->outline_crs);
+		fprintf(vf->json, "\"features\":[");
+		return 0;
+	}
+	vf->ds = GDALCreate(GDALGetDriverByName(Out->outline_format), file, 0, 0, 0, GDT_Unknown, NULL);
+	if (vf->ds == NULL) {
+		fprintf(stderr, "[OUTLINE] Cannot create %s file=[%s]!\n", Out->outline_format, file);
+		return 1;
+	}
+	if (strlen(Out->outline_wkt)) srs = OSRNewSpatialReference(Out->outline_wkt);
+	vf->layer = GDALDatasetCreateLayer(vf->ds, layer, srs, wkbMultiPolygon, NULL);
+	if (srs != NULL) OSRDestroySpatialReference(srs);
+	if (vf->layer == NULL) {
+		fprintf(stderr, "[OUTLINE] Cannot create layer %s in [%s]!\n", layer, file);
+		GDALClose(vf->ds);
+		return 1;
+	}
+	for (i = 0; i < nfields; i++) {
+		field = OGR_Fld_Create(fields[i], OFTReal);
+		OGR_L_CreateField(vf->layer, field, TRUE);
+		OGR_Fld_Destroy(field);
+	}
+	return 0;
+}
+
+/* Write ring r as a closed GeoJSON coordinate array */
+static void json_ring(
+FILE *out,
+Rings *rg,
+int r)
+{
+	char buf[64];
+	size_t n;
+	int i, k;
+
+	for (i = rg->start[r]; i <= rg->start[r + 1]; i++) {
+		k = (i < rg->start[r + 1]) ? i : rg->start[r]; /* first vertex again */
+		n = 0;
+		buf[n++] = (i == rg->start[r]) ? '[' : ',';
+		buf[n++] = '[';
+		n += format_fixed(buf + n, rg->x[k], 3);
+		buf[n++] = ',';
+		n += format_fixed(buf + n, rg->y[k], 3);
+		buf[n++] = ']';
+		fwrite(buf, 1, n, out);
+	}
+	fputc(']', out);
+}
+
+/* Append ring r to an OGR polygon */
+static void ogr_ring(
+OGRGeometryH polygon,
+Rings *rg,
+int r)
+{
+	OGRGeometryH ring = OGR_G_CreateGeometry(wkbLinearRing);
+	int i;
+
+	for (i = rg->start[r]; i < rg->start[r + 1]; i++) OGR_G_AddPoint_2D(ring, rg->x[i], rg->y[i]);
+	OGR_G_AddPoint_2D(ring, rg->x[rg->start[r]], rg->y[rg->start[r]]);
+	OGR_G_AddGeometryDirectly(polygon, ring);
+}
+
+/* Write the rings of one level as a MultiPolygon feature:
+   each exterior, followed by its holes */
+static int vector_feature(
+VectorFile *vf,
+Rings *rg,
+const char **fields,
+double *values,
+int nfields)
+{
+	OGRFeatureH feature;
+	OGRGeometryH multi, polygon;
+	int e, h, i, polygons = 0;
+
+	if (vf->json != NULL) {
+		fprintf(vf->json, "%s\n{\"type\":\"Feature\",\"properties\":{", vf->features ? "," : "");
+		for (i = 0; i < nfields; i++)
+			fprintf(vf->json, "%s\"%s\":%.10g", i ? "," : "", fields[i], values[i]);
+		fprintf(vf->json, "},\"geometry\":{\"type\":\"MultiPolygon\",\"coordinates\":[");
+		for (e = 0; e < rg->nrings; e++) {
+			if (rg->area[e] <= 0) continue;
+			fputs(polygons++ ? ",[" : "[", vf->json);
+			json_ring(vf->json, rg, e);
+			for (h = 0; h < rg->nrings; h++) {
+				if (rg->outer[h] != e) continue;
+				fputc(',', vf->json);
+				json_ring(vf->json, rg, h);
+			}
+			fputc(']', vf->json);
+		}
+		fputs("]}}", vf->json);
+		vf->features++;
+		return ferror(vf->json) != 0;
+	}
+
+	feature = OGR_F_Create(OGR_L_GetLayerDefn(vf->layer));
+	for (i = 0; i < nfields; i++) OGR_F_SetFieldDouble(feature, i, values[i]);
+	multi = OGR_G_CreateGeometry(wkbMultiPolygon);
+	for (e = 0; e < rg->nrings; e++) {
+		if (rg->area[e] <= 0) continue;
+		polygon = OGR_G_CreateGeometry(wkbPolygon);
+		ogr_ring(polygon, rg, e);
+		for (h = 0; h < rg->nrings; h++)
+			if (rg->outer[h] == e) ogr_ring(polygon, rg, h);
+		OGR_G_AddGeometryDirectly(multi, polygon);
+	}
+	OGR_F_SetGeometryDirectly(feature, multi);
+	if (OGR_L_CreateFeature(vf->layer, feature) != OGRERR_NONE) {
+		fprintf(stderr, "[OUTLINE] Cannot write feature!\n");
+		OGR_F_Destroy(feature);
+		return 1;
+	}
+	OGR_F_Destroy(feature);
+	vf->features++;
+	return 0;
+}
+
+static int vector_close(
+VectorFile *vf,
+char *file)
+{
+	if (vf->json != NULL) {
+		fputs("\n]}\n", vf->json);
+		if (ferror(vf->json) | fclose(vf->json)) {
+			fprintf(stderr, "Cannot write outline file=[%s]:[%s]!\n", file, strerror(errno));
+			return 1;
+		}
+		return 0;
+	}
+	GDALClose(vf->ds);
+	return 0;
+}
+
+/* Net area (square km) of the rings */
+static double rings_area(
+Rings *rg)
+{
+	double area = 0;
+	int r;
+
+	for (r = 0; r < rg->nrings; r++)
+		if (rg->area[r] > 0 || rg->outer[r] >= 0) area += rg->area[r];
+	return area / 1e6;
+}
+
+int OUTLINE_INIT(
+Inputs *In,
+Outputs *Out)
+{
+	OGRSpatialReferenceH srs;
+	GDALDriverH driver;
+	const char *name, *code, *ext;
+	char *p;
+
+	Out->outline_wkt = DEM_PROJECTION(In);
+	if (Out->outline_wkt == NULL) return 1;
+	Out->outline_crs = "";
+	if (strlen(Out->outline_wkt)) {
+		srs = OSRNewSpatialReference(Out->outline_wkt);
+		if (srs != NULL) {
+			code = OSRGetAuthorityCode(srs, NULL);
+			if (code == NULL && OSRAutoIdentifyEPSG(srs) == OGRERR_NONE) code = OSRGetAuthorityCode(srs, NULL);
+			name = OSRGetAuthorityName(srs, NULL);
+			if (code != NULL && name != NULL) {
+				Out->outline_crs = (char *) GC_MALLOC_ATOMIC(strlen(name) + strlen(code) + 32);
+				if (Out->outline_crs == NULL) {
+					fprintf(stderr, "[OUTLINE_INIT] Out of Memory!\n");
+					OSRDestroySpatialReference(srs);
+					return 1;
+				}
+				sprintf(Out->outline_crs, "urn:ogc:def:crs:%s::%s", name, code);
+			}
+			OSRDestroySpatialReference(srs);
+		}
+	}
+	if (!strcmp(Out->outline_format, "GeoJSON")) {
+		Out->outline_ext = ".geojson";
+		if (!strlen(Out->outline_crs))
+			fprintf(stderr, "[OUTLINE_INIT] No EPSG code for the DEM projection, GeoJSON outlines will have no crs.\n");
+	}
+	else {
+		driver = GDALGetDriverByName(Out->outline_format);
+		if (driver == NULL) { /* config values have no spaces: ESRI_Shapefile */
+			for (p = Out->outline_format; *p; p++) if (*p == '_') *p = ' ';
+			driver = GDALGetDriverByName(Out->outline_format);
+		}
+		if (driver == NULL) {
+			fprintf(stderr, "[OUTLINE_INIT] No OGR driver named %s!\n", Out->outline_format);
+			return 1;
+		}
+		ext = GDALGetMetadataItem(driver, GDAL_DMD_EXTENSION, NULL);
+		Out->outline_ext = "";
+		if (ext != NULL && strlen(ext)) {
+			Out->outline_ext = (char *) GC_MALLOC_ATOMIC(strlen(ext) + 2);
+			if (Out->outline_ext == NULL) {
+				fprintf(stderr, "[OUTLINE_INIT] Out of Memory!\n");
+				return 1;
+			}
+			sprintf(Out->outline_ext, ".%s", ext);
+		}
+	}
+	fprintf(stdout, "Writing %s outlines, crs %s\n", Out->outline_format,
+	        strlen(Out->outline_crs) ? Out->outline_crs : "unknown");
+	return 0;
+}
+
+int OUTLINE_FOOTPRINT(
+FlowFootprint *fp,
+Outputs *Out,
+double *gridinfo)
+{
+	static const char *fields[] = {"run", "volume", "thickness", "area_km2"};
+	char file[FILENAME_MAX];
+	VectorFile vf;
+	Rings rg;
+	double *v, values[4];
+	int *next, r0, r1, c0, c1, R, C, t, ret = 0;
+	unsigned int c;
+	size_t k;
+
+	snprintf(file, sizeof file, "%s%d%s", Out->flow_outline_file, fp->run, Out->outline_ext);
+	if (vector_open(&vf, file, Out, "outline", fields, 4)) return 1;
+	if (!fp->count) return vector_close(&vf, file);
+
+	/* samples: the cells around the footprint, with an outside ring */
+	r0 = fp->cells[0].row;
+	r1 = fp->cells[fp->count - 1].row;
+	c0 = c1 = fp->cells[0].col;
+	for (c = 1; c < fp->count; c++) {
+		if (fp->cells[c].col < c0) c0 = fp->cells[c].col;
+		if (fp->cells[c].col > c1) c1 = fp->cells[c].col;
+	}
+	R = r1 - r0 + 3;
+	C = c1 - c0 + 3;
+	v = (double *) GC_MALLOC_ATOMIC((size_t) R * C * sizeof(double));
+	next = (int *) GC_MALLOC_ATOMIC(2 * (size_t) R * C * sizeof(int));
+	if (v == NULL || next == NULL || rings_init(&rg)) {
+		fprintf(stderr, "[OUTLINE_FOOTPRINT] Out of Memory tracing run %d!\n", fp->run);
+		vector_close(&vf, file);
+		return 1;
+	}
+	values[0] = fp->run;
+	values[1] = fp->volume;
+
+	/* the outline of the inundated cells */
+	memset(v, 0, (size_t) R * C * sizeof(double));
+	for (c = 0; c < fp->count; c++)
+		v[(size_t) (fp->cells[c].row - r0 + 1) * C + fp->cells[c].col - c0 + 1] = 1.0;
+	if (trace_level(v, R, C, 0.5, gridinfo[0] + gridinfo[1] * (c0 - 1), gridinfo[3] + gridinfo[5] * (r0 - 1),
+	                gridinfo[1], gridinfo[5], next, &rg)) ret = 1;
+	else {
+		values[2] = 0.0;
+		values[3] = rings_area(&rg);
+		ret |= vector_feature(&vf, &rg, fields, values, 4);
+	}
+
+	/* thickness contours */
+	for (c = 0; c < fp->count; c++) {
+		k = (size_t) (fp->cells[c].row - r0 + 1) * C + fp->cells[c].col - c0 + 1;
+		v[k] = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+	}
+	for (t = 0; t < Out->num_thresholds && !ret; t++) {
+		if (trace_level(v, R, C, Out->thresholds[t], gridinfo[0] + gridinfo[1] * (c0 - 1),
+		                gridinfo[3] + gridinfo[5] * (r0 - 1), gridinfo[1], gridinfo[5], next, &rg)) ret = 1;
+		else if (rg.nrings) {
+			values[2] = Out->thresholds[t];
+			values[3] = rings_area(&rg);
+			ret |= vector_feature(&vf, &rg, fields, values, 4);
+		}
+	}
+	if (ret) fprintf(stderr, "[OUTLINE_FOOTPRINT] Error tracing run %d!\n", fp->run);
+	return vector_close(&vf, file) | ret;
+}
+
+int OUTLINE_HITS(
+DataCell **grid,
+int runs,
+Outputs *Out,
+double *gridinfo)
+{
+	static const char *fields[] = {"probability", "area_km2"};
+	VectorFile vf;
+	Rings rg;
+	double *v, values[2];
+	int *next, r0, r1, c0, c1, R, C, row, col, l, ret = 0;
+	int rows = (int) gridinfo[4], cols = (int) gridinfo[2];
+
+	if (vector_open(&vf, Out->hit_outline_file, Out, "hit_probability", fields, 2)) return 1;
+	/* samples: the cells around the area hit, with an outside ring */
+	r0 = rows; r1 = -1; c0 = cols; c1 = -1;
+	for (row = 0; row < rows; row++) {
+		for (col = 0; col < cols; col++) {
+			if (!grid[row][col].hit_count) continue;
+			if (row < r0) r0 = row;
+			r1 = row;
+			if (col < c0) c0 = col;
+			if (col > c1) c1 = col;
+		}
+	}
+	if (r1 < 0 || runs < 1) return vector_close(&vf, Out->hit_outline_file);
+	R = r1 - r0 + 3;
+	C = c1 - c0 + 3;
+	v = (double *) GC_MALLOC_ATOMIC((size_t) R * C * sizeof(double));
+	next = (int *) GC_MALLOC_ATOMIC(2 * (size_t) R * C * sizeof(int));
+	if (v == NULL || next == NULL || rings_init(&rg)) {
+		fprintf(stderr, "[OUTLINE_HITS] Out of Memory tracing %d x %d cells!\n", R, C);
+		vector_close(&vf, Out->hit_outline_file);
+		return 1;
+	}
+	memset(v, 0, (size_t) R * C * sizeof(double));
+	for (row = r0; row <= r1; row++)
+		for (col = c0; col <= c1; col++)
+			v[(size_t) (row - r0 + 1) * C + col - c0 + 1] = (double) grid[row][col].hit_count / runs;
+
+	for (l = 0; l < Out->num_hit_levels && !ret; l++) {
+		if (trace_level(v, R, C, Out->hit_levels[l], gridinfo[0] + gridinfo[1] * (c0 - 1),
+		                gridinfo[3] + gridinfo[5] * (r0 - 1), gridinfo[1], gridinfo[5], next, &rg)) ret = 1;
+		else if (rg.nrings) {
+			values[0] = Out->hit_levels[l];
+			values[1] = rings_area(&rg);
+			ret |= vector_feature(&vf, &rg, fields, values, 2);
+		}
+	}
+	if (ret) fprintf(stderr, "[OUTLINE_HITS] Error tracing hit probabilities!\n");
+	else fprintf(stdout, "Hit probability outlines: %s\n", Out->hit_outline_file);
+	return vector_close(&vf, Out->hit_outline_file) | ret;
+}
@@ -30,11 +30,17 @@ Print out flow data to a file.
 File types to output:
 	0 = flow_map, format = X Y Z, easting northing thickness(m)
 	1 = hits_map, format = X Y Z, easting northing hits(count)
+	7 = flow archive, one record per run in one file (see archive_LJC2.c)
+	8 = binary flow map, easting northing thickness new_elev orig_elev as doubles
+	6 = stats file, one CSV line per run from active_flow->stats
+	2 = hits raster, UInt32 or UInt16 (RASTER_HIT_TYPE)
+	3 = thickness raster, Float32
+	4 = post-flow elevation raster, Float32
 	not implemented:
-	2: Thickness Raster
-	3: Elevation Raster
-	4: Elevation + Lava Raster (2+3)
-	5: Update internal DEMgrid to build volcano from lavaflows
+	5: Elevation Raster
+	
+Rasters are written with WRITE_RASTER as tiled GeoTIFFs, compressed
+as chosen by RASTER_COMPRESSION, in the projection of the DEM.
 	
 
 GeoTransform Double List:	
@@ -65,6 +71,40 @@ Retrieve hit count values and print to hit map:
 x y z: easting  northing  count
 *******************************/
 
+/*****************************
+MODULE: OUTPUT_FOOTPRINT
+Write the per-run outputs of a finished flow from its footprint 
+snapshot (see FOOTPRINT_SNAPSHOT): the ASCII and/or binary flow
+maps (see FLOW_WRITER), the flow archive record, the footprint
+index record, the flow outline (see OUTLINE), the quick-look
+image (see QUICKLOOK) and the arrival map (see ARRIVAL).
+Safe to call from the output writer threads.
+RETURN: 0 on success, 1 on error
+*******************************/
+int OUTPUT_FOOTPRINT(
+FlowFootprint *fp,
+Outputs *Out,
+double *geotransform) {
+
+	int ret = 0;
+	
+	if (strlen(Out->ascii_flow_file) > 0) 
+		ret |= WRITE_ASCII_FLOW(fp, Out->ascii_flow_file, geotransform);
+	if (strlen(Out->binary_flow_file) > 0) 
+		ret |= WRITE_BINARY_FLOW(fp, Out->binary_flow_file, geotransform);
+	if (Out->flow_archive != NULL)
+		ret |= ARCHIVE_WRITE_RUN(Out->flow_archive, fp);
+	if (Out->footprint_index != NULL)
+		ret |= FOOTINDEX_WRITE_RUN(Out->footprint_index, fp);
+	if (strlen(Out->flow_outline_file) > 0)
+		ret |= OUTLINE_FOOTPRINT(fp, Out, geotransform);
+	if (Out->quicklook != NULL && strlen(Out->quicklook_flow_file) > 0)
+		ret |= QUICKLOOK_FOOTPRINT(Out->quicklook, fp, Out->quicklook_flow_file);
+	if (Out->arrival != NULL && strlen(Out->arrival_file) > 0)
+		ret |= ARRIVAL_WRITE_RUN(Out->arrival, fp, Out, geotransform);
+	return ret;
+}
+
 int OUTPUT(
 int run,
 File_output_type type,
@@ -77,28 +117,18 @@ double *geotransform) {
 
 	FILE     *out;
 	int row, col, i, j, k;
-	double easting, northing, thickness, new_elev, orig_elev, value;
-	char file[25];
-	/* GDAL variables */
-	char projection[] = "";
-	GDALDatasetH hDstDS;
-	double GDALGeoTransform[6];
-	GDALDriverH hDriver = GDALGetDriverByName("GTiff"); /*Try this*/
-	GDALRasterBandH hBand;
+	double easting, northing, value;
+	char file[FILENAME_MAX];
 	float   *RasterDataF = NULL;
-	int raster_double_file = 0;
-	CPLErr IOErr;
-	
-	/*Modify Metadata back to GDAL format*/
-	GDALGeoTransform[0] = geotransform[0];
-	GDALGeoTransform[1] = geotransform[1];
-	GDALGeoTransform[3] = geotransform[3] + (geotransform[5] * geotransform[4]);
-	GDALGeoTransform[5] = -1 * geotransform[5];
-	GDALGeoTransform[2] = GDALGeoTransform[4] = 0;
+	GUInt32 *RasterDataU32 = NULL;
+	GUInt16 *RasterDataU16 = NULL;
+	unsigned int max_hits = 0;
+	FlowFootprint *fp;
+	FlowStats *stats;
 	
 	/*Create Data Block*/
-	if (type > 1) {
-		if((RasterDataF = GC_MALLOC (sizeof (float) * geotransform[2] *
+	if (type == raster_flow || type == raster_post) {
+		if((RasterDataF = GC_MALLOC_ATOMIC (sizeof (float) * geotransform[2] *
 						                     geotransform[4])) == NULL) {
 			printf("[OUTPUT] Out of Memory creating Outgoing Raster Data Array\n");
 			return(1);
@@ -109,47 +139,17 @@ double *geotransform) {
 		switch(type) {
 	
 		case ascii_flow :
-			sprintf (file, "%s%d", Out->ascii_flow_file, run);
-			out  = fopen(file, "w");
-			if (out == NULL) {
-				fprintf(stderr, "Cannot open ASCII FLOW file=[%s]:[%s]!\n",
-				file, strerror(errno));
-				return 1;
-			}	
-			/* Print file header */
-			fprintf (out, "# VOLUME PULSE RESIDUAL VENTS\n");
+			fp = FOOTPRINT_SNAPSHOT(grid, active_flow, geotransform, run);
+			if (fp == NULL || WRITE_ASCII_FLOW(fp, Out->ascii_flow_file, geotransform)) return 1;
+		break;
 		
-			fprintf(out, "# %0.4f\t%0.4f\t%0.1f ",
-			        active_flow->volumeToErupt, active_flow->pulsevolume, active_flow->residual ); 
-			        
-      for (i = 0; i < active_flow->num_vents; i++) {
-				fprintf(out, " %0.3f\t%.03f\t", (active_flow->source+i)->easting, (active_flow->source+i)->northing);
-			}
-						
-			fprintf (out, "\n# EAST NORTH THICKNESS NEW_ELEV ORIG_ELEV");
-			
-			/* Print data */
-			for(row=0; row < geotransform[4]; row++) { 
-				for(col=0; col < geotransform[2]; col++) {
-					thickness = grid[row][col].eff_elev - grid[row][col].dem_elev;
-					if (thickness > 0) {
-						easting = geotransform[0] + (geotransform[1] * col);
-					   northing = geotransform[3] + (geotransform[5] * row);
-				   	new_elev = grid[row][col].eff_elev;
-				   	orig_elev = grid[row][col].dem_elev;
-				   	fprintf(out, "\n%0.3f\t%0.3f\t%f\t%f\t%f", easting, northing, thickness, new_elev, orig_elev);	
-					}
-				}
-			}
-			
-			raster_double_file = 0;
-			fflush(out);
-		 fclose(out);
-		 fprintf(stderr, " ASCII Output file: %s successfully written.\n \n", file);
+		case binary_flow :
+			fp = FOOTPRINT_SNAPSHOT(grid, active_flow, geotransform, run);
+			if (fp == NULL || WRITE_BINARY_FLOW(fp, Out->binary_flow_file, geotransform)) return 1;
 		break;
 		
 		case ascii_hits :
-			sprintf (file, "%s%d", Out->ascii_hits_file, run);
+			snprintf (file, sizeof file, "%s%d", Out->ascii_hits_file, run);
 			out = fopen(file, "w");
 			if (out == NULL) {
 				fprintf(stderr, "Cannot open hits file: file=[%s]:[%s]! Exiting.\n",
@@ -165,38 +165,52 @@ double *geotransform) {
 					if (value > 0) fprintf(out, "\n%0.3f\t%0.3f\t%0.0f", easting, northing, value);
 				}
 			}
-			raster_double_file = 0;
 			fflush(out);
 			fclose(out);
 			fprintf(stderr, " ASCII Hits file: %s successfully written.\n (x,y,hit count)\n", file);
 		break;
 		
 		case raster_hits : /* Raster hits file */
-			sprintf (file, "%s%d", Out->raster_hits_file, run);
-			out = fopen(file, "w");
-			if (out == NULL) {
-				fprintf(stderr, "Cannot open hits file: file=[%s]:[%s]! Exiting.\n",
-	              file, strerror(errno));
-	    	return 1;
+			snprintf (file, sizeof file, "%s%d", Out->raster_hits_file, run);
+			for (i = 0; i < geotransform[4]; i++)
+				for (j = 0; j < geotransform[2]; j++)
+					if ((unsigned int) grid[i][j].hit_count > max_hits) max_hits = grid[i][j].hit_count;
+			if (Out->raster_hits_type == GDT_UInt16 && max_hits > 65535) {
+				fprintf(stderr, "[OUTPUT] %u hits do not fit in UInt16, writing UInt32.\n", max_hits);
+				Out->raster_hits_type = GDT_UInt32;
 			}
 			/*Assign Model Data to Data Block*/	
 			k=0; /*Data Counter*/
-			for (i = geotransform[4]; i > 0; i--) { 			/*For each row, TOP DOWN*/
-				for(j=0; j < geotransform[2]; j++) {		/*For each col, Left->Right*/
-						RasterDataF[k++] = (float) (grid[i-1][j].hit_count); 
+			if (Out->raster_hits_type == GDT_UInt16) {
+				if((RasterDataU16 = GC_MALLOC_ATOMIC (sizeof (GUInt16) * geotransform[2] *
+				                                      geotransform[4])) == NULL) {
+					printf("[OUTPUT] Out of Memory creating Outgoing Raster Data Array\n");
+					return(1);
+				}
+				for (i = geotransform[4]; i > 0; i--) { 			/*For each row, TOP DOWN*/
+					for(j=0; j < geotransform[2]; j++) {		/*For each col, Left->Right*/
+						RasterDataU16[k++] = (GUInt16) (grid[i-1][j].hit_count); 
 					}
 				}
-			raster_double_file = 1;
+				if (WRITE_RASTER(file, RasterDataU16, GDT_UInt16, 1, Out, In, geotransform)) return 1;
+			}
+			else {
+				if((RasterDataU32 = GC_MALLOC_ATOMIC (sizeof (GUInt32) * geotransform[2] *
+				                                      geotransform[4])) == NULL) {
+					printf("[OUTPUT] Out of Memory creating Outgoing Raster Data Array\n");
+					return(1);
+				}
+				for (i = geotransform[4]; i > 0; i--) { 			/*For each row, TOP DOWN*/
+					for(j=0; j < geotransform[2]; j++) {		/*For each col, Left->Right*/
+						RasterDataU32[k++] = (GUInt32) (grid[i-1][j].hit_count); 
+					}
+				}
+				if (WRITE_RASTER(file, RasterDataU32, GDT_UInt32, 1, Out, In, geotransform)) return 1;
+			}
 		break;
 		
 		case raster_flow : /* Lava Thickness Raster */
-			sprintf (file, "%s%d", Out->raster_flow_file, run);
-			out = fopen(file, "w");
-			if (out == NULL) {
-				fprintf(stderr, "Cannot open hits file: file=[%s]:[%s]! Exiting.\n",
-	              file, strerror(errno));
-	    	return 1;
-			}
+			snprintf (file, sizeof file, "%s%d", Out->raster_flow_file, run);
 			/*Assign Model Data to Data Block*/	
 			k=0; /*Data Counter*/
 			for (i = geotransform[4]; i > 0; i--) { 			/*For each row, TOP DOWN*/
@@ -207,17 +221,11 @@ double *geotransform) {
 					else RasterDataF[k++] = (float) 0.0; /* Else print out 0  */
 				}
 			}
-			raster_double_file = 1;
+			if (WRITE_RASTER(file, RasterDataF, GDT_Float32, 1, Out, In, geotransform)) return 1;
 		break;
 		
 		case raster_post : /*POST FLOW TOPOGRAPHY RASTER*/
-			sprintf (file, "%s%d", Out->raster_post_dem_file, run);
-			out = fopen(file, "w");
-			if (out == NULL) {
-				fprintf(stderr, "Cannot open hits file: file=[%s]:[%s]! Exiting.\n",
-	              file, strerror(errno));
-	    	return 1;
-			}
+			snprintf (file, sizeof file, "%s%d", Out->raster_post_dem_file, run);
 			/*Assign Model Data to Data Block*/
 			k=0; /*Data Counter*/
 			for (i = geotransform[4]; i > 0; i--) { /*For each row, TOP DOWN*/
@@ -225,43 +233,174 @@ double *geotransform) {
 					RasterDataF[k++] = (float) grid[i-1][j].eff_elev;
 				}
 			}
-			raster_double_file = 1;
+			if (WRITE_RASTER(file, RasterDataF, GDT_Float32, 1, Out, In, geotransform)) return 1;
 		break;
 		
 		case raster_pre :
 		
 		break;
 		
-		case stats_file :
+		case stats_file : /* one CSV line per run, see FlowStats */
+			if (Out->stats == NULL) {
+				Out->stats = fopen(Out->stats_file, "w");
+				if (Out->stats == NULL) {
+					fprintf(stderr, "Cannot open STATS file=[%s]:[%s]!\n",
+					Out->stats_file, strerror(errno));
+					return 1;
+				}
+				fprintf(Out->stats, "run,seed1,seed2,vents,volume,pulse_volume,residual,"
+				        "pulses,ca_list_size,cells,area_km2,max_thickness,runout,mass_error,wall_seconds\n");
+			}
+			stats = &active_flow->stats;
+			fprintf(Out->stats, "%d,%d,%d,", run, stats->seed1, stats->seed2);
+			for (i = 0; i < active_flow->num_vents; i++) 
+				fprintf(Out->stats, "%s%0.3f %0.3f", i ? ";" : "",
+				        active_flow->source[i].easting, active_flow->source[i].northing);
+			fprintf(Out->stats, ",%0.4f,%0.4f,%0.4f,%u,%u,%u,%0.6f,%f,%0.3f,%0.6g,%0.3f\n",
+			        stats->total_volume, stats->pulse_volume, stats->residual,
+			        stats->pulse_count, stats->ca_list_size, stats->active_count, stats->area,
+			        stats->max_thickness, stats->runout, stats->mass_error, stats->wall_time);
+			if (fflush(Out->stats)) {
+				fprintf(stderr, "Cannot write STATS file=[%s]:[%s]!\n", Out->stats_file, strerror(errno));
+				return 1;
+			}
+		break;
 		
+		case flow_archive :
+			fp = FOOTPRINT_SNAPSHOT(grid, active_flow, geotransform, run);
+			if (fp == NULL || ARCHIVE_WRITE_RUN(Out->flow_archive, fp)) return 1;
 		break;
 		
 		default :
 			fprintf (stderr, "[OUTPUT] No ouput files specified!\n");
 		}
-	//Write the raster file here if cells have double floating point values.
-	if (raster_double_file) {
-		
-		/*Setup Raster Dataset*/
-		hDstDS = GDALCreate(hDriver, file, geotransform[2], 
-			                  geotransform[4], 1, GDT_Float32, NULL);		
-		GDALSetGeoTransform( hDstDS, GDALGeoTransform ); /*Set Transform*/
-		GDALSetProjection( hDstDS, projection );     /*Set Projection*/
-		hBand = GDALGetRasterBand( hDstDS, 1 );      /*Set Band to 1*/
-		
-		/*Write the formatted raster data to a file*/
+	return(0);
+}
+
+/*****************************
+MODULE: WRITE_RASTER
+Write a block of raster data to a GeoTIFF file.
+The data block holds [bands] bands one after the other, each band 
+[cols]x[rows] of [data_type], TOP DOWN and Left->Right.
+	
+Creation options:
+	tiled, 256x256 blocks
+	compression from Out->raster_compression (NONE, DEFLATE, ZSTD, LZW),
+	with the horizontal (integer) or floating point predictor
+	compressed by all available cpus
+	projection (CRS) copied from the DEM
+	RUNS metadata item: the runs of an ensemble output (Out->ensemble_runs,
+	set by ENSEMBLE_WRITE), fewer than RUNS when it stopped early
+	
+RETURN: 0 on success, 1 on error
+*******************************/
+int WRITE_RASTER(
+char *file,
+void *data,
+GDALDataType data_type,
+int bands,
+Outputs *Out,
+Inputs *In,
+double *geotransform) {
+
+	GDALDatasetH hDstDS;
+	double GDALGeoTransform[6];
+	GDALDriverH hDriver = GDALGetDriverByName("GTiff");
+	GDALRasterBandH hBand;
+	char **options = NULL;
+	char runs[32];
+	size_t band_size;
+	int b;
+	CPLErr IOErr = CE_None;
+	
+	/*Modify Metadata back to GDAL format*/
+	GDALGeoTransform[0] = geotransform[0];
+	GDALGeoTransform[1] = geotransform[1];
+	GDALGeoTransform[3] = geotransform[3] + (geotransform[5] * geotransform[4]);
+	GDALGeoTransform[5] = -1 * geotransform[5];
+	GDALGeoTransform[2] = GDALGeoTransform[4] = 0;
+	
+	if (DEM_PROJECTION(In) == NULL) return 1;
+	
+	options = CSLSetNameValue(options, "TILED", "YES");
+	options = CSLSetNameValue(options, "BLOCKXSIZE", "256");
+	options = CSLSetNameValue(options, "BLOCKYSIZE", "256");
+	options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+	if (bands > 1) options = CSLSetNameValue(options, "INTERLEAVE", "BAND");
+	if (Out->raster_compression != NULL && strcmp(Out->raster_compression, "NONE")) {
+		options = CSLSetNameValue(options, "COMPRESS", Out->raster_compression);
+		options = CSLSetNameValue(options, "PREDICTOR", (data_type == GDT_Float32) ? "3" : "2");
+		options = CSLSetNameValue(options, "NUM_THREADS", "ALL_CPUS");
+		if (!strcmp(Out->raster_compression, "ZSTD")) 
+			options = CSLSetNameValue(options, "ZSTD_LEVEL", "9");
+	}
+	
+	/*Setup Raster Dataset*/
+	hDstDS = GDALCreate(hDriver, file, geotransform[2], 
+		                  geotransform[4], bands, data_type, options);
+	CSLDestroy(options);
+	if (hDstDS == NULL) {
+		fprintf(stderr, "ERROR [WRITE_RASTER]: Cannot create raster file=[%s]!\n", file);
+		return 1;
+	}
+	GDALSetGeoTransform( hDstDS, GDALGeoTransform ); /*Set Transform*/
+	GDALSetProjection( hDstDS, In->dem_projection );     /*Set Projection*/
+	if (Out->ensemble_runs > 0) {
+		snprintf(runs, sizeof runs, "%d", Out->ensemble_runs);
+		GDALSetMetadataItem(hDstDS, "RUNS", runs, NULL);
+	}
+	
+	/*Write the formatted raster data to a file, band by band*/
+	band_size = (size_t) geotransform[2] * (size_t) geotransform[4];
+	switch (data_type) {
+		case GDT_UInt16 : band_size *= sizeof(GUInt16); break;
+		case GDT_UInt32 : band_size *= sizeof(GUInt32); break;
+		default :         band_size *= sizeof(float);
+	}
+	for (b = 0; b < bands && IOErr == CE_None; b++) {
+		hBand = GDALGetRasterBand( hDstDS, b+1 );
 		IOErr = GDALRasterIO(hBand, GF_Write, 0, 0, geotransform[2], geotransform[4],
-		        RasterDataF, geotransform[2], geotransform[4], GDT_Float32, 0, 0);
-		if(IOErr) {
-			fprintf(stderr, "ERROR [OUTPUT]: Error from GDALRasterIO!!\n");
-			return 1;
-		}
-		
-		/*Properly close the raster dataset*/
-		GDALClose( hDstDS );
-		/* free(RasterDataF); */
-		
-		fprintf(stderr, "Raster Output file: %s successfully written.\n", file); 
+		        (char *) data + b * band_size, geotransform[2], geotransform[4], data_type, 0, 0);
 	}
+	
+	/*Properly close the raster dataset*/
+	GDALClose( hDstDS );
+	if(IOErr) {
+		fprintf(stderr, "ERROR [WRITE_RASTER]: Error from GDALRasterIO!!\n");
+		return 1;
+	}
+	
+	fprintf(stderr, "Raster Output file: %s successfully written.\n", file); 
 	return(0);
 }
+
+/*****************************
+MODULE: DEM_PROJECTION
+Look up the projection (WKT) of the DEM once; all output rasters and
+vector files share it.
+RETURN: the WKT, "" if the DEM has none, NULL on error
+*******************************/
+char *DEM_PROJECTION(
+Inputs *In) {
+
+	GDALDatasetH hDEM;
+	
+	if (In->dem_projection != NULL) return In->dem_projection;
+	In->dem_projection = "";
+	hDEM = GDALOpen(In->dem_file, GA_ReadOnly);
+	if (hDEM != NULL) {
+		if (GDALGetProjectionRef(hDEM) != NULL) {
+			In->dem_projection = (char *) GC_MALLOC_ATOMIC(strlen(GDALGetProjectionRef(hDEM)) + 1);
+			if (In->dem_projection == NULL) {
+				fprintf(stderr, "[DEM_PROJECTION] Out of Memory copying DEM projection\n");
+				GDALClose(hDEM);
+				return NULL;
+			}
+			strcpy(In->dem_projection, GDALGetProjectionRef(hDEM));
+		}
+		GDALClose(hDEM);
+	}
+	if (!strlen(In->dem_projection))
+		fprintf(stderr, "[DEM_PROJECTION] DEM [%s] has no projection, outputs will have none.\n", In->dem_file);
+	return In->dem_projection;
+}
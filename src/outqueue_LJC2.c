@@ -0,0 +1,197 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: OUTPUT_QUEUE
+Bounded queue of finished flow footprints, emptied by writer threads
+(OUTPUT_THREADS in the config file) that write the per-run output files
+with OUTPUT_FOOTPRINT, while the driver goes on with the next run.
+
+OUTPUT_QUEUE_INIT  start the writer threads
+OUTPUT_QUEUE_PUSH  hand a footprint to the writers; waits while the
+                   queue is full (backpressure)
+OUTPUT_QUEUE_FLUSH wait until every footprint handed over is written
+OUTPUT_QUEUE_CLOSE write what is left, stop the writers and
+                   print the queue depth statistics
+
+With 0 writer threads, OUTPUT_QUEUE_PUSH writes the footprint itself.
+Writer threads are created through the collector (GC_THREADS), so
+a footprint they hold stays alive while it is written.
+*******************************/
+
+static double seconds_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+}
+
+/* Writer thread: take footprints off the queue until it is closed and empty */
+static void *output_writer(
+void *arg)
+{
+	OutputQueue *q = (OutputQueue *) arg;
+	FlowFootprint *fp;
+	int ret;
+
+	for (;;) {
+		pthread_mutex_lock(&q->lock);
+		while (!q->count && !q->closing) pthread_cond_wait(&q->not_empty, &q->lock);
+		if (!q->count) { /* closing and nothing left */
+			pthread_mutex_unlock(&q->lock);
+			return NULL;
+		}
+		fp = q->slots[q->head];
+		q->slots[q->head] = NULL;
+		q->head = (q->head + 1) % q->capacity;
+		q->count--;
+		pthread_cond_signal(&q->not_full);
+		pthread_mutex_unlock(&q->lock);
+
+		ret = OUTPUT_FOOTPRINT(fp, q->Out, q->gridinfo);
+
+		pthread_mutex_lock(&q->lock);
+		if (ret) q->errors++;
+		q->written++;
+		pthread_cond_broadcast(&q->idle);
+		pthread_mutex_unlock(&q->lock);
+	}
+}
+
+OutputQueue *OUTPUT_QUEUE_INIT(
+int threads,
+int capacity,
+Outputs *Out,
+double *gridinfo)
+{
+	OutputQueue *q;
+	int i, ret;
+
+	q = (OutputQueue *) GC_MALLOC(sizeof(OutputQueue));
+	if (q == NULL) {
+		fprintf(stderr, "[OUTPUT_QUEUE_INIT] Out of Memory creating output queue!\n");
+		return NULL;
+	}
+	if (capacity < 1) capacity = 1;
+	q->capacity = capacity;
+	q->slots = (FlowFootprint **) GC_MALLOC((size_t) capacity * sizeof(FlowFootprint *));
+	q->threads = (pthread_t *) GC_MALLOC_ATOMIC((size_t) (threads + 1) * sizeof(pthread_t));
+	if (q->slots == NULL || q->threads == NULL) {
+		fprintf(stderr, "[OUTPUT_QUEUE_INIT] Out of Memory creating output queue!\n");
+		return NULL;
+	}
+	q->Out = Out;
+	q->gridinfo = gridinfo;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->not_empty, NULL);
+	pthread_cond_init(&q->not_full, NULL);
+	pthread_cond_init(&q->idle, NULL);
+
+	for (i = 0; i < threads; i++) {
+		if ((ret = pthread_create(q->threads + i, NULL, output_writer, q))) {
+			fprintf(stderr, "[OUTPUT_QUEUE_INIT] Cannot start output thread %d:[%s]\n", i, strerror(ret));
+			break;
+		}
+		q->nthreads++;
+	}
+	if (q->nthreads)
+		fprintf(stdout, "Output: %d writer threads, queue of %d runs.\n", q->nthreads, q->capacity);
+	return q;
+}
+
+/* Hand a footprint to the writer threads.
+   RETURN: 0, or 1 if it was written here and that failed */
+int OUTPUT_QUEUE_PUSH(
+OutputQueue *q,
+FlowFootprint *fp)
+{
+	double wait_start;
+	int ret;
+
+	if (!q->nthreads) { /* synchronous output */
+		ret = OUTPUT_FOOTPRINT(fp, q->Out, q->gridinfo);
+		q->pushed++;
+		q->written++;
+		if (ret) q->errors++;
+		return ret;
+	}
+
+	pthread_mutex_lock(&q->lock);
+	if (q->count == q->capacity) { /* writers are behind, wait for a free slot */
+		q->stalls++;
+		wait_start = seconds_now();
+		while (q->count == q->capacity) pthread_cond_wait(&q->not_full, &q->lock);
+		q->stall_seconds += seconds_now() - wait_start;
+	}
+	q->slots[(q->head + q->count) % q->capacity] = fp;
+	q->count++;
+	q->pushed++;
+	q->depth_sum += q->count;
+	if (q->count > q->max_depth) q->max_depth = q->count;
+	pthread_cond_signal(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
+
+/* Wait for the writers to write every footprint pushed so far, so the
+   per-run outputs of the finished runs are complete (see ENSEMBLE_STATE).
+   RETURN: number of footprints that could not be written */
+int OUTPUT_QUEUE_FLUSH(
+OutputQueue *q)
+{
+	int errors;
+
+	pthread_mutex_lock(&q->lock);
+	while (q->written < q->pushed) pthread_cond_wait(&q->idle, &q->lock);
+	errors = q->errors;
+	pthread_mutex_unlock(&q->lock);
+	return errors;
+}
+
+/* Let the writers empty the queue, stop them and report.
+   RETURN: number of footprints that could not be written */
+int OUTPUT_QUEUE_CLOSE(
+OutputQueue *q)
+{
+	int i;
+
+	pthread_mutex_lock(&q->lock);
+	q->closing = 1;
+	pthread_cond_broadcast(&q->not_empty);
+	pthread_mutex_unlock(&q->lock);
+	for (i = 0; i < q->nthreads; i++) pthread_join(q->threads[i], NULL);
+
+	if (q->nthreads && q->pushed) {
+		fprintf(stdout, "\nOutput queue: %lu runs written by %d threads.\n", q->written, q->nthreads);
+		fprintf(stdout, "  Queue depth:  mean %0.2f, max %d of %d\n",
+		        (double) q->depth_sum / (double) q->pushed, q->max_depth, q->capacity);
+		fprintf(stdout, "  Queue full:   %lu times, simulation waited %0.3f seconds\n",
+		        q->stalls, q->stall_seconds);
+	}
+	if (q->errors) fprintf(stderr, "[OUTPUT_QUEUE] %d runs could not be written!\n", q->errors);
+	return q->errors;
+}
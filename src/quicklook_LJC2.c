@@ -0,0 +1,529 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+#include <unistd.h>
+
+/*****************************
+MODULE: QUICKLOOK
+Quick-look images of the flows, rendered from the grid without GMT
+(see plotting/plot_flow.gmt.pl for publication maps):
+
+QUICKLOOK_INIT       shade the DEM once: Horn hillshade (sun from the
+                     north-west, 45 degrees up) over an inverted copper
+                     ramp of elevation, like plot_flow.gmt.pl
+QUICKLOOK_FOOTPRINT  QUICKLOOK_FLOW: per run, lava thickness over the
+                     shaded DEM, from 0 to 2 x residual as in the
+                     GMT script, and the vents of the run
+QUICKLOOK_HITS       QUICKLOOK_HITS: hit probability (hits / runs)
+                     over the shaded DEM, and the vents of VENTS_FILE
+
+Lava colours follow an inverted "hot" ramp: yellow for thin lava or
+a low probability, dark red for thick lava or a high probability.
+Images are PNG (8 bit RGB) or PPM (P6), chosen by QUICKLOOK_FORMAT.
+QUICKLOOK_WIDTH limits the image width: a pixel then covers a block
+of cells and shows the largest value in it.
+
+The work is split by image rows over QUICKLOOK_THREADS threads
+(default: all cpus): shading the DEM, and compressing the PNG, where
+each block of rows is deflated on its own and the blocks are joined
+with sync flushes into one zlib stream (as pigz does). With several
+OUTPUT_THREADS the per-run images are already written in parallel,
+so each one is rendered on its writer thread alone.
+*******************************/
+
+#define QUICKLOOK_VENT_RADIUS 3   /* pixels */
+
+/* A block of image rows for one thread */
+typedef struct RowJob {
+	QuickLook *ql;
+	DataCell **grid;
+	unsigned char *image;
+	int y0, y1;               /* rows y0 .. y1-1 */
+	int last;                 /* last block of the image */
+	unsigned char *out;       /* deflated rows */
+	size_t out_size;
+	size_t out_len;
+	uLong adler;              /* adler32 of the filtered rows */
+	int err;
+} RowJob;
+
+/* Run fn on the blocks of rows, one thread each */
+static int run_jobs(
+RowJob *jobs,
+int njobs,
+void *(*fn)(void *))
+{
+	pthread_t *threads;
+	int i, ret, started = 0, err = 0;
+
+	if (njobs == 1) {
+		fn(jobs);
+		return jobs[0].err;
+	}
+	threads = (pthread_t *) GC_MALLOC_ATOMIC(njobs * sizeof(pthread_t));
+	if (threads == NULL) {
+		fprintf(stderr, "[QUICKLOOK] Out of Memory starting threads!\n");
+		return 1;
+	}
+	for (i = 0; i < njobs; i++, started++) {
+		if ((ret = pthread_create(threads + i, NULL, fn, jobs + i))) {
+			fprintf(stderr, "[QUICKLOOK] Cannot start thread %d:[%s]\n", i, strerror(ret));
+			break;
+		}
+	}
+	for (; i < njobs; i++) fn(jobs + i); /* left over blocks */
+	for (i = 0; i < started; i++) pthread_join(threads[i], NULL);
+	for (i = 0; i < njobs; i++) err |= jobs[i].err;
+	return err;
+}
+
+/* Split the image rows into blocks */
+static RowJob *row_jobs(
+QuickLook *ql,
+int n,
+int *njobs)
+{
+	RowJob *jobs;
+	int i;
+
+	if (n > ql->height) n = ql->height;
+	if (n < 1) n = 1;
+	jobs = (RowJob *) GC_MALLOC(n * sizeof(RowJob));
+	if (jobs == NULL) return NULL;
+	for (i = 0; i < n; i++) {
+		jobs[i].ql = ql;
+		jobs[i].y0 = (int) ((long long) ql->height * i / n);
+		jobs[i].y1 = (int) ((long long) ql->height * (i + 1) / n);
+		jobs[i].last = (i == n - 1);
+		jobs[i].err = 0;
+	}
+	*njobs = n;
+	return jobs;
+}
+
+/* Shade a block of rows of the base image */
+static void *shade_rows(
+void *arg)
+{
+	RowJob *job = (RowJob *) arg;
+	QuickLook *ql = job->ql;
+	DataCell **g = job->grid;
+	double dzdx, dzdy, norm, shade, x, range;
+	/* sun from azimuth 315 (clockwise from north), 45 degrees up */
+	const double lx = -0.5, ly = 0.5, lz = M_SQRT1_2;
+	int y, px, row, col, rn, rs, ce, cw;
+	unsigned char *p;
+
+	range = (ql->max_elev > ql->min_elev) ? ql->max_elev - ql->min_elev : 1.0;
+	for (y = job->y0; y < job->y1; y++) {
+		row = ql->rows - 1 - y * ql->scale;
+		rn = (row + 1 < ql->rows) ? row + 1 : row;
+		rs = (row > 0) ? row - 1 : row;
+		p = ql->base + (size_t) y * ql->width * 3;
+		for (px = 0; px < ql->width; px++) {
+			col = px * ql->scale;
+			ce = (col + 1 < ql->cols) ? col + 1 : col;
+			cw = (col > 0) ? col - 1 : col;
+			/* Horn's slope, rows increase to the north */
+			dzdx = ((g[rn][ce].dem_elev + 2 * g[row][ce].dem_elev + g[rs][ce].dem_elev) -
+			        (g[rn][cw].dem_elev + 2 * g[row][cw].dem_elev + g[rs][cw].dem_elev)) /
+			       (4.0 * (ce - cw + (ce == cw)) * ql->dx);
+			dzdy = ((g[rn][cw].dem_elev + 2 * g[rn][col].dem_elev + g[rn][ce].dem_elev) -
+			        (g[rs][cw].dem_elev + 2 * g[rs][col].dem_elev + g[rs][ce].dem_elev)) /
+			       (4.0 * (rn - rs + (rn == rs)) * ql->dy);
+			norm = sqrt(dzdx * dzdx + dzdy * dzdy + 1.0);
+			shade = (-dzdx * lx - dzdy * ly + lz) / norm;
+			if (shade < 0) shade = 0;
+			shade = 0.35 + 0.65 * shade;
+			/* inverted copper: light at low elevations */
+			x = 1.0 - (g[row][col].dem_elev - ql->min_elev) / range;
+			x = 0.35 + 0.65 * x;
+			*p++ = (unsigned char) (255.0 * shade * fmin(1.0, 1.25 * x));
+			*p++ = (unsigned char) (255.0 * shade * 0.7812 * x);
+			*p++ = (unsigned char) (255.0 * shade * 0.4975 * x);
+		}
+	}
+	return NULL;
+}
+
+QuickLook *QUICKLOOK_INIT(
+DataCell **grid,
+Outputs *Out,
+double *gridinfo)
+{
+	QuickLook *ql;
+	RowJob *jobs;
+	int row, col, njobs;
+
+	ql = (QuickLook *) GC_MALLOC(sizeof(QuickLook));
+	if (ql == NULL) {
+		fprintf(stderr, "[QUICKLOOK_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	ql->cols = (int) gridinfo[2];
+	ql->rows = (int) gridinfo[4];
+	ql->x0 = gridinfo[0];
+	ql->y0 = gridinfo[3];
+	ql->dx = gridinfo[1];
+	ql->dy = gridinfo[5];
+	ql->scale = 1;
+	if (Out->quicklook_width > 0 && ql->cols > Out->quicklook_width)
+		ql->scale = (ql->cols + Out->quicklook_width - 1) / Out->quicklook_width;
+	ql->width = (ql->cols + ql->scale - 1) / ql->scale;
+	ql->height = (ql->rows + ql->scale - 1) / ql->scale;
+	ql->png = strcmp(Out->quicklook_format, "PPM");
+	ql->threads = Out->quicklook_threads;
+	if (ql->threads < 1) ql->threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (ql->threads < 1) ql->threads = 1;
+	ql->run_threads = (Out->output_threads > 1) ? 1 : ql->threads;
+	ql->base = (unsigned char *) GC_MALLOC_ATOMIC((size_t) ql->width * ql->height * 3);
+	if (ql->base == NULL) {
+		fprintf(stderr, "[QUICKLOOK_INIT] Out of Memory for a %d x %d image!\n", ql->width, ql->height);
+		return NULL;
+	}
+	ql->min_elev = DBL_MAX;
+	ql->max_elev = -DBL_MAX;
+	for (row = 0; row < ql->rows; row++) {
+		for (col = 0; col < ql->cols; col++) {
+			if (grid[row][col].dem_elev < ql->min_elev) ql->min_elev = grid[row][col].dem_elev;
+			if (grid[row][col].dem_elev > ql->max_elev) ql->max_elev = grid[row][col].dem_elev;
+		}
+	}
+	jobs = row_jobs(ql, ql->threads, &njobs);
+	if (jobs == NULL) {
+		fprintf(stderr, "[QUICKLOOK_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	for (row = 0; row < njobs; row++) jobs[row].grid = grid;
+	if (run_jobs(jobs, njobs, shade_rows)) return NULL;
+	fprintf(stdout, "Quick-look images: %d x %d pixels (%d cell%s per pixel), %d threads\n",
+	        ql->width, ql->height, ql->scale, (ql->scale > 1) ? "s" : "", ql->threads);
+	return ql;
+}
+
+/* Inverted "hot" ramp for v in 0..1 */
+static void lava_colour(
+double v,
+double shade,
+unsigned char *p)
+{
+	double x = 0.8 - 0.7 * fmax(0.0, fmin(1.0, v));
+
+	p[0] = (unsigned char) (255.0 * shade * fmin(1.0, 3.0 * x));
+	p[1] = (unsigned char) (255.0 * shade * fmax(0.0, fmin(1.0, 3.0 * x - 1.0)));
+	p[2] = (unsigned char) (255.0 * shade * fmax(0.0, fmin(1.0, 3.0 * x - 2.0)));
+}
+
+/* Paint the pixels with a value > 0 over the shaded DEM; the relief
+   still shows through the lava */
+static void paint_values(
+QuickLook *ql,
+unsigned char *image,
+float *value,
+double max_value)
+{
+	size_t k, n = (size_t) ql->width * ql->height;
+	unsigned char *b;
+	double shade;
+
+	for (k = 0; k < n; k++) {
+		if (value[k] <= 0) continue;
+		b = ql->base + 3 * k;
+		shade = 0.6 + 0.4 * (b[0] + b[1] + b[2]) / (3.0 * 255.0);
+		lava_colour(value[k] / max_value, shade, image + 3 * k);
+	}
+}
+
+/* Red dots with a black rim at the vents */
+static void paint_vents(
+QuickLook *ql,
+unsigned char *image,
+Vent *vents,
+int num_vents)
+{
+	int v, row, col, px, py, x, y, r2, R = QUICKLOOK_VENT_RADIUS;
+	unsigned char *p;
+
+	for (v = 0; v < num_vents; v++) {
+		/* the pixel of the vent cell, as the footprint cells are placed */
+		col = (int) floor((vents[v].easting - ql->x0) / ql->dx);
+		row = (int) floor((vents[v].northing - ql->y0) / ql->dy);
+		px = col / ql->scale;
+		py = (ql->rows - 1 - row) / ql->scale;
+		for (y = py - R; y <= py + R; y++) {
+			for (x = px - R; x <= px + R; x++) {
+				if (x < 0 || y < 0 || x >= ql->width || y >= ql->height) continue;
+				r2 = (x - px) * (x - px) + (y - py) * (y - py);
+				if (r2 > R * R) continue;
+				p = image + 3 * ((size_t) y * ql->width + x);
+				p[0] = (r2 > (R - 1) * (R - 1)) ? 0 : 255;
+				p[1] = p[2] = 0;
+			}
+		}
+	}
+}
+
+/* Filter (Sub) and deflate a block of rows */
+static void *deflate_rows(
+void *arg)
+{
+	RowJob *job = (RowJob *) arg;
+	QuickLook *ql = job->ql;
+	size_t stride = (size_t) ql->width * 3, i;
+	unsigned char *row, *filtered;
+	z_stream zs;
+	int y, ret;
+
+	filtered = (unsigned char *) malloc(stride + 1);
+	if (filtered == NULL) {
+		job->err = 1;
+		return NULL;
+	}
+	memset(&zs, 0, sizeof zs);
+	if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		free(filtered);
+		job->err = 1;
+		return NULL;
+	}
+	job->adler = adler32(0L, Z_NULL, 0);
+	zs.next_out = job->out;
+	zs.avail_out = (uInt) job->out_size;
+	for (y = job->y0; y < job->y1; y++) {
+		row = job->image + y * stride;
+		filtered[0] = 1; /* Sub: each byte minus the byte of the pixel to its left */
+		for (i = 0; i < 3; i++) filtered[1 + i] = row[i];
+		for (i = 3; i < stride; i++) filtered[1 + i] = (unsigned char) (row[i] - row[i - 3]);
+		job->adler = adler32(job->adler, filtered, (uInt) (stride + 1));
+		zs.next_in = filtered;
+		zs.avail_in = (uInt) (stride + 1);
+		ret = deflate(&zs, (y < job->y1 - 1) ? Z_NO_FLUSH : (job->last ? Z_FINISH : Z_SYNC_FLUSH));
+		if (ret == Z_STREAM_ERROR || zs.avail_in) {
+			job->err = 1;
+			break;
+		}
+	}
+	job->out_len = job->out_size - zs.avail_out;
+	deflateEnd(&zs);
+	free(filtered);
+	return NULL;
+}
+
+static void put_u32(
+unsigned char *p,
+unsigned long v)
+{
+	p[0] = (unsigned char) (v >> 24);
+	p[1] = (unsigned char) (v >> 16);
+	p[2] = (unsigned char) (v >> 8);
+	p[3] = (unsigned char) v;
+}
+
+/* Write a PNG chunk: length, type, data, crc of type and data */
+static void png_chunk(
+FILE *out,
+const char *type,
+const unsigned char *data,
+size_t len,
+const unsigned char *data2,
+size_t len2)
+{
+	unsigned char b[4];
+	uLong crc;
+
+	put_u32(b, (unsigned long) (len + len2));
+	fwrite(b, 1, 4, out);
+	fwrite(type, 1, 4, out);
+	crc = crc32(0L, (const Bytef *) type, 4);
+	if (len) {
+		fwrite(data, 1, len, out);
+		crc = crc32(crc, data, (uInt) len);
+	}
+	if (len2) {
+		fwrite(data2, 1, len2, out);
+		crc = crc32(crc, data2, (uInt) len2);
+	}
+	put_u32(b, crc);
+	fwrite(b, 1, 4, out);
+}
+
+static int write_image(
+QuickLook *ql,
+unsigned char *image,
+int threads,
+char *file)
+{
+	static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+	unsigned char ihdr[13], head[2] = {0x78, 0x9c}, tail[4];
+	unsigned char *idat, *p;
+	size_t stride = (size_t) ql->width * 3, len = 2;
+	RowJob *jobs;
+	uLong adler;
+	FILE *out;
+	int i, njobs;
+
+	out = fopen(file, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot open quick-look file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	if (!ql->png) {
+		fprintf(out, "P6\n%d %d\n255\n", ql->width, ql->height);
+		fwrite(image, 1, stride * ql->height, out);
+	}
+	else {
+		jobs = row_jobs(ql, threads, &njobs);
+		if (jobs == NULL) {
+			fprintf(stderr, "[QUICKLOOK] Out of Memory writing [%s]!\n", file);
+			fclose(out);
+			return 1;
+		}
+		for (i = 0; i < njobs; i++) {
+			jobs[i].image = image;
+			jobs[i].out_size = compressBound((uLong) ((stride + 1) * (jobs[i].y1 - jobs[i].y0))) + 64;
+			jobs[i].out = (unsigned char *) GC_MALLOC_ATOMIC(jobs[i].out_size);
+			if (jobs[i].out == NULL) {
+				fprintf(stderr, "[QUICKLOOK] Out of Memory writing [%s]!\n", file);
+				fclose(out);
+				return 1;
+			}
+			len += jobs[i].out_size;
+		}
+		if (run_jobs(jobs, njobs, deflate_rows)) {
+			fprintf(stderr, "[QUICKLOOK] Cannot compress [%s]!\n", file);
+			fclose(out);
+			return 1;
+		}
+		/* one zlib stream: header, the deflated blocks, adler32 of it all */
+		idat = (unsigned char *) GC_MALLOC_ATOMIC(len);
+		if (idat == NULL) {
+			fprintf(stderr, "[QUICKLOOK] Out of Memory writing [%s]!\n", file);
+			fclose(out);
+			return 1;
+		}
+		memcpy(idat, head, 2);
+		p = idat + 2;
+		adler = jobs[0].adler;
+		for (i = 0; i < njobs; i++) {
+			memcpy(p, jobs[i].out, jobs[i].out_len);
+			p += jobs[i].out_len;
+			if (i) adler = adler32_combine(adler, jobs[i].adler,
+			                               (z_off_t) ((stride + 1) * (jobs[i].y1 - jobs[i].y0)));
+		}
+		put_u32(tail, adler);
+
+		fwrite(signature, 1, 8, out);
+		put_u32(ihdr, ql->width);
+		put_u32(ihdr + 4, ql->height);
+		ihdr[8] = 8;   /* bits per sample */
+		ihdr[9] = 2;   /* RGB */
+		ihdr[10] = ihdr[11] = ihdr[12] = 0;
+		png_chunk(out, "IHDR", ihdr, 13, NULL, 0);
+		png_chunk(out, "IDAT", idat, p - idat, tail, 4);
+		png_chunk(out, "IEND", NULL, 0, NULL, 0);
+	}
+	if (ferror(out) | fclose(out)) {
+		fprintf(stderr, "Cannot write quick-look file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/* A copy of the shaded DEM and a zeroed value per pixel */
+static unsigned char *new_image(
+QuickLook *ql,
+float **value)
+{
+	size_t n = (size_t) ql->width * ql->height;
+	unsigned char *image;
+
+	image = (unsigned char *) GC_MALLOC_ATOMIC(3 * n);
+	*value = (float *) GC_MALLOC_ATOMIC(n * sizeof(float));
+	if (image == NULL || *value == NULL) return NULL;
+	memcpy(image, ql->base, 3 * n);
+	memset(*value, 0, n * sizeof(float));
+	return image;
+}
+
+int QUICKLOOK_FOOTPRINT(
+QuickLook *ql,
+FlowFootprint *fp,
+char *prefix)
+{
+	char file[FILENAME_MAX];
+	unsigned char *image;
+	float *value, thickness;
+	double max_value = 2.0 * fp->residual;
+	unsigned int c;
+	size_t k;
+
+	image = new_image(ql, &value);
+	if (image == NULL) {
+		fprintf(stderr, "[QUICKLOOK_FOOTPRINT] Out of Memory for run %d!\n", fp->run);
+		return 1;
+	}
+	for (c = 0; c < fp->count; c++) {
+		thickness = (float) (fp->cells[c].eff_elev - fp->cells[c].dem_elev);
+		k = (size_t) ((ql->rows - 1 - fp->cells[c].row) / ql->scale) * ql->width + fp->cells[c].col / ql->scale;
+		if (thickness > value[k]) value[k] = thickness;
+		if (max_value <= 0 && thickness > max_value) max_value = thickness;
+	}
+	if (max_value > 0) paint_values(ql, image, value, max_value);
+	paint_vents(ql, image, fp->vents, fp->num_vents);
+	snprintf(file, sizeof file, "%s%d%s", prefix, fp->run, ql->png ? ".png" : ".ppm");
+	return write_image(ql, image, ql->run_threads, file);
+}
+
+int QUICKLOOK_HITS(
+QuickLook *ql,
+DataCell **grid,
+int runs,
+Vent *vents,
+int num_vents,
+char *file)
+{
+	unsigned char *image;
+	float *value, p;
+	int row, col;
+	size_t k;
+
+	image = new_image(ql, &value);
+	if (image == NULL) {
+		fprintf(stderr, "[QUICKLOOK_HITS] Out of Memory!\n");
+		return 1;
+	}
+	for (row = 0; row < ql->rows && runs > 0; row++) {
+		for (col = 0; col < ql->cols; col++) {
+			if (!grid[row][col].hit_count) continue;
+			p = (float) grid[row][col].hit_count / (float) runs;
+			k = (size_t) ((ql->rows - 1 - row) / ql->scale) * ql->width + col / ql->scale;
+			if (p > value[k]) value[k] = p;
+		}
+	}
+	paint_values(ql, image, value, 1.0);
+	paint_vents(ql, image, vents, num_vents);
+	if (write_image(ql, image, ql->threads, file)) return 1;
+	fprintf(stdout, "Hit probability quick-look: %s\n", file);
+	return 0;
+}
@@ -0,0 +1,426 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: RUN_POOL
+The runs of the driver, and the worker threads that make the runs of
+a SCENARIO_FILE ahead of it (SCENARIO_THREADS = N in the config file):
+
+RUN_MAKE        set up a run (SEED, flow parameters, vent), erupt it
+                and copy it out of the grid
+RUN_POOL_START  copy the context for each worker and start them
+RUN_POOL_TAKE   hand a made run to the driver, in the driver's order
+RUN_POOL_STOP   stop the workers
+RUN_PAST_DEADLINE  TIME_BUDGET has passed: no run starts
+
+A pair is a run of a scenario, with its attempts (a flow off the grid
+is run again). Each worker makes whole pairs in turn on its own copy
+of the grid and its own arrival stamps, at most a window of pairs
+ahead of the driver; the driver takes the runs in its order and adds
+them to the ensemble outputs as if it had made them. The random draws
+of a run are made under a lock, ranlib and the samplers being shared,
+and start from SEED and the run (see seed_run), so the runs are those
+of one thread, whichever worker made them. With TIME_BUDGET no worker
+starts a pair, or an attempt of one, after the deadline; the driver
+stops at the first run not made, and the runs made ahead of it are
+dropped.
+*******************************/
+
+/* splitmix64: well-spread bits from nearby numbers */
+static unsigned long long mix64(
+unsigned long long z)
+{
+	z += 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* Seed the random number generators of a run from SEED, its run number
+   and the times it was run before (a flow off the grid is run again),
+   so a run draws the same numbers whichever runs came before it.
+   The seeds are hashed: ranlib gives nearby seeds (and phrtsd nearby
+   phrases) nearly the same first numbers. */
+static void seed_run(
+long long seed,
+int run,
+int attempt,
+unsigned int *rand_state)
+{
+	unsigned long long z;
+	int seed1, seed2;
+
+	z = mix64(mix64(mix64((unsigned long long) seed) ^ (unsigned int) run) ^ (unsigned int) attempt);
+	seed1 = 1 + (int) (z % 2147483562ULL);  /* the ranges of set_initial_seed */
+	seed2 = 1 + (int) (mix64(z) % 2147483398ULL);
+	set_initial_seed(seed1, seed2);
+	*rand_state = (unsigned int) seed1 ^ (unsigned int) seed2;  /* DISTRIBUTE */
+}
+
+/* Flow parameters and vents of a run. RETURN: 0, 1 on error */
+static int set_up_run(
+MolassesContext *ctx,
+Lava_flow *flow,
+int start,
+int run,
+int attempt)
+{
+	Inputs *In = ctx->In;
+	int ret;
+
+	/* A resumed flow keeps its parameters and vents, see FLOW_STATE */
+	if (In->resume != NULL) {
+		if (FLOWSTATE_PARAMS(In->resume, flow, ctx->gridinfo, ctx->grid)) {
+			fprintf (stderr, "[RUN_MAKE] Error returned from [FLOWSTATE_PARAMS].\n");
+			return 1;
+		}
+		return 0;
+	}
+	/* The point of the run in the SAMPLING design */
+	SAMPLE_RUN(In->sample, run - start, attempt);
+	ret = SET_FLOW_PARAMS(	/* see file set_flow_params.c  */
+		In,				/* (type=Inputs*) 1D Input parameters structure  */
+		flow,			/* (Lava_flow*) Flow Structure */
+		ctx->gridinfo,	/* (type=double*) Metadata array */
+		ctx->grid);		/* (type=DataCell**)  2D Data Grid */
+
+	/* Select new vent from spatial density grid 
+	   OR
+	   If a vent coordinate is given, then use this coordinate. 
+	*/
+	if (In->spd_file != NULL) {
+		do { 
+			ret = CHOOSE_NEW_VENT(In, flow->source, flow->spd_grd );
+			if (ret) {
+				fprintf (stderr, "\n[RUN_MAKE] Error returned from [CHOOSE_NEW_VENT].\n");
+				return 1;
+			}
+			ret = CHECK_VENT_LOCATION(flow->source, ctx->gridinfo, ctx->grid); /*Check for Vent outside of map region*/
+			if (ret) {
+				flow->source->easting = 0;
+				flow->source->northing = 0;
+				continue; /* select another vent location */
+			}
+		} while (!flow->source->easting || !flow->source->northing);
+	}
+	return 0;
+}
+
+int RUN_MAKE(
+MolassesContext *ctx,
+Lava_flow *flow,
+Snapshot *snap,
+int start,
+int run,
+int attempt,
+pthread_mutex_t *draws,
+RunResult *made)
+{
+	Inputs *In = ctx->In;
+	struct timespec started, ended;
+	int i, ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+	if (draws != NULL) pthread_mutex_lock(draws);
+	/* With SEED each run has its own random numbers */
+	if (In->seed >= 0) seed_run(In->seed, run, attempt, &ctx->rand_state);
+	/* Remember where the random number generators start this run */
+	get_state(&flow->stats.seed1, &flow->stats.seed2);
+	made->rand_state = ctx->rand_state;
+	ret = set_up_run(ctx, flow, start, run, attempt);
+	if (draws != NULL) pthread_mutex_unlock(draws);
+	if (ret) return 1;
+
+	for (i = 0; i < flow->num_vents; i++) {
+		ret = CHECK_VENT_LOCATION(flow->source+i, ctx->gridinfo, ctx->grid); /*Check for Vent outside of map region*/
+		if (ret) {
+			fprintf (stderr, "[RUN_MAKE] Vent location outside of the grid area.\n");
+			return 1;
+		}
+		if (ctx->verbose) {
+			fprintf (stderr, "[Run: %d] Vent: EASTING: %f\tNorthing: %f\n", run, (flow->source+i)->easting, (flow->source+i)->northing);
+			fprintf (stdout, "[Run: %d] Vent: EASTING: %f\tNorthing: %f\n", run, (flow->source+i)->easting, (flow->source+i)->northing);
+		}
+	}
+	/* Erupt the flow: pulse lava at the vents and distribute it to cells */
+	ret = FLOW_ERUPT(
+	ctx,             /* (type=MolassesContext*) data grid and active list */
+	flow,            /* (type=Lava_flow*) Lava_flow Data structure */
+	snap,            /* (type=Snapshot*) snapshot frames, or NULL */
+	run,             /* run number */
+	&made->pulses,   /* (type=unsigned int*) pulses of this run */
+	&made->remaining); /* (type=double*) Lava volume not yet erupted */
+	if (ret > 0) {
+		fprintf (stderr, "[RUN_MAKE] Error returned from [FLOW_ERUPT].\n");
+		return 1;
+	}
+	made->ret = ret;
+
+	/* Copy the inundated cells out of the grid; the driver counts a
+	   flow off the grid as the run before it, and runs the run again */
+	made->fp = FOOTPRINT_SNAPSHOT(ctx->grid, flow, ctx->gridinfo, (ret < 0 && run > 0) ? run - 1 : run);
+	if (made->fp == NULL) {
+		fprintf (stderr, "[RUN_MAKE] Error returned from [FOOTPRINT_SNAPSHOT].\n");
+		return 1;
+	}
+	if (In->arrival != NULL && ARRIVAL_END(In->arrival, made->fp)) {
+		fprintf (stderr, "[RUN_MAKE] Error returned from [ARRIVAL_END].\n");
+		return 1;
+	}
+	flow->stats.ca_list_size = ctx->active_size;
+	clock_gettime(CLOCK_MONOTONIC, &ended);
+	flow->stats.wall_time = (double) (ended.tv_sec - started.tv_sec) +
+	                        1e-9 * (double) (ended.tv_nsec - started.tv_nsec);
+	return 0;
+}
+
+/* Make the pair of scenario s, run, with its attempts.
+   RETURN: the attempts made, 0 on error */
+static int make_pair(
+RunWorker *w,
+int s,
+int run,
+RunResult **results)
+{
+	RunPool *pool = w->pool;
+	RunResult *made = NULL, *grown;
+	Lava_flow flow;
+	int n = 0;
+
+	do {
+		grown = (RunResult *) GC_MALLOC((size_t) (n + 1) * sizeof(RunResult));
+		if (grown == NULL) {
+			fprintf(stderr, "[RUN_POOL] Out of Memory for run %d!\n", run);
+			return 0;
+		}
+		if (n) memcpy(grown, made, (size_t) n * sizeof(RunResult));
+		made = grown;
+		/* the vents get the chosen vent and their cells */
+		flow = pool->flow[s];
+		flow.source = (Vent *) GC_MALLOC_ATOMIC((size_t) flow.num_vents * sizeof(Vent));
+		if (flow.source == NULL) {
+			fprintf(stderr, "[RUN_POOL] Out of Memory for run %d!\n", run);
+			return 0;
+		}
+		memcpy(flow.source, pool->flow[s].source, (size_t) flow.num_vents * sizeof(Vent));
+		/* a flow off the grid is not run again after the deadline */
+		if (n && RUN_PAST_DEADLINE(pool->In + s)) {
+			pthread_mutex_lock(&pool->lock);
+			pool->stopped = 1;
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		if (RUN_MAKE(w->ctx, &flow, NULL, pool->start, run, n, &pool->draws, made + n)) {
+			FLOW_RESET(w->ctx);
+			return 0;
+		}
+		FLOW_RESET(w->ctx);
+		made[n].flow = flow;
+		n++;
+	} while (made[n - 1].ret < 0 && run > 0);
+	*results = made;
+	return n;
+}
+
+/* Worker thread: make the next pair until all are made */
+static void *run_worker(
+void *arg)
+{
+	RunWorker *w = (RunWorker *) arg;
+	RunPool *pool = w->pool;
+	RunResult *results = NULL;
+	Inputs in;
+	int k, n, s = -1;
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		while (pool->next < pool->pairs && pool->next >= pool->handed + pool->window &&
+		       !pool->error && !pool->stopped && !pool->closing)
+			pthread_cond_wait(&pool->taken, &pool->lock);
+		/* TIME_BUDGET: the pairs from next on are not made */
+		if (pool->next < pool->pairs && !pool->stopped && RUN_PAST_DEADLINE(pool->In)) {
+			pool->stopped = 1;
+			pthread_cond_broadcast(&pool->made);
+		}
+		if (pool->next >= pool->pairs || pool->error || pool->stopped || pool->closing) {
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		k = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		/* pairs are made in order: the scenario only goes forward */
+		if (s < 0 || k >= pool->first[s + 1]) {
+			while (k >= pool->first[s + 1]) s++;
+			in = pool->In[s];
+			in.arrival = (pool->arrival[s]) ? w->stamps : NULL;
+			w->ctx->In = &in;
+		}
+		n = make_pair(w, s, pool->start + k - pool->first[s], &results);
+
+		pthread_mutex_lock(&pool->lock);
+		if (n) {
+			pool->results[k] = results;
+			pool->attempts[k] = n;
+		}
+		else pool->error = 1;
+		pthread_cond_broadcast(&pool->made);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+RunPool *RUN_POOL_START(
+MolassesContext *ctx,
+int threads,
+Inputs *In,
+Outputs *Out,
+Lava_flow *flow,
+int num_scenarios,
+int start)
+{
+	RunPool *pool;
+	int i, s, ret;
+
+	pool = (RunPool *) GC_MALLOC(sizeof(RunPool));
+	if (pool == NULL) {
+		fprintf(stderr, "[RUN_POOL_START] Out of Memory!\n");
+		return NULL;
+	}
+	pool->num_scenarios = num_scenarios;
+	pool->start = start;
+	pool->In = (Inputs *) GC_MALLOC((size_t) num_scenarios * sizeof(Inputs));
+	pool->flow = (Lava_flow *) GC_MALLOC((size_t) num_scenarios * sizeof(Lava_flow));
+	pool->arrival = (int *) GC_MALLOC_ATOMIC((size_t) num_scenarios * sizeof(int));
+	pool->first = (int *) GC_MALLOC_ATOMIC((size_t) (num_scenarios + 1) * sizeof(int));
+	if (pool->In == NULL || pool->flow == NULL || pool->arrival == NULL || pool->first == NULL) {
+		fprintf(stderr, "[RUN_POOL_START] Out of Memory!\n");
+		return NULL;
+	}
+	/* the workers read copies: the driver changes its own as it goes */
+	for (s = 0; s < num_scenarios; s++) {
+		pool->In[s] = In[s];
+		pool->In[s].volume_steps = NULL;
+		pool->flow[s] = flow[s];
+		pool->arrival[s] = (strlen(Out[s].arrival_file) > 0 || strlen(Out[s].arrival_ensemble_file) > 0);  /* as ENSEMBLE_OPEN */
+		pool->first[s] = pool->pairs;
+		pool->pairs += In[s].runs;
+	}
+	pool->first[num_scenarios] = pool->pairs;
+	pool->results = (RunResult **) GC_MALLOC((size_t) (pool->pairs + 1) * sizeof(RunResult *));
+	pool->attempts = (int *) GC_MALLOC_ATOMIC((size_t) (pool->pairs + 1) * sizeof(int));
+	pool->workers = (RunWorker *) GC_MALLOC((size_t) threads * sizeof(RunWorker));
+	pool->threads = (pthread_t *) GC_MALLOC_ATOMIC((size_t) threads * sizeof(pthread_t));
+	if (pool->results == NULL || pool->attempts == NULL || pool->workers == NULL || pool->threads == NULL) {
+		fprintf(stderr, "[RUN_POOL_START] Out of Memory for %d runs!\n", pool->pairs);
+		return NULL;
+	}
+	memset(pool->attempts, 0, (size_t) (pool->pairs + 1) * sizeof(int));
+	pool->window = 4 * threads;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_init(&pool->draws, NULL);
+	pthread_cond_init(&pool->made, NULL);
+	pthread_cond_init(&pool->taken, NULL);
+
+	/* each worker runs its flows on a grid of its own */
+	for (i = 0; i < threads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].ctx = CONTEXT_COPY(ctx);
+		pool->workers[i].stamps = ARRIVAL_STAMPS(ctx->gridinfo);
+		if (pool->workers[i].ctx == NULL || pool->workers[i].stamps == NULL) {
+			fprintf(stderr, "[RUN_POOL_START] Out of Memory for the grid of worker %d!\n", i);
+			break;
+		}
+	}
+	if (i == threads) {
+		for (i = 0; i < threads; i++) {
+			if ((ret = pthread_create(pool->threads + i, NULL, run_worker, pool->workers + i))) {
+				fprintf(stderr, "[RUN_POOL_START] Cannot start worker thread %d:[%s]\n", i, strerror(ret));
+				break;
+			}
+			pool->nthreads++;
+		}
+	}
+	if (!pool->nthreads) return NULL;
+	fprintf(stdout, "Scenarios: %d worker threads make %d runs.\n", pool->nthreads, pool->pairs);
+	return pool;
+}
+
+RunResult *RUN_POOL_TAKE(
+RunPool *pool,
+int scenario,
+int run,
+int attempt)
+{
+	RunResult *made;
+	int k = pool->first[scenario] + run - pool->start;
+
+	pthread_mutex_lock(&pool->lock);
+	/* TIME_BUDGET: a pair no worker has started is not made */
+	if (!pool->attempts[k] && k >= pool->next && RUN_PAST_DEADLINE(pool->In + scenario)) pool->stopped = 1;
+	while (!pool->attempts[k] && !pool->error && !(pool->stopped && k >= pool->next))
+		pthread_cond_wait(&pool->made, &pool->lock);
+	if (pool->stopped && !pool->error && (!pool->attempts[k] || attempt >= pool->attempts[k])) {
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+	if (!pool->attempts[k] || attempt >= pool->attempts[k]) {
+		pthread_mutex_unlock(&pool->lock);
+		fprintf(stderr, "[RUN_POOL_TAKE] Run %d of scenario %d was not made!\n", run, scenario);
+		return NULL;
+	}
+	made = pool->results[k] + attempt;
+	/* the last attempt hands the pair over, the workers may go on */
+	if (attempt == pool->attempts[k] - 1) {
+		pool->results[k] = NULL;
+		pool->handed = k + 1;
+		pthread_cond_broadcast(&pool->taken);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return made;
+}
+
+int RUN_PAST_DEADLINE(
+Inputs *In)
+{
+	struct timespec now;
+
+	if (In->deadline <= 0) return 0;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec + 1e-9 * now.tv_nsec >= In->deadline);
+}
+
+void RUN_POOL_STOP(
+RunPool *pool)
+{
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->closing = 1;
+	pthread_cond_broadcast(&pool->taken);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->nthreads; i++) pthread_join(pool->threads[i], NULL);
+}
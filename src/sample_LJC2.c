@@ -0,0 +1,370 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: SAMPLE
+The draws of the vent cell (SPD_FILE), total volume, residual and pulse
+volume of each run (SAMPLING in the config file):
+
+	MC          each run draws its parameters independently (default)
+	STRATIFIED  the parameters drawn span k strata each, k^d joint strata
+	            for d parameters (k^d <= RUNS); each joint stratum gets
+	            one run, in random order, cycle after cycle
+	LHS         Latin hypercube: each parameter spans RUNS strata, each
+	            stratum gets one run
+	SOBOL       Owen-scrambled Sobol points (best with RUNS a power of 2)
+
+SAMPLE_INIT              lay out the design of the ensemble
+SAMPLE_RUN               the point of a run (its index in the ensemble)
+SAMPLE_POINT             the coordinate of a parameter, uniform on [0,1)
+SAMPLE_CELL              the spatial density cell holding a draw
+SAMPLE_TRUNCATED_NORMAL  inverse CDF of a truncated normal distribution
+
+A design point is uniform on [0,1) in each parameter; SET_FLOW_PARAMS
+maps it by the inverse CDF of the parameter's distribution (uniform,
+or log-normal truncated to MIN_ and MAX_) and CHOOSE_NEW_VENT through
+the cumulative spatial density. The position of the vent in its cell
+is always drawn at random. A point is taken once: a vent off the map is
+drawn again at random, and a run started again (a flow off the grid)
+draws at random.
+
+The permutations and scrambles come from SEED, so the shards of an
+ensemble (--shard) and a resumed ensemble share the design; without
+SEED they are drawn at random (and RESUME_ENSEMBLE needs SEED). The
+offsets of the runs within their strata are drawn with the random
+numbers of the run.
+*******************************/
+
+#define SAMPLE_SOBOL_DIMS 4
+
+/* Sobol direction numbers of dimensions 2 to SAMPLE_SOBOL_DIMS
+   (Joe and Kuo, new-joe-kuo-6.21201): degree s, coefficients a, m_1..m_s */
+static const int sobol_s[SAMPLE_SOBOL_DIMS] = {0, 1, 2, 3};
+static const int sobol_a[SAMPLE_SOBOL_DIMS] = {0, 0, 1, 1};
+static const unsigned int sobol_m[SAMPLE_SOBOL_DIMS][3] = {{0}, {1}, {1, 3}, {1, 3, 1}};
+
+/* splitmix64 stream */
+static unsigned long long splitmix(
+unsigned long long *state)
+{
+	unsigned long long z = (*state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* random permutation of 0 .. n-1 */
+static void shuffle(
+int *order,
+int n,
+unsigned long long state)
+{
+	int i, j, t;
+
+	for (i = 0; i < n; i++) order[i] = i;
+	for (i = n - 1; i > 0; i--) {
+		j = (int) (splitmix(&state) % (unsigned long long) (i + 1));
+		t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+}
+
+/* coordinate dim of Sobol point index, 32 bits */
+static unsigned int sobol(
+unsigned int index,
+int dim)
+{
+	unsigned int v[32], x = 0;
+	int k, l, s = sobol_s[dim];
+
+	for (k = 0; k < 32; k++) {
+		if (!dim) v[k] = 1U << (31 - k);
+		else if (k < s) v[k] = sobol_m[dim][k] << (31 - k);
+		else {
+			v[k] = v[k - s] ^ (v[k - s] >> s);
+			for (l = 1; l < s; l++)
+				if ((sobol_a[dim] >> (s - 1 - l)) & 1) v[k] ^= v[k - l];
+		}
+	}
+	for (k = 0; index; index >>= 1, k++)
+		if (index & 1) x ^= v[k];
+	return x;
+}
+
+static unsigned int reverse_bits(
+unsigned int x)
+{
+	x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+	x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fU) | ((x & 0x0f0f0f0fU) << 4);
+	x = ((x >> 8) & 0x00ff00ffU) | ((x & 0x00ff00ffU) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/* nested uniform (Owen) scramble of a coordinate, hashed as in
+   Burley, "Practical Hash-based Owen Scrambling" (2020) */
+static unsigned int owen_scramble(
+unsigned int x,
+unsigned int seed)
+{
+	x = reverse_bits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cU;
+	x ^= x * 0xb82f1e52U;
+	x ^= x * 0xc7afe638U;
+	x ^= x * 0x8d22f6e6U;
+	return reverse_bits(x);
+}
+
+/* standard normal CDF and its inverse (Acklam's approximation,
+   refined by one Halley step to double precision) */
+static double normal_cdf(
+double z)
+{
+	return 0.5 * erfc(-z / M_SQRT2);
+}
+
+static double normal_quantile(
+double p)
+{
+	static const double a[6] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+	                            1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+	static const double b[5] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+	                            6.680131188771972e+01, -1.328068155288572e+01};
+	static const double c[6] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+	                            -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+	static const double d[4] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+	                            3.754408661907416e+00};
+	double q, r, x, e;
+
+	if (p <= 0) return -HUGE_VAL;
+	if (p >= 1) return HUGE_VAL;
+	if (p < 0.02425) {
+		q = sqrt(-2 * log(p));
+		x = (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+		    ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1);
+	}
+	else if (p > 1 - 0.02425) {
+		q = sqrt(-2 * log(1 - p));
+		x = -(((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+		     ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1);
+	}
+	else {
+		q = p - 0.5;
+		r = q * q;
+		x = (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5]) * q /
+		    (((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1);
+	}
+	e = normal_cdf(x) - p;
+	q = e * sqrt(2 * M_PI) * exp(x * x / 2);
+	return x - q / (1 + x * q / 2);
+}
+
+double SAMPLE_TRUNCATED_NORMAL(
+double u,
+double mean,
+double std,
+double lo,
+double hi)
+{
+	double a = (lo - mean) / std, b = (hi - mean) / std, pa, pb, z;
+
+	if (hi <= lo) return lo;
+	/* above the mean the lower tail of the mirrored distribution keeps the precision */
+	if (a > 0) {
+		pa = normal_cdf(-b);
+		pb = normal_cdf(-a);
+		z = -normal_quantile(pa + (1 - u) * (pb - pa));
+	}
+	else {
+		pa = normal_cdf(a);
+		pb = normal_cdf(b);
+		z = normal_quantile(pa + u * (pb - pa));
+	}
+	if (z < a) z = a;
+	if (z > b) z = b;
+	return mean + std * z;
+}
+
+Sampler *SAMPLE_INIT(
+Inputs *In,
+Lava_flow *flow)
+{
+	static const char *names[] = {"MC", "STRATIFIED", "LHS", "SOBOL"};
+	static const char *params[] = {"vent", "volume", "residual", "pulse"};
+	Sampler *s;
+	unsigned long long state;
+	double p;
+	int i, j;
+
+	s = (Sampler *) GC_MALLOC(sizeof(Sampler));
+	if (s == NULL) {
+		fprintf(stderr, "[SAMPLE_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	s->design = In->sampling;
+	s->runs = In->runs;
+	s->order = NULL;
+	s->cycle = -1;
+	s->have = 0;
+	s->num_cells = 0;
+	s->cum = NULL;
+
+	/* the cumulative spatial density of the vents */
+	if (In->spd_file != NULL) {
+		s->num_cells = In->num_grids;
+		s->cum = (double *) GC_MALLOC_ATOMIC((s->num_cells + 1) * sizeof(double));
+		if (s->cum == NULL) {
+			fprintf(stderr, "[SAMPLE_INIT] Out of Memory for %d spatial density cells!\n", s->num_cells);
+			return NULL;
+		}
+		s->cum[0] = 0;
+		for (i = 0; i < s->num_cells; i++) {
+			p = (double) flow->spd_grd[i].prob;
+			s->cum[i + 1] = s->cum[i] + ((p > 0) ? p : 0);
+		}
+		if (s->num_cells < 1 || s->cum[s->num_cells] <= 0) {
+			fprintf(stderr, "[SAMPLE_INIT] The spatial density of %s sums to 0!\n", In->spd_file);
+			return NULL;
+		}
+	}
+
+	/* the parameters that are drawn */
+	s->dims = 0;
+	s->dim[SAMPLE_VENT] = (In->spd_file != NULL) ? s->dims++ : -1;
+	s->dim[SAMPLE_VOLUME] = (In->min_total_volume > 0 && In->max_total_volume > In->min_total_volume) ? s->dims++ : -1;
+	s->dim[SAMPLE_RESIDUAL] = (In->min_residual > 0 && In->max_residual > In->min_residual) ? s->dims++ : -1;
+	s->dim[SAMPLE_PULSE] = (In->min_pulse_volume > 0 && In->max_pulse_volume > In->min_pulse_volume) ? s->dims++ : -1;
+	if (s->design == SAMPLE_MC || !s->dims) {
+		s->design = SAMPLE_MC;
+		return s;
+	}
+
+	if (In->seed >= 0) {
+		state = (unsigned long long) In->seed ^ 0x53414d504c45ULL;
+		s->seed = splitmix(&state);
+	}
+	else s->seed = ((unsigned long long) i4_uni() << 31) ^ (unsigned long long) i4_uni();
+	state = s->seed;
+
+	if (s->design == SAMPLE_STRATIFIED) {
+		/* the most strata per parameter with strata^dims <= RUNS */
+		for (s->strata = 1; ; s->strata++) {
+			for (s->cells = 1, j = 0; j < s->dims && s->cells <= s->runs; j++) s->cells *= s->strata + 1;
+			if (s->cells > s->runs) break;
+		}
+		for (s->cells = 1, j = 0; j < s->dims; j++) s->cells *= s->strata;
+		s->order = (int *) GC_MALLOC_ATOMIC(s->cells * sizeof(int));
+	}
+	else if (s->design == SAMPLE_LHS) {
+		s->order = (int *) GC_MALLOC_ATOMIC((size_t) s->dims * s->runs * sizeof(int));
+		if (s->order != NULL)
+			for (j = 0; j < s->dims; j++) shuffle(s->order + (size_t) j * s->runs, s->runs, splitmix(&state));
+	}
+	if (s->design != SAMPLE_SOBOL && s->order == NULL) {
+		fprintf(stderr, "[SAMPLE_INIT] Out of Memory for the design of %d runs!\n", s->runs);
+		return NULL;
+	}
+
+	fprintf(stdout, "Sampling: %s design of %d runs over", names[s->design], s->runs);
+	for (i = 0; i < SAMPLE_PARAMS; i++)
+		if (s->dim[i] >= 0) fprintf(stdout, " %s", params[i]);
+	if (s->design == SAMPLE_STRATIFIED) fprintf(stdout, ", %d strata each", s->strata);
+	fprintf(stdout, "\n");
+	return s;
+}
+
+int SAMPLE_RUN(
+Sampler *s,
+int index,
+int attempt)
+{
+	double u[SAMPLE_PARAMS];
+	unsigned long long state;
+	int j, cell;
+
+	s->have = 0;
+	if (s->design == SAMPLE_MC || attempt > 0 || index < 0) return 0;
+	switch (s->design) {
+		case SAMPLE_STRATIFIED:
+			if (index / s->cells != s->cycle) {
+				s->cycle = index / s->cells;
+				state = s->seed ^ (unsigned long long) (s->cycle + 1) * 0x9e3779b97f4a7c15ULL;
+				shuffle(s->order, s->cells, splitmix(&state));
+			}
+			cell = s->order[index % s->cells];
+			for (j = 0; j < s->dims; j++) {
+				u[j] = (cell % s->strata + r4_uni_01()) / s->strata;
+				cell /= s->strata;
+			}
+			break;
+		case SAMPLE_LHS:
+			if (index >= s->runs) return 0;
+			for (j = 0; j < s->dims; j++)
+				u[j] = (s->order[(size_t) j * s->runs + index] + r4_uni_01()) / s->runs;
+			break;
+		case SAMPLE_SOBOL:
+			for (j = 0; j < s->dims; j++) {
+				state = s->seed + (unsigned long long) j;
+				u[j] = (owen_scramble(sobol((unsigned int) index, j), (unsigned int) splitmix(&state)) + 0.5) / 4294967296.0;
+			}
+			break;
+	}
+	for (j = 0; j < SAMPLE_PARAMS; j++)
+		s->u[j] = (s->dim[j] >= 0) ? u[s->dim[j]] : -1.0;
+	s->have = 1;
+	return 0;
+}
+
+int SAMPLE_POINT(
+Sampler *s,
+int param,
+double *u)
+{
+	if (s == NULL || !s->have || s->u[param] < 0) return 0;
+	*u = s->u[param];
+	s->u[param] = -1.0;	/* taken */
+	return 1;
+}
+
+int SAMPLE_CELL(
+Sampler *s,
+double r)
+{
+	int lo = 0, hi = s->num_cells - 1, mid;
+
+	/* the first cell whose cumulative density passes r */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (s->cum[mid + 1] > r) hi = mid;
+		else lo = mid + 1;
+	}
+	/* r at the total: the last cell with a density */
+	while (lo > 0 && s->cum[lo + 1] <= s->cum[lo]) lo--;
+	return lo;
+}
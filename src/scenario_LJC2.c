@@ -0,0 +1,277 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: SCENARIO
+A table of scenarios run one after the other in one process, on the
+DEM loaded once (SCENARIO_FILE = file in the config file); with
+SCENARIO_THREADS their runs are made by worker threads (RUN_POOL):
+
+SCENARIO_LOAD   read the table
+SCENARIO_APPLY  set up the inputs and outputs of a scenario
+
+The table is CSV. The first line names the columns: configuration
+keywords (RUNS, MIN_RESIDUAL, MAX_TOTAL_VOLUME, VENTS_FILE,
+CELL_STATS, ...), plus
+	NAME  the scenario name, default scenario<N> (N from 0)
+	VENT  one vent, "easting northing"
+Each following line is a scenario; its non-empty cells override the
+config file, empty cells keep the config file's value. Lines starting
+with # are skipped, cells may be double-quoted.
+
+Output files of the config file are renamed for each scenario with its
+name in front of the file name (out/flow -> out/NAME_flow); output
+columns of the table are used as given. The terrain keywords
+(DEM_FILE, ELEVATION_UNCERT) and CREATE_FLOW_FIELD cannot change.
+*******************************/
+
+#define SCENARIO_LINE 4096
+
+/* Split a CSV line in place. RETURN the number of cells */
+static int split_line(
+char *line,
+char **cells,
+int max)
+{
+	int n = 0;
+	char *p = line, *end;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	while (n < max) {
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p == '"') {
+			cells[n++] = ++p;
+			p = strchr(p, '"');
+			if (p == NULL) break;
+			*p++ = '\0';
+			p = strchr(p, ',');
+		}
+		else {
+			cells[n++] = p;
+			p = strchr(p, ',');
+			end = (p == NULL) ? cells[n-1] + strlen(cells[n-1]) : p;
+			while (end > cells[n-1] && (end[-1] == ' ' || end[-1] == '\t')) end--;
+			*end = '\0';
+		}
+		if (p == NULL) break;
+		*p++ = '\0';
+	}
+	return n;
+}
+
+static char *copy_string(
+const char *s)
+{
+	char *copy = (char *) GC_MALLOC_ATOMIC(strlen(s) + 1);
+
+	if (copy != NULL) strcpy(copy, s);
+	return copy;
+}
+
+ScenarioTable *SCENARIO_LOAD(
+char *file)
+{
+	FILE *in;
+	ScenarioTable *t;
+	char line[SCENARIO_LINE], *cells[SCENARIO_MAX_COLUMNS];
+	int n, i, size = 16;
+
+	in = fopen(file, "r");
+	if (in == NULL) {
+		fprintf(stderr, "[SCENARIO_LOAD] Cannot open scenario file=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	t = (ScenarioTable *) GC_MALLOC(sizeof(ScenarioTable));
+	if (t == NULL) {
+		fprintf(stderr, "[SCENARIO_LOAD] Out of Memory!\n");
+		fclose(in);
+		return NULL;
+	}
+	t->num_columns = -1;
+	t->num_scenarios = 0;
+	t->values = (char ***) GC_MALLOC(size * sizeof(char **));
+
+	while (t->values != NULL && fgets(line, sizeof line, in) != NULL) {
+		if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+		n = split_line(line, cells, SCENARIO_MAX_COLUMNS);
+		if (t->num_columns < 0) {           /* the header */
+			t->num_columns = n;
+			t->columns = (char **) GC_MALLOC(n * sizeof(char *));
+			if (t->columns == NULL) break;
+			for (i = 0; i < n; i++) {
+				if (!strncmp(cells[i], "DEM_FILE", strlen("DEM_FILE")) ||
+				    !strncmp(cells[i], "ELEVATION_UNCERT", strlen("ELEVATION_UNCERT")) ||
+				    !strncmp(cells[i], "CREATE_FLOW_FIELD", strlen("CREATE_FLOW_FIELD")) ||
+				    !strncmp(cells[i], "SCENARIO_FILE", strlen("SCENARIO_FILE"))) {
+					fprintf(stderr, "[SCENARIO_LOAD] %s cannot change between scenarios!\n", cells[i]);
+					fclose(in);
+					return NULL;
+				}
+				if ((t->columns[i] = copy_string(cells[i])) == NULL) break;
+			}
+			continue;
+		}
+		if (n != t->num_columns) {
+			fprintf(stderr, "[SCENARIO_LOAD] Scenario %d has %d cells, the header %d!\n",
+			        t->num_scenarios, n, t->num_columns);
+			fclose(in);
+			return NULL;
+		}
+		if (t->num_scenarios == size) {
+			size *= 2;
+			t->values = (char ***) GC_REALLOC(t->values, size * sizeof(char **));
+			if (t->values == NULL) break;
+		}
+		t->values[t->num_scenarios] = (char **) GC_MALLOC(n * sizeof(char *));
+		if (t->values[t->num_scenarios] == NULL) break;
+		for (i = 0; i < n; i++)
+			if ((t->values[t->num_scenarios][i] = copy_string(cells[i])) == NULL) break;
+		if (i < n) break;
+		t->num_scenarios++;
+	}
+	if (!feof(in)) {
+		fprintf(stderr, "[SCENARIO_LOAD] Out of Memory reading [%s]!\n", file);
+		fclose(in);
+		return NULL;
+	}
+	fclose(in);
+	if (t->num_scenarios < 1) {
+		fprintf(stderr, "[SCENARIO_LOAD] No scenarios in [%s]!\n", file);
+		return NULL;
+	}
+	fprintf(stdout, "Scenario file: %s, %d scenarios\n", file, t->num_scenarios);
+	return t;
+}
+
+/* file with the scenario name in front of its file name */
+static char *scenario_file(
+const char *name,
+char *file)
+{
+	const char *base;
+	char *renamed;
+	size_t dir;
+
+	if (file == NULL || !strlen(file)) return file;
+	base = strrchr(file, '/');
+	dir = (base == NULL) ? 0 : (size_t) (base - file + 1);
+	renamed = (char *) GC_MALLOC_ATOMIC(strlen(file) + strlen(name) + 2);
+	if (renamed == NULL) return NULL;
+	memcpy(renamed, file, dir);
+	sprintf(renamed + dir, "%s_%s", name, file + dir);
+	return renamed;
+}
+
+int SCENARIO_APPLY(
+ScenarioTable *t,
+int k,
+Inputs *In,
+Outputs *Out,
+Lava_flow *flow)
+{
+	char name[256], value[SCENARIO_LINE];
+	char **files[] = {
+		&Out->ascii_flow_file, &Out->binary_flow_file, &Out->ascii_hits_file,
+		&Out->raster_hits_file, &Out->raster_flow_file, &Out->raster_post_dem_file,
+		&Out->raster_pre_dem_file, &Out->stats_file, &Out->flow_archive_file,
+		&Out->footprint_index_file, &Out->cell_stats_file, &Out->exceedance_file,
+		&Out->asset_impacts_file, &Out->flow_outline_file, &Out->hit_outline_file,
+		&Out->quicklook_flow_file, &Out->quicklook_hits_file, &Out->snapshot_file,
+		&Out->arrival_file, &Out->arrival_ensemble_file, &Out->volume_steps_file};
+	Vent *vents;
+	int i, ret;
+
+	snprintf(name, sizeof name, "scenario%d", k);
+	for (i = 0; i < t->num_columns; i++)
+		if (!strcmp(t->columns[i], "NAME") && strlen(t->values[k][i]))
+			snprintf(name, sizeof name, "%s", t->values[k][i]);
+	fprintf(stdout, "\nSCENARIO #%d: %s\n", k, name);
+	fprintf(stderr, "SCENARIO #%d: %s\n", k, name);
+
+	for (i = 0; i < (int) (sizeof files / sizeof files[0]); i++) {
+		*files[i] = scenario_file(name, *files[i]);
+		if (*files[i] == NULL) {
+			fprintf(stderr, "[SCENARIO_APPLY] Out of Memory!\n");
+			return 1;
+		}
+	}
+	if (In->flow_checkpoint_file != NULL) {
+		In->flow_checkpoint_file = scenario_file(name, In->flow_checkpoint_file);
+		if (In->flow_checkpoint_file == NULL) {
+			fprintf(stderr, "[SCENARIO_APPLY] Out of Memory!\n");
+			return 1;
+		}
+	}
+	if (In->ensemble_checkpoint_file != NULL) {
+		In->ensemble_checkpoint_file = scenario_file(name, In->ensemble_checkpoint_file);
+		if (In->ensemble_checkpoint_file == NULL) {
+			fprintf(stderr, "[SCENARIO_APPLY] Out of Memory!\n");
+			return 1;
+		}
+	}
+	/* the vents of the config file are left as they are */
+	vents = (Vent *) GC_MALLOC_ATOMIC(flow->num_vents * sizeof(Vent));
+	if (vents == NULL) {
+		fprintf(stderr, "[SCENARIO_APPLY] Out of Memory!\n");
+		return 1;
+	}
+	memcpy(vents, flow->source, flow->num_vents * sizeof(Vent));
+	flow->source = vents;
+
+	for (i = 0; i < t->num_columns; i++) {
+		if (!strlen(t->values[k][i]) || !strcmp(t->columns[i], "NAME")) continue;
+		fprintf(stdout, "%25s = %-25s\n", t->columns[i], t->values[k][i]);
+		if (!strcmp(t->columns[i], "VENT")) {
+			vents = (Vent *) GC_MALLOC_ATOMIC(sizeof(Vent));
+			if (vents == NULL) {
+				fprintf(stderr, "[SCENARIO_APPLY] Out of Memory!\n");
+				return 1;
+			}
+			if (sscanf(t->values[k][i], "%lf %lf", &vents->easting, &vents->northing) != 2) {
+				fprintf(stderr, "[SCENARIO_APPLY] Scenario %s: VENT is \"easting northing\" [%s]\n",
+				        name, t->values[k][i]);
+				return 1;
+			}
+			flow->source = vents;
+			flow->num_vents = 1;
+			continue;
+		}
+		snprintf(value, sizeof value, "%s", t->values[k][i]);
+		ret = CONFIG_ASSIGN(In, Out, flow, t->columns[i], value);
+		if (ret) {
+			if (ret < 0) fprintf(stderr, "[SCENARIO_APPLY] Unknown keyword [%s]\n", t->columns[i]);
+			fprintf(stderr, "[SCENARIO_APPLY] Scenario %s: cannot assign %s = %s\n",
+			        name, t->columns[i], t->values[k][i]);
+			return 1;
+		}
+	}
+	if (In->max_residual < In->min_residual || In->max_pulse_volume < In->min_pulse_volume ||
+	    In->max_total_volume < In->min_total_volume) {
+		fprintf(stderr, "[SCENARIO_APPLY] Scenario %s: a MIN_ value is above its MAX_ value\n", name);
+		return 1;
+	}
+	return 0;
+}
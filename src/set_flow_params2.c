@@ -31,22 +31,24 @@ Lava_flow *active_flow,
 double *gridinfo, 
 DataCell **grid)
 {
-	float	log_min;
-	float	log_max;
+	double u;
 	int i, j;
   
+	/* A parameter is drawn by the inverse CDF of its distribution, at the
+	   point of the run in the SAMPLING design or at a uniform random number
+	   (see sample_LJC2.c); the log-normals are truncated to MIN_ and MAX_ */
 	if (In->min_residual > 0 && 
 	In->max_residual > 0 && 
 	In->max_residual >= In->min_residual) 
 	{	
 		if (In->log_mean_residual > 0 && In->log_std_residual > 0) 
 		{
-			log_min = log10(In->min_residual);
-			log_max = log10(In->max_residual);
-			while (active_flow->residual = 
-					(double) gennor( (float) In->log_mean_residual, (float) In->log_std_residual ),active_flow->residual > log_max || active_flow->residual < log_min);
-			active_flow->residual = pow(10, active_flow->residual); 
+			if (!SAMPLE_POINT(In->sample, SAMPLE_RESIDUAL, &u)) u = (double) r4_uni_01();
+			active_flow->residual = pow(10, SAMPLE_TRUNCATED_NORMAL(u, In->log_mean_residual, In->log_std_residual,
+			                                    log10(In->min_residual), log10(In->max_residual)));
 		}
+		else if (SAMPLE_POINT(In->sample, SAMPLE_RESIDUAL, &u))
+			active_flow->residual = In->min_residual + u * (In->max_residual - In->min_residual);
 		else active_flow->residual = (double) genunf( (float) In->min_residual, (float) In->max_residual );
       fprintf(stdout, "Flow residual: %0.2f (meters)\n", active_flow->residual);
 	}
@@ -58,13 +60,12 @@ DataCell **grid)
 	{
 		if (In->log_mean_volume > 0 && In->log_std_volume > 0) 
 		{
-		  log_min = log10(In->min_total_volume);
-		  log_max = log10(In->max_total_volume);
-			while (active_flow->volumeToErupt = 
-						(double) gennor ( (float) In->log_mean_volume, (float) In->log_std_volume ),
-						active_flow->volumeToErupt > log_max || active_flow->volumeToErupt < log_min);
-			active_flow->volumeToErupt = pow(10, active_flow->volumeToErupt); 
+			if (!SAMPLE_POINT(In->sample, SAMPLE_VOLUME, &u)) u = (double) r4_uni_01();
+			active_flow->volumeToErupt = pow(10, SAMPLE_TRUNCATED_NORMAL(u, In->log_mean_volume, In->log_std_volume,
+			                                         log10(In->min_total_volume), log10(In->max_total_volume)));
 		}
+		else if (SAMPLE_POINT(In->sample, SAMPLE_VOLUME, &u))
+			active_flow->volumeToErupt = In->min_total_volume + u * (In->max_total_volume - In->min_total_volume);
 		else active_flow->volumeToErupt = (double) genunf ( (float) In->min_total_volume, (float) In->max_total_volume );
 		fprintf(stdout, "Total lava volume: %0.2g (cubic meters)\n", active_flow->volumeToErupt);
 		active_flow->currentvolume = active_flow->volumeToErupt;
@@ -74,7 +75,9 @@ DataCell **grid)
 		In->max_pulse_volume > 0 && 
 		In->max_pulse_volume >= In->min_pulse_volume) 
 	{
-		active_flow->pulsevolume = 
+		if (SAMPLE_POINT(In->sample, SAMPLE_PULSE, &u))
+			active_flow->pulsevolume = In->min_pulse_volume + u * (In->max_pulse_volume - In->min_pulse_volume);
+		else active_flow->pulsevolume = 
 		(double) genunf ( (float) In->min_pulse_volume, (float) In->max_pulse_volume );
 		fprintf(stdout, "Flow pulse volume: %0.2g (cubic meters)\n", active_flow->pulsevolume);
 	}
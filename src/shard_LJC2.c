@@ -0,0 +1,391 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: SHARD
+An ensemble split between processes: molasses.ljc config --shard K/N
+runs the runs start + K-1, start + K-1 + N, ... of the ensemble and
+writes them to its shard file (SHARD_FILE = prefix, prefix<K>.msh).
+molasses-merge (shard_merge.c) replays the runs of the N shard files in
+run order through ENSEMBLE_ADD, so the ensemble outputs are those of
+the same ensemble run in one process.
+
+SHARD_OPEN       open the shard file (or reopen it at its size of an
+                 ensemble checkpoint), turn off the ensemble outputs
+SHARD_WRITE_RUN  append a finished run
+SHARD_CLOSE      write the end tag and close the file
+SHARD_READ_OPEN  open a shard file for molasses-merge
+SHARD_READ_RUN   read the next run
+
+The runs of a shard must not depend on the runs before them, so
+--shard needs SEED (each run seeds its own random numbers, see the
+driver). Each shard writes the per-run outputs of its runs as usual;
+its FLOW_ARCHIVE, FOOTPRINT_INDEX and ENSEMBLE_CHECKPOINT hold only its
+runs, so shards sharing a directory need their own names for them.
+
+File layout, native byte order:
+	HEADER
+	char   magic[8]        "MOLSHRD1"
+	int    cols, rows
+	double gridinfo[6]
+	long long seed         (SEED)
+	int    start, runs     (first run and runs of the ensemble)
+	int    index, count    (K and N)
+
+	RUN RECORD (one per run, in run order)
+	char   tag[4]          "SRUN"
+	int    slot, attempt   (run of the driver loop; times it was run before,
+	                        a flow off the grid is run again)
+	int    run             (run number the flow is written as)
+	FlowStats stats        (the STATS_FILE line)
+	double volume, pulse volume, residual
+	int    num_vents
+	double easting, northing  (x num_vents)
+	unsigned int cells
+	unsigned long long raw_size, packed_size
+	packed_size bytes      zlib compressed block of raw_size bytes:
+	                       cells varints: cell index (row*cols+col) minus previous index
+	                       cells doubles: elevation with lava
+	                       cells doubles: original (pre-flow) elevation
+	                       cells unsigned ints: arrival pulse (see ARRIVAL)
+
+	END
+	char   tag[4]          "SEND"
+	int    end             (run the shard stopped at: start + runs, or
+	                        earlier at TIME_BUDGET; its later runs are
+	                        left out of the merged ensemble)
+*******************************/
+
+/* RETURN: 0, 1 if the header is not that of a shard file */
+static int read_header(
+FILE *in,
+Shard *shard)
+{
+	char magic[8];
+	size_t n;
+
+	n = fread(magic, 1, 8, in);
+	n += fread(&shard->cols, sizeof(int), 1, in);
+	n += fread(&shard->rows, sizeof(int), 1, in);
+	n += fread(shard->gridinfo, sizeof(double), 6, in);
+	n += fread(&shard->seed, sizeof(long long), 1, in);
+	n += fread(&shard->start, sizeof(int), 1, in);
+	n += fread(&shard->runs, sizeof(int), 1, in);
+	n += fread(&shard->index, sizeof(int), 1, in);
+	n += fread(&shard->count, sizeof(int), 1, in);
+	return (n != 21 || memcmp(magic, SHARD_MAGIC, 8));
+}
+
+Shard *SHARD_OPEN(
+Inputs *In,
+Outputs *Out,
+double *gridinfo,
+int start)
+{
+	Shard *shard, saved;
+	EnsembleState *resume = In->resume_ensemble;
+	FILE *in;
+
+	shard = (Shard *) GC_MALLOC(sizeof(Shard));
+	if (shard == NULL) {
+		fprintf(stderr, "[SHARD_OPEN] Out of Memory!\n");
+		return NULL;
+	}
+	shard->file = (char *) GC_MALLOC_ATOMIC(strlen(In->shard_file) + 32);
+	if (shard->file == NULL) {
+		fprintf(stderr, "[SHARD_OPEN] Out of Memory!\n");
+		return NULL;
+	}
+	sprintf(shard->file, "%s%d.msh", In->shard_file, In->shard_index);
+	shard->cols = (int) gridinfo[2];
+	shard->rows = (int) gridinfo[4];
+	memcpy(shard->gridinfo, gridinfo, sizeof shard->gridinfo);
+	shard->seed = In->seed;
+	shard->start = start;
+	shard->runs = In->runs;
+	shard->index = In->shard_index;
+	shard->count = In->shard_count;
+
+	/* molasses-merge writes the ensemble outputs from the shard files */
+	Out->ascii_hits_file = "";
+	Out->raster_hits_file = "";
+	Out->stats_file = "";
+	Out->cell_stats_file = "";
+	Out->exceedance_file = "";
+	Out->arrival_ensemble_file = "";
+	Out->hit_outline_file = "";
+	Out->quicklook_hits_file = "";
+	In->assets_file = NULL;
+
+	/* a resumed ensemble goes on after the runs of its checkpoint (see ENSEMBLE_STATE) */
+	if (resume != NULL) {
+		if (resume->shard_size < 0) {
+			fprintf(stderr, "[SHARD_OPEN] %s is not the checkpoint of a shard!\n", resume->file);
+			return NULL;
+		}
+		in = fopen(shard->file, "rb");
+		if (in == NULL || read_header(in, &saved) || saved.cols != shard->cols || saved.rows != shard->rows ||
+		    memcmp(saved.gridinfo, gridinfo, sizeof saved.gridinfo) || saved.seed != shard->seed ||
+		    saved.start != start || saved.runs != shard->runs || saved.index != shard->index ||
+		    saved.count != shard->count) {
+			fprintf(stderr, "[SHARD_OPEN] [%s] is not the shard file of %s!\n", shard->file, resume->file);
+			if (in != NULL) fclose(in);
+			return NULL;
+		}
+		fclose(in);
+		shard->fp = ENSSTATE_REOPEN(shard->file, resume->shard_size);
+		if (shard->fp == NULL) return NULL;
+		fprintf(stdout, "Shard %d of %d: %s\n", shard->index, shard->count, shard->file);
+		return shard;
+	}
+	shard->fp = fopen(shard->file, "wb");
+	if (shard->fp == NULL) {
+		fprintf(stderr, "Cannot open SHARD file=[%s]:[%s]!\n", shard->file, strerror(errno));
+		return NULL;
+	}
+	fwrite(SHARD_MAGIC, 1, 8, shard->fp);
+	fwrite(&shard->cols, sizeof(int), 1, shard->fp);
+	fwrite(&shard->rows, sizeof(int), 1, shard->fp);
+	fwrite(gridinfo, sizeof(double), 6, shard->fp);
+	fwrite(&shard->seed, sizeof(long long), 1, shard->fp);
+	fwrite(&shard->start, sizeof(int), 1, shard->fp);
+	fwrite(&shard->runs, sizeof(int), 1, shard->fp);
+	fwrite(&shard->index, sizeof(int), 1, shard->fp);
+	fwrite(&shard->count, sizeof(int), 1, shard->fp);
+	if (ferror(shard->fp)) {
+		fprintf(stderr, "[SHARD_OPEN] Cannot write [%s]:[%s]!\n", shard->file, strerror(errno));
+		return NULL;
+	}
+	fprintf(stdout, "Shard %d of %d: %s\n", shard->index, shard->count, shard->file);
+	return shard;
+}
+
+int SHARD_WRITE_RUN(
+Shard *shard,
+int slot,
+int attempt,
+Lava_flow *flow,
+FlowFootprint *fp)
+{
+	unsigned int cells = fp->count, c;
+	int i;
+	unsigned long long index, last = 0, raw_size = 0, packed_size;
+	uLongf packed_len;
+	unsigned char *raw, *packed;
+
+	/* Worst case: a 10 byte varint, two doubles and an arrival per cell */
+	raw = (unsigned char *) GC_MALLOC_ATOMIC((size_t) cells * (10 + 2 * sizeof(double) + sizeof(unsigned int)) + 1);
+	if (raw == NULL) {
+		fprintf(stderr, "[SHARD_WRITE_RUN] Out of Memory packing run %d!\n", fp->run);
+		return 1;
+	}
+	for (c = 0; c < cells; c++) {
+		index = (unsigned long long) fp->cells[c].row * shard->cols + fp->cells[c].col;
+		raw_size += varint_put(raw + raw_size, index - last);
+		last = index;
+	}
+	for (c = 0; c < cells; c++, raw_size += sizeof(double))
+		memcpy(raw + raw_size, &fp->cells[c].eff_elev, sizeof(double));
+	for (c = 0; c < cells; c++, raw_size += sizeof(double))
+		memcpy(raw + raw_size, &fp->cells[c].dem_elev, sizeof(double));
+	for (c = 0; c < cells; c++, raw_size += sizeof(unsigned int))
+		memcpy(raw + raw_size, &fp->cells[c].arrival, sizeof(unsigned int));
+
+	packed_len = compressBound(raw_size);
+	packed = (unsigned char *) GC_MALLOC_ATOMIC(packed_len);
+	if (packed == NULL) {
+		fprintf(stderr, "[SHARD_WRITE_RUN] Out of Memory packing run %d!\n", fp->run);
+		return 1;
+	}
+	if (compress2(packed, &packed_len, raw, raw_size, 6) != Z_OK) {
+		fprintf(stderr, "[SHARD_WRITE_RUN] zlib could not compress run %d!\n", fp->run);
+		return 1;
+	}
+	packed_size = packed_len;
+
+	fwrite("SRUN", 1, 4, shard->fp);
+	fwrite(&slot, sizeof(int), 1, shard->fp);
+	fwrite(&attempt, sizeof(int), 1, shard->fp);
+	fwrite(&fp->run, sizeof(int), 1, shard->fp);
+	fwrite(&flow->stats, sizeof(FlowStats), 1, shard->fp);
+	fwrite(&fp->volume, sizeof(double), 1, shard->fp);
+	fwrite(&fp->pulsevolume, sizeof(double), 1, shard->fp);
+	fwrite(&fp->residual, sizeof(double), 1, shard->fp);
+	fwrite(&fp->num_vents, sizeof(int), 1, shard->fp);
+	for (i = 0; i < fp->num_vents; i++) {
+		fwrite(&fp->vents[i].easting, sizeof(double), 1, shard->fp);
+		fwrite(&fp->vents[i].northing, sizeof(double), 1, shard->fp);
+	}
+	fwrite(&cells, sizeof(unsigned int), 1, shard->fp);
+	fwrite(&raw_size, sizeof(unsigned long long), 1, shard->fp);
+	fwrite(&packed_size, sizeof(unsigned long long), 1, shard->fp);
+	fwrite(packed, 1, packed_len, shard->fp);
+	if (ferror(shard->fp)) {
+		fprintf(stderr, "[SHARD_WRITE_RUN] Cannot write run %d:[%s]!\n", fp->run, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+int SHARD_CLOSE(
+Shard *shard,
+int end)
+{
+	fwrite("SEND", 1, 4, shard->fp);
+	fwrite(&end, sizeof(int), 1, shard->fp);
+	if (ferror(shard->fp) || fclose(shard->fp)) {
+		fprintf(stderr, "[SHARD_CLOSE] Cannot write [%s]:[%s]!\n", shard->file, strerror(errno));
+		return 1;
+	}
+	fprintf(stdout, "Shard %d of %d written to %s", shard->index, shard->count, shard->file);
+	if (end < shard->start + shard->runs) fprintf(stdout, ", stopped at run %d", end);
+	fprintf(stdout, "\n");
+	return 0;
+}
+
+Shard *SHARD_READ_OPEN(
+char *file)
+{
+	Shard *shard;
+
+	shard = (Shard *) GC_MALLOC(sizeof(Shard));
+	if (shard == NULL) {
+		fprintf(stderr, "[SHARD_READ_OPEN] Out of Memory!\n");
+		return NULL;
+	}
+	shard->file = file;
+	shard->fp = fopen(file, "rb");
+	if (shard->fp == NULL) {
+		fprintf(stderr, "Cannot open SHARD file=[%s]:[%s]!\n", file, strerror(errno));
+		return NULL;
+	}
+	if (read_header(shard->fp, shard) || shard->count < 1 || shard->index < 1 ||
+	    shard->index > shard->count || shard->runs < 1) {
+		fprintf(stderr, "[SHARD_READ_OPEN] [%s] is not a shard file!\n", file);
+		fclose(shard->fp);
+		return NULL;
+	}
+	return shard;
+}
+
+int SHARD_READ_RUN(
+Shard *shard)
+{
+	FlowFootprint *fp;
+	char tag[4];
+	unsigned int cells, c;
+	unsigned long long raw_size, packed_size, delta, index = 0;
+	uLongf raw_len;
+	unsigned char *raw, *packed, *p, *end;
+	size_t n;
+	int i, ok;
+
+	if (fread(tag, 1, 4, shard->fp) != 4) {
+		fprintf(stderr, "[SHARD_READ_RUN] [%s] ends without its end tag: the shard did not finish!\n", shard->file);
+		return -1;
+	}
+	if (!memcmp(tag, "SEND", 4)) {
+		if (fread(&shard->end, sizeof(int), 1, shard->fp) != 1 ||
+		    shard->end < shard->start || shard->end > shard->start + shard->runs) {
+			fprintf(stderr, "[SHARD_READ_RUN] [%s] has a bad end tag!\n", shard->file);
+			return -1;
+		}
+		return 0;
+	}
+	fp = (FlowFootprint *) GC_MALLOC(sizeof(FlowFootprint));
+	if (fp == NULL) {
+		fprintf(stderr, "[SHARD_READ_RUN] Out of Memory!\n");
+		return -1;
+	}
+	ok = !memcmp(tag, "SRUN", 4) &&
+	     fread(&shard->slot, sizeof(int), 1, shard->fp) == 1 &&
+	     fread(&shard->attempt, sizeof(int), 1, shard->fp) == 1 &&
+	     fread(&fp->run, sizeof(int), 1, shard->fp) == 1 &&
+	     fread(&shard->flow.stats, sizeof(FlowStats), 1, shard->fp) == 1 &&
+	     fread(&fp->volume, sizeof(double), 1, shard->fp) == 1 &&
+	     fread(&fp->pulsevolume, sizeof(double), 1, shard->fp) == 1 &&
+	     fread(&fp->residual, sizeof(double), 1, shard->fp) == 1 &&
+	     fread(&fp->num_vents, sizeof(int), 1, shard->fp) == 1 && fp->num_vents > 0;
+	if (ok) {
+		fp->vents = (Vent *) GC_MALLOC_ATOMIC((size_t) fp->num_vents * sizeof(Vent));
+		if (fp->vents == NULL) {
+			fprintf(stderr, "[SHARD_READ_RUN] Out of Memory!\n");
+			return -1;
+		}
+		memset(fp->vents, 0, (size_t) fp->num_vents * sizeof(Vent));
+		for (i = 0; i < fp->num_vents && ok; i++)
+			ok = fread(&fp->vents[i].easting, sizeof(double), 1, shard->fp) == 1 &&
+			     fread(&fp->vents[i].northing, sizeof(double), 1, shard->fp) == 1;
+	}
+	ok = ok && fread(&cells, sizeof(unsigned int), 1, shard->fp) == 1 &&
+	     fread(&raw_size, sizeof(unsigned long long), 1, shard->fp) == 1 &&
+	     fread(&packed_size, sizeof(unsigned long long), 1, shard->fp) == 1 &&
+	     raw_size >= (unsigned long long) cells * (1 + 2 * sizeof(double) + sizeof(unsigned int));
+	if (!ok) {
+		fprintf(stderr, "[SHARD_READ_RUN] [%s] is truncated or corrupt!\n", shard->file);
+		return -1;
+	}
+	raw = (unsigned char *) GC_MALLOC_ATOMIC(raw_size + 1);
+	packed = (unsigned char *) GC_MALLOC_ATOMIC(packed_size + 1);
+	fp->cells = (FootprintCell *) GC_MALLOC_ATOMIC(((size_t) cells + 1) * sizeof(FootprintCell));
+	if (raw == NULL || packed == NULL || fp->cells == NULL) {
+		fprintf(stderr, "[SHARD_READ_RUN] Out of Memory for run %d!\n", fp->run);
+		return -1;
+	}
+	raw_len = raw_size;
+	if (fread(packed, 1, packed_size, shard->fp) != packed_size ||
+	    uncompress(raw, &raw_len, packed, packed_size) != Z_OK || raw_len != raw_size) {
+		fprintf(stderr, "[SHARD_READ_RUN] [%s] is truncated or corrupt at run %d!\n", shard->file, fp->run);
+		return -1;
+	}
+	p = raw;
+	end = raw + raw_size - (size_t) cells * (2 * sizeof(double) + sizeof(unsigned int));
+	for (c = 0; c < cells; c++) {
+		n = varint_get(p, end, &delta);
+		if (!n) break;
+		p += n;
+		index += delta;
+		fp->cells[c].row = (int) (index / shard->cols);
+		fp->cells[c].col = (int) (index % shard->cols);
+	}
+	if (c < cells || p != end || index >= (unsigned long long) shard->cols * shard->rows) {
+		fprintf(stderr, "[SHARD_READ_RUN] [%s] is corrupt at run %d!\n", shard->file, fp->run);
+		return -1;
+	}
+	for (c = 0; c < cells; c++, p += sizeof(double)) memcpy(&fp->cells[c].eff_elev, p, sizeof(double));
+	for (c = 0; c < cells; c++, p += sizeof(double)) memcpy(&fp->cells[c].dem_elev, p, sizeof(double));
+	for (c = 0; c < cells; c++, p += sizeof(unsigned int)) memcpy(&fp->cells[c].arrival, p, sizeof(unsigned int));
+	fp->count = cells;
+
+	/* the flow of the STATS_FILE line */
+	shard->flow.source = fp->vents;
+	shard->flow.num_vents = fp->num_vents;
+	shard->flow.volumeToErupt = fp->volume;
+	shard->flow.pulsevolume = fp->pulsevolume;
+	shard->flow.residual = fp->residual;
+	shard->footprint = fp;
+	return 1;
+}
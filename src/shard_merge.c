@@ -0,0 +1,193 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*
+MOLASSES-MERGE:
+Writes the ensemble outputs of an ensemble run in shards
+(molasses.ljc config-file --shard K/N, see shard_LJC2.c).
+
+Usage:
+	molasses-merge config-file shard-file ...
+
+The config file is that of the shards. Every shard file 1 to N must be
+given, each finished. Their runs are added to the ensemble in run order,
+so the hit maps, CELL_STATS, EXCEEDANCE_MAP, ARRIVAL_ENSEMBLE, HIT_OUTLINE,
+QUICKLOOK_HITS, asset impacts and STATS_FILE are those the ensemble
+would have written run in one process with the same SEED (the
+wall_seconds of STATS_FILE are those of the shards).
+A shard stopped at TIME_BUDGET leaves out its runs after it stopped;
+the ensemble outputs are of the runs the shards made.
+*/
+
+/* The next run to merge from run slot on: runs of shards that stopped
+   before them (TIME_BUDGET, see SHARD_CLOSE) are skipped */
+static int next_slot(
+Shard **shards,
+int *more,
+int num,
+int slot)
+{
+	Shard *s = shards[0];
+	int owner;
+
+	while (slot < s->start + s->runs) {
+		owner = (slot - s->start) % num;
+		if (more[owner] || slot < shards[owner]->end) break;
+		slot++;
+	}
+	return slot;
+}
+
+int main(int argc, char *argv[]) {
+
+	MolassesContext *Ctx;
+	Inputs In;
+	Outputs Out;
+	Lava_flow Flow;
+	Shard **shards, *s;
+	int num, i, k, ret, slot, attempt, runs = 0, made = 0;
+	int *more;	/* 1: the shard has a run read, 0: it has ended */
+
+	GC_INIT();
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s config-file shard-file ...\n", argv[0]);
+		return 1;
+	}
+	In.config_file = argv[1];
+	if (INITIALIZE(&In, &Out, &Flow)) {
+		fprintf(stderr, "[MERGE]: Error flag returned from [INITIALIZE]. Exiting.\n");
+		return 1;
+	}
+
+	/* The shards, in the order of their index */
+	num = argc - 2;
+	shards = (Shard **) GC_MALLOC(num * sizeof(Shard *));
+	more = (int *) GC_MALLOC_ATOMIC(num * sizeof(int));
+	if (shards == NULL || more == NULL) {
+		fprintf(stderr, "[MERGE]: Out of Memory!\n");
+		return 1;
+	}
+	memset(shards, 0, num * sizeof(Shard *));
+	for (i = 0; i < num; i++) {
+		s = SHARD_READ_OPEN(argv[i + 2]);
+		if (s == NULL) return 1;
+		if (s->count != num) {
+			fprintf(stderr, "[MERGE]: %s is shard %d of %d, %d shard files given!\n", s->file, s->index, s->count, num);
+			return 1;
+		}
+		if (shards[s->index - 1] != NULL) {
+			fprintf(stderr, "[MERGE]: %s and %s are both shard %d!\n", shards[s->index - 1]->file, s->file, s->index);
+			return 1;
+		}
+		shards[s->index - 1] = s;
+	}
+	s = shards[0];
+	for (i = 1; i < num; i++) {
+		if (shards[i]->cols != s->cols || shards[i]->rows != s->rows ||
+		    memcmp(shards[i]->gridinfo, s->gridinfo, sizeof s->gridinfo) || shards[i]->seed != s->seed ||
+		    shards[i]->start != s->start || shards[i]->runs != s->runs) {
+			fprintf(stderr, "[MERGE]: %s and %s are not of the same ensemble!\n", s->file, shards[i]->file);
+			return 1;
+		}
+	}
+	if (s->runs != In.runs) {
+		fprintf(stderr, "[MERGE]: the shards are of an ensemble of %d runs, not RUNS = %d!\n", s->runs, In.runs);
+		return 1;
+	}
+
+	/* The ensemble outputs are written on the DEM of the shards */
+	Ctx = CONTEXT_OPEN(&In);
+	if (Ctx == NULL) {
+		fprintf(stderr, "[MERGE]: Error returned from [CONTEXT_OPEN]. Exiting.\n");
+		return 1;
+	}
+	if ((int) Ctx->gridinfo[2] != s->cols || (int) Ctx->gridinfo[4] != s->rows ||
+	    memcmp(Ctx->gridinfo, s->gridinfo, sizeof s->gridinfo)) {
+		fprintf(stderr, "[MERGE]: the shards are not of DEM_FILE = %s!\n", In.dem_file);
+		return 1;
+	}
+	if (ENSEMBLE_OPEN(Ctx->grid, &In, &Out, Ctx->gridinfo)) {
+		fprintf(stderr, "[MERGE]: Error returned from [ENSEMBLE_OPEN]. Exiting.\n");
+		return 1;
+	}
+	fprintf(stdout, "Merging %d shards of runs %d to %d, SEED = %lld\n",
+	        num, s->start, s->start + s->runs - 1, s->seed);
+
+	/* Add the runs in the order the driver ran them: by run, then by
+	   the times a flow off the grid was run again */
+	for (i = 0; i < num; i++) {
+		more[i] = SHARD_READ_RUN(shards[i]);
+		if (more[i] < 0) return 1;
+	}
+	slot = s->start;
+	attempt = 0;
+	for (;;) {
+		k = -1;
+		for (i = 0; i < num; i++) {
+			if (!more[i]) continue;
+			if (k < 0 || shards[i]->slot < shards[k]->slot ||
+			    (shards[i]->slot == shards[k]->slot && shards[i]->attempt < shards[k]->attempt)) k = i;
+		}
+		if (k < 0) break;
+		s = shards[k];
+		if (s->attempt == 0) slot = next_slot(shards, more, num, slot);
+		/* the run is the next one, or the next attempt of the last one */
+		if (!((s->attempt == 0 && s->slot == slot) || (s->attempt == attempt + 1 && s->slot == slot - 1)) ||
+		    (s->slot - s->start) % s->count != s->index - 1) {
+			fprintf(stderr, "[MERGE]: %s has run %d (attempt %d) out of order, a run is missing!\n",
+			        s->file, s->slot, s->attempt);
+			return 1;
+		}
+		if (s->attempt == 0) {
+			slot++;
+			made++;
+		}
+		attempt = s->attempt;
+		ret = ENSEMBLE_ADD(Ctx->grid, &In, &Out, &s->flow, s->footprint, Ctx->gridinfo);
+		if (ret) {
+			fprintf(stderr, "[MERGE]: Error returned from [ENSEMBLE_ADD]. Exiting.\n");
+			return 1;
+		}
+		runs++;
+		more[k] = SHARD_READ_RUN(s);
+		if (more[k] < 0) return 1;
+	}
+	for (i = 0; i < num; i++) fclose(shards[i]->fp);
+	s = shards[0];
+	slot = next_slot(shards, more, num, slot);
+	if (slot != s->start + s->runs) {
+		fprintf(stderr, "[MERGE]: the shards end at run %d, the ensemble at run %d!\n",
+		        slot - 1, s->start + s->runs - 1);
+		return 1;
+	}
+	fprintf(stdout, "%d runs merged\n", runs);
+	if (made < s->runs)
+		fprintf(stdout, "The shards stopped at TIME_BUDGET: %d of %d runs made\n", made, s->runs);
+	In.runs = made;
+	ENSEMBLE_WRITE(Ctx->grid, &In, &Out, &Flow, Ctx->gridinfo, s->start + made);
+	fprintf(stdout, "OK\n");
+	return 0;
+}
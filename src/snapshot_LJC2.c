@@ -0,0 +1,339 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: SNAPSHOT
+Record how a flow advances: every SNAPSHOT_PULSES pulses and/or every
+SNAPSHOT_VOLUME cubic meters erupted, a frame with the cells whose
+lava thickness changed since the previous frame, in one file per run
+(SNAPSHOT_FILE = prefix, file prefix<run>.mfs). The last frame is the
+end of the run. molasses-snapshot rebuilds any frame as a raster.
+
+SNAPSHOT_INIT   allocate the thickness of the previous frame
+SNAPSHOT_BEGIN  open the file of a run
+SNAPSHOT_PULSE  after each pulse: write a frame when one is due
+SNAPSHOT_END    write the last frame and the frame index, close
+
+Only the cells around the flow are compared. A flow is connected to
+its vents, so the box around the vents is grown until no lava lies on
+its border; the box only grows during a run.
+
+File layout (native byte order):
+	HEADER
+	char   magic[8]        "MOLSNAP1"
+	int    cols, rows
+	double gridinfo[6]     (this code's metadata format, see DEM_LOADER)
+	int    run
+	double volume, pulse volume, residual
+	int    num_vents
+	double easting, northing  (x num_vents)
+	int    length of the projection, char projection[length] (WKT of the DEM)
+
+	FRAME (one per snapshot)
+	char   tag[4]          "FRAM"
+	unsigned int frame, pulse
+	double erupted         (volume erupted so far)
+	unsigned int cells     (cells that changed)
+	unsigned long long raw_size, packed_size
+	packed_size bytes      zlib compressed block of raw_size bytes:
+	                       cells varints: cell index (row*cols+col) minus previous index
+	                       cells floats: new lava thickness
+
+	INDEX
+	char   tag[4]          "SIDX"
+	unsigned int count
+	long long offset of each frame  (x count)
+
+	FOOTER
+	long long offset of INDEX
+	char   magic[8]        "MOLSNEND"
+
+Frame k is rebuilt by setting the cells of frames 0 to k in order.
+*******************************/
+
+Snapshot *SNAPSHOT_INIT(
+Outputs *Out,
+char *projection,
+double *gridinfo)
+{
+	Snapshot *snap;
+	size_t cells;
+	int i;
+
+	snap = (Snapshot *) GC_MALLOC(sizeof(Snapshot));
+	if (snap == NULL) {
+		fprintf(stderr, "[SNAPSHOT_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	snap->cols = (int) gridinfo[2];
+	snap->rows = (int) gridinfo[4];
+	for (i = 0; i < 6; i++) snap->gridinfo[i] = gridinfo[i];
+	snap->prefix = Out->snapshot_file;
+	snap->projection = projection;
+	snap->every_pulses = Out->snapshot_pulses;
+	snap->every_volume = Out->snapshot_volume;
+	cells = (size_t) snap->cols * snap->rows;
+	snap->last = (float *) GC_MALLOC_ATOMIC(cells * sizeof(float));
+	snap->size = 1024;
+	snap->offsets = (long long *) GC_MALLOC_ATOMIC(snap->size * sizeof(long long));
+	snap->scratch_size = 0;
+	snap->scratch = NULL;
+	if (snap->last == NULL || snap->offsets == NULL) {
+		fprintf(stderr, "[SNAPSHOT_INIT] Out of Memory for %d x %d cells!\n", snap->cols, snap->rows);
+		return NULL;
+	}
+	memset(snap->last, 0, cells * sizeof(float));
+	snap->fp = NULL;
+	return snap;
+}
+
+int SNAPSHOT_BEGIN(
+Snapshot *snap,
+Lava_flow *active_flow,
+int run)
+{
+	char file[FILENAME_MAX];
+	int i, len = (int) strlen(snap->projection);
+
+	snprintf(file, sizeof file, "%s%d.mfs", snap->prefix, run);
+	snap->fp = fopen(file, "wb");
+	if (snap->fp == NULL) {
+		fprintf(stderr, "Cannot open SNAPSHOT file=[%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	snap->run = run;
+	snap->frames = 0;
+	snap->pulses = 0;
+	snap->next_pulse = snap->every_pulses;
+	snap->next_volume = snap->every_volume;
+	snap->rmin = snap->rows;
+	snap->rmax = -1;
+	snap->cmin = snap->cols;
+	snap->cmax = -1;
+	for (i = 0; i < active_flow->num_vents; i++) {
+		if (active_flow->source[i].row < snap->rmin) snap->rmin = active_flow->source[i].row;
+		if (active_flow->source[i].row > snap->rmax) snap->rmax = active_flow->source[i].row;
+		if (active_flow->source[i].col < snap->cmin) snap->cmin = active_flow->source[i].col;
+		if (active_flow->source[i].col > snap->cmax) snap->cmax = active_flow->source[i].col;
+	}
+
+	fwrite(SNAPSHOT_MAGIC, 1, 8, snap->fp);
+	fwrite(&snap->cols, sizeof(int), 1, snap->fp);
+	fwrite(&snap->rows, sizeof(int), 1, snap->fp);
+	fwrite(snap->gridinfo, sizeof(double), 6, snap->fp);
+	fwrite(&run, sizeof(int), 1, snap->fp);
+	fwrite(&active_flow->volumeToErupt, sizeof(double), 1, snap->fp);
+	fwrite(&active_flow->pulsevolume, sizeof(double), 1, snap->fp);
+	fwrite(&active_flow->residual, sizeof(double), 1, snap->fp);
+	fwrite(&active_flow->num_vents, sizeof(int), 1, snap->fp);
+	for (i = 0; i < active_flow->num_vents; i++) {
+		fwrite(&active_flow->source[i].easting, sizeof(double), 1, snap->fp);
+		fwrite(&active_flow->source[i].northing, sizeof(double), 1, snap->fp);
+	}
+	fwrite(&len, sizeof(int), 1, snap->fp);
+	fwrite(snap->projection, 1, len, snap->fp);
+	if (ferror(snap->fp)) {
+		fprintf(stderr, "[SNAPSHOT_BEGIN] Cannot write [%s]:[%s]!\n", file, strerror(errno));
+		return 1;
+	}
+	return 0;
+}
+
+/* Is there lava in rows r0..r1, columns c0..c1? */
+static int has_lava(
+DataCell **grid,
+int r0, int r1, int c0, int c1)
+{
+	int row, col;
+
+	for (row = r0; row <= r1; row++)
+		for (col = c0; col <= c1; col++)
+			if (grid[row][col].eff_elev > grid[row][col].dem_elev) return 1;
+	return 0;
+}
+
+/* Grow the box until its border is free of lava */
+static void grow_box(
+Snapshot *snap,
+DataCell **grid)
+{
+	int grown;
+
+	do {
+		grown = 0;
+		if (snap->rmin > 0 && has_lava(grid, snap->rmin, snap->rmin, snap->cmin, snap->cmax)) {
+			snap->rmin--; grown = 1;
+		}
+		if (snap->rmax < snap->rows - 1 && has_lava(grid, snap->rmax, snap->rmax, snap->cmin, snap->cmax)) {
+			snap->rmax++; grown = 1;
+		}
+		if (snap->cmin > 0 && has_lava(grid, snap->rmin, snap->rmax, snap->cmin, snap->cmin)) {
+			snap->cmin--; grown = 1;
+		}
+		if (snap->cmax < snap->cols - 1 && has_lava(grid, snap->rmin, snap->rmax, snap->cmax, snap->cmax)) {
+			snap->cmax++; grown = 1;
+		}
+	} while (grown);
+}
+
+/* Write the cells that changed since the last frame */
+static int write_frame(
+Snapshot *snap,
+DataCell **grid,
+double erupted)
+{
+	int row, col;
+	unsigned int cells = 0;
+	unsigned long long index, last = 0, raw_size, packed_size;
+	size_t box, nvar = 0, k;
+	unsigned char *raw, *packed;
+	float thickness, *values;
+	uLongf packed_len;
+	long long *grown;
+
+	grow_box(snap, grid);
+
+	/* Worst case: a 10 byte varint and a float per cell; the floats
+	   are collected at the end of the buffer, then moved after the varints */
+	box = (size_t) (snap->rmax - snap->rmin + 1) * (snap->cmax - snap->cmin + 1);
+	if (box * (10 + sizeof(float)) > snap->scratch_size) {
+		snap->scratch_size = 2 * box * (10 + sizeof(float));
+		snap->scratch = (unsigned char *) GC_MALLOC_ATOMIC(snap->scratch_size);
+		if (snap->scratch == NULL) {
+			fprintf(stderr, "[SNAPSHOT] Out of Memory for frame %u of run %d!\n", snap->frames, snap->run);
+			return 1;
+		}
+	}
+	raw = snap->scratch;
+	values = (float *) (raw + 10 * box);
+	for (row = snap->rmin; row <= snap->rmax; row++) {
+		for (col = snap->cmin; col <= snap->cmax; col++) {
+			k = (size_t) row * snap->cols + col;
+			thickness = (float) (grid[row][col].eff_elev - grid[row][col].dem_elev);
+			if (thickness == snap->last[k]) continue;
+			snap->last[k] = thickness;
+			index = (unsigned long long) k;
+			nvar += varint_put(raw + nvar, index - last);
+			last = index;
+			values[cells++] = thickness;
+		}
+	}
+	memmove(raw + nvar, values, cells * sizeof(float));
+	raw_size = nvar + cells * sizeof(float);
+
+	packed_len = compressBound(raw_size);
+	packed = (unsigned char *) GC_MALLOC_ATOMIC(packed_len);
+	if (packed == NULL) {
+		fprintf(stderr, "[SNAPSHOT] Out of Memory for frame %u of run %d!\n", snap->frames, snap->run);
+		return 1;
+	}
+	if (compress2(packed, &packed_len, raw, raw_size, 6) != Z_OK) {
+		fprintf(stderr, "[SNAPSHOT] zlib could not compress frame %u of run %d!\n", snap->frames, snap->run);
+		return 1;
+	}
+	packed_size = packed_len;
+
+	if (snap->frames == snap->size) {
+		snap->size *= 2;
+		grown = (long long *) GC_REALLOC(snap->offsets, snap->size * sizeof(long long));
+		if (grown == NULL) {
+			fprintf(stderr, "[SNAPSHOT] Out of Memory growing frame index of run %d!\n", snap->run);
+			return 1;
+		}
+		snap->offsets = grown;
+	}
+	snap->offsets[snap->frames] = (long long) ftello(snap->fp);
+
+	fwrite("FRAM", 1, 4, snap->fp);
+	fwrite(&snap->frames, sizeof(unsigned int), 1, snap->fp);
+	fwrite(&snap->pulses, sizeof(unsigned int), 1, snap->fp);
+	fwrite(&erupted, sizeof(double), 1, snap->fp);
+	fwrite(&cells, sizeof(unsigned int), 1, snap->fp);
+	fwrite(&raw_size, sizeof(unsigned long long), 1, snap->fp);
+	fwrite(&packed_size, sizeof(unsigned long long), 1, snap->fp);
+	fwrite(packed, 1, packed_len, snap->fp);
+	if (ferror(snap->fp)) {
+		fprintf(stderr, "[SNAPSHOT] Cannot write frame %u of run %d:[%s]!\n", snap->frames, snap->run, strerror(errno));
+		return 1;
+	}
+	snap->frame_pulse = snap->pulses;
+	snap->frames++;
+	return 0;
+}
+
+int SNAPSHOT_PULSE(
+Snapshot *snap,
+DataCell **grid,
+double erupted)
+{
+	int due = 0;
+
+	snap->pulses++;
+	if (snap->every_pulses && snap->pulses >= snap->next_pulse) {
+		snap->next_pulse += snap->every_pulses;
+		due = 1;
+	}
+	if (snap->every_volume > 0.0 && erupted >= snap->next_volume) {
+		while (snap->next_volume <= erupted) snap->next_volume += snap->every_volume;
+		due = 1;
+	}
+	if (!due) return 0;
+	return write_frame(snap, grid, erupted);
+}
+
+int SNAPSHOT_END(
+Snapshot *snap,
+DataCell **grid,
+double erupted)
+{
+	long long index_offset;
+	int row;
+
+	/* The last frame is the flow at the end of the run,
+	   unless the last pulse already wrote it */
+	if (!snap->frames || snap->frame_pulse != snap->pulses) {
+		if (write_frame(snap, grid, erupted)) return 1;
+	}
+
+	index_offset = (long long) ftello(snap->fp);
+	fwrite("SIDX", 1, 4, snap->fp);
+	fwrite(&snap->frames, sizeof(unsigned int), 1, snap->fp);
+	fwrite(snap->offsets, sizeof(long long), snap->frames, snap->fp);
+	fwrite(&index_offset, sizeof(long long), 1, snap->fp);
+	fwrite(SNAPSHOT_END_MAGIC, 1, 8, snap->fp);
+	if (ferror(snap->fp) || fclose(snap->fp)) {
+		fprintf(stderr, "[SNAPSHOT_END] Cannot write frame index of run %d:[%s]!\n", snap->run, strerror(errno));
+		return 1;
+	}
+	snap->fp = NULL;
+	fprintf(stderr, " Run %d: %u snapshot frames.\n", snap->run, snap->frames);
+
+	/* The next run starts from bare ground */
+	for (row = snap->rmin; row <= snap->rmax; row++)
+		memset(snap->last + (size_t) row * snap->cols + snap->cmin, 0,
+		       (size_t) (snap->cmax - snap->cmin + 1) * sizeof(float));
+	return 0;
+}
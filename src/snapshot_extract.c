@@ -0,0 +1,278 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*
+MOLASSES-SNAPSHOT:
+Reads the snapshot frames of a run written with SNAPSHOT_FILE (see snapshot_LJC2.c).
+
+Usage:
+	molasses-snapshot snapshot-file                    list the frames
+	molasses-snapshot snapshot-file frame raster-file  write one frame as a GeoTIFF
+	molasses-snapshot snapshot-file all prefix         write every frame, prefix<frame>.tif
+
+The GeoTIFF holds the lava thickness (Float32) of the whole grid, with
+the projection of the DEM.
+*/
+
+/* Read the frame index from the end of the file.
+   If the run did not end, find the frames by scanning from the header.
+   RETURN: number of frames, or -1 on error */
+static int read_index(
+FILE *in,
+long long first,
+long long **offsets)
+{
+	char magic[8], tag[4];
+	long long index_offset, offset, file_size;
+	unsigned int count = 0, size = 1024, frame, pulse, cells;
+	unsigned long long raw_size, packed_size;
+	double erupted;
+
+	if (!fseeko(in, -16, SEEK_END) &&
+	    fread(&index_offset, sizeof(long long), 1, in) == 1 &&
+	    fread(magic, 1, 8, in) == 8 && !memcmp(magic, SNAPSHOT_END_MAGIC, 8) &&
+	    !fseeko(in, index_offset, SEEK_SET) &&
+	    fread(tag, 1, 4, in) == 4 && !memcmp(tag, "SIDX", 4) &&
+	    fread(&count, sizeof(unsigned int), 1, in) == 1) {
+		*offsets = (long long *) malloc((count + 1) * sizeof(long long));
+		if (*offsets == NULL) return -1;
+		if (fread(*offsets, sizeof(long long), count, in) != count) return -1;
+		return (int) count;
+	}
+
+	fprintf(stderr, "No frame index found (run not finished?), scanning frames.\n");
+	if (fseeko(in, 0, SEEK_END)) return -1;
+	file_size = ftello(in);
+	*offsets = (long long *) malloc(size * sizeof(long long));
+	if (*offsets == NULL) return -1;
+	offset = first;
+	while (!fseeko(in, offset, SEEK_SET) && fread(tag, 1, 4, in) == 4 && !memcmp(tag, "FRAM", 4)) {
+		if (fread(&frame, sizeof(unsigned int), 1, in) != 1 ||
+		    fread(&pulse, sizeof(unsigned int), 1, in) != 1 ||
+		    fread(&erupted, sizeof(double), 1, in) != 1 ||
+		    fread(&cells, sizeof(unsigned int), 1, in) != 1 ||
+		    fread(&raw_size, sizeof(unsigned long long), 1, in) != 1 ||
+		    fread(&packed_size, sizeof(unsigned long long), 1, in) != 1) break;
+		if (ftello(in) + (long long) packed_size > file_size) break; /* cut off frame */
+		if (count == size) {
+			size *= 2;
+			*offsets = (long long *) realloc(*offsets, size * sizeof(long long));
+			if (*offsets == NULL) return -1;
+		}
+		(*offsets)[count++] = offset;
+		offset = ftello(in) + packed_size;
+	}
+	return (int) count;
+}
+
+/* Read the frame at [offset]: print it (thickness == NULL) or apply its
+   cells to thickness (row * cols + col). RETURN 0 or 1 on error */
+static int read_frame(
+FILE *in,
+long long offset,
+long long ncells,
+float *thickness)
+{
+	char tag[4];
+	unsigned int frame, pulse, cells, c;
+	unsigned long long raw_size, packed_size, index = 0, delta;
+	double erupted;
+	uLongf raw_len;
+	unsigned char *raw, *packed, *p, *end;
+	size_t n;
+
+	if (fseeko(in, offset, SEEK_SET) || fread(tag, 1, 4, in) != 4 || memcmp(tag, "FRAM", 4) ||
+	    fread(&frame, sizeof(unsigned int), 1, in) != 1 ||
+	    fread(&pulse, sizeof(unsigned int), 1, in) != 1 ||
+	    fread(&erupted, sizeof(double), 1, in) != 1 ||
+	    fread(&cells, sizeof(unsigned int), 1, in) != 1 ||
+	    fread(&raw_size, sizeof(unsigned long long), 1, in) != 1 ||
+	    fread(&packed_size, sizeof(unsigned long long), 1, in) != 1) {
+		fprintf(stderr, "[molasses-snapshot] Corrupt frame at offset %lld\n", offset);
+		return 1;
+	}
+	if (thickness == NULL) {
+		fprintf(stdout, "%u\t%u\t%0.3f\t%u\t%llu\n", frame, pulse, erupted, cells, packed_size);
+		return 0;
+	}
+
+	raw = (unsigned char *) malloc(raw_size + 1);
+	packed = (unsigned char *) malloc(packed_size + 1);
+	if (raw == NULL || packed == NULL) {
+		fprintf(stderr, "[molasses-snapshot] Out of Memory reading frame %u\n", frame);
+		return 1;
+	}
+	raw_len = raw_size;
+	if (fread(packed, 1, packed_size, in) != packed_size ||
+	    uncompress(raw, &raw_len, packed, packed_size) != Z_OK || raw_len != raw_size ||
+	    raw_size < (unsigned long long) cells * sizeof(float)) {
+		fprintf(stderr, "[molasses-snapshot] Cannot decompress frame %u\n", frame);
+		return 1;
+	}
+
+	/* The floats follow the varints */
+	p = raw;
+	end = raw + raw_size - (size_t) cells * sizeof(float);
+	for (c = 0; c < cells; c++) {
+		if (!(n = varint_get(p, end, &delta)) || (index += delta) >= (unsigned long long) ncells) {
+			fprintf(stderr, "[molasses-snapshot] Corrupt cell list in frame %u\n", frame);
+			return 1;
+		}
+		p += n;
+		memcpy(thickness + index, end + c * sizeof(float), sizeof(float));
+	}
+	free(raw); free(packed);
+	return 0;
+}
+
+/* Write the thickness grid as a GeoTIFF. RETURN 0 or 1 on error */
+static int write_frame(
+char *file,
+float *thickness,
+int cols,
+int rows,
+double *gridinfo,
+char *projection)
+{
+	GDALDatasetH hDstDS;
+	GDALRasterBandH hBand;
+	double GDALGeoTransform[6];
+	char **options = NULL;
+	CPLErr IOErr = CE_None;
+	int row;
+
+	/*Modify Metadata back to GDAL format*/
+	GDALGeoTransform[0] = gridinfo[0];
+	GDALGeoTransform[1] = gridinfo[1];
+	GDALGeoTransform[3] = gridinfo[3] + (gridinfo[5] * gridinfo[4]);
+	GDALGeoTransform[5] = -1 * gridinfo[5];
+	GDALGeoTransform[2] = GDALGeoTransform[4] = 0;
+
+	options = CSLSetNameValue(options, "TILED", "YES");
+	options = CSLSetNameValue(options, "BIGTIFF", "IF_SAFER");
+	options = CSLSetNameValue(options, "COMPRESS", "DEFLATE");
+	options = CSLSetNameValue(options, "PREDICTOR", "3");
+	hDstDS = GDALCreate(GDALGetDriverByName("GTiff"), file, cols, rows, 1, GDT_Float32, options);
+	CSLDestroy(options);
+	if (hDstDS == NULL) {
+		fprintf(stderr, "[molasses-snapshot] Cannot create raster file=[%s]!\n", file);
+		return 1;
+	}
+	GDALSetGeoTransform(hDstDS, GDALGeoTransform);
+	GDALSetProjection(hDstDS, projection);
+
+	/* Grid row 0 is the south row, the raster starts with the north row */
+	hBand = GDALGetRasterBand(hDstDS, 1);
+	for (row = 0; row < rows && IOErr == CE_None; row++)
+		IOErr = GDALRasterIO(hBand, GF_Write, 0, rows - 1 - row, cols, 1,
+		        thickness + (size_t) row * cols, cols, 1, GDT_Float32, 0, 0);
+	GDALClose(hDstDS);
+	if (IOErr) {
+		fprintf(stderr, "[molasses-snapshot] Error from GDALRasterIO writing [%s]!\n", file);
+		return 1;
+	}
+	fprintf(stderr, "Frame written: %s\n", file);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	FILE *in;
+	char magic[8], file[FILENAME_MAX], *projection;
+	int cols, rows, run, num_vents, len, count, i, last;
+	long long *offsets = NULL, first;
+	double gridinfo[6], volume, pulse, residual;
+	float *thickness;
+
+	if (argc != 2 && argc != 4) {
+		fprintf(stderr, "Usage: %s snapshot-file [frame raster-file | all prefix]\n", argv[0]);
+		return 1;
+	}
+	in = fopen(argv[1], "rb");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open snapshot file=[%s]:[%s]!\n", argv[1], strerror(errno));
+		return 1;
+	}
+	if (fread(magic, 1, 8, in) != 8 || memcmp(magic, SNAPSHOT_MAGIC, 8) ||
+	    fread(&cols, sizeof(int), 1, in) != 1 ||
+	    fread(&rows, sizeof(int), 1, in) != 1 ||
+	    fread(gridinfo, sizeof(double), 6, in) != 6 ||
+	    fread(&run, sizeof(int), 1, in) != 1 ||
+	    fread(&volume, sizeof(double), 1, in) != 1 ||
+	    fread(&pulse, sizeof(double), 1, in) != 1 ||
+	    fread(&residual, sizeof(double), 1, in) != 1 ||
+	    fread(&num_vents, sizeof(int), 1, in) != 1 ||
+	    fseeko(in, 2 * sizeof(double) * num_vents, SEEK_CUR) ||
+	    fread(&len, sizeof(int), 1, in) != 1 || len < 0) {
+		fprintf(stderr, "[%s] is not a MOLASSES snapshot file!\n", argv[1]);
+		return 1;
+	}
+	projection = (char *) malloc(len + 1);
+	if (projection == NULL || fread(projection, 1, len, in) != (size_t) len) {
+		fprintf(stderr, "[%s] is not a MOLASSES snapshot file!\n", argv[1]);
+		return 1;
+	}
+	projection[len] = '\0';
+	first = ftello(in);
+	count = read_index(in, first, &offsets);
+	if (count < 0) {
+		fprintf(stderr, "Cannot read the frame index of [%s]!\n", argv[1]);
+		return 1;
+	}
+
+	if (argc == 2) {
+		fprintf(stdout, "# %s: run %d, %d frames, grid %d cols x %d rows\n", argv[1], run, count, cols, rows);
+		fprintf(stdout, "# VOLUME PULSE RESIDUAL: %0.4f\t%0.4f\t%0.1f\n", volume, pulse, residual);
+		fprintf(stdout, "# FRAME PULSE ERUPTED CELLS BYTES\n");
+		for (i = 0; i < count; i++) if (read_frame(in, offsets[i], 0, NULL)) return 1;
+		return 0;
+	}
+
+	if (!strcmp(argv[2], "all")) last = count - 1;
+	else {
+		last = atoi(argv[2]);
+		if (last < 0 || last >= count) {
+			fprintf(stderr, "Frame %d is not in [%s] (%d frames)!\n", last, argv[1], count);
+			return 1;
+		}
+	}
+	thickness = (float *) calloc((size_t) cols * rows, sizeof(float));
+	if (thickness == NULL) {
+		fprintf(stderr, "[molasses-snapshot] Out of Memory for %d x %d cells\n", cols, rows);
+		return 1;
+	}
+	GDALAllRegister();
+	/* Each frame holds the cells changed since the previous one */
+	for (i = 0; i <= last; i++) {
+		if (read_frame(in, offsets[i], (long long) cols * rows, thickness)) return 1;
+		if (strcmp(argv[2], "all")) continue;
+		snprintf(file, sizeof file, "%s%d.tif", argv[3], i);
+		if (write_frame(file, thickness, cols, rows, gridinfo, projection)) return 1;
+	}
+	if (strcmp(argv[2], "all") && write_frame(argv[3], thickness, cols, rows, gridinfo, projection)) return 1;
+	fclose(in);
+	return 0;
+}
@@ -0,0 +1,279 @@
+/*############################################################################
+# MOLASSES (MOdular LAva Simulation Software for the Earth Sciences)
+# The MOLASSES model relies on a cellular automata algorithm to
+# estimate the area inundated by lava flows.
+#
+#    Copyright (C) 2015-2021
+#    Laura Connor (lconnor@usf.edu)
+#    Jacob Richardson
+#    Charles Connor
+#
+#    This program is free software: you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation, either version 3 of the License, or
+#    any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################*/
+
+#include "include/prototypes_LJC2.h"
+
+/*****************************
+MODULE: VOLUME_STEPS
+The flow of each run at smaller erupted volumes (VOLUME_STEPS in the
+config file). Every pulse is distributed before the next one erupts,
+so when a run has erupted V it holds the flow of volume V: one run of
+the largest volume gives the flows of all the smaller ones.
+
+VOLSTEPS_INIT     allocate the hit counters, open the outputs (or reopen
+                  those of a resumed ensemble, see ENSEMBLE_STATE)
+VOLSTEPS_BEGIN    start a run, or resume it (see FLOW_STATE)
+VOLSTEPS_PULSE    shorten the pulse that would erupt past the next step,
+                  so the flow is taken at the step volume exactly
+VOLSTEPS_REACHED  take the flow at the steps the run has reached
+VOLSTEPS_COMMIT   add the steps of a finished run to the outputs; a run
+                  that left the grid is retried, and its steps dropped
+VOLSTEPS_WIDEN    make the hit counters 32 bit
+VOLSTEPS_WRITE    write the hit probabilities, close the outputs
+
+Outputs, VOLUME_STEPS_FILE = prefix:
+	prefix.csv          run, volume, pulses, cells, area_km2,
+	                    max_thickness and runout of each run at each step
+	prefix_hits.tif     Float32, one band per step: the runs that
+	                    inundated each cell / the runs that reached the step
+	prefix_<volume>.mla the flows at each step as flow archives
+	                    (VOLUME_STEPS_ARCHIVE = Y), see molasses-extract
+A run that erupts less than a step volume does not count at that step.
+
+Hit counters are 16 bit when the ensemble has at most 65535 runs,
+32 bit otherwise, and widened before they would overflow, as in
+EXCEEDANCE.
+*******************************/
+
+/* a step is reached within rounding of the erupted volume */
+#define VOLSTEP_REACHED(vs, t, erupted) ((erupted) >= (vs)->volumes[t] * (1.0 - 1e-12))
+
+VolumeSteps *VOLSTEPS_INIT(
+Inputs *In,
+Outputs *Out,
+double *gridinfo)
+{
+	VolumeSteps *vs;
+	char file[1024];
+	size_t bytes;
+	int t;
+
+	vs = (VolumeSteps *) GC_MALLOC(sizeof(VolumeSteps));
+	if (vs == NULL) {
+		fprintf(stderr, "[VOLSTEPS_INIT] Out of Memory!\n");
+		return NULL;
+	}
+	vs->cols = (int) gridinfo[2];
+	vs->rows = (int) gridinfo[4];
+	vs->num_steps = Out->num_volume_steps;
+	vs->volumes = Out->step_volumes;
+	vs->next = vs->first = 0;
+	vs->wide = (In->runs > USHRT_MAX);
+	vs->runs = (int *) GC_MALLOC_ATOMIC(vs->num_steps * sizeof(int));
+	vs->taken = (FlowFootprint **) GC_MALLOC(vs->num_steps * sizeof(FlowFootprint *));
+	vs->pulses = (unsigned int *) GC_MALLOC_ATOMIC(vs->num_steps * sizeof(unsigned int));
+	vs->archives = NULL;
+	bytes = (size_t) vs->cols * (size_t) vs->rows * (size_t) vs->num_steps *
+	        (vs->wide ? sizeof(unsigned int) : sizeof(unsigned short));
+	vs->counts = GC_MALLOC_ATOMIC(bytes);
+	if (vs->runs == NULL || vs->taken == NULL || vs->pulses == NULL || vs->counts == NULL) {
+		fprintf(stderr, "[VOLSTEPS_INIT] Out of Memory for %d volume steps on %d x %d cells!\n",
+		        vs->num_steps, vs->cols, vs->rows);
+		return NULL;
+	}
+	memset(vs->runs, 0, vs->num_steps * sizeof(int));
+	memset(vs->counts, 0, bytes);
+
+	/* a resumed ensemble goes on after the runs of its checkpoint (see ENSEMBLE_STATE) */
+	snprintf(file, sizeof file, "%s.csv", Out->volume_steps_file);
+	if (In->resume_ensemble != NULL) {
+		vs->stats = ENSSTATE_REOPEN(file, In->resume_ensemble->steps_size);
+		if (vs->stats == NULL) return NULL;
+	}
+	else {
+		vs->stats = fopen(file, "w");
+		if (vs->stats == NULL) {
+			fprintf(stderr, "[VOLSTEPS_INIT] Cannot open %s:[%s]!\n", file, strerror(errno));
+			return NULL;
+		}
+		fprintf(vs->stats, "run,volume,pulses,cells,area_km2,max_thickness,runout\n");
+	}
+
+	if (Out->volume_steps_archive) {
+		vs->archives = (FlowArchive **) GC_MALLOC(vs->num_steps * sizeof(FlowArchive *));
+		if (vs->archives == NULL) {
+			fprintf(stderr, "[VOLSTEPS_INIT] Out of Memory!\n");
+			return NULL;
+		}
+		for (t = 0; t < vs->num_steps; t++) {
+			snprintf(file, sizeof file, "%s_%.0f.mla", Out->volume_steps_file, vs->volumes[t]);
+			if (In->resume_ensemble != NULL)
+				vs->archives[t] = ENSSTATE_ARCHIVE(In->resume_ensemble, ENSSTATE_STEP_ARCHIVES + t,
+				                                   file, gridinfo, ARCHIVE_MAGIC);
+			else vs->archives[t] = ARCHIVE_OPEN(file, gridinfo);
+			if (vs->archives[t] == NULL) {
+				fprintf(stderr, "[VOLSTEPS_INIT] Error returned from [ARCHIVE_OPEN].\n");
+				return NULL;
+			}
+		}
+	}
+	fprintf(stdout, "Volume steps (m^3):");
+	for (t = 0; t < vs->num_steps; t++) fprintf(stdout, " %g", vs->volumes[t]);
+	fprintf(stdout, "\n");
+	return vs;
+}
+
+void VOLSTEPS_BEGIN(
+VolumeSteps *vs,
+double erupted)
+{
+	/* a resumed run took the steps before its checkpoint */
+	for (vs->next = 0; vs->next < vs->num_steps && VOLSTEP_REACHED(vs, vs->next, erupted); vs->next++);
+	vs->first = vs->next;
+}
+
+double VOLSTEPS_PULSE(
+VolumeSteps *vs,
+double erupted,
+double pulsevolume)
+{
+	double left;
+
+	if (vs->next >= vs->num_steps) return pulsevolume;
+	left = vs->volumes[vs->next] - erupted;
+	if (left < pulsevolume && !VOLSTEP_REACHED(vs, vs->next, erupted)) return left;
+	return pulsevolume;
+}
+
+int VOLSTEPS_REACHED(
+VolumeSteps *vs,
+DataCell **grid,
+Lava_flow *flow,
+double *gridinfo,
+int run,
+unsigned int pulses,
+double erupted)
+{
+	FlowFootprint *fp;
+	int t;
+
+	while (vs->next < vs->num_steps && VOLSTEP_REACHED(vs, vs->next, erupted)) {
+		t = vs->next++;
+		fp = FOOTPRINT_SNAPSHOT(grid, flow, gridinfo, run);
+		if (fp == NULL) {
+			fprintf(stderr, "[VOLSTEPS_REACHED] Error returned from [FOOTPRINT_SNAPSHOT].\n");
+			return 1;
+		}
+		fp->volume = vs->volumes[t];
+		vs->taken[t] = fp;
+		vs->pulses[t] = pulses;
+	}
+	return 0;
+}
+
+int VOLSTEPS_WIDEN(
+VolumeSteps *vs)
+{
+	size_t n = (size_t) vs->cols * (size_t) vs->rows * (size_t) vs->num_steps, k;
+	unsigned int *counts;
+
+	counts = (unsigned int *) GC_MALLOC_ATOMIC(n * sizeof(unsigned int));
+	if (counts == NULL) {
+		fprintf(stderr, "[VOLSTEPS_WIDEN] Out of Memory for %d volume steps on %d x %d cells!\n",
+		        vs->num_steps, vs->cols, vs->rows);
+		return 1;
+	}
+	for (k = 0; k < n; k++) counts[k] = ((unsigned short *) vs->counts)[k];
+	vs->counts = counts;
+	vs->wide = 1;
+	return 0;
+}
+
+int VOLSTEPS_COMMIT(
+VolumeSteps *vs,
+double *gridinfo)
+{
+	FlowFootprint *fp;
+	size_t band = (size_t) vs->cols * (size_t) vs->rows, k;
+	double x, max_thickness, runout, distance, nearest;
+	unsigned int c;
+	int t, i;
+
+	for (t = vs->first; t < vs->next; t++) {
+		fp = vs->taken[t];
+		vs->taken[t] = NULL;
+		/* a count is at most the runs that reached the step */
+		if (!vs->wide && vs->runs[t] >= USHRT_MAX && VOLSTEPS_WIDEN(vs)) return 1;
+		max_thickness = runout = 0.0;
+		for (c = 0; c < fp->count; c++) {
+			k = (size_t) t * band + (size_t) fp->cells[c].row * vs->cols + fp->cells[c].col;
+			if (vs->wide) ((unsigned int *) vs->counts)[k]++;
+			else ((unsigned short *) vs->counts)[k]++;
+			x = fp->cells[c].eff_elev - fp->cells[c].dem_elev;
+			if (x > max_thickness) max_thickness = x;
+			nearest = DBL_MAX;
+			for (i = 0; i < fp->num_vents; i++) {
+				distance = hypot(gridinfo[0] + gridinfo[1] * fp->cells[c].col - fp->vents[i].easting,
+				                 gridinfo[3] + gridinfo[5] * fp->cells[c].row - fp->vents[i].northing);
+				if (distance < nearest) nearest = distance;
+			}
+			if (nearest > runout) runout = nearest;
+		}
+		vs->runs[t]++;
+		fprintf(vs->stats, "%d,%.4f,%u,%u,%.6f,%.6f,%.3f\n", fp->run, vs->volumes[t], vs->pulses[t], fp->count,
+		        fp->count * gridinfo[1] * gridinfo[5] / 1e6, max_thickness, runout);
+		if (vs->archives != NULL && ARCHIVE_WRITE_RUN(vs->archives[t], fp)) {
+			fprintf(stderr, "[VOLSTEPS_COMMIT] Error returned from [ARCHIVE_WRITE_RUN].\n");
+			return 1;
+		}
+	}
+	vs->first = vs->next;
+	return 0;
+}
+
+int VOLSTEPS_WRITE(
+VolumeSteps *vs,
+Outputs *Out,
+Inputs *In,
+double *gridinfo)
+{
+	size_t band = (size_t) vs->cols * (size_t) vs->rows, k, j = 0;
+	char file[1024];
+	float *data;
+	double count;
+	int t, row, col, ret = 0;
+
+	if (fclose(vs->stats)) ret = 1;
+	if (vs->archives != NULL)
+		for (t = 0; t < vs->num_steps; t++)
+			if (ARCHIVE_CLOSE(vs->archives[t])) ret = 1;
+	data = (float *) GC_MALLOC_ATOMIC(band * vs->num_steps * sizeof(float));
+	if (data == NULL) {
+		fprintf(stderr, "[VOLSTEPS_WRITE] Out of Memory creating raster data!\n");
+		return 1;
+	}
+	/* band sequential, top row first */
+	for (t = 0; t < vs->num_steps; t++) {
+		for (row = vs->rows - 1; row >= 0; row--) {
+			for (col = 0, k = t * band + (size_t) row * vs->cols; col < vs->cols; col++, k++) {
+				count = vs->wide ? ((unsigned int *) vs->counts)[k] : ((unsigned short *) vs->counts)[k];
+				data[j++] = vs->runs[t] ? (float) (count / vs->runs[t]) : 0.0f;
+			}
+		}
+		fprintf(stdout, "Volume step %g: %d runs\n", vs->volumes[t], vs->runs[t]);
+	}
+	snprintf(file, sizeof file, "%s_hits.tif", Out->volume_steps_file);
+	if (WRITE_RASTER(file, data, GDT_Float32, vs->num_steps, Out, In, gridinfo)) ret = 1;
+	return ret;
+}